@@ -0,0 +1,134 @@
+/*  executor_bench.c
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Throughput of the sharded executor on synthetic traffic (mostly CCs, some single-value sysex), for 1, 2, 4, ...
+// shards up to the number of CPUs. Each run uses as many producer threads as shards.
+//
+// Usage: executor_bench [instances (256)] [events per run (2000000)] [max shards (CPUs)]
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libh9.h"
+
+#define SYSEX_EVERY 20  // One event in SYSEX_EVERY is sysex
+
+typedef struct producer {
+    pthread_t    thread;
+    h9_executor* executor;
+    size_t       first_event;
+    size_t       num_events;
+    size_t       num_instances;
+} producer;
+
+static double now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + 1.0E-9 * (double)now.tv_nsec;
+}
+
+// Instance i listens on port (i / 16) % 16, channel i % 16, sysex id i % 16 + 1
+static void* produce(void* arg) {
+    producer* p = arg;
+    for (size_t e = p->first_event; e < p->first_event + p->num_events; e++) {
+        size_t  target  = (e * 7919) % p->num_instances;  // scatter over instances
+        uint8_t port    = (target / 16) % H9_EXECUTOR_MAX_PORTS;
+        uint8_t channel = target % 16;
+        bool    posted;
+        do {
+            if (e % SYSEX_EVERY == 0) {
+                uint8_t sysex[] = {0xF0, 0x1C, 0x70, (uint8_t)(channel + 1), 0x2E, '1', '0', '2', ' ', (uint8_t)('0' + (e & 1)), 0x00, 0xF7};
+                posted          = h9_executorPostSysex(p->executor, port, sysex, sizeof(sysex));
+            } else {
+                posted = h9_executorPostCC(p->executor, port, channel, 22 + (e % 10), e & 0x7F);
+            }
+            if (!posted) {
+                sched_yield();  // Back off while the shard catches up
+            }
+        } while (!posted);
+    }
+    return NULL;
+}
+
+static double run(size_t num_shards, h9** instances, size_t num_instances, size_t num_events) {
+    h9_executor* executor = h9_executor_new(num_shards, 4096, true);
+    if (executor == NULL) {
+        fprintf(stderr, "Could not create an executor with %zu shards\n", num_shards);
+        exit(1);
+    }
+    for (size_t i = 0; i < num_instances; i++) {
+        h9_executorAdd(executor, instances[i], (i / 16) % H9_EXECUTOR_MAX_PORTS);
+    }
+    h9_executorStart(executor);
+
+    producer producers[H9_EXECUTOR_MAX_SHARDS];
+    size_t   per_producer = num_events / num_shards;
+    double   start        = now_seconds();
+    for (size_t i = 0; i < num_shards; i++) {
+        producers[i] = (producer){.executor = executor, .first_event = i * per_producer, .num_events = per_producer, .num_instances = num_instances};
+        pthread_create(&producers[i].thread, NULL, produce, &producers[i]);
+    }
+    for (size_t i = 0; i < num_shards; i++) {
+        pthread_join(producers[i].thread, NULL);
+    }
+    h9_executorDrain(executor);
+    double elapsed = now_seconds() - start;
+
+    h9_executor_delete(executor);
+    return (double)(per_producer * num_shards) / elapsed;
+}
+
+int main(int argc, char* argv[]) {
+    size_t num_instances = (argc > 1) ? strtoul(argv[1], NULL, 10) : 256;
+    size_t num_events    = (argc > 2) ? strtoul(argv[2], NULL, 10) : 2000000;
+    long   num_cpus      = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t max_shards    = (argc > 3) ? strtoul(argv[3], NULL, 10) : (num_cpus > 0 ? (size_t)num_cpus : 1);
+    if (max_shards > H9_EXECUTOR_MAX_SHARDS) {
+        max_shards = H9_EXECUTOR_MAX_SHARDS;
+    }
+
+    h9** instances = calloc(num_instances, sizeof(*instances));
+    for (size_t i = 0; i < num_instances; i++) {
+        instances[i]                              = h9_new();
+        instances[i]->midi_config.midi_rx_channel = i % 16;
+        instances[i]->midi_config.sysex_id        = i % 16 + 1;
+    }
+
+    printf("%zu instances, %zu events per run, 1 in %d sysex, %ld CPUs\n", num_instances, num_events, SYSEX_EVERY, num_cpus);
+    printf("%8s %16s %10s\n", "shards", "events/s", "speedup");
+    double baseline = 0.0;
+    for (size_t shards = 1; shards <= max_shards; shards *= 2) {
+        double rate = run(shards, instances, num_instances, num_events);
+        if (shards == 1) {
+            baseline = rate;
+        }
+        printf("%8zu %16.0f %9.2fx\n", shards, rate, rate / baseline);
+    }
+
+    for (size_t i = 0; i < num_instances; i++) {
+        h9_delete(instances[i]);
+    }
+    free(instances);
+    return 0;
+}
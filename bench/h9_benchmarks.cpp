@@ -0,0 +1,606 @@
+/*  h9_benchmarks.cpp
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Microbenchmarks of libh9's hot paths: sysex parsing and generation, incoming CCs, control changes and the utils.c
+// scanning and summing kernels. Plus one end to end benchmark, streaming a generated corpus (test/h9_corpus.h) of
+// programs and sysvars dumps through parse, modify and dump.
+//
+// Usage: benchmarks [google benchmark options], e.g. --benchmark_filter=Parse
+//        or build the benchmarks_json target, which writes benchmarks.json in the build directory.
+
+#include <stdio.h>
+#include <string.h>
+#include <memory>
+#include <random>
+#include <vector>
+#include "h9_corpus.h"
+#include "libh9.h"
+#include "libh9.hpp"
+#include "utils.h"
+
+#include "benchmark/benchmark.h"
+
+#ifndef H9_TEST_DATA_DIR
+#define H9_TEST_DATA_DIR "test_data"
+#endif
+
+#define SYSEX_MAX_LEN 640
+#define SP_BYPASS     0x102  // The bypass sysvar key
+
+namespace h9_bench {
+
+static const char kProgram[] =
+    "\xf0\x1c\x70\x01\x4f"
+    "[1] 8 5 5\r\n"
+    " 8 3ff0 3ff0 3ff0 2c92 293c 3226 3458 b12 5656 0 0\r\n"
+    " 0 0 0 0 0 0 0 0 0 0 0 0 3459 2c38 0 0 5657 6fcf 7088 6264 23cf 0 0 0 0 0 0 0 0 0\r\n"
+    " 0 c42 0 14 9 8 4 0\r\n"
+    " 65000 65000 65000 65000 65000 65000 65000 65000 65000 65000 65000 65000\r\n"
+    "C_ee49\r\n"
+    "HRMDLO\r\n";
+static const char kValueDump[] = "\xf0\x1c\x70\x01\x2e"
+                                 "102 1";  // sp_bypass = 1
+
+// Same-sized lines of hex, decimal and float words as found in a preset's rows
+static const char kHexLine[]   = " 8 3ff0 3ff0 3ff0 2c92 293c 3226 3458 b12 5656 0 0 3459 2c38 0 0 5657 6fcf 7088 6264 23cf 0 0 0";
+static const char kDecLine[]   = " 65000 65000 65000 65000 65000 65000 65000 65000 65000 65000 65000 65000 1 2 3 4 5 6 7 8 9 10 11 12";
+static const char kFloatLine[] = " 0.000000 0.125000 120.500000 1.000000 0.500000 0.250000 0.750000 0.333333 12.000000 8.000000 -4.5 7";
+static const char kBoolLine[]  = " 1 0 1 1 0 0 1 0 1 1 1 0 0 0 1 0 1 0 1 1 0 1 0 1";
+
+#define KERNEL_WORDS 24  // Words in each of the lines above
+
+#define CORPUS_SEED        0x5EED
+#define CORPUS_MESSAGES    4096
+#define CORPUS_SYSVARS_1IN 16  // One message in this many is a sysvars dump, the rest are programs
+
+static std::vector<uint8_t> LoadSysvars(void) {
+    std::vector<uint8_t> sysex;
+    FILE *               file = fopen(H9_TEST_DATA_DIR "/Device_Config1.syx", "rb");
+    if (file == nullptr) {
+        return sysex;
+    }
+    uint8_t buffer[1024];
+    size_t  len = fread(buffer, 1, sizeof(buffer), file);
+    fclose(file);
+    sysex.assign(buffer, buffer + len);
+    return sysex;
+}
+
+static h9 *NewLoadedH9(void) {
+    h9 *h9obj = h9_new();
+    h9_parse_sysex(h9obj, (uint8_t *)kProgram, sizeof(kProgram) - 1, kH9_RESPOND_TO_ANY_SYSEX_ID);
+    return h9obj;
+}
+
+// ==== Sysex
+
+static void BM_ParseSysexProgram(benchmark::State &state) {
+    h9 *h9obj = h9_new();
+    if (h9_parse_sysex(h9obj, (uint8_t *)kProgram, sizeof(kProgram) - 1, kH9_RESPOND_TO_ANY_SYSEX_ID) != kH9_OK) {
+        state.SkipWithError("Payload does not parse");
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(h9_parse_sysex(h9obj, (uint8_t *)kProgram, sizeof(kProgram) - 1, kH9_RESPOND_TO_ANY_SYSEX_ID));
+    }
+    state.SetBytesProcessed(state.iterations() * (sizeof(kProgram) - 1));
+    h9_delete(h9obj);
+}
+BENCHMARK(BM_ParseSysexProgram);
+
+static void BM_ParseSysexSysvars(benchmark::State &state) {
+    std::vector<uint8_t> sysvars = LoadSysvars();
+    if (sysvars.empty()) {
+        state.SkipWithError("Could not read " H9_TEST_DATA_DIR "/Device_Config1.syx");
+        return;
+    }
+    h9 *h9obj = h9_new();
+    if (h9_parse_sysex(h9obj, sysvars.data(), sysvars.size(), kH9_RESPOND_TO_ANY_SYSEX_ID) != kH9_OK) {
+        state.SkipWithError("Payload does not parse");
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(h9_parse_sysex(h9obj, sysvars.data(), sysvars.size(), kH9_RESPOND_TO_ANY_SYSEX_ID));
+    }
+    state.SetBytesProcessed(state.iterations() * sysvars.size());
+    h9_delete(h9obj);
+}
+BENCHMARK(BM_ParseSysexSysvars);
+
+static void BM_ParseSysexValueDump(benchmark::State &state) {
+    h9 *h9obj = h9_new();
+    if (h9_parse_sysex(h9obj, (uint8_t *)kValueDump, sizeof(kValueDump) - 1, kH9_RESPOND_TO_ANY_SYSEX_ID) != kH9_OK) {
+        state.SkipWithError("Payload does not parse");
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(h9_parse_sysex(h9obj, (uint8_t *)kValueDump, sizeof(kValueDump) - 1, kH9_RESPOND_TO_ANY_SYSEX_ID));
+    }
+    state.SetBytesProcessed(state.iterations() * (sizeof(kValueDump) - 1));
+    h9_delete(h9obj);
+}
+BENCHMARK(BM_ParseSysexValueDump);
+
+// Traffic for another pedal on the same bus, discarded from the header
+static void BM_ParseSysexOtherPedal(benchmark::State &state) {
+    h9 *h9obj                   = h9_new();
+    h9obj->midi_config.sysex_id = 2;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(h9_parse_sysex(h9obj, (uint8_t *)kProgram, sizeof(kProgram) - 1, kH9_RESTRICT_TO_SYSEX_ID));
+    }
+    state.SetBytesProcessed(state.iterations() * (sizeof(kProgram) - 1));
+    h9_delete(h9obj);
+}
+BENCHMARK(BM_ParseSysexOtherPedal);
+
+static void BM_Dump(benchmark::State &state) {
+    h9 *    h9obj = NewLoadedH9();
+    uint8_t sysex[SYSEX_MAX_LEN];
+    size_t  len = 0;
+    for (auto _ : state) {
+        len = h9_dump(h9obj, sysex, sizeof(sysex), false);
+        benchmark::DoNotOptimize(sysex);
+    }
+    state.SetBytesProcessed(state.iterations() * len);
+    h9_delete(h9obj);
+}
+BENCHMARK(BM_Dump);
+
+// ==== Incoming CCs
+
+static void BM_CCMsbOnly(benchmark::State &state) {
+    h9 *    h9obj = NewLoadedH9();
+    uint8_t cc    = h9obj->midi_config.cc_tx_map[KNOB3];
+    uint8_t value = 0;
+    for (auto _ : state) {
+        h9_cc(h9obj, cc, value++ & 0x7F);
+    }
+    benchmark::DoNotOptimize(h9obj->preset->knobs[KNOB3].current_value);
+    h9_delete(h9obj);
+}
+BENCHMARK(BM_CCMsbOnly);
+
+static void BM_CCMsbLsb(benchmark::State &state) {
+    h9 *    h9obj = NewLoadedH9();
+    uint8_t cc    = h9obj->midi_config.cc_tx_map[KNOB3];
+    uint8_t value = 0;
+    for (auto _ : state) {
+        h9_cc(h9obj, cc, value++ & 0x7F);
+        h9_cc(h9obj, cc + 32, 0x55);
+    }
+    benchmark::DoNotOptimize(h9obj->preset->knobs[KNOB3].current_value);
+    h9_delete(h9obj);
+}
+BENCHMARK(BM_CCMsbLsb);
+
+// A queue of MSB/LSB pairs drained in one call, each paired by its own timestamp; items_per_second is CCs per second
+static void BM_CCBatch(benchmark::State &state) {
+    h9 *                     h9obj = NewLoadedH9();
+    uint8_t                  cc    = h9obj->midi_config.cc_tx_map[KNOB3];
+    std::vector<h9_cc_event> events;
+    for (size_t i = 0; i < (size_t)state.range(0); i += 2) {
+        events.push_back({(double)i, cc, (uint8_t)(i & 0x7F)});
+        events.push_back({(double)i + 0.5, (uint8_t)(cc + 32), 0x55});
+    }
+    for (auto _ : state) {
+        h9_ccBatch(h9obj, events.data(), events.size());
+    }
+    benchmark::DoNotOptimize(h9obj->preset->knobs[KNOB3].current_value);
+    state.SetItemsProcessed(state.iterations() * (int64_t)events.size());
+    h9_delete(h9obj);
+}
+BENCHMARK(BM_CCBatch)->Arg(1024);
+
+// ==== Controls
+
+static void BM_SetControlKnob(benchmark::State &state) {
+    h9 *          h9obj = NewLoadedH9();
+    control_value value = 0.0;
+    for (auto _ : state) {
+        h9_setControl(h9obj, KNOB3, value, kH9_SUPPRESS_CALLBACK);
+        value = (value >= 1.0) ? 0.0 : value + 0.001;
+    }
+    h9_delete(h9obj);
+}
+BENCHMARK(BM_SetControlKnob);
+
+// Moving the expression pedal with every knob mapped to it re-evaluates all ten
+static void BM_SetControlExprMapped(benchmark::State &state) {
+    h9 *h9obj = NewLoadedH9();
+    for (size_t i = 0; i < H9_NUM_KNOBS; i++) {
+        h9_setKnobMap(h9obj, (control_id)i, 0.0, 1.0, 0.5);
+    }
+    control_value value = 0.0;
+    for (auto _ : state) {
+        h9_setControl(h9obj, EXPR, value, kH9_SUPPRESS_CALLBACK);
+        value = (value >= 1.0) ? 0.0 : value + 0.001;
+    }
+    h9_delete(h9obj);
+}
+BENCHMARK(BM_SetControlExprMapped);
+
+static void BM_SetControlPswMapped(benchmark::State &state) {
+    h9 *h9obj = NewLoadedH9();
+    for (size_t i = 0; i < H9_NUM_KNOBS; i++) {
+        h9_setKnobMap(h9obj, (control_id)i, 0.0, 1.0, 0.5);
+    }
+    bool psw = false;
+    for (auto _ : state) {
+        psw = !psw;
+        h9_setControl(h9obj, PSW, psw ? 1.0 : 0.0, kH9_SUPPRESS_CALLBACK);
+    }
+    h9_delete(h9obj);
+}
+BENCHMARK(BM_SetControlPswMapped);
+
+// ==== Fleets
+
+#define FLEET_EVENTS 4096
+
+// Knob moves spread over the instances in random order; the same seed gives both fleet benchmarks the same events
+static std::vector<h9_fleet_event> FleetEvents(size_t num_instances) {
+    std::mt19937                random(CORPUS_SEED);
+    std::vector<h9_fleet_event> events(FLEET_EVENTS);
+    for (h9_fleet_event &event : events) {
+        event.instance = (uint32_t)(random() % num_instances);
+        event.control  = (control_id)(random() % H9_NUM_KNOBS);
+        event.value    = (control_value)(random() % 1000) / 1000.0f;
+    }
+    return events;
+}
+
+// items_per_second is control events per second, across the fleet
+static void BM_FleetApply(benchmark::State &state) {
+    size_t                      num_instances = (size_t)state.range(0);
+    h9_fleet *                  fleet         = h9_fleet_new(num_instances);
+    std::vector<h9_fleet_event> events        = FleetEvents(num_instances);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(h9_fleetApply(fleet, events.data(), events.size(), kH9_SUPPRESS_CALLBACK));
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t)events.size());
+    h9_fleet_delete(fleet);
+}
+BENCHMARK(BM_FleetApply)->Arg(100)->Arg(1000);
+
+// The same events through h9_setControl on separately allocated instances, for comparison with BM_FleetApply
+static void BM_FleetSetControlLoop(benchmark::State &state) {
+    size_t                      num_instances = (size_t)state.range(0);
+    std::vector<h9 *>           instances(num_instances);
+    std::vector<h9_fleet_event> events = FleetEvents(num_instances);
+    for (h9 *&instance : instances) {
+        instance = h9_new();
+    }
+    for (auto _ : state) {
+        for (const h9_fleet_event &event : events) {
+            h9_setControl(instances[event.instance], event.control, event.value, kH9_SUPPRESS_CALLBACK);
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t)events.size());
+    for (h9 *instance : instances) {
+        h9_delete(instance);
+    }
+}
+BENCHMARK(BM_FleetSetControlLoop)->Arg(100)->Arg(1000);
+
+// ==== utils.c kernels
+
+template <typename T>
+static void ScanLine(benchmark::State &state, const char *line, size_t (*scan)(char *, size_t, T *, size_t)) {
+    char   buffer[256];
+    size_t len = strlen(line);
+    memcpy(buffer, line, len + 1);
+    T values[KERNEL_WORDS];
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(scan(buffer, len, values, KERNEL_WORDS));
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * len);
+}
+// Sysex logging: hex encoding of a large capture, into one buffer and streamed in chunks
+static void BM_Hexdump(benchmark::State &state) {
+    std::vector<uint8_t> data(state.range(0));
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = (uint8_t)(i * 131);
+    }
+    std::vector<char> text(data.size() * 3 + 1);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(hexdump(text.data(), text.size(), data.data(), data.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_Hexdump)->Arg(256)->Arg(4 << 20);
+
+static void discard_chunk(void *context, const char *chunk, size_t len) {
+    benchmark::DoNotOptimize(chunk);
+    *static_cast<size_t *>(context) += len;
+}
+
+static void BM_HexdumpStream(benchmark::State &state) {
+    std::vector<uint8_t> data(state.range(0));
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = (uint8_t)(i * 131);
+    }
+    size_t total = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(hexdump_stream(data.data(), data.size(), discard_chunk, &total));
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_HexdumpStream)->Arg(4 << 20);
+
+static void BM_ScanHex(benchmark::State &state) {
+    ScanLine<uint32_t>(state, kHexLine, scanhex);
+}
+BENCHMARK(BM_ScanHex);
+
+static void BM_ScanHexWord(benchmark::State &state) {
+    ScanLine<uint16_t>(state, kHexLine, scanhex_word);
+}
+BENCHMARK(BM_ScanHexWord);
+
+static void BM_ScanHexByte(benchmark::State &state) {
+    ScanLine<uint8_t>(state, kBoolLine, scanhex_byte);
+}
+BENCHMARK(BM_ScanHexByte);
+
+static void BM_ScanHexBool(benchmark::State &state) {
+    ScanLine<bool>(state, kBoolLine, scanhex_bool);
+}
+BENCHMARK(BM_ScanHexBool);
+
+static void BM_ScanDec(benchmark::State &state) {
+    ScanLine<int32_t>(state, kDecLine, scandec);
+}
+BENCHMARK(BM_ScanDec);
+
+static void BM_ScanFloat(benchmark::State &state) {
+    ScanLine<float>(state, kFloatLine, scanfloat);
+}
+BENCHMARK(BM_ScanFloat);
+
+static void BM_ScanHexBool32(benchmark::State &state) {
+    char   buffer[256];
+    size_t len = strlen(kBoolLine);
+    memcpy(buffer, kBoolLine, len + 1);
+    uint32_t bits = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(scanhex_bool32(buffer, len, &bits));
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * len);
+}
+BENCHMARK(BM_ScanHexBool32);
+
+template <typename T, uint16_t (*Sum)(T *, size_t)>
+static void BM_Sum(benchmark::State &state) {
+    size_t               len = state.range(0);
+    std::unique_ptr<T[]> values(new T[len]);  // Not a vector, vector<bool> has no data()
+    for (size_t i = 0; i < len; i++) {
+        values[i] = (T)(i * 2654435761U);
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Sum(values.get(), len));
+    }
+    state.SetBytesProcessed(state.iterations() * len * sizeof(T));
+}
+BENCHMARK_TEMPLATE2(BM_Sum, uint32_t, array_sum)->Arg(32)->Arg(1024);
+BENCHMARK_TEMPLATE2(BM_Sum, uint16_t, array_sum16)->Arg(32)->Arg(1024);
+BENCHMARK_TEMPLATE2(BM_Sum, uint8_t, array_sum8)->Arg(32)->Arg(1024);
+BENCHMARK_TEMPLATE2(BM_Sum, bool, array_sum1)->Arg(32)->Arg(1024);
+BENCHMARK_TEMPLATE2(BM_Sum, float, iarray_sumf)->Arg(32)->Arg(1024);
+
+// ==== C++ wrapper (libh9.hpp), each against its C twin: the pairs should match
+
+static void BM_ControlValue(benchmark::State &state) {
+    h9 *h9obj = NewLoadedH9();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(h9_controlValue(h9obj, KNOB3));
+    }
+    h9_delete(h9obj);
+}
+BENCHMARK(BM_ControlValue);
+
+static void BM_CppControlValue(benchmark::State &state) {
+    libh9::H9 pedal(NewLoadedH9());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(pedal.value<KNOB3>());
+    }
+}
+BENCHMARK(BM_CppControlValue);
+
+static void BM_CppSetControlKnob(benchmark::State &state) {
+    libh9::H9     pedal(NewLoadedH9());
+    control_value value = 0.0;
+    for (auto _ : state) {
+        pedal.set<KNOB3>(value);
+        value = (value >= 1.0) ? 0.0 : value + 0.001;
+    }
+}
+BENCHMARK(BM_CppSetControlKnob);
+
+static void CountDisplay(void *ctx, control_id control, control_value current_value, control_value display_value) {
+    (*static_cast<size_t *>(ctx))++;
+}
+
+static void BM_SetControlWithCallback(benchmark::State &state) {
+    h9 *          h9obj   = NewLoadedH9();
+    size_t        updates = 0;
+    control_value value   = 0.0;
+    h9obj->display_callback = CountDisplay;
+    h9obj->callback_context = &updates;
+    for (auto _ : state) {
+        h9_setControl(h9obj, KNOB3, value, kH9_SUPPRESS_CALLBACK);
+        value = (value >= 1.0) ? 0.0 : value + 0.001;
+    }
+    benchmark::DoNotOptimize(updates);
+    h9_delete(h9obj);
+}
+BENCHMARK(BM_SetControlWithCallback);
+
+static void BM_CppSetControlWithLambda(benchmark::State &state) {
+    libh9::H9 pedal(NewLoadedH9());
+    size_t    updates = 0;
+    pedal.onDisplay([&updates](control_id, control_value, control_value) { updates++; });
+    control_value value = 0.0;
+    for (auto _ : state) {
+        pedal.set<KNOB3>(value);
+        value = (value >= 1.0) ? 0.0 : value + 0.001;
+    }
+    benchmark::DoNotOptimize(updates);
+}
+BENCHMARK(BM_CppSetControlWithLambda);
+
+static void BM_CppParseSysexProgram(benchmark::State &state) {
+    libh9::H9                  pedal;
+    libh9::span<const uint8_t> sysex(reinterpret_cast<const uint8_t *>(kProgram), sizeof(kProgram) - 1);
+    if (pedal.parse(sysex, kH9_RESPOND_TO_ANY_SYSEX_ID) != kH9_OK) {
+        state.SkipWithError("Payload does not parse");
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(pedal.parse(sysex, kH9_RESPOND_TO_ANY_SYSEX_ID));
+    }
+    state.SetBytesProcessed(state.iterations() * sysex.size());
+}
+BENCHMARK(BM_CppParseSysexProgram);
+
+static void BM_CppDump(benchmark::State &state) {
+    libh9::H9 pedal(NewLoadedH9());
+    uint8_t   sysex[SYSEX_MAX_LEN];
+    size_t    len = 0;
+    for (auto _ : state) {
+        len = pedal.dump(sysex);
+        benchmark::DoNotOptimize(sysex);
+    }
+    state.SetBytesProcessed(state.iterations() * len);
+}
+BENCHMARK(BM_CppDump);
+
+// Automation as it arrives in a MIDI file: each track sweeps one knob with 14-bit CCs, an MSB then its LSB a tick
+// later, and the first track sends a program every 256 sweep steps. Returns a format 1 SMF.
+static std::vector<uint8_t> AutomationSmf(size_t num_tracks, size_t steps) {
+    auto put_be = [](std::vector<uint8_t> &dest, uint32_t value, size_t len) {
+        for (size_t i = len; i > 0; i--) {
+            dest.push_back((uint8_t)(value >> (8 * (i - 1))));
+        }
+    };
+    h9 *                 h9obj = h9_new();
+    std::vector<uint8_t> file  = {'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1};
+    put_be(file, (uint32_t)num_tracks, 2);
+    put_be(file, 480, 2);
+    for (size_t track = 0; track < num_tracks; track++) {
+        std::vector<uint8_t> events;
+        uint8_t              cc = h9obj->midi_config.cc_tx_map[KNOB0 + track % H9_NUM_KNOBS];
+        for (size_t step = 0; step < steps; step++) {
+            events.insert(events.end(), {0x08, 0xB0, cc, (uint8_t)(step & 0x7F), 0x01, (uint8_t)(cc + 32), (uint8_t)((step * 3) & 0x7F)});
+            if (track == 0 && step % 256 == 0) {
+                uint32_t len = sizeof(kProgram) - 2;  // Without the F0, as a two byte varint
+                events.insert(events.end(), {0x00, 0xF0, (uint8_t)(0x80 | (len >> 7)), (uint8_t)(len & 0x7F)});
+                events.insert(events.end(), kProgram + 1, kProgram + sizeof(kProgram) - 1);
+            }
+        }
+        events.insert(events.end(), {0x00, 0xFF, 0x2F, 0x00});
+        file.insert(file.end(), {'M', 'T', 'r', 'k'});
+        put_be(file, (uint32_t)events.size(), 4);
+        file.insert(file.end(), events.begin(), events.end());
+    }
+    h9_delete(h9obj);
+    return file;
+}
+
+// h9_ccAt and h9_parse_sysex driven by h9_smfPlay as fast as it goes; items_per_second is events per second
+static void BM_SmfPlay(benchmark::State &state) {
+    std::vector<uint8_t> file  = AutomationSmf((size_t)state.range(0), 4096);
+    h9_smf *             smf   = h9_smfOpenBuffer(file.data(), file.size());
+    h9 *                 h9obj = NewLoadedH9();
+    h9_smf_result        result;
+    uint64_t             events = 0;
+    if (smf == NULL) {
+        state.SkipWithError("Generated file does not open");
+    }
+    for (auto _ : state) {
+        h9_smfPlay(smf, h9obj, kH9_SMF_FAST, &result);
+        events += result.ccs + result.sysex;
+    }
+    state.SetItemsProcessed((int64_t)events);
+    h9_smfClose(smf);
+    h9_delete(h9obj);
+}
+BENCHMARK(BM_SmfPlay)->Arg(1)->Arg(16)->Unit(benchmark::kMillisecond);
+
+// ==== End to end
+
+struct CorpusMessage {
+    std::vector<uint8_t> sysex;
+    bool                 is_program;
+};
+
+static const std::vector<CorpusMessage> &Corpus(void) {
+    static std::vector<CorpusMessage> messages;
+    if (messages.empty()) {
+        corpus  generator;
+        uint8_t sysex[CORPUS_MAX_SYSEX];
+        corpus_init(&generator, CORPUS_SEED);
+        for (size_t i = 0; i < CORPUS_MESSAGES; i++) {
+            bool   is_program = (i % CORPUS_SYSVARS_1IN) != 0;
+            size_t len        = is_program ? corpus_program(&generator, sysex, sizeof(sysex)) : corpus_sysvars(&generator, sysex, sizeof(sysex));
+            messages.push_back({std::vector<uint8_t>(sysex, sysex + len), is_program});
+        }
+    }
+    return messages;
+}
+
+// What archive tools and sync daemons do with every message: parse it, change something, and write it back out.
+// Each iteration streams the whole corpus; items_per_second is messages per second.
+static void BM_CorpusParseModifyDump(benchmark::State &state) {
+    const std::vector<CorpusMessage> &messages = Corpus();
+    h9 *                              h9obj    = h9_new();
+    uint8_t                           out[CORPUS_MAX_SYSEX];
+    size_t                            bytes_in = 0;
+    for (const CorpusMessage &message : messages) {
+        bytes_in += message.sysex.size();
+    }
+    size_t failures = 0;
+    size_t knob     = 0;
+    for (auto _ : state) {
+        for (const CorpusMessage &message : messages) {
+            if (h9_parse_sysex(h9obj, (uint8_t *)message.sysex.data(), message.sysex.size(), kH9_RESPOND_TO_ANY_SYSEX_ID) != kH9_OK) {
+                failures++;
+                continue;
+            }
+            if (message.is_program) {
+                knob = (knob + 1) % H9_NUM_KNOBS;
+                h9_setControl(h9obj, (control_id)knob, 0.5, kH9_SUPPRESS_CALLBACK);
+                benchmark::DoNotOptimize(h9_dump(h9obj, out, sizeof(out), true));
+            } else {
+                benchmark::DoNotOptimize(h9_sysexGenWriteConfigVar(h9obj, SP_BYPASS, !h9obj->bypass, out, sizeof(out)));
+            }
+        }
+        benchmark::ClobberMemory();
+    }
+    if (failures > 0) {
+        state.SkipWithError("Corpus messages failed to parse");
+    }
+    state.SetItemsProcessed(state.iterations() * messages.size());
+    state.SetBytesProcessed(state.iterations() * bytes_in);
+    h9_delete(h9obj);
+}
+BENCHMARK(BM_CorpusParseModifyDump)->Unit(benchmark::kMillisecond)->MinTime(2.0);
+
+}  // namespace h9_bench
+
+BENCHMARK_MAIN();
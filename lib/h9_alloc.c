@@ -0,0 +1,227 @@
+/*  h9_alloc.c
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "h9_alloc.h"
+
+#include <string.h>
+
+#ifndef H9_FREESTANDING
+#include <pthread.h>
+#include <stdlib.h>
+#endif
+
+#include "h9_module.h"
+#include "libh9.h"
+
+// A free pool entry holds the freelist link in place of the preset
+typedef union pool_entry {
+    h9_preset         preset;
+    union pool_entry* next_free;
+} pool_entry;
+
+typedef struct preset_slab {
+    struct preset_slab* next;
+    pool_entry          entries[H9_PRESET_SLAB_SIZE];
+} preset_slab;
+
+/* ==== Private Variables ========================================================= */
+
+#ifndef H9_FREESTANDING
+static void* default_alloc(void* ctx, size_t size) {
+    return malloc(size);
+}
+
+static void default_free(void* ctx, void* ptr) {
+    free(ptr);
+}
+
+static const h9_allocator default_allocator = {default_alloc, default_free, NULL};
+#else
+static const h9_allocator default_allocator = {NULL, NULL, NULL};
+#endif
+
+static h9_allocator allocator        = {NULL, NULL, NULL};
+static bool         allocator_set    = false;
+static size_t       live_allocations = 0;
+
+static preset_slab* slabs          = NULL;
+static pool_entry*  free_entries   = NULL;
+static size_t       presets_in_use = 0;
+static size_t       pool_capacity  = 0;
+
+// Guards everything above, which all h9s share. Freestanding builds have no threads to guard against.
+#ifndef H9_FREESTANDING
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+#define POOL_LOCK()   pthread_mutex_lock(&pool_lock)
+#define POOL_UNLOCK() pthread_mutex_unlock(&pool_lock)
+#else
+#define POOL_LOCK()   ((void)0)
+#define POOL_UNLOCK() ((void)0)
+#endif
+
+/* ==== Private Functions ========================================================= */
+
+static const h9_allocator* current_allocator(void) {
+    return allocator_set ? &allocator : &default_allocator;
+}
+
+// The _locked functions expect pool_lock to be held
+
+static void* alloc_locked(size_t size) {
+    const h9_allocator* hooks = current_allocator();
+    if (hooks->alloc == NULL) {
+        return NULL;
+    }
+    void* ptr = hooks->alloc(hooks->ctx, size);
+    if (ptr != NULL) {
+        live_allocations++;
+    }
+    return ptr;
+}
+
+static void free_locked(void* ptr) {
+    const h9_allocator* hooks = current_allocator();
+    hooks->free(hooks->ctx, ptr);
+    live_allocations--;
+}
+
+static bool grow_pool_locked(void) {
+    preset_slab* slab = alloc_locked(sizeof(*slab));
+    if (slab == NULL) {
+        return false;
+    }
+    slab->next = slabs;
+    slabs      = slab;
+    for (size_t i = 0; i < H9_PRESET_SLAB_SIZE; i++) {
+        slab->entries[i].next_free = free_entries;
+        free_entries               = &slab->entries[i];
+    }
+    pool_capacity += H9_PRESET_SLAB_SIZE;
+    return true;
+}
+
+static h9_preset* pool_take(void) {
+    POOL_LOCK();
+    pool_entry* entry = NULL;
+    if (free_entries != NULL || grow_pool_locked()) {
+        entry        = free_entries;
+        free_entries = entry->next_free;
+        presets_in_use++;
+    }
+    POOL_UNLOCK();
+    return (entry != NULL) ? &entry->preset : NULL;
+}
+
+static bool trim_locked(void) {
+    if (presets_in_use != 0) {
+        return false;
+    }
+    while (slabs != NULL) {
+        preset_slab* next = slabs->next;
+        free_locked(slabs);
+        slabs = next;
+    }
+    free_entries  = NULL;
+    pool_capacity = 0;
+    return true;
+}
+
+/* ==== MODULE Private Function Definitions (implements h9_module.h) ============== */
+
+void* h9_alloc(size_t size) {
+    POOL_LOCK();
+    void* ptr = alloc_locked(size);
+    POOL_UNLOCK();
+    return ptr;
+}
+
+void h9_free(void* ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    POOL_LOCK();
+    free_locked(ptr);
+    POOL_UNLOCK();
+}
+
+/* ==== PUBLIC (exported) Functions =============================================== */
+
+bool h9_setAllocator(const h9_allocator* new_allocator) {
+    if (new_allocator != NULL && (new_allocator->alloc == NULL || new_allocator->free == NULL)) {
+        return false;
+    }
+    POOL_LOCK();
+    trim_locked();
+    bool idle = (live_allocations == 0);
+    if (idle) {
+        allocator_set = (new_allocator != NULL);
+        if (allocator_set) {
+            allocator = *new_allocator;
+        }
+    }
+    POOL_UNLOCK();
+    return idle;
+}
+
+h9_preset* h9_preset_new(void) {
+    h9_preset* preset = pool_take();
+    if (preset != NULL) {
+        h9_preset_init(preset);
+    }
+    return preset;
+}
+
+h9_preset* h9_preset_clone(const h9_preset* preset) {
+    h9_preset* clone = pool_take();
+    if (clone != NULL) {
+        memcpy(clone, preset, sizeof(*clone));
+    }
+    return clone;
+}
+
+void h9_preset_delete(h9_preset* preset) {
+    if (preset == NULL) {
+        return;
+    }
+    pool_entry* entry = (pool_entry*)preset;
+    POOL_LOCK();
+    entry->next_free = free_entries;
+    free_entries     = entry;
+    presets_in_use--;
+    POOL_UNLOCK();
+}
+
+void h9_presetPoolStats(size_t* in_use, size_t* capacity) {
+    POOL_LOCK();
+    if (in_use != NULL) {
+        *in_use = presets_in_use;
+    }
+    if (capacity != NULL) {
+        *capacity = pool_capacity;
+    }
+    POOL_UNLOCK();
+}
+
+bool h9_presetPoolTrim(void) {
+    POOL_LOCK();
+    bool trimmed = trim_locked();
+    POOL_UNLOCK();
+    return trimmed;
+}
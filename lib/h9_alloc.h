@@ -0,0 +1,64 @@
+/*  h9_alloc.h
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef h9_alloc_h
+#define h9_alloc_h
+
+#include "libh9.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Allocation.
+ *
+ * Everything libh9 allocates (h9_new and the preset pool) goes through one pair of hooks, malloc/free by default.
+ * Freestanding builds have no default: until h9_setAllocator is called, h9_new and h9_preset_new return NULL.
+ *
+ * Presets come from a pool: slabs of H9_PRESET_SLAB_SIZE presets, handed out and returned through a freelist, so
+ * h9_preset_new / h9_preset_clone / h9_preset_delete are O(1) and only touch the allocator when the pool grows.
+ * Slabs are kept for reuse until h9_presetPoolTrim. The pool is shared by every h9, so in hosted builds it is guarded
+ * by a mutex: independent h9s can be created and deleted on different threads. Freestanding builds have no lock, so
+ * serialize h9_new / h9_delete there. h9_setAllocator should only be called while nothing else is allocating.
+ */
+
+#define H9_PRESET_SLAB_SIZE 64
+
+typedef struct h9_allocator {
+    void* (*alloc)(void* ctx, size_t size);
+    void (*free)(void* ctx, void* ptr);
+    void* ctx;
+} h9_allocator;
+
+// Pass NULL to restore the default. Returns false (and changes nothing) if allocator is missing a hook, or if anything
+// allocated through the current one is still live. An idle preset pool is trimmed first.
+bool       h9_setAllocator(const h9_allocator* allocator);
+h9_preset* h9_preset_new(void);                      // A pooled preset with safe defaults, NULL if the allocator fails
+h9_preset* h9_preset_clone(const h9_preset* preset);  // A pooled copy of preset, NULL if the allocator fails
+void       h9_preset_delete(h9_preset* preset);       // Returns a pooled preset to the pool. NULL is ignored.
+void       h9_presetPoolStats(size_t* in_use, size_t* capacity);
+bool       h9_presetPoolTrim(void);  // Releases every slab to the allocator. Only possible (true) with no presets in use.
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* h9_alloc_h */
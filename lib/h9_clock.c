@@ -0,0 +1,76 @@
+/*  h9_clock.c
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "h9_clock.h"
+
+#include <stdatomic.h>
+#include <time.h>
+
+#define CALIBRATION_NSEC 10000000  // 10 ms
+
+static _Atomic double ticks_per_second;
+
+#ifdef H9_CLOCK_TSC
+static uint64_t monotonic_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+#endif
+
+double h9_clockTicksPerSecond(void) {
+    double cached = atomic_load_explicit(&ticks_per_second, memory_order_relaxed);
+    if (cached > 0.0) {
+        return cached;
+    }
+#ifdef H9_CLOCK_TSC
+    uint64_t start_ns    = monotonic_ns();
+    uint64_t start_ticks = h9_clock_ticks();
+    uint64_t now_ns;
+    do {
+        now_ns = monotonic_ns();
+    } while (now_ns - start_ns < CALIBRATION_NSEC);
+    double measured = (double)(h9_clock_ticks() - start_ticks) * 1.0E9 / (double)(now_ns - start_ns);
+#else
+    double measured = 1.0E9;
+#endif
+    atomic_store_explicit(&ticks_per_second, measured, memory_order_relaxed);  // Racing callers store much the same value
+    return measured;
+}
+
+double h9_clockNowMs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+    return ((double)now.tv_sec + 1.0E-9 * (double)now.tv_nsec) * 1000.0;
+}
+
+double h9_clockElapsedSeconds(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + 1.0E-9 * (double)(now.tv_nsec - start->tv_nsec);
+}
+
+void h9_clockWaitUntil(const struct timespec* start, double offset_seconds) {
+    double remaining = offset_seconds - h9_clockElapsedSeconds(start);
+    if (remaining > 0.0) {
+        struct timespec delay = {(time_t)remaining, (long)((remaining - (double)(time_t)remaining) * 1.0E9)};
+        nanosleep(&delay, NULL);
+    }
+}
@@ -0,0 +1,65 @@
+/*  h9_clock.h
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef h9_clock_h
+#define h9_clock_h
+
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <x86intrin.h>
+#define H9_CLOCK_TSC 1
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A cheap monotonic tick counter for instrumentation (hosted builds only).
+ *
+ * On x86_64 this is the TSC (a few ns to read, assumed invariant as on any CPU of the last decade), elsewhere
+ * CLOCK_MONOTONIC in nanoseconds. Ticks only mean something relative to each other: convert differences with
+ * h9_clockTicksPerSecond().
+ */
+
+static inline uint64_t h9_clock_ticks(void) {
+#ifdef H9_CLOCK_TSC
+    return __rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+#endif
+}
+
+double h9_clockTicksPerSecond(void);  // Measured once against CLOCK_MONOTONIC (taking about 10 ms), then cached
+double h9_clockNowMs(void);            // CLOCK_MONOTONIC_RAW in milliseconds, the clock h9_cc reads by default
+
+// Pacing for playback, relative to a start read with clock_gettime(CLOCK_MONOTONIC, &start)
+double h9_clockElapsedSeconds(const struct timespec* start);
+void   h9_clockWaitUntil(const struct timespec* start, double offset_seconds);  // Returns at once if already past
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* h9_clock_h */
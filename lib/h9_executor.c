@@ -0,0 +1,389 @@
+/*  h9_executor.c
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE  // CPU affinity
+
+#include "h9_executor.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "h9_clock.h"
+#include "h9_module.h"
+#include "libh9.h"
+
+#define CACHE_LINE      64
+#define SPIN_POLLS      64   // empty polls before yielding
+#define YIELD_POLLS     256  // empty polls before sleeping
+#define IDLE_SLEEP_NSEC 50000
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_RELAX() __builtin_ia32_pause()
+#else
+#define CPU_RELAX()
+#endif
+
+typedef enum executor_event_type {
+    kEVENT_CC = 0U,
+    kEVENT_SYSEX,
+} executor_event_type;
+
+typedef struct executor_event {
+    uint8_t  type;
+    uint8_t  port;
+    uint8_t  midi_channel;
+    uint8_t  cc_num;
+    uint8_t  cc_value;
+    uint16_t sysex_len;
+    double   time_ms;  // CC arrival, taken when posted so queueing delay doesn't split MSB/LSB pairs
+    uint8_t  sysex[H9_EXECUTOR_MAX_SYSEX];
+} executor_event;
+
+// Bounded MPSC queue cell (after Vyukov): sequence == position when free for that position, position + 1 when filled
+typedef struct queue_cell {
+    _Alignas(CACHE_LINE) atomic_size_t sequence;
+    executor_event event;
+} queue_cell;
+
+typedef struct routed_instance {
+    h9*     h9;
+    uint8_t port;
+    uint8_t midi_channel;
+    uint8_t sysex_id;
+} routed_instance;
+
+typedef struct shard {
+    _Alignas(CACHE_LINE) atomic_size_t enqueue_pos;  // Shared by producers
+    atomic_uint_fast64_t posted;
+    _Alignas(CACHE_LINE) size_t dequeue_pos;  // Owned by the worker
+    atomic_uint_fast64_t processed;
+    queue_cell*          cells;
+    size_t               mask;
+    routed_instance*     instances;
+    size_t               num_instances;
+    size_t               max_instances;
+    pthread_t            thread;
+    size_t               index;
+    struct h9_executor*  executor;
+} shard;
+
+struct h9_executor {
+    shard*      shards;
+    size_t      num_shards;
+    size_t      next_shard;
+    bool        pin_threads;
+    bool        started;
+    atomic_bool running;
+    uint64_t    port_routes[H9_EXECUTOR_MAX_PORTS];        // Shard masks, by port
+    uint64_t    cc_routes[H9_EXECUTOR_MAX_PORTS][16];      // by MIDI channel
+    uint64_t    sysex_routes[H9_EXECUTOR_MAX_PORTS][128];  // by sysex id
+};
+
+/* ==== Private Functions ========================================================= */
+
+// h9_alloc only guarantees malloc alignment; keep the raw pointer just before the aligned block
+static void* aligned_alloc_line(size_t size) {
+    uint8_t* raw = h9_alloc(size + CACHE_LINE + sizeof(void*));
+    if (raw == NULL) {
+        return NULL;
+    }
+    uintptr_t aligned     = ((uintptr_t)raw + sizeof(void*) + CACHE_LINE - 1) & ~(uintptr_t)(CACHE_LINE - 1);
+    ((void**)aligned)[-1] = raw;
+    return (void*)aligned;
+}
+
+static void aligned_free_line(void* ptr) {
+    if (ptr != NULL) {
+        h9_free(((void**)ptr)[-1]);
+    }
+}
+
+static bool enqueue(shard* shard, const executor_event* event, size_t event_size) {
+    size_t      pos = atomic_load_explicit(&shard->enqueue_pos, memory_order_relaxed);
+    queue_cell* cell;
+    for (;;) {
+        cell          = &shard->cells[pos & shard->mask];
+        size_t   seq  = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&shard->enqueue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;  // Full
+        } else {
+            pos = atomic_load_explicit(&shard->enqueue_pos, memory_order_relaxed);
+        }
+    }
+    memcpy(&cell->event, event, event_size);  // Only the used part of the sysex buffer
+    atomic_fetch_add_explicit(&shard->posted, 1, memory_order_relaxed);
+    atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+    return true;
+}
+
+static bool post(h9_executor* executor, uint64_t shard_mask, const executor_event* event, size_t event_size) {
+    bool delivered = true;
+    while (shard_mask != 0) {
+        size_t index = (size_t)__builtin_ctzll(shard_mask);
+        shard_mask &= shard_mask - 1;
+        delivered &= enqueue(&executor->shards[index], event, event_size);
+    }
+    return delivered;
+}
+
+static uint8_t sysex_dest_id(const uint8_t* sysex, size_t len) {
+    size_t offset = (len > 0 && sysex[0] == 0xF0) ? 3 : 2;  // [F0] 1C 70 <id>
+    return (len > offset) ? sysex[offset] & 0x7F : 0;
+}
+
+static void dispatch(shard* shard, const executor_event* event) {
+    uint8_t dest_id = (event->type == kEVENT_SYSEX) ? sysex_dest_id(event->sysex, event->sysex_len) : 0;
+    for (size_t i = 0; i < shard->num_instances; i++) {
+        routed_instance* instance = &shard->instances[i];
+        if (instance->port != event->port) {
+            continue;
+        }
+        if (event->type == kEVENT_CC) {
+            if (instance->midi_channel == event->midi_channel) {
+                h9_ccAt(instance->h9, event->cc_num, event->cc_value, event->time_ms);
+            }
+        } else if (dest_id == 0 || instance->sysex_id == 0 || dest_id == instance->sysex_id) {  // An h9 with id 0 takes any id
+            h9_parse_sysex(instance->h9, (uint8_t*)event->sysex, event->sysex_len, kH9_RESPOND_TO_ANY_SYSEX_ID);
+        }
+    }
+}
+
+static bool run_one(shard* shard) {
+    size_t      pos  = shard->dequeue_pos;
+    queue_cell* cell = &shard->cells[pos & shard->mask];
+    if (atomic_load_explicit(&cell->sequence, memory_order_acquire) != pos + 1) {
+        return false;
+    }
+    dispatch(shard, &cell->event);  // In place, no copy out of the queue
+    atomic_store_explicit(&cell->sequence, pos + shard->mask + 1, memory_order_release);
+    shard->dequeue_pos = pos + 1;
+    atomic_fetch_add_explicit(&shard->processed, 1, memory_order_release);
+    return true;
+}
+
+static void pin_to_cpu(shard* shard) {
+#if defined(__linux__)
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_cpus > 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(shard->index % (size_t)num_cpus, &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+#endif
+}
+
+static void* worker(void* arg) {
+    shard*       shard    = arg;
+    h9_executor* executor = shard->executor;
+    if (executor->pin_threads) {
+        pin_to_cpu(shard);
+    }
+    size_t idle_polls = 0;
+    while (atomic_load_explicit(&executor->running, memory_order_relaxed)) {
+        if (run_one(shard)) {
+            idle_polls = 0;
+        } else if (++idle_polls < SPIN_POLLS) {
+            CPU_RELAX();
+        } else if (idle_polls < YIELD_POLLS) {
+            sched_yield();
+        } else {
+            struct timespec idle = {0, IDLE_SLEEP_NSEC};
+            nanosleep(&idle, NULL);
+        }
+    }
+    while (run_one(shard)) {
+        // Finish whatever was posted before stopping
+    }
+    return NULL;
+}
+
+/* ==== PUBLIC (exported) Functions =============================================== */
+
+h9_executor* h9_executor_new(size_t num_shards, size_t queue_capacity, bool pin_threads) {
+    if (num_shards == 0 || num_shards > H9_EXECUTOR_MAX_SHARDS || queue_capacity == 0) {
+        return NULL;
+    }
+    size_t capacity = 2;
+    while (capacity < queue_capacity) {
+        capacity <<= 1;
+    }
+
+    h9_executor* executor = h9_alloc(sizeof(*executor));
+    if (executor == NULL) {
+        return NULL;
+    }
+    memset(executor, 0x0, sizeof(*executor));
+    executor->num_shards  = num_shards;
+    executor->pin_threads = pin_threads;
+    atomic_init(&executor->running, false);
+
+    executor->shards = aligned_alloc_line(num_shards * sizeof(shard));
+    if (executor->shards == NULL) {
+        h9_free(executor);
+        return NULL;
+    }
+    memset(executor->shards, 0x0, num_shards * sizeof(shard));
+    for (size_t i = 0; i < num_shards; i++) {
+        shard* shard    = &executor->shards[i];
+        shard->index    = i;
+        shard->executor = executor;
+        shard->mask     = capacity - 1;
+        shard->cells    = aligned_alloc_line(capacity * sizeof(queue_cell));
+        if (shard->cells == NULL) {
+            h9_executor_delete(executor);
+            return NULL;
+        }
+        for (size_t c = 0; c < capacity; c++) {
+            atomic_init(&shard->cells[c].sequence, c);
+        }
+        atomic_init(&shard->enqueue_pos, 0);
+        atomic_init(&shard->posted, 0);
+        atomic_init(&shard->processed, 0);
+    }
+    return executor;
+}
+
+void h9_executor_delete(h9_executor* executor) {
+    if (executor == NULL) {
+        return;
+    }
+    if (executor->started) {
+        atomic_store(&executor->running, false);
+        for (size_t i = 0; i < executor->num_shards; i++) {
+            pthread_join(executor->shards[i].thread, NULL);
+        }
+    }
+    for (size_t i = 0; i < executor->num_shards; i++) {
+        aligned_free_line(executor->shards[i].cells);
+        h9_free(executor->shards[i].instances);
+    }
+    aligned_free_line(executor->shards);
+    h9_free(executor);
+}
+
+int h9_executorAdd(h9_executor* executor, h9* h9, uint8_t port) {
+    if (executor->started || h9 == NULL || port >= H9_EXECUTOR_MAX_PORTS) {
+        return -1;
+    }
+    // Round robin keeps the shards balanced for uniform traffic
+    size_t index = executor->next_shard;
+    shard* shard = &executor->shards[index];
+    if (shard->num_instances == shard->max_instances) {
+        size_t           max_instances = shard->max_instances ? shard->max_instances * 2 : 8;
+        routed_instance* instances     = h9_alloc(max_instances * sizeof(*instances));
+        if (instances == NULL) {
+            return -1;
+        }
+        if (shard->num_instances > 0) {
+            memcpy(instances, shard->instances, shard->num_instances * sizeof(*instances));
+        }
+        h9_free(shard->instances);
+        shard->instances     = instances;
+        shard->max_instances = max_instances;
+    }
+
+    routed_instance* instance = &shard->instances[shard->num_instances++];
+    instance->h9              = h9;
+    instance->port            = port;
+    instance->midi_channel    = h9->midi_config.midi_rx_channel & 0x0F;
+    instance->sysex_id        = h9->midi_config.sysex_id & 0x7F;
+
+    uint64_t bit = (uint64_t)1 << index;
+    executor->port_routes[port] |= bit;
+    executor->cc_routes[port][instance->midi_channel] |= bit;
+    executor->sysex_routes[port][instance->sysex_id] |= bit;
+    executor->next_shard = (index + 1) % executor->num_shards;
+    return (int)index;
+}
+
+bool h9_executorStart(h9_executor* executor) {
+    if (executor->started) {
+        return false;
+    }
+    atomic_store(&executor->running, true);
+    for (size_t i = 0; i < executor->num_shards; i++) {
+        if (pthread_create(&executor->shards[i].thread, NULL, worker, &executor->shards[i]) != 0) {
+            atomic_store(&executor->running, false);
+            for (size_t j = 0; j < i; j++) {
+                pthread_join(executor->shards[j].thread, NULL);
+            }
+            return false;
+        }
+    }
+    executor->started = true;
+    return true;
+}
+
+size_t h9_executorNumShards(h9_executor* executor) {
+    return executor->num_shards;
+}
+
+bool h9_executorPostCC(h9_executor* executor, uint8_t port, uint8_t midi_channel, uint8_t cc_num, uint8_t cc_value) {
+    if (port >= H9_EXECUTOR_MAX_PORTS) {
+        return false;
+    }
+    executor_event event;
+    event.type         = kEVENT_CC;
+    event.port         = port;
+    event.midi_channel = midi_channel & 0x0F;
+    event.cc_num       = cc_num;
+    event.cc_value     = cc_value;
+    event.sysex_len    = 0;
+    event.time_ms      = h9_clockNowMs();
+    return post(executor, executor->cc_routes[port][event.midi_channel], &event, offsetof(executor_event, sysex));
+}
+
+bool h9_executorPostSysex(h9_executor* executor, uint8_t port, const uint8_t* sysex, size_t len) {
+    if (port >= H9_EXECUTOR_MAX_PORTS || len > H9_EXECUTOR_MAX_SYSEX) {
+        return false;
+    }
+    executor_event event;
+    event.type      = kEVENT_SYSEX;
+    event.port      = port;
+    event.sysex_len = (uint16_t)len;
+    memcpy(event.sysex, sysex, len);
+
+    uint8_t  dest_id    = sysex_dest_id(sysex, len);
+    uint64_t shard_mask = (dest_id == 0) ? executor->port_routes[port] : executor->sysex_routes[port][dest_id] | executor->sysex_routes[port][0];
+    return post(executor, shard_mask, &event, offsetof(executor_event, sysex) + len);
+}
+
+void h9_executorDrain(h9_executor* executor) {
+    for (size_t i = 0; i < executor->num_shards; i++) {
+        shard*   shard  = &executor->shards[i];
+        uint64_t posted = atomic_load(&shard->posted);
+        while (atomic_load_explicit(&shard->processed, memory_order_acquire) < posted) {
+            if (!executor->started) {
+                return;  // Nothing will ever process it
+            }
+            sched_yield();
+        }
+    }
+}
@@ -0,0 +1,65 @@
+/*  h9_executor.h
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef h9_executor_h
+#define h9_executor_h
+
+#include "libh9.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Sharded executor (hosted builds only, needs pthreads).
+ *
+ * Spreads h9 instances across worker threads ("shards"). Each instance is owned by exactly one shard, and only that
+ * shard's thread touches it once the executor is started, so the instances themselves need no locking. Any number of
+ * threads may post incoming MIDI; each event is routed by port and MIDI channel (CC) or sysex id (sysex, with 0 as
+ * broadcast, and an instance with id 0 taking any id) to the shards owning a matching instance, through a bounded
+ * lock-free queue per shard.
+ *
+ * Routing uses each instance's midi_rx_channel and sysex_id as they were when it was added. Instance callbacks fire on
+ * the owning shard's thread. CCs are timestamped when posted, on h9_clockNowMs (the clock h9_cc reads by default), so
+ * time spent queued doesn't count against the MSB/LSB pairing window. Posting never blocks: if a target shard's queue
+ * is full the event is dropped for that shard and the post returns false.
+ */
+
+#define H9_EXECUTOR_MAX_SHARDS 64
+#define H9_EXECUTOR_MAX_PORTS  16
+#define H9_EXECUTOR_MAX_SYSEX  640  // Larger sysex is refused
+
+typedef struct h9_executor h9_executor;
+
+// queue_capacity is per shard, rounded up to a power of two. pin_threads sets per-shard CPU affinity (Linux only).
+h9_executor* h9_executor_new(size_t num_shards, size_t queue_capacity, bool pin_threads);
+void         h9_executor_delete(h9_executor* executor);  // Stops the workers (after draining) and frees the executor
+int          h9_executorAdd(h9_executor* executor, h9* h9, uint8_t port);  // Before starting. Returns the shard, -1 on failure.
+bool         h9_executorStart(h9_executor* executor);
+size_t       h9_executorNumShards(h9_executor* executor);
+bool         h9_executorPostCC(h9_executor* executor, uint8_t port, uint8_t midi_channel, uint8_t cc_num, uint8_t cc_value);
+bool         h9_executorPostSysex(h9_executor* executor, uint8_t port, const uint8_t* sysex, size_t len);
+void         h9_executorDrain(h9_executor* executor);  // Waits until everything posted so far has been processed
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* h9_executor_h */
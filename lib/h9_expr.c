@@ -0,0 +1,156 @@
+/*  h9_expr.c
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "h9_expr.h"
+
+#include <string.h>
+
+#include "h9_module.h"
+#include "libh9.h"
+#include "utils.h"
+
+// The fixed curve shapes, sampled at the same points as the compiled table.
+// LOG is log10(1 + 9x), EXP is its inverse (10^x - 1) / 9. Precomputed so that compiling needs no libm.
+static const float log_shape[H9_EXPR_TABLE_SIZE] = {
+    0.000000f, 0.107634f, 0.193820f, 0.265702f, 0.327359f, 0.381341f, 0.429348f, 0.472574f, 0.511883f, 0.547928f, 0.581210f,
+    0.612121f, 0.640978f, 0.668036f, 0.693507f, 0.717566f, 0.740363f, 0.762022f, 0.782652f, 0.802346f, 0.821186f, 0.839242f,
+    0.856578f, 0.873248f, 0.889302f, 0.904783f, 0.919732f, 0.934183f, 0.948168f, 0.961718f, 0.974857f, 0.987610f, 1.000000f,
+};
+
+static const float exp_shape[H9_EXPR_TABLE_SIZE] = {
+    0.000000f, 0.008290f, 0.017198f, 0.026771f, 0.037058f, 0.048113f, 0.059992f, 0.072757f, 0.086475f, 0.101217f, 0.117058f,
+    0.134082f, 0.152375f, 0.172033f, 0.193158f, 0.215859f, 0.240253f, 0.266468f, 0.294638f, 0.324910f, 0.357441f, 0.392398f,
+    0.429964f, 0.470332f, 0.513713f, 0.560329f, 0.610424f, 0.664256f, 0.722105f, 0.784269f, 0.851071f, 0.922858f, 1.000000f,
+};
+
+//////////////////// Private Functions
+
+// Linear interpolation in a table sampled evenly over 0..1
+static float interpolate_table(const float* table, float x) {
+    float  position = clip(x, 0.0f, 1.0f) * (H9_EXPR_TABLE_SIZE - 1);
+    size_t index    = (size_t)position;
+    if (index >= H9_EXPR_TABLE_SIZE - 1) {
+        return table[H9_EXPR_TABLE_SIZE - 1];
+    }
+    float fraction = position - (float)index;
+    return table[index] + (table[index + 1] - table[index]) * fraction;
+}
+
+static float interpolate_points(const h9_expr_point* points, size_t num_points, float x) {
+    size_t i = 1;
+    while (i < num_points - 1 && x > points[i].x) {
+        i++;
+    }
+    const h9_expr_point* lo = &points[i - 1];
+    const h9_expr_point* hi = &points[i];
+    return lo->y + (hi->y - lo->y) * (x - lo->x) / (hi->x - lo->x);
+}
+
+static float shape(h9* h9, float x) {
+    switch (h9->expr_curve) {
+        case kH9_EXPR_LOG:
+            return interpolate_table(log_shape, x);
+        case kH9_EXPR_EXP:
+            return interpolate_table(exp_shape, x);
+        case kH9_EXPR_SCURVE:
+            return x * x * (3.0f - 2.0f * x);
+        case kH9_EXPR_CUSTOM:
+            return interpolate_points(h9->expr_points, h9->expr_num_points, x);
+        case kH9_EXPR_LINEAR:
+        default:
+            return x;
+    }
+}
+
+static float calibrate(h9* h9, float position) {
+    float raw = position * H9_PEDAL_CAL_FULL_SCALE;
+    return clip((raw - h9->pedal_cal_min) / (float)(h9->pedal_cal_max - h9->pedal_cal_min), 0.0f, 1.0f);
+}
+
+static bool valid_points(const h9_expr_point* points, size_t num_points) {
+    if (points == NULL || num_points < 2 || num_points > H9_EXPR_MAX_POINTS) {
+        return false;
+    }
+    if (points[0].x != 0.0f || points[num_points - 1].x != 1.0f) {
+        return false;
+    }
+    for (size_t i = 0; i < num_points; i++) {
+        if (points[i].y < 0.0f || points[i].y > 1.0f) {
+            return false;
+        }
+        if (i > 0 && points[i].x <= points[i - 1].x) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* ==== MODULE Private Function Definitions (implements h9_module.h) ============== */
+
+void h9_compile_expr(h9* h9) {
+    h9->expr_identity = (h9->expr_curve == kH9_EXPR_LINEAR) && (h9->pedal_cal_min == 0) && (h9->pedal_cal_max == H9_PEDAL_CAL_FULL_SCALE);
+    for (size_t i = 0; i < H9_EXPR_TABLE_SIZE; i++) {
+        float position    = (float)i / (float)(H9_EXPR_TABLE_SIZE - 1);
+        h9->expr_table[i] = shape(h9, calibrate(h9, position));
+    }
+}
+
+/* ==== PUBLIC (exported) Functions =============================================== */
+
+bool h9_setExprCurve(h9* h9, h9_expr_curve curve, const h9_expr_point* points, size_t num_points) {
+    if (curve > kH9_EXPR_CUSTOM) {
+        return false;
+    }
+    if (curve == kH9_EXPR_CUSTOM) {
+        if (!valid_points(points, num_points)) {
+            return false;
+        }
+        memcpy(h9->expr_points, points, num_points * sizeof(*points));
+        h9->expr_num_points = num_points;
+    }
+    h9->expr_curve = curve;
+    h9_compile_expr(h9);
+    h9_update_expr_mappings(h9);
+    return true;
+}
+
+h9_expr_curve h9_exprCurve(h9* h9) {
+    return h9->expr_curve;
+}
+
+bool h9_setPedalCalibration(h9* h9, uint16_t cal_min, uint16_t cal_max) {
+    if (cal_min >= cal_max || cal_max > H9_PEDAL_CAL_FULL_SCALE) {
+        return false;
+    }
+    h9->pedal_cal_min    = cal_min;
+    h9->pedal_cal_max    = cal_max;
+    h9->pedal_cal_rx_min = cal_min;
+    h9->pedal_cal_rx_max = cal_max;
+    h9_compile_expr(h9);
+    h9_update_expr_mappings(h9);
+    return true;
+}
+
+control_value h9_exprResponse(h9* h9, control_value position) {
+    if (h9->expr_identity) {
+        return position;
+    }
+    return interpolate_table(h9->expr_table, position);
+}
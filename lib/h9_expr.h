@@ -0,0 +1,57 @@
+/*  h9_expr.h
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef h9_expr_h
+#define h9_expr_h
+
+#include "libh9.h"
+
+// Forward declarations
+typedef struct h9 h9;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Expression response curves.
+ *
+ * The curve and the pedal calibration range are compiled into a small lookup table whenever either changes
+ * (h9_setExprCurve, h9_setPedalCalibration, or a sysvars dump carrying sp_pedal_cal_min/max). Moving the
+ * expression pedal then costs a table interpolation per mapped knob, with no transcendental math.
+ *
+ * Calibration is applied first: the pedal position is treated as a fraction of H9_PEDAL_CAL_FULL_SCALE and
+ * rescaled so that cal_min..cal_max covers 0.0..1.0, clipping outside it. The curve shapes the result.
+ */
+
+// Returns false (and leaves the current curve alone) if the curve is unknown or the custom breakpoints are invalid.
+// points / num_points are only used for kH9_EXPR_CUSTOM, and must run from x = 0.0 to x = 1.0 with x strictly increasing.
+bool          h9_setExprCurve(h9* h9, h9_expr_curve curve, const h9_expr_point* points, size_t num_points);
+h9_expr_curve h9_exprCurve(h9* h9);
+// Returns false if cal_min >= cal_max or cal_max exceeds H9_PEDAL_CAL_FULL_SCALE.
+bool          h9_setPedalCalibration(h9* h9, uint16_t cal_min, uint16_t cal_max);
+// The response (0.0 to 1.0) for a pedal position, as applied to expression-mapped knobs.
+control_value h9_exprResponse(h9* h9, control_value position);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* h9_expr_h */
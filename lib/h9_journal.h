@@ -0,0 +1,107 @@
+/*  h9_journal.h
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef h9_journal_h
+#define h9_journal_h
+
+#include "libh9.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Journal of an h9's MIDI I/O, for reproducing field issues and as a replayable load test (hosted builds only).
+ *
+ * Recording (compiled in with H9_JOURNAL, the CMake option of the same name) attaches a journal file to an h9. It
+ * starts with a snapshot of the h9's state (preset, MIDI config, settings, which callbacks are registered), then
+ * records, with h9_clock timestamps:
+ *   - inputs: h9_cc / h9_ccAt, h9_parse_sysex, h9_setControl, h9_beginUpdate and h9_commitUpdate (only the outermost
+ *     call, so the h9_setControl made by an incoming CC isn't an input of its own)
+ *   - outputs: every cc, display, batch display and sysex callback. Those made outside any input (e.g. a sysex
+ *     request) are flagged as spontaneous.
+ * Records go through a stdio buffer, so recording costs a few bytes of memcpy per record rather than a system call.
+ *
+ * Replay (any hosted build) applies the snapshot to an h9, registers the same callbacks, then feeds it every input,
+ * either as fast as possible or at the recorded pace, and checks that each input produces exactly the outputs which
+ * followed it in the journal (spontaneous ones aside). tools/h9_replay does this from the command line.
+ */
+
+#define H9_JOURNAL_MAGIC   0x4c4a3948  // "H9JL", little endian
+#define H9_JOURNAL_VERSION 1
+
+typedef enum h9_journal_record_kind {
+    kH9_JOURNAL_CC_IN = 1U,           // cc, value, time_ms (f64)
+    kH9_JOURNAL_SYSEX_IN,             // enforce_sysex_id, length (varint), bytes
+    kH9_JOURNAL_CONTROL_IN,           // control, h9_callback_action, value (f64)
+    kH9_JOURNAL_BEGIN_UPDATE,         // (no fields)
+    kH9_JOURNAL_COMMIT_UPDATE,        // (no fields)
+    kH9_JOURNAL_CC_OUT,               // channel, cc, msb, lsb
+    kH9_JOURNAL_DISPLAY_OUT,          // control, current value (f64), display value (f64)
+    kH9_JOURNAL_BATCH_DISPLAY_OUT,    // h9_control_mask (u16)
+    kH9_JOURNAL_SYSEX_OUT,            // length (varint), bytes
+    kH9_JOURNAL_NUM_KINDS,            // KEEP THIS LAST
+} h9_journal_record_kind;
+
+#define H9_JOURNAL_SPONTANEOUS 0x80  // Or'd into the kind byte of an output made outside any input
+
+/*
+ Layout: an h9_journal_header, the snapshot (snapshot_size bytes), then records to the end of the file. Each record is
+ its kind byte, the h9_clock ticks since the previous record as an unsigned LEB128 varint, then the fields listed
+ above. Multi-byte fields are little endian.
+ */
+typedef struct h9_journal_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t snapshot_size;  // Including the preset it carries
+    uint32_t state_size;     // Size of the snapshot's fixed part in the recording build, which must match the replaying one
+    double   ticks_per_second;
+} h9_journal_header;
+
+typedef enum h9_replay_speed {
+    kH9_REPLAY_FAST = 0U,  // As fast as possible
+    kH9_REPLAY_REALTIME,   // Each input at its recorded offset from the start
+} h9_replay_speed;
+
+typedef struct h9_replay_result {
+    uint64_t inputs;
+    uint64_t outputs;         // Recorded outputs matched by the replay
+    uint64_t mismatches;      // Outputs recorded but not produced, or produced but not recorded (or different)
+    uint64_t first_mismatch;  // Record number (from 0) of the first mismatch, if any
+    double   seconds;         // Replay time, excluding reading the file
+} h9_replay_result;
+
+typedef struct h9_journal h9_journal;
+
+// Starts recording h9 into a new file at path. NULL if the file can't be written, recording is already on for this h9,
+// or the library was built without H9_JOURNAL.
+h9_journal* h9_journalStart(h9* h9, const char* path);
+bool        h9_journalStop(h9_journal* journal);  // Detaches, flushes and closes. False if any write failed.
+uint64_t    h9_journalRecords(const h9_journal* journal);
+
+// Replays the journal at path into h9 (whose state it replaces with the snapshot). Its callbacks are restored when done.
+// False if the file can't be read or isn't a journal from a compatible build, in which case result is untouched.
+bool h9_journalReplay(const char* path, h9* h9, h9_replay_speed speed, h9_replay_result* result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* h9_journal_h */
@@ -0,0 +1,113 @@
+/*  h9_latency.c
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include "libh9.h"
+#include "h9_clock.h"
+#include "h9_module.h"
+
+/* ==== Private Functions ========================================================= */
+
+#if defined(H9_LATENCY)
+static size_t bucket_index(uint64_t ticks) {
+    if (ticks < (1U << H9_LATENCY_SUB_BITS)) {
+        return (size_t)ticks;  // Exact
+    }
+    unsigned msb = 63U - (unsigned)__builtin_clzll(ticks);
+    if (msb >= H9_LATENCY_MAX_BITS) {
+        return H9_LATENCY_NUM_BUCKETS - 1;
+    }
+    unsigned shift = msb - H9_LATENCY_SUB_BITS;
+    return ((size_t)(shift + 1) << H9_LATENCY_SUB_BITS) + (size_t)((ticks >> shift) & ((1U << H9_LATENCY_SUB_BITS) - 1));
+}
+#endif
+
+// The largest value which lands in the bucket
+static uint64_t bucket_upper_bound(size_t index) {
+    if (index < (1U << H9_LATENCY_SUB_BITS)) {
+        return index;
+    }
+    unsigned shift = (unsigned)(index >> H9_LATENCY_SUB_BITS) - 1;
+    uint64_t lower = ((uint64_t)(1U << H9_LATENCY_SUB_BITS) + (index & ((1U << H9_LATENCY_SUB_BITS) - 1))) << shift;
+    return lower + ((uint64_t)1 << shift) - 1;
+}
+
+/* ==== MODULE Private Function Definitions (implements h9_module.h) ============== */
+
+#if defined(H9_LATENCY)
+void h9_latency_stop(h9* h9) {
+    uint64_t              ticks     = h9_clock_ticks() - h9->latency_start;
+    h9_latency_histogram* histogram = &h9->latency[h9->latency_pending - 1];
+    histogram->counts[bucket_index(ticks)]++;
+    histogram->total++;
+    if (ticks > histogram->max_ticks) {
+        histogram->max_ticks = ticks;
+    }
+    h9->latency_pending = 0;
+}
+#endif
+
+/* ==== PUBLIC (exported) Functions =============================================== */
+
+bool h9_latencySnapshot(h9* h9, h9_latency_path path, h9_latency_histogram* dest) {
+#if defined(H9_LATENCY)
+    if (path < kH9_NUM_LATENCY_PATHS) {
+        *dest = h9->latency[path];
+        return true;
+    }
+#else
+    (void)h9;
+    (void)path;
+#endif
+    memset(dest, 0x0, sizeof(*dest));
+    return false;
+}
+
+double h9_latencyPercentile(const h9_latency_histogram* histogram, double percentile) {
+    if (histogram->total == 0) {
+        return 0.0;
+    }
+    uint64_t rank = (uint64_t)((percentile / 100.0) * (double)histogram->total + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    } else if (rank > histogram->total) {
+        rank = histogram->total;
+    }
+    uint64_t seen  = 0;
+    uint64_t ticks = histogram->max_ticks;
+    for (size_t i = 0; i < H9_LATENCY_NUM_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if (seen >= rank) {
+            uint64_t upper = bucket_upper_bound(i);
+            ticks          = (upper < histogram->max_ticks) ? upper : histogram->max_ticks;
+            break;
+        }
+    }
+    return (double)ticks * 1.0E6 / h9_clockTicksPerSecond();
+}
+
+void h9_latencyReset(h9* h9) {
+#if defined(H9_LATENCY)
+    memset(h9->latency, 0x0, sizeof(h9->latency));
+    h9->latency_pending = 0;
+#else
+    (void)h9;
+#endif
+}
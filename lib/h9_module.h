@@ -20,9 +20,124 @@
 #ifndef h9_module_h
 #define h9_module_h
 
+// Per-instance counters (see h9_stats), which cost nothing unless built with H9_STATS
+#ifdef H9_STATS
+#define H9_STATS_COUNT(h9, counter)      ((h9)->stats.counter++)
+#define H9_STATS_ADD(h9, counter, value) ((h9)->stats.counter += (value))
+#else
+#define H9_STATS_COUNT(h9, counter)      ((void)0)
+#define H9_STATS_ADD(h9, counter, value) ((void)0)
+#endif
+
+// Trace points (see h9_trace.h), which are not compiled at all unless built with H9_TRACE
+#if defined(H9_TRACE) && !defined(H9_FREESTANDING)
+#include <stdatomic.h>
+extern atomic_bool h9_trace_enabled;
+void               h9_trace_write(uint16_t event, uint32_t arg0, uint32_t arg1, uint32_t arg2);
+#define H9_TRACE_POINT(event, arg0, arg1, arg2)                                                   \
+    do {                                                                                          \
+        if (atomic_load_explicit(&h9_trace_enabled, memory_order_relaxed)) {                      \
+            h9_trace_write((event), (uint32_t)(arg0), (uint32_t)(arg1), (uint32_t)(arg2));        \
+        }                                                                                         \
+    } while (0)
+// A non-negative duration in ms as a trace argument in microseconds, saturating rather than overflowing the cast
+static inline uint32_t h9_trace_us(double ms) {
+    double us = ms * 1000.0;
+    return (us < (double)UINT32_MAX) ? (uint32_t)us : UINT32_MAX;
+}
+#else
+#define H9_TRACE_POINT(event, arg0, arg1, arg2) ((void)0)
+#endif
+
+// End-to-end latency (see h9_latencySnapshot), timed only when built with H9_LATENCY. BEGIN starts timing a path,
+// the matching callback stops it (at most once), and END abandons it if no callback came.
+#if defined(H9_LATENCY) && !defined(H9_FREESTANDING)
+#include "h9_clock.h"
+void h9_latency_stop(h9* h9);
+#define H9_LATENCY_BEGIN(h9, path) ((h9)->latency_start = h9_clock_ticks(), (h9)->latency_pending = (uint8_t)((path) + 1))
+#define H9_LATENCY_END(h9)         ((h9)->latency_pending = 0)
+#define H9_LATENCY_DISPLAY(h9)                                                                             \
+    do {                                                                                                   \
+        if ((h9)->latency_pending != 0 && (h9)->latency_pending != kH9_LATENCY_CONTROL_TO_CC + 1) {        \
+            h9_latency_stop(h9);                                                                           \
+        }                                                                                                  \
+    } while (0)
+#define H9_LATENCY_CC_OUT(h9)                                                                              \
+    do {                                                                                                   \
+        if ((h9)->latency_pending == kH9_LATENCY_CONTROL_TO_CC + 1) {                                      \
+            h9_latency_stop(h9);                                                                           \
+        }                                                                                                  \
+    } while (0)
+#else
+#define H9_LATENCY_BEGIN(h9, path) ((void)0)
+#define H9_LATENCY_END(h9)         ((void)0)
+#define H9_LATENCY_DISPLAY(h9)     ((void)0)
+#define H9_LATENCY_CC_OUT(h9)      ((void)0)
+#endif
+
+// Journal recording (see h9_journal.h), compiled in with H9_JOURNAL. INPUT records an input and runs its body with
+// recording of further inputs suppressed, OUTPUT records a callback. Both cost one untaken branch while not recording.
+#if defined(H9_JOURNAL) && !defined(H9_FREESTANDING)
+void h9_journal_cc_in(h9* h9, uint8_t cc_num, uint8_t cc_value, double time_ms);
+void h9_journal_sysex_in(h9* h9, const uint8_t* sysex, size_t len, uint8_t enforce_sysex_id);
+void h9_journal_control_in(h9* h9, control_id control, control_value value, h9_callback_action cc_cb_action);
+void h9_journal_event(h9* h9, uint8_t kind);
+void h9_journal_cc_out(h9* h9, uint8_t midi_channel, uint8_t cc, uint8_t msb, uint8_t lsb);
+void h9_journal_display_out(h9* h9, control_id control, control_value current_value, control_value display_value);
+void h9_journal_batch_display_out(h9* h9, h9_control_mask changed);
+void h9_journal_sysex_out(h9* h9, const uint8_t* sysex, size_t len);
+#define H9_JOURNAL_INPUT(h9, record, body)                    \
+    do {                                                      \
+        if ((h9)->journal != NULL && !(h9)->journal_input) {  \
+            record;                                           \
+            (h9)->journal_input = true;                       \
+            body;                                             \
+            (h9)->journal_input = false;                      \
+        } else {                                              \
+            body;                                             \
+        }                                                     \
+    } while (0)
+#define H9_JOURNAL_OUTPUT(h9, record) \
+    do {                              \
+        if ((h9)->journal != NULL) {  \
+            record;                   \
+        }                             \
+    } while (0)
+#else
+#define H9_JOURNAL_INPUT(h9, record, body) \
+    do {                                   \
+        body;                              \
+    } while (0)
+#define H9_JOURNAL_OUTPUT(h9, record) ((void)0)
+#endif
+
+// USDT probes (provider libh9) for perf / bpftrace, compiled in with H9_USDT. Unattached, each is a single nop.
+#if defined(H9_USDT) && !defined(H9_FREESTANDING)
+#include <sys/sdt.h>
+#define H9_PROBE(name, ...) STAP_PROBEV(libh9, name, __VA_ARGS__)
+#else
+#define H9_PROBE(name, ...) ((void)0)
+#endif
+
+// How h9_cc handled a CC, the last argument of the cc probe
+typedef enum h9_probe_cc_kind {
+    kH9_PROBE_CC_MSB = 0U,
+    kH9_PROBE_CC_LSB,
+    kH9_PROBE_CC_LSB_UNPAIRED,
+    kH9_PROBE_CC_LSB_TIMEOUT,
+    kH9_PROBE_CC_UNMAPPED,
+} h9_probe_cc_kind;
+
 //////////////////// Module Function Declarations
 void       h9_reset_display_values(h9* h9);
 void       h9_update_display_value(h9* h9, control_id control, control_value value);
-h9_preset* h9_preset_new(void);
+void       h9_preset_init(h9_preset* h9_preset);
+void*      h9_alloc(size_t size);  // Through the h9_setAllocator hooks, NULL on failure
+void       h9_free(void* ptr);
+void       h9_compile_expr(h9* h9);
+void       h9_update_expr_mappings(h9* h9);
+uint16_t   h9_cc_value(control_value value);  // 14-bit, as sent by cc_callback
+void       h9_send_sysex(h9* h9, uint8_t* sysex, size_t len);  // Through sysex_callback, if registered
+size_t     h9_format_preset(h9* h9, const h9_preset* preset, uint8_t* sysex, size_t max_len);  // As h9_dump, but only formats
 
 #endif /* h9_module_h */
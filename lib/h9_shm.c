@@ -0,0 +1,227 @@
+/*  h9_shm.c
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "h9_shm.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "libh9.h"
+#include "h9_module.h"
+
+#define CACHE_LINE       64
+#define SHM_NAME_MAX     255
+#define SHM_READ_RETRIES 1000
+
+// Slots are cache line aligned, so publishing one h9 never disturbs readers of another
+typedef struct shm_slot {
+    _Alignas(CACHE_LINE) _Atomic uint32_t sequence;  // Odd while a publish is in progress
+    h9_shm_state state;
+} shm_slot;
+
+typedef struct shm_segment {
+    _Alignas(CACHE_LINE) h9_shm_header header;
+    shm_slot slots[];
+} shm_segment;
+
+_Static_assert(sizeof(_Atomic uint32_t) == sizeof(uint32_t) && ATOMIC_INT_LOCK_FREE == 2, "seqlocks need lock-free 32-bit atomics");
+
+struct h9_shm {
+    shm_segment* segment;
+    size_t       mapped_len;
+    size_t       num_slots;
+    bool         writable;
+};
+
+static size_t segment_len(size_t num_slots) {
+    return sizeof(shm_segment) + num_slots * sizeof(shm_slot);
+}
+
+// shm_open wants "/name", accept either
+static bool shm_path(const char* name, char* path) {
+    size_t len = strlen(name);
+    if (name[0] == '/') {
+        name++;
+        len--;
+    }
+    if (len == 0 || len >= SHM_NAME_MAX - 1 || strchr(name, '/') != NULL) {
+        errno = EINVAL;
+        return false;
+    }
+    path[0] = '/';
+    memcpy(path + 1, name, len + 1);
+    return true;
+}
+
+static h9_shm* shm_new(shm_segment* segment, size_t mapped_len, size_t num_slots, bool writable) {
+    h9_shm* shm = h9_alloc(sizeof(*shm));
+    if (shm == NULL) {
+        munmap(segment, mapped_len);
+        errno = ENOMEM;
+        return NULL;
+    }
+    shm->segment    = segment;
+    shm->mapped_len = mapped_len;
+    shm->num_slots  = num_slots;
+    shm->writable   = writable;
+    return shm;
+}
+
+h9_shm* h9_shmCreate(const char* name, size_t num_slots) {
+    char path[SHM_NAME_MAX + 1];
+    if (num_slots == 0 || num_slots > UINT32_MAX || !shm_path(name, path)) {
+        errno = EINVAL;
+        return NULL;
+    }
+    int fd = shm_open(path, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+    size_t len = segment_len(num_slots);
+    if (ftruncate(fd, 0) != 0 || ftruncate(fd, (off_t)len) != 0) {  // Zeroed, whatever was there before
+        int error = errno;
+        close(fd);
+        errno = error;
+        return NULL;
+    }
+    shm_segment* segment = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED) {
+        return NULL;
+    }
+
+    segment->header.version    = H9_SHM_VERSION;
+    segment->header.state_size = sizeof(h9_shm_state);
+    segment->header.num_slots  = (uint32_t)num_slots;
+    // Readers check the magic first, so it goes in last
+    atomic_thread_fence(memory_order_release);
+    segment->header.magic = H9_SHM_MAGIC;
+    return shm_new(segment, len, num_slots, true);
+}
+
+h9_shm* h9_shmOpen(const char* name) {
+    char path[SHM_NAME_MAX + 1];
+    if (!shm_path(name, path)) {
+        return NULL;
+    }
+    int fd = shm_open(path, O_RDONLY, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(shm_segment)) {
+        close(fd);
+        errno = EPROTO;
+        return NULL;
+    }
+    size_t       len     = (size_t)info.st_size;
+    shm_segment* segment = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED) {
+        return NULL;
+    }
+
+    h9_shm_header header = segment->header;
+    atomic_thread_fence(memory_order_acquire);
+    if (header.magic != H9_SHM_MAGIC || header.version != H9_SHM_VERSION || header.state_size != sizeof(h9_shm_state) ||
+        segment_len(header.num_slots) > len) {
+        munmap(segment, len);
+        errno = EPROTO;
+        return NULL;
+    }
+    return shm_new(segment, len, header.num_slots, false);
+}
+
+void h9_shmClose(h9_shm* shm) {
+    if (shm == NULL) {
+        return;
+    }
+    munmap(shm->segment, shm->mapped_len);
+    h9_free(shm);
+}
+
+bool h9_shmUnlink(const char* name) {
+    char path[SHM_NAME_MAX + 1];
+    return shm_path(name, path) && shm_unlink(path) == 0;
+}
+
+size_t h9_shmNumSlots(const h9_shm* shm) {
+    return shm->num_slots;
+}
+
+bool h9_shmPublish(h9_shm* shm, size_t slot, const h9* h9) {
+    assert(shm && h9);
+    if (!shm->writable || slot >= shm->num_slots) {
+        return false;
+    }
+
+    // Gather first, so the slot is odd for no longer than one copy
+    h9_shm_state     state;
+    const h9_preset* preset = h9->preset;
+    shm_slot*        target = &shm->segment->slots[slot];
+    memset(&state, 0x0, sizeof(state));
+    state.generation = target->state.generation + 1;  // Only this writer changes it
+    for (size_t i = 0; i < H9_NUM_KNOBS; i++) {
+        state.current_values[i] = preset->knobs[i].current_value;
+        state.display_values[i] = preset->knobs[i].display_value;
+    }
+    state.current_values[EXPR] = state.display_values[EXPR] = preset->expression;
+    state.current_values[PSW]  = state.display_values[PSW]  = preset->psw ? 1.0 : 0.0;
+    state.module_sysex_id = preset->module->sysex_id;
+    state.algorithm_id    = preset->algorithm->id;
+    memcpy(state.preset_name, preset->name, sizeof(state.preset_name));
+    state.dirty       = preset->dirty;
+    state.loaded      = preset->loaded;
+    state.bypass      = h9->bypass;
+    state.midi_config = h9->midi_config;
+
+    uint32_t sequence = atomic_load_explicit(&target->sequence, memory_order_relaxed);
+    atomic_store_explicit(&target->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&target->state, &state, sizeof(state));
+    atomic_store_explicit(&target->sequence, sequence + 2, memory_order_release);
+    return true;
+}
+
+bool h9_shmRead(const h9_shm* shm, size_t slot, h9_shm_state* dest) {
+    assert(shm && dest);
+    if (slot >= shm->num_slots) {
+        return false;
+    }
+    shm_slot* source = &shm->segment->slots[slot];
+    for (size_t i = 0; i < SHM_READ_RETRIES; i++) {
+        uint32_t before = atomic_load_explicit(&source->sequence, memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        memcpy(dest, &source->state, sizeof(*dest));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&source->sequence, memory_order_relaxed) == before) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,88 @@
+/*  h9_shm.h
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef h9_shm_h
+#define h9_shm_h
+
+#include "libh9.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Shared-memory state publishing (hosted POSIX builds only).
+ *
+ * One process owns a named segment (h9_shmCreate) and publishes the state of up to num_slots h9 instances into it,
+ * one slot each, whenever it likes (h9_shmPublish, typically after handling a batch of MIDI). Any number of other
+ * processes map the same segment read only (h9_shmOpen) and poll it with h9_shmRead: no system calls or locks, just
+ * a copy of the slot.
+ *
+ * Each slot is a seqlock. The writer makes the slot's sequence odd, copies the state in, then makes it even again; a
+ * reader copies the state out between two reads of the sequence and retries if they differ or were odd. So readers
+ * never block the writer, and only ever see a whole publish. There must be one writer per slot.
+ *
+ * The segment starts with an h9_shm_header. Readers refuse a segment whose magic, version or state size differ from
+ * their own build's, so H9_SHM_VERSION changes with any change to h9_shm_state.
+ */
+
+#define H9_SHM_MAGIC   0x4d533948  // "H9SM", little endian
+#define H9_SHM_VERSION 1
+
+typedef struct h9_shm_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t state_size;  // sizeof(h9_shm_state)
+    uint32_t num_slots;
+} h9_shm_header;
+
+// Everything published for one h9
+typedef struct h9_shm_state {
+    uint64_t       generation;  // Publishes to this slot so far, 0 if never published
+    control_value  current_values[NUM_CONTROLS];
+    control_value  display_values[NUM_CONTROLS];
+    uint8_t        module_sysex_id;  // Preset identity
+    uint8_t        algorithm_id;
+    char           preset_name[H9_MAX_NAME_LEN];
+    bool           dirty;
+    bool           loaded;
+    bool           bypass;
+    h9_midi_config midi_config;
+} h9_shm_state;
+
+typedef struct h9_shm h9_shm;
+
+// Writer. Creates (or replaces) the segment /name with num_slots empty slots. NULL on failure, with errno set.
+h9_shm* h9_shmCreate(const char* name, size_t num_slots);
+// Reader. Maps an existing segment read only. NULL on failure: errno set, or EPROTO if the layout doesn't match.
+h9_shm* h9_shmOpen(const char* name);
+void    h9_shmClose(h9_shm* shm);          // Unmaps. The segment itself stays until h9_shmUnlink.
+bool    h9_shmUnlink(const char* name);  // Removes the segment name. Existing mappings stay valid.
+size_t  h9_shmNumSlots(const h9_shm* shm);
+
+bool h9_shmPublish(h9_shm* shm, size_t slot, const h9* h9);  // False if slot is out of range or shm is read only
+// Copies out the last complete publish. False if slot is out of range or the writer kept it busy through every retry.
+bool h9_shmRead(const h9_shm* shm, size_t slot, h9_shm_state* dest);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* h9_shm_h */
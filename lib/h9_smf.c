@@ -0,0 +1,453 @@
+/*  h9_smf.c
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "h9_smf.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "h9_clock.h"
+#include "libh9.h"
+#include "h9_module.h"
+
+#define SMF_HEADER_LEN    6       // Of the MThd chunk's data, at least
+#define SMF_DEFAULT_TEMPO 500000  // Microseconds per quarter note (120 bpm) until the first tempo event
+#define SMF_MAX_VARINT    4
+
+typedef struct smf_track {
+    const uint8_t* start;  // The first event's delta time
+    const uint8_t* end;
+    const uint8_t* cursor;  // The next event, just past its delta time. NULL once the track is done.
+    uint64_t       tick;    // Of the next event
+    uint8_t        running_status;
+} smf_track;
+
+struct h9_smf {
+    const uint8_t* data;
+    size_t         len;
+    bool           mapped;
+    uint16_t       format;
+    uint16_t       division;  // Ticks per quarter note, or SMPTE frames per second and ticks per frame if the top bit is set
+    uint16_t       num_tracks;
+    uint64_t       num_events;
+    smf_track      tracks[];
+};
+
+typedef enum smf_event_kind {
+    kSmfCC = 0U,
+    kSmfSysex,
+    kSmfTempo,
+    kSmfEndOfTrack,
+    kSmfMeta,     // Any other meta event
+    kSmfSkipped,  // Not for an h9
+} smf_event_kind;
+
+typedef struct smf_event {
+    smf_event_kind kind;
+    uint8_t        channel;
+    uint8_t        cc_num;
+    uint8_t        cc_value;
+    uint32_t       tempo;  // Microseconds per quarter note
+    const uint8_t* data;   // Sysex, without the F0
+    size_t         len;
+} smf_event;
+
+// The tempo in force, and where it started
+typedef struct smf_timing {
+    uint32_t tempo;
+    uint64_t tick;
+    double   ms;
+} smf_timing;
+
+typedef struct smf_targets {
+    h9**            instances;
+    size_t          num_instances;
+    const uint32_t* by_channel;  // Indexes into instances grouped by midi_rx_channel, or NULL to send every CC to all
+    uint32_t        channel_start[17];
+} smf_targets;
+
+static uint32_t get_be32(const uint8_t* source) {
+    return ((uint32_t)source[0] << 24) | ((uint32_t)source[1] << 16) | ((uint32_t)source[2] << 8) | source[3];
+}
+
+static uint16_t get_be16(const uint8_t* source) {
+    return (uint16_t)((source[0] << 8) | source[1]);
+}
+
+// SMF variable length quantities are big endian, 7 bits a byte, at most 4 bytes. NULL if malformed or truncated.
+static const uint8_t* get_varint(const uint8_t* cursor, const uint8_t* end, uint32_t* value) {
+    *value = 0;
+    for (size_t i = 0; i < SMF_MAX_VARINT && cursor < end; i++) {
+        uint8_t byte = *cursor++;
+        *value       = (*value << 7) | (byte & 0x7F);
+        if ((byte & 0x80) == 0) {
+            return cursor;
+        }
+    }
+    return NULL;
+}
+
+// Decodes the event at cursor (past its delta time). Returns the end of the event, or NULL if it's malformed.
+static const uint8_t* read_event(const uint8_t* cursor, const uint8_t* end, uint8_t* running_status, smf_event* event) {
+    event->kind = kSmfSkipped;
+    if (cursor >= end) {
+        return NULL;
+    }
+    uint8_t status = *cursor;
+    if (status & 0x80) {
+        cursor++;
+    } else if (*running_status != 0) {
+        status = *running_status;
+    } else {
+        return NULL;  // Data without a status
+    }
+
+    if (status < 0xF0) {
+        // Channel message: program change and channel pressure have one data byte, the rest two
+        size_t len      = ((status & 0xE0) == 0xC0) ? 1 : 2;
+        *running_status = status;
+        if ((size_t)(end - cursor) < len || (cursor[0] & 0x80) || (len == 2 && (cursor[1] & 0x80))) {
+            return NULL;
+        }
+        if ((status & 0xF0) == 0xB0) {
+            event->kind     = kSmfCC;
+            event->channel  = status & 0x0F;
+            event->cc_num   = cursor[0];
+            event->cc_value = cursor[1];
+        }
+        return cursor + len;
+    }
+
+    *running_status = 0;  // Sysex and meta events cancel running status
+    uint8_t  meta_type = 0;
+    uint32_t len;
+    if (status == 0xFF) {
+        if (cursor >= end) {
+            return NULL;
+        }
+        meta_type = *cursor++;
+    } else if (status != 0xF0 && status != 0xF7) {
+        return NULL;  // System common and real-time messages have no place in a file
+    }
+    cursor = get_varint(cursor, end, &len);
+    if (cursor == NULL || len > (size_t)(end - cursor)) {
+        return NULL;
+    }
+    if (status == 0xF0) {
+        event->kind = kSmfSysex;
+        event->data = cursor;
+        event->len  = len;
+    } else if (status == 0xFF && meta_type == 0x51 && len == 3) {
+        event->kind  = kSmfTempo;
+        event->tempo = ((uint32_t)cursor[0] << 16) | ((uint32_t)cursor[1] << 8) | cursor[2];
+    } else if (status == 0xFF) {
+        event->kind = (meta_type == 0x2F) ? kSmfEndOfTrack : kSmfMeta;
+    }
+    return cursor + len;
+}
+
+// Moves the track on to the event after the one ending at next, NULL if there was no next
+static void advance(smf_track* track, const uint8_t* next, smf_event_kind kind) {
+    uint32_t delta;
+    if (next == NULL || kind == kSmfEndOfTrack || next >= track->end || (next = get_varint(next, track->end, &delta)) == NULL) {
+        track->cursor = NULL;
+        return;
+    }
+    track->cursor = next;
+    track->tick += delta;
+}
+
+static void rewind_track(smf_track* track) {
+    track->cursor         = NULL;
+    track->tick           = 0;
+    track->running_status = 0;
+    uint32_t delta;
+    if (track->start < track->end && (track->cursor = get_varint(track->start, track->end, &delta)) != NULL) {
+        track->tick = delta;
+    }
+}
+
+static bool valid_division(uint16_t division) {
+    if ((division & 0x8000) == 0) {
+        return division > 0;
+    }
+    int frames_per_second = -(int8_t)(division >> 8);
+    return (frames_per_second == 24 || frames_per_second == 25 || frames_per_second == 29 || frames_per_second == 30) &&
+           (division & 0xFF) > 0;
+}
+
+// Walks every event of every track, so that playing never meets a malformed one
+static bool check_tracks(h9_smf* smf) {
+    smf->num_events = 0;
+    for (size_t i = 0; i < smf->num_tracks; i++) {
+        smf_track* track = &smf->tracks[i];
+        rewind_track(track);
+        if (track->start < track->end && track->cursor == NULL) {
+            return false;
+        }
+        while (track->cursor != NULL) {
+            smf_event      event;
+            const uint8_t* next = read_event(track->cursor, track->end, &track->running_status, &event);
+            if (next == NULL) {
+                return false;
+            }
+            smf->num_events++;
+            advance(track, next, event.kind);
+            if (track->cursor == NULL && next < track->end && event.kind != kSmfEndOfTrack) {
+                return false;  // A truncated delta time
+            }
+        }
+    }
+    return true;
+}
+
+static h9_smf* smf_new(const uint8_t* data, size_t len, bool mapped) {
+    if (len < 8 + SMF_HEADER_LEN || memcmp(data, "MThd", 4) != 0 || get_be32(&data[4]) < SMF_HEADER_LEN) {
+        return NULL;
+    }
+    uint32_t header_len = get_be32(&data[4]);
+    uint16_t format     = get_be16(&data[8]);
+    uint16_t num_tracks = get_be16(&data[10]);
+    uint16_t division   = get_be16(&data[12]);
+    if (format > 1 || (format == 0 && num_tracks != 1) || num_tracks == 0 || !valid_division(division) || header_len > len - 8) {
+        return NULL;  // Format 2 files are independent patterns, with no single timeline to play
+    }
+
+    h9_smf* smf = h9_alloc(sizeof(*smf) + num_tracks * sizeof(smf_track));
+    if (smf == NULL) {
+        return NULL;
+    }
+    smf->data       = data;
+    smf->len        = len;
+    smf->mapped     = mapped;
+    smf->format     = format;
+    smf->division   = division;
+    smf->num_tracks = num_tracks;
+
+    // Track chunks, skipping any chunk types we don't know, as the standard asks
+    size_t offset = 8 + header_len;
+    size_t found  = 0;
+    while (found < num_tracks && len - offset >= 8) {
+        uint32_t chunk_len = get_be32(&data[offset + 4]);
+        if (chunk_len > len - offset - 8) {
+            break;
+        }
+        if (memcmp(&data[offset], "MTrk", 4) == 0) {
+            smf->tracks[found].start = &data[offset + 8];
+            smf->tracks[found].end   = &data[offset + 8 + chunk_len];
+            found++;
+        }
+        offset += 8 + chunk_len;
+    }
+    if (found < num_tracks || !check_tracks(smf)) {
+        h9_free(smf);
+        return NULL;
+    }
+    return smf;
+}
+
+h9_smf* h9_smfOpenBuffer(const uint8_t* data, size_t len) {
+    assert(data || len == 0);
+    h9_smf* smf = smf_new(data, len, false);
+    if (smf == NULL) {
+        errno = EINVAL;
+    }
+    return smf;
+}
+
+h9_smf* h9_smfOpen(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return NULL;
+    }
+    if (info.st_size == 0) {
+        close(fd);
+        errno = EINVAL;  // Can't map nothing, and it wouldn't be a MIDI file anyway
+        return NULL;
+    }
+    size_t len  = (size_t)info.st_size;
+    void*  data = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // The mapping holds its own reference
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+    madvise(data, len, MADV_SEQUENTIAL);
+    h9_smf* smf = smf_new(data, len, true);
+    if (smf == NULL) {
+        munmap(data, len);
+        errno = EINVAL;
+    }
+    return smf;
+}
+
+void h9_smfClose(h9_smf* smf) {
+    if (smf == NULL) {
+        return;
+    }
+    if (smf->mapped) {
+        munmap((void*)smf->data, smf->len);
+    }
+    h9_free(smf);
+}
+
+uint16_t h9_smfFormat(const h9_smf* smf) {
+    return smf->format;
+}
+
+uint16_t h9_smfNumTracks(const h9_smf* smf) {
+    return smf->num_tracks;
+}
+
+uint64_t h9_smfNumEvents(const h9_smf* smf) {
+    return smf->num_events;
+}
+
+// ==== Playing
+
+static double tick_ms(const h9_smf* smf, const smf_timing* timing, uint64_t tick) {
+    if (smf->division & 0x8000) {
+        // SMPTE time is absolute, tempo events don't affect it. 29 means 29.97 drop frame.
+        int    frames_per_second = -(int8_t)(smf->division >> 8);
+        double ticks_per_second  = ((frames_per_second == 29) ? 29.97 : (double)frames_per_second) * (double)(smf->division & 0xFF);
+        return (double)tick * 1000.0 / ticks_per_second;
+    }
+    return timing->ms + (double)(tick - timing->tick) * (double)timing->tempo / (1000.0 * (double)smf->division);
+}
+
+static void deliver(const smf_targets* targets, const smf_event* event, double time_ms, h9_smf_result* result) {
+    if (event->kind == kSmfCC) {
+        if (targets->by_channel == NULL) {
+            for (size_t i = 0; i < targets->num_instances; i++) {
+                h9_ccAt(targets->instances[i], event->cc_num, event->cc_value, time_ms);
+            }
+            result->ccs += targets->num_instances;
+        } else {
+            uint32_t first = targets->channel_start[event->channel];
+            uint32_t last  = targets->channel_start[event->channel + 1];
+            for (uint32_t i = first; i < last; i++) {
+                h9_ccAt(targets->instances[targets->by_channel[i]], event->cc_num, event->cc_value, time_ms);
+            }
+            result->ccs += last - first;
+        }
+    } else {
+        for (size_t i = 0; i < targets->num_instances; i++) {
+            // h9_parse_sysex only reads the message, so the read only mapping is fine
+            h9_parse_sysex(targets->instances[i], (uint8_t*)event->data, event->len, kH9_RESTRICT_TO_SYSEX_ID);
+        }
+        result->sysex += targets->num_instances;
+    }
+}
+
+static void play(h9_smf* smf, const smf_targets* targets, h9_smf_speed speed, h9_smf_result* result) {
+    memset(result, 0x0, sizeof(*result));
+    for (size_t i = 0; i < smf->num_tracks; i++) {
+        rewind_track(&smf->tracks[i]);
+    }
+    smf_timing timing = {SMF_DEFAULT_TEMPO, 0, 0.0};
+    double     time_ms = 0.0;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (;;) {
+        // Merge the tracks: the earliest next event, the lowest track first on a tie (so the tempo track leads)
+        smf_track* track = NULL;
+        for (size_t i = 0; i < smf->num_tracks; i++) {
+            if (smf->tracks[i].cursor != NULL && (track == NULL || smf->tracks[i].tick < track->tick)) {
+                track = &smf->tracks[i];
+            }
+        }
+        if (track == NULL) {
+            break;
+        }
+        smf_event      event;
+        uint64_t       tick = track->tick;
+        const uint8_t* next = read_event(track->cursor, track->end, &track->running_status, &event);
+        advance(track, next, event.kind);
+        time_ms = tick_ms(smf, &timing, tick);
+
+        switch (event.kind) {
+            case kSmfCC:
+            case kSmfSysex:
+                if (speed == kH9_SMF_REALTIME) {
+                    h9_clockWaitUntil(&start, time_ms / 1000.0);
+                }
+                deliver(targets, &event, time_ms, result);
+                break;
+            case kSmfTempo:
+                timing.tempo = event.tempo;
+                timing.tick  = tick;
+                timing.ms    = time_ms;
+                break;
+            case kSmfSkipped:
+                result->skipped++;
+                break;
+            default:
+                break;
+        }
+    }
+    result->song_seconds = time_ms / 1000.0;
+    result->seconds      = h9_clockElapsedSeconds(&start);
+}
+
+void h9_smfPlay(h9_smf* smf, h9* h9, h9_smf_speed speed, h9_smf_result* result) {
+    assert(smf && h9 && result);
+    smf_targets targets = {.instances = &h9, .num_instances = 1};
+    play(smf, &targets, speed, result);
+}
+
+bool h9_smfPlayFleet(h9_smf* smf, h9_fleet* fleet, h9_smf_speed speed, h9_smf_result* result) {
+    assert(smf && fleet && result);
+    size_t    num_instances = h9_fleetSize(fleet);
+    h9**      instances     = h9_alloc(num_instances * (sizeof(h9*) + sizeof(uint32_t)));
+    if (instances == NULL) {
+        return false;
+    }
+    uint32_t* by_channel = (uint32_t*)(instances + num_instances);
+
+    // Group the instances by channel, with a counting sort
+    smf_targets targets = {.instances = instances, .num_instances = num_instances, .by_channel = by_channel};
+    for (size_t i = 0; i < num_instances; i++) {
+        instances[i] = h9_fleetInstance(fleet, i);
+        targets.channel_start[(instances[i]->midi_config.midi_rx_channel & 0x0F) + 1]++;
+    }
+    for (size_t channel = 1; channel <= 16; channel++) {
+        targets.channel_start[channel] += targets.channel_start[channel - 1];
+    }
+    uint32_t next[16];
+    memcpy(next, targets.channel_start, sizeof(next));
+    for (size_t i = 0; i < num_instances; i++) {
+        by_channel[next[instances[i]->midi_config.midi_rx_channel & 0x0F]++] = (uint32_t)i;
+    }
+
+    play(smf, &targets, speed, result);
+    h9_free(instances);
+    return true;
+}
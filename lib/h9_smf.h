@@ -0,0 +1,79 @@
+/*  h9_smf.h
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef h9_smf_h
+#define h9_smf_h
+
+#include "libh9.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Standard MIDI File player, for driving h9 instances with recorded automation (hosted POSIX builds only).
+ *
+ * h9_smfOpen maps a format 0 or 1 file read only and checks every track up front, so playing it can't fail halfway.
+ * h9_smfPlay then merges the tracks into time order and streams their events straight from the mapping:
+ *   - control changes go to h9_ccAt, timestamped with the event's time by the file's tempo map (in ms from the start
+ *     of the file), so 14-bit MSB/LSB pairing sees the musical timing whatever the playback speed
+ *   - sysex goes to h9_parse_sysex with kH9_RESTRICT_TO_SYSEX_ID, in place (without its F0, which the parser allows)
+ *   - everything else (notes, program changes, F7 escapes, meta events) is skipped, tempo changes aside
+ * Nothing is allocated per event. kH9_SMF_REALTIME waits for each event's time; kH9_SMF_FAST doesn't, which makes
+ * the result's seconds a measure of h9_ccAt and h9_parse_sysex throughput under realistic traffic.
+ *
+ * h9_smfPlay sends every event to its one h9, whatever the channel. h9_smfPlayFleet routes control changes to the
+ * instances whose midi_rx_channel matches, as h9_executor does, and sysex to every instance (the id check picks the
+ * pedal it's addressed to). A player keeps its track cursors in the h9_smf, so play one file on one thread at a time.
+ */
+
+typedef enum h9_smf_speed {
+    kH9_SMF_FAST = 0U,  // As fast as possible
+    kH9_SMF_REALTIME,   // Each event at its time by the tempo map
+} h9_smf_speed;
+
+typedef struct h9_smf_result {
+    uint64_t ccs;           // Calls to h9_ccAt
+    uint64_t sysex;         // Calls to h9_parse_sysex
+    uint64_t skipped;       // Events in the file which weren't for an h9
+    double   song_seconds;  // Time of the last event, by the tempo map
+    double   seconds;       // Time taken to play
+} h9_smf_result;
+
+typedef struct h9_smf h9_smf;
+struct h9_fleet;
+
+// Maps the file at path. NULL on failure, with errno set (EINVAL if it isn't a well formed format 0 or 1 SMF).
+h9_smf* h9_smfOpen(const char* path);
+// As h9_smfOpen, over a file already in memory, which must outlive the h9_smf
+h9_smf*  h9_smfOpenBuffer(const uint8_t* data, size_t len);
+void     h9_smfClose(h9_smf* smf);
+uint16_t h9_smfFormat(const h9_smf* smf);
+uint16_t h9_smfNumTracks(const h9_smf* smf);
+uint64_t h9_smfNumEvents(const h9_smf* smf);  // All events in all tracks, meta events included
+
+void h9_smfPlay(h9_smf* smf, h9* h9, h9_smf_speed speed, h9_smf_result* result);
+bool h9_smfPlayFleet(h9_smf* smf, struct h9_fleet* fleet, h9_smf_speed speed, h9_smf_result* result);  // False if out of memory
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* h9_smf_h */
@@ -21,41 +21,18 @@
 #include "h9_sysex.h"
 
 #include <assert.h>
-#include <math.h>
 #include <stddef.h>
 #include <stdint.h>
-#include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
 
 #include "h9_module.h"
+#include "h9_modules.h"
 #include "libh9.h"
 #include "utils.h"
 
-#define DEBUG_LEVEL DEBUG_ERROR
-#include "debug.h"
-
 #define KNOB_MAX           0x7FE0  // By observation
 #define DEFAULT_PRESET_NUM 1
 
-extern h9_module h9_modules[H9_NUM_MODULES];
-
-typedef enum h9_message_code {
-    kH9_SYSEX_OK          = 0x0,
-    kH9_ERROR             = 0x0d,  // Response from pedal with problem. Body of response is ASCII readable error description.
-    kH9_USER_VALUE_PUT    = 0x2d,  // COMMAND to set indicated key to value. Data format: [key]<space>[value] in "ASCII hex". Response is VALUE_DUMP
-    kH9_SYSEX_VALUE_DUMP  = 0x2e,  // Response containing a single value as "ASCII hex"
-    kH9_OBJECTINFO_WANT   = 0x31,  // Request value of specified key. Data format: [key] = ["ASCII hex", e.g. "201" = 0x32 0x30 0x31 0x00]
-    kH9_VALUE_WANT        = 0x3b,  // Same as OBJECTINFO_WANT. Both reply with a VALUE_DUMP.
-    kH9_USER_OBJECT_SHORT = 0x3c,  // COMMAND: XXXX YY = [key] [value], same as VALUE_PUT.
-    kH9_DUMP_ALL          = 0x48,  // Requests all programs. Response is a PROGRAM_DUMP.
-    kH9_PROGRAM_DUMP      = 0x49,  // Response containing all programs in memory on the unit, sequentially.
-    kH9_TJ_SYSVARS_WANT   = 0x4c,  // Request full sysvars. Response is a TJ_SYSVARS_DUMP.
-    kH9_TJ_SYSVARS_DUMP   = 0x4d,  // Response to SYSVARS_WANT, contains full sysvar dump in unspecified format.
-    kH9_DUMP_ONE          = 0x4e,  // Requests the currently loaded PROGRAM. Response is PROGRAM.
-    kH9_PROGRAM           = 0x4f,  // COMMAND to set temporary PROGRAM, RESPONSE contains indicated PROGRAM.
-} h9_message_code;
-
 #define SYSVAR_BOOL_BASE   0x100
 #define SYSVAR_BYTE_BASE   0x200
 #define SYSVAR_WORD_BASE   0x300
@@ -206,34 +183,28 @@ typedef struct h9_system_value_dump {
 } h9_system_value_dump;
 
 //////////////////// Private Function Declarations
-static void      export_preset(h9_sysex_preset *sxpreset, h9_preset *preset);
+static void      export_preset(h9_sysex_preset *sxpreset, const h9_preset *preset);
 static h9_status load_preset(h9 *h9, uint8_t *cursor, size_t len);
 
 //////////////////// Private Functions
 
 static uint32_t export_knob_value(float knob_value) {
-    float interim = rintf(knob_value * KNOB_MAX);
-    if (interim > KNOB_MAX) {
-        interim = KNOB_MAX;
-    } else if (interim < 0.0f) {
-        interim = 0.0f;
-    }
-    return (uint32_t)interim;
+    return (uint32_t)round_even(clip(knob_value * KNOB_MAX, 0.0f, KNOB_MAX));
 }
 
 static float export_mknob_value(float knob_value) {
     return 65000.0f;  // This value is always accepted by the pedal.
 }
 
-static void export_knob_values(uint32_t *value_row, size_t index, h9_knob *knobs) {
-    h9_knob *knob = &knobs[index];
+static void export_knob_values(uint32_t *value_row, size_t index, const h9_knob *knobs) {
+    const h9_knob *knob = &knobs[index];
 
     size_t indices[]          = {9, 8, 7, 6, 5, 4, 0, 1, 2, 3};
     value_row[indices[index]] = export_knob_value(knob->current_value);
 }
 
-static void export_knob_map(uint32_t *value_row, size_t index, h9_knob *knobs) {
-    h9_knob *knob = &knobs[index];
+static void export_knob_map(uint32_t *value_row, size_t index, const h9_knob *knobs) {
+    const h9_knob *knob = &knobs[index];
 
     size_t min_indices[]          = {18, 16, 14, 12, 10, 8, 0, 2, 4, 6};
     size_t max_indices[]          = {19, 17, 15, 13, 11, 9, 1, 3, 5, 7};
@@ -243,9 +214,9 @@ static void export_knob_map(uint32_t *value_row, size_t index, h9_knob *knobs) {
     value_row[psw_indices[index]] = export_knob_value(knob->psw);
 }
 
-static void export_knob_mknob(float *value_row, size_t index, h9_knob *knobs) {
-    h9_knob *knob             = &knobs[index];
-    size_t   indices[]        = {9, 8, 7, 6, 5, 4, 0, 1, 2, 3};
+static void export_knob_mknob(float *value_row, size_t index, const h9_knob *knobs) {
+    const h9_knob *knob       = &knobs[index];
+    size_t         indices[]  = {9, 8, 7, 6, 5, 4, 0, 1, 2, 3};
     value_row[indices[index]] = export_mknob_value(knob->current_value);
 }
 
@@ -291,6 +262,14 @@ static void import_mknob_values(h9_preset *preset, float *mknob_row) {
     }
 }
 
+// Parses a C_xxxx checksum line
+static bool scan_checksum(char *line, size_t len, uint32_t *checksum) {
+    if (len < 2 || line[0] != 'C' || line[1] != '_') {
+        return false;
+    }
+    return scanhex(line + 2, len - 2, checksum, 1) == 1;
+}
+
 static bool unpack_preset(uint8_t *sysex, size_t len, h9_sysex_preset *sxpreset) {
     // Break up received data into lines
     size_t max_lines = 7;
@@ -299,28 +278,33 @@ static bool unpack_preset(uint8_t *sysex, size_t len, h9_sysex_preset *sxpreset)
     size_t found = find_lines((char *)sysex, len, lines, lengths, max_lines);
 
     if (found != max_lines) {
-        debug_info("Did not find expected data. Retrieved only %zu lines.\n", found);
+        H9_TRACE_POINT(kH9_TRACE_PRESET_LINES, found, max_lines, 0);
         return false;
     }
-    debug_info("Retrieved %zu lines:\n", found);
-    for (size_t i = 0; i < max_lines; i++) {
-        debug_info("%s\n", lines[i]);
-    }
 
     // Unpack Line 1: [00] 0 0 0 => [<preset>] {module} {unknown, always 5} {algorithm}
-    found = sscanf(lines[0], "[%d] %d %*d %d", &sxpreset->preset_num, &sxpreset->algorithm, &sxpreset->module_sysex_id);
+    char *  preset_end = memchr(lines[0], ']', lengths[0]);
+    int32_t line_ints[3];
+    if (lines[0][0] != '[' || preset_end == NULL || scandec(lines[0] + 1, preset_end - lines[0] - 1, line_ints, 1) != 1) {
+        H9_TRACE_POINT(kH9_TRACE_PRESET_LINE_INVALID, 1, 0, 1);
+        return false;
+    }
+    sxpreset->preset_num = line_ints[0];
+    found                = scandec(preset_end + 1, lengths[0] - (preset_end + 1 - lines[0]), line_ints, 3);
     if (found != 3) {
-        debug_info("Line 1 did not validate, found %zu.\n", found);
+        H9_TRACE_POINT(kH9_TRACE_PRESET_LINE_INVALID, 1, found, 3);
         return false;
     }
-    debug_info("Found [%d] => %d:%d\n", sxpreset->preset_num, sxpreset->module, sxpreset->algorithm);
+    sxpreset->algorithm       = line_ints[0];
+    sxpreset->module_sysex_id = line_ints[2];
+    H9_TRACE_POINT(kH9_TRACE_PRESET_FOUND, sxpreset->preset_num, sxpreset->module_sysex_id, sxpreset->algorithm);
 
     // Unpack Line 2: hex ascii knob values, order: <alg repeat> 7 8 9 10 6 5 4 3 2 1 <expression>
     size_t   expected_values = 12;
     uint32_t line_values[12];
     found = scanhex(lines[1], 100, line_values, expected_values);
     if (found != expected_values) {
-        debug_info("Line 2 did not validate, found %zu.\n", found);
+        H9_TRACE_POINT(kH9_TRACE_PRESET_LINE_INVALID, 2, found, expected_values);
         return false;
     }
     // Assign them to the sxpreset
@@ -333,7 +317,7 @@ static bool unpack_preset(uint8_t *sysex, size_t len, h9_sysex_preset *sxpreset)
     expected_values = 30;
     found           = scanhex(lines[2], lengths[2], sxpreset->knob_map, expected_values);
     if (found != expected_values) {
-        debug_info("Line 3 did not validate, found %zu.\n", found);
+        H9_TRACE_POINT(kH9_TRACE_PRESET_LINE_INVALID, 3, found, expected_values);
         return false;
     }
 
@@ -342,7 +326,7 @@ static bool unpack_preset(uint8_t *sysex, size_t len, h9_sysex_preset *sxpreset)
     expected_values = 8;
     found           = scanhex(lines[3], lengths[3], sxpreset->options, expected_values);
     if (found != expected_values) {
-        debug_info("Line 4 did not validate, found %zu.\n", found);
+        H9_TRACE_POINT(kH9_TRACE_PRESET_LINE_INVALID, 4, found, expected_values);
         return false;
     }
 
@@ -350,16 +334,17 @@ static bool unpack_preset(uint8_t *sysex, size_t len, h9_sysex_preset *sxpreset)
     expected_values = 12;
     found           = scanfloat(lines[4], lengths[4], sxpreset->mknob_values, expected_values);
     if (found != expected_values) {
-        debug_info("Line 4 did not validate, found %zu.\n", found);
+        H9_TRACE_POINT(kH9_TRACE_PRESET_LINE_INVALID, 5, found, expected_values);
         return false;
     }
 
     // Unpack Line 6: C_xxxx -> xxxx = ascii hex checksum (LSB) ** see note
-    found = sscanf(lines[5], "C_%x", &sxpreset->checksum);
-    if (found != 1) {
-        debug_info("Did not identify checksum.\n");
+    uint32_t checksum;
+    if (!scan_checksum(lines[5], lengths[5], &checksum)) {
+        H9_TRACE_POINT(kH9_TRACE_PRESET_LINE_INVALID, 6, 0, 1);
         return false;
     }
+    sxpreset->checksum = checksum;
 
     // Unpack Line 7: ASCII string patch name
     memset(sxpreset->patch_name, 0x0, H9_MAX_NAME_LEN);
@@ -406,7 +391,7 @@ static void import_preset(h9_preset *preset, h9_sysex_preset *sxpreset) {
     size_t module_index = sxpreset->module_sysex_id - 1;  // modules are 1-based, algorithms are 0-. Why? No clue.
     strncpy(preset->name, sxpreset->patch_name, H9_MAX_NAME_LEN);
     preset->module    = &h9_modules[module_index];
-    preset->algorithm = &h9_modules[module_index].algorithms[sxpreset->algorithm];
+    preset->algorithm = h9_algorithmAt(module_index, sxpreset->algorithm);
     import_control_values(preset, sxpreset->control_values);
     import_knob_map(preset, sxpreset->knob_map);
     import_mknob_values(preset, sxpreset->mknob_values);
@@ -422,7 +407,7 @@ static void import_preset(h9_preset *preset, h9_sysex_preset *sxpreset) {
     preset->output_gain = ((int32_t)(sxpreset->options[3] << 8) >> 8) * 0.1f;
 }
 
-static void export_preset(h9_sysex_preset *sxpreset, h9_preset *preset) {
+static void export_preset(h9_sysex_preset *sxpreset, const h9_preset *preset) {
     sxpreset->module_sysex_id  = preset->module->sysex_id;
     sxpreset->algorithm        = preset->algorithm->id;
     sxpreset->algorithm_repeat = preset->algorithm->id;
@@ -441,9 +426,9 @@ static void export_preset(h9_sysex_preset *sxpreset, h9_preset *preset) {
     sxpreset->mknob_values[11]   = export_mknob_value(KNOB_MAX);  // Always seems to be constant.
 
     // Dump translated option values
-    sxpreset->options[1] = (uint16_t)rintf(preset->tempo * 100.0f);
+    sxpreset->options[1] = (uint16_t)round_even(preset->tempo * 100.0f);
     sxpreset->options[2] = (preset->tempo_enabled ? 1 : 0);
-    sxpreset->options[3] = (int16_t)rintf(preset->output_gain * 10.0f);
+    sxpreset->options[3] = (uint32_t)round_even(preset->output_gain * 10.0f) & 0xFFFFFF;  // 24-bit two's complement, see import_preset
     sxpreset->options[4] = preset->xyz_map[0];
     sxpreset->options[5] = preset->xyz_map[1];
     sxpreset->options[6] = preset->xyz_map[2];
@@ -456,103 +441,105 @@ static void export_preset(h9_sysex_preset *sxpreset, h9_preset *preset) {
     sxpreset->checksum = checksum(sxpreset);
 }
 
+// Request messages which only vary by sysex id, precomputed for each of ids 1-16 (indexed by id - 1)
+#define REQUEST_IDS 16
+#define REQUEST_LEN 6
+#define REQUEST(id, message_code) {0xF0, H9_SYSEX_EVENTIDE, H9_SYSEX_H9, (id), (message_code), 0xF7}
+#define REQUEST_TABLE(message_code)                                                                                    \
+    {                                                                                                                  \
+        REQUEST(1, message_code), REQUEST(2, message_code), REQUEST(3, message_code), REQUEST(4, message_code),        \
+        REQUEST(5, message_code), REQUEST(6, message_code), REQUEST(7, message_code), REQUEST(8, message_code),        \
+        REQUEST(9, message_code), REQUEST(10, message_code), REQUEST(11, message_code), REQUEST(12, message_code),     \
+        REQUEST(13, message_code), REQUEST(14, message_code), REQUEST(15, message_code), REQUEST(16, message_code),    \
+    }
+
+static const uint8_t preset_requests[REQUEST_IDS][REQUEST_LEN]  = REQUEST_TABLE(kH9_DUMP_ONE);
+static const uint8_t sysvars_requests[REQUEST_IDS][REQUEST_LEN] = REQUEST_TABLE(kH9_TJ_SYSVARS_WANT);
+
+static size_t write_request_preamble(uint8_t *dest, uint8_t sysex_id, uint8_t message_code) {
+    dest[0] = 0xF0;
+    dest[1] = H9_SYSEX_EVENTIDE;
+    dest[2] = H9_SYSEX_H9;
+    dest[3] = sysex_id;
+    dest[4] = message_code;
+    return 5;
+}
+
+// Same contract as the text_writer: copies what fits before a terminating null, and returns the full length
+static size_t copy_message(const uint8_t *message, size_t len, uint8_t *sysex, size_t max_len) {
+    if (max_len > 0) {
+        size_t copied = (len < max_len) ? len : max_len - 1;
+        memcpy(sysex, message, copied);
+        sysex[copied] = 0x0;
+    }
+    return len;
+}
+
+static size_t gen_request(uint8_t sysex_id, uint8_t message_code, const uint8_t table[REQUEST_IDS][REQUEST_LEN], uint8_t *sysex, size_t max_len) {
+    if (sysex_id >= 1 && sysex_id <= REQUEST_IDS) {
+        return copy_message(table[sysex_id - 1], REQUEST_LEN, sysex, max_len);
+    }
+    uint8_t message[REQUEST_LEN];
+    write_request_preamble(message, sysex_id, message_code);
+    message[REQUEST_LEN - 1] = 0xF7;
+    return copy_message(message, REQUEST_LEN, sysex, max_len);
+}
+
+static void write_preamble(text_writer *writer, uint8_t sysex_id, uint8_t message_code) {
+    write_char(writer, (char)0xF0);
+    write_char(writer, H9_SYSEX_EVENTIDE);
+    write_char(writer, H9_SYSEX_H9);
+    write_char(writer, sysex_id);
+    write_char(writer, message_code);
+}
+
+// Writes a row of hex values, each preceded by a space, and ends the line
+static void write_hex_row(text_writer *writer, uint32_t *values, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        write_char(writer, ' ');
+        write_hex(writer, values[i]);
+    }
+    write_string(writer, "\r\n");
+}
+
 static size_t format_sysex(uint8_t *sysex, size_t max_len, h9_sysex_preset *sxpreset, uint8_t sysex_id) {
-    // The mknob floats are formatted to ASCII. Eventually we might want to individually adjust
-    // the width and precision, as the pedal seems to do.
-    uint8_t mknob_widths[] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-    size_t  bytes_written  = snprintf((char *)sysex,
-                                    max_len,
-                                    "\xf0%c%c%c%c"
-                                    "[%d] %d 5 %d\r\n"
-                                    " %d %x %x %x %x %x %x %x %x %x %x %x\r\n"
-                                    " %x %x %x %x %x %x %x %x %x %x %x %x %x %x %x %x %x %x %x %x %x %x %x %x %x %x %x %x %x %x\r\n"
-                                    " %x %x %x %x %x %x %x %x\r\n"
-                                    " %.*f %.*f %.*f %.*f %.*f %.*f %.*f %.*f %.*f %.*f %.*f %.*f\r\n"
-                                    "C_%x\r\n"
-                                    "%s\r\n",
-                                    H9_SYSEX_EVENTIDE,
-                                    H9_SYSEX_H9,
-                                    sysex_id,
-                                    kH9_PROGRAM,  // Preamble
-                                    sxpreset->preset_num,
-                                    sxpreset->algorithm,
-                                    sxpreset->module_sysex_id,  // Line 1, etc..
-                                    sxpreset->algorithm,        // Again, not sure why
-                                    sxpreset->control_values[0],
-                                    sxpreset->control_values[1],
-                                    sxpreset->control_values[2],
-                                    sxpreset->control_values[3],
-                                    sxpreset->control_values[4],
-                                    sxpreset->control_values[5],
-                                    sxpreset->control_values[6],
-                                    sxpreset->control_values[7],
-                                    sxpreset->control_values[8],
-                                    sxpreset->control_values[9],
-                                    sxpreset->control_values[10],
-                                    sxpreset->knob_map[0],
-                                    sxpreset->knob_map[1],
-                                    sxpreset->knob_map[2],
-                                    sxpreset->knob_map[3],
-                                    sxpreset->knob_map[4],
-                                    sxpreset->knob_map[5],
-                                    sxpreset->knob_map[6],
-                                    sxpreset->knob_map[7],
-                                    sxpreset->knob_map[8],
-                                    sxpreset->knob_map[9],
-                                    sxpreset->knob_map[10],
-                                    sxpreset->knob_map[11],
-                                    sxpreset->knob_map[12],
-                                    sxpreset->knob_map[13],
-                                    sxpreset->knob_map[14],
-                                    sxpreset->knob_map[15],
-                                    sxpreset->knob_map[16],
-                                    sxpreset->knob_map[17],
-                                    sxpreset->knob_map[18],
-                                    sxpreset->knob_map[19],
-                                    sxpreset->knob_map[20],
-                                    sxpreset->knob_map[21],
-                                    sxpreset->knob_map[22],
-                                    sxpreset->knob_map[23],
-                                    sxpreset->knob_map[24],
-                                    sxpreset->knob_map[25],
-                                    sxpreset->knob_map[26],
-                                    sxpreset->knob_map[27],
-                                    sxpreset->knob_map[28],
-                                    sxpreset->knob_map[29],
-                                    sxpreset->options[0],
-                                    sxpreset->options[1],
-                                    sxpreset->options[2],
-                                    sxpreset->options[3],
-                                    sxpreset->options[4],
-                                    sxpreset->options[5],
-                                    sxpreset->options[6],
-                                    sxpreset->options[7],
-                                    mknob_widths[0],
-                                    sxpreset->mknob_values[0],
-                                    mknob_widths[1],
-                                    sxpreset->mknob_values[1],
-                                    mknob_widths[2],
-                                    sxpreset->mknob_values[2],
-                                    mknob_widths[3],
-                                    sxpreset->mknob_values[3],
-                                    mknob_widths[4],
-                                    sxpreset->mknob_values[4],
-                                    mknob_widths[5],
-                                    sxpreset->mknob_values[5],
-                                    mknob_widths[6],
-                                    sxpreset->mknob_values[6],
-                                    mknob_widths[7],
-                                    sxpreset->mknob_values[7],
-                                    mknob_widths[8],
-                                    sxpreset->mknob_values[8],
-                                    mknob_widths[9],
-                                    sxpreset->mknob_values[9],
-                                    mknob_widths[10],
-                                    sxpreset->mknob_values[10],
-                                    mknob_widths[11],
-                                    sxpreset->mknob_values[11],
-                                    sxpreset->checksum,
-                                    sxpreset->patch_name);
+    text_writer writer;
+    writer_init(&writer, (char *)sysex, max_len);
+    write_preamble(&writer, sysex_id, kH9_PROGRAM);
+
+    // Line 1: [preset] algorithm 5 module
+    write_char(&writer, '[');
+    write_decimal(&writer, sxpreset->preset_num);
+    write_string(&writer, "] ");
+    write_decimal(&writer, sxpreset->algorithm);
+    write_string(&writer, " 5 ");
+    write_decimal(&writer, sxpreset->module_sysex_id);
+    write_string(&writer, "\r\n");
+
+    // Line 2: the algorithm (again, not sure why) then the control values. All hex, as unpack_preset and the checksum read them.
+    write_char(&writer, ' ');
+    write_hex(&writer, sxpreset->algorithm_repeat);
+    write_hex_row(&writer, sxpreset->control_values, 11);
+
+    // Lines 3 and 4: knob map and options
+    write_hex_row(&writer, sxpreset->knob_map, 30);
+    write_hex_row(&writer, sxpreset->options, 8);
+
+    // Line 5: the mknob floats. The pedal seems to vary the precision, but whole numbers are always accepted.
+    for (size_t i = 0; i < 12; i++) {
+        write_char(&writer, ' ');
+        write_decimal(&writer, round_even(sxpreset->mknob_values[i]));
+    }
+    write_string(&writer, "\r\n");
+
+    // Lines 6 and 7: checksum and name
+    write_string(&writer, "C_");
+    write_hex(&writer, sxpreset->checksum);
+    write_string(&writer, "\r\n");
+    write_string(&writer, sxpreset->patch_name);
+    write_string(&writer, "\r\n");
+
+    size_t bytes_written = writer_finish(&writer);
     bytes_written += 1;  // Count the null byte
     if (max_len > (bytes_written + 1)) {
         sysex[bytes_written] = 0xF7;
@@ -571,10 +558,9 @@ static h9_status load_preset(h9 *h9, uint8_t *cursor, size_t len) {
 
     uint16_t computed_checksum = checksum(&sxpreset);
     if (sxpreset.checksum != computed_checksum) {
-        debug_info("Checksum is invalid. Difference is %d\n", sxpreset.checksum - computed_checksum);
+        H9_TRACE_POINT(kH9_TRACE_PRESET_CHECKSUM, sxpreset.checksum, computed_checksum, 0);
         return kH9_SYSEX_CHECKSUM_INVALID;
     }
-    debug_info("Checksum VALID.\n");
 
     // Validate contents - checksum is fine, but if the module / algorithm indices are invalid, we cannot continue.
     if (!validate_h9_sysex_preset(&sxpreset)) {
@@ -600,6 +586,7 @@ static h9_status parse_system_value_dump(h9 *h9, uint8_t *data, size_t len) {
     size_t found_lines = find_lines((char *)data, len, lines, lengths, num_lines);
 
     if (found_lines != num_lines) {
+        H9_TRACE_POINT(kH9_TRACE_SYSVARS_LINE_INVALID, 0, found_lines, num_lines);
         return kH9_SYSEX_INVALID;
     }
 
@@ -613,6 +600,7 @@ static h9_status parse_system_value_dump(h9 *h9, uint8_t *data, size_t len) {
     size_t expected_values = sizeof(values.byte_values) / sizeof(*values.byte_values);
     size_t found           = scanhex_byte((char *)lines[1], lengths[1], values.byte_values, expected_values);
     if (found != expected_values) {
+        H9_TRACE_POINT(kH9_TRACE_SYSVARS_LINE_INVALID, 2, found, expected_values);
         return kH9_SYSEX_INVALID;
     }
 
@@ -620,6 +608,7 @@ static h9_status parse_system_value_dump(h9 *h9, uint8_t *data, size_t len) {
     expected_values = sizeof(values.word_values) / sizeof(*values.word_values);
     found           = scanhex_word((char *)lines[2], lengths[2], values.word_values, expected_values);
     if (found != expected_values) {
+        H9_TRACE_POINT(kH9_TRACE_SYSVARS_LINE_INVALID, 3, found, expected_values);
         return kH9_SYSEX_INVALID;
     }
 
@@ -627,14 +616,14 @@ static h9_status parse_system_value_dump(h9 *h9, uint8_t *data, size_t len) {
     expected_values = sizeof(values.bit_values) / sizeof(*values.bit_values);
     found           = scanhex_bool((char *)lines[3], lengths[3], values.bit_values, expected_values);
     if (found != expected_values) {
+        H9_TRACE_POINT(kH9_TRACE_SYSVARS_LINE_INVALID, 4, found, expected_values);
         return kH9_SYSEX_INVALID;
     }
 
     // Line 4 should have the checksum
     uint32_t checksum;
-    found = sscanf(lines[4], "C_%x", &checksum);
-    if (found != 1) {
-        debug_info("Did not identify checksum.\n");
+    if (!scan_checksum(lines[4], lengths[4], &checksum)) {
+        H9_TRACE_POINT(kH9_TRACE_SYSVARS_LINE_INVALID, 5, 0, 1);
         return kH9_SYSEX_INVALID;
     }
 
@@ -645,6 +634,7 @@ static h9_status parse_system_value_dump(h9 *h9, uint8_t *data, size_t len) {
     computed_checksum += array_sum1(values.bit_values, sizeof(values.bit_values) / sizeof(*values.bit_values));
 
     if (computed_checksum != (uint16_t)checksum) {
+        H9_TRACE_POINT(kH9_TRACE_SYSVARS_CHECKSUM, checksum, computed_checksum, 0);
         return kH9_SYSEX_CHECKSUM_INVALID;
     }
 
@@ -658,6 +648,7 @@ static h9_status parse_system_value_dump(h9 *h9, uint8_t *data, size_t len) {
         [11] = tx CC
         [12] = tx PC
         [16] = global TEMPO
+        [25] = pedal calibration disabled
       Byte values: [index]
         [3]  = MIDI RX Channel
         [4]  = Sysex ID
@@ -669,6 +660,7 @@ static h9_status parse_system_value_dump(h9 *h9, uint8_t *data, size_t len) {
         [32] = EXPR map to CC
         [69] = Knob Mode [0 = normal, 1 = catchup, 2 = "locked"
       Word values: [index]
+        [46] + [47] : Pedal calibration min / max
         [48] + [49] : Bluetooth PIN (see notes in system variables)
         [50] -> [57] : Pedal name (also encoded)
      */
@@ -695,6 +687,12 @@ static h9_status parse_system_value_dump(h9 *h9, uint8_t *data, size_t len) {
     strncpy(h9->name, (char *)&values.word_values[50], H9_MAX_NAME_LEN - 1);
     strncpy(h9->bluetooth_pin, (char *)&values.word_values[48], 4);
 
+    // Fold the pedal calibration into the expression response. Disabled (or nonsensical) calibration means full scale.
+    bool cal_disabled = values.bit_values[sp_pedal_cal_disabled - SYSVAR_BOOL_BASE];
+    if (cal_disabled || !h9_setPedalCalibration(h9, values.word_values[46], values.word_values[47])) {
+        h9_setPedalCalibration(h9, 0, H9_PEDAL_CAL_FULL_SCALE);
+    }
+
     return kH9_OK;
 }
 
@@ -708,11 +706,15 @@ static void internalize_cc(h9 *h9, control_id id, uint32_t cc) {
 }
 
 static h9_status parse_system_value(h9 *h9, uint8_t *cursor, size_t len) {
-    uint32_t key         = 0;
-    uint32_t value       = 0;
-    char *   value_chars = (char *)&value + 2;  // last two chars of 32-bit word
-
-    if (sscanf("%d %d", (char *)cursor, &key, &value) == 2) {
+    uint32_t key_value[2] = {0, 0};
+    uint32_t key          = 0;
+    uint32_t value        = 0;
+    char *   value_chars  = (char *)&value + 2;  // last two chars of 32-bit word
+
+    // Key and value are hex, as in the requests we generate
+    if (scanhex((char *)cursor, len, key_value, 2) == 2) {
+        key   = key_value[0];
+        value = key_value[1];
         switch (key) {
             case sp_bypass:
                 h9->bypass = value;
@@ -814,6 +816,20 @@ static h9_status parse_system_value(h9 *h9, uint8_t *cursor, size_t len) {
             case bluetoothPIN23:
                 strncpy(h9->bluetooth_pin + 2, value_chars, 2);
                 break;
+            case sp_pedal_cal_min:  // The bounds come one at a time, and may only make a valid range once both have
+                if (value > H9_PEDAL_CAL_FULL_SCALE) {
+                    return kH9_SYSEX_INVALID;
+                }
+                h9->pedal_cal_rx_min = (uint16_t)value;
+                h9_setPedalCalibration(h9, h9->pedal_cal_rx_min, h9->pedal_cal_rx_max);
+                break;
+            case sp_pedal_cal_max:
+                if (value > H9_PEDAL_CAL_FULL_SCALE) {
+                    return kH9_SYSEX_INVALID;
+                }
+                h9->pedal_cal_rx_max = (uint16_t)value;
+                h9_setPedalCalibration(h9, h9->pedal_cal_rx_min, h9->pedal_cal_rx_max);
+                break;
             default:
                 return kH9_UNKNOWN;
         }
@@ -825,10 +841,13 @@ static h9_status parse_system_value(h9 *h9, uint8_t *cursor, size_t len) {
 
 static h9_status parse_sysex_header(h9 *h9, uint8_t *sysex, size_t len, h9_sysex_blob *payload) {
     assert(h9);
-    uint8_t *cursor = sysex;  // start the cursor at the beginning
-    if (*cursor == 0xF0) {    // Skip the leading F0 if present
+    uint8_t *cursor = sysex;             // start the cursor at the beginning
+    if (len > 0 && *cursor == 0xF0) {  // Skip the leading F0 if present
         cursor++;
     }
+    if (len < (size_t)(cursor - sysex) + 4) {
+        return kH9_SYSEX_INVALID;  // Too short for the preamble, id and type
+    }
 
     // Validate that it's an H9 piece of sysex
     uint8_t preamble[] = {H9_SYSEX_EVENTIDE, H9_SYSEX_H9};
@@ -846,35 +865,167 @@ static h9_status parse_sysex_header(h9 *h9, uint8_t *sysex, size_t len, h9_sysex
     return kH9_OK;
 }
 
-h9_status h9_parse_sysex(h9 *h9, uint8_t *sysex, size_t len, h9_enforce_sysex_id enforce_sysex_id) {
-    assert(h9);
-    h9_sysex_blob payload;
-    h9_status     result = parse_sysex_header(h9, sysex, len, &payload);
+static void count_parse(h9 *h9, uint8_t message_type, h9_status result) {
+#ifdef H9_STATS
     if (result != kH9_OK) {
-        return result;
+        H9_STATS_COUNT(h9, parse_failures[result]);
+        return;
     }
-
-    switch (payload.type) {
+    switch (message_type) {
         case kH9_PROGRAM:
-            return load_preset(h9, payload.data, payload.len);
+            H9_STATS_COUNT(h9, sysex_parsed[kH9_STATS_PROGRAM]);
+            break;
         case kH9_TJ_SYSVARS_DUMP:
-            return parse_system_value_dump(h9, payload.data, payload.len);
+            H9_STATS_COUNT(h9, sysex_parsed[kH9_STATS_SYSVARS]);
+            break;
         case kH9_SYSEX_VALUE_DUMP:
-            return parse_system_value(h9, payload.data, payload.len);
+            H9_STATS_COUNT(h9, sysex_parsed[kH9_STATS_VALUE_DUMP]);
+            break;
         default:
-            return kH9_UNSUPPORTED_COMMAND;
+            break;
     }
+#endif
 }
 
-size_t h9_dump(h9 *h9, uint8_t *sysex, size_t max_len, bool update_dirty_flag) {
-    assert(h9->preset && h9->preset->module && h9->preset->algorithm);
+// Router: every message code has a slot, found from the type byte with one table lookup. A slot's built-in parser (if
+// any) updates the h9 first, then its registered handler (if any) sees the payload.
+typedef h9_status (*builtin_parser)(h9 *h9, uint8_t *data, size_t len);
+
+typedef enum h9_route_slot {
+    kRouteSysexOk = 0U,
+    kRouteError,
+    kRouteUserValuePut,
+    kRouteValueDump,
+    kRouteObjectInfoWant,
+    kRouteValueWant,
+    kRouteUserObjectShort,
+    kRouteDumpAll,
+    kRouteProgramDump,
+    kRouteSysvarsWant,
+    kRouteSysvarsDump,
+    kRouteDumpOne,
+    kRouteProgram,
+    kNumRoutes,  // KEEP THIS LAST
+} h9_route_slot;
+_Static_assert(kNumRoutes == H9_NUM_MESSAGE_CODES, "every h9_message_code needs a route slot");
+
+static const uint8_t route_slots[0x80] = {  // Slot + 1, 0 for types we don't know
+    [kH9_SYSEX_OK]          = kRouteSysexOk + 1,
+    [kH9_ERROR]             = kRouteError + 1,
+    [kH9_USER_VALUE_PUT]    = kRouteUserValuePut + 1,
+    [kH9_SYSEX_VALUE_DUMP]  = kRouteValueDump + 1,
+    [kH9_OBJECTINFO_WANT]   = kRouteObjectInfoWant + 1,
+    [kH9_VALUE_WANT]        = kRouteValueWant + 1,
+    [kH9_USER_OBJECT_SHORT] = kRouteUserObjectShort + 1,
+    [kH9_DUMP_ALL]          = kRouteDumpAll + 1,
+    [kH9_PROGRAM_DUMP]      = kRouteProgramDump + 1,
+    [kH9_TJ_SYSVARS_WANT]   = kRouteSysvarsWant + 1,
+    [kH9_TJ_SYSVARS_DUMP]   = kRouteSysvarsDump + 1,
+    [kH9_DUMP_ONE]          = kRouteDumpOne + 1,
+    [kH9_PROGRAM]           = kRouteProgram + 1,
+};
+
+static const builtin_parser builtin_parsers[kNumRoutes] = {
+    [kRouteValueDump]   = parse_system_value,
+    [kRouteSysvarsDump] = parse_system_value_dump,
+    [kRouteProgram]     = load_preset,
+};
+
+static inline int route_slot(uint8_t type) {
+    return (type < sizeof(route_slots)) ? (int)route_slots[type] - 1 : -1;
+}
+
+static h9_status route_message(h9 *h9, h9_sysex_blob *payload) {
+    int slot = route_slot(payload->type);
+    if (slot < 0) {
+        return kH9_UNSUPPORTED_COMMAND;
+    }
+    const h9_sysex_route *route  = &h9->sysex_routes[slot];
+    builtin_parser        parser = builtin_parsers[slot];
+    if (parser == NULL && route->handler == NULL) {
+        return kH9_UNSUPPORTED_COMMAND;
+    }
+    h9_status result = (parser != NULL) ? parser(h9, payload->data, payload->len) : kH9_OK;
+    if (result == kH9_OK && route->handler != NULL) {
+        result = route->handler(route->context, payload->type, payload->data, payload->len);
+        if ((uint32_t)result >= kH9_NUM_STATUS) {
+            result = kH9_UNKNOWN;  // Not an h9_status, which mustn't index the failure counters
+        }
+    }
+    return result;
+}
+
+static h9_status parse_sysex(h9 *h9, uint8_t *sysex, size_t len, h9_enforce_sysex_id enforce_sysex_id) {
+    H9_PROBE(parse__start, h9, len);
+    h9_sysex_blob payload;
+    h9_status     result = parse_sysex_header(h9, sysex, len, &payload);
+    if (result == kH9_OK && enforce_sysex_id == kH9_RESTRICT_TO_SYSEX_ID && payload.dest_id != h9->midi_config.sysex_id &&
+        payload.dest_id != H9_SYSEX_BROADCAST_ID && h9->midi_config.sysex_id != H9_SYSEX_BROADCAST_ID) {
+        result = kH9_SYSEX_ID_MISMATCH;  // Another pedal's, rejected before touching the payload
+    }
+    if (result != kH9_OK) {
+        count_parse(h9, 0, result);
+        H9_PROBE(parse__done, h9, 0, len, result);
+        return result;
+    }
+
+    H9_LATENCY_BEGIN(h9, kH9_LATENCY_SYSEX_TO_DISPLAY);
+    result = route_message(h9, &payload);
+    H9_LATENCY_END(h9);
+    count_parse(h9, payload.type, result);
+    H9_TRACE_POINT(kH9_TRACE_SYSEX_PARSED, payload.type, len, result);
+    H9_PROBE(parse__done, h9, payload.type, len, result);
+    return result;
+}
+
+h9_status h9_parse_sysex(h9 *h9, uint8_t *sysex, size_t len, h9_enforce_sysex_id enforce_sysex_id) {
+    assert(h9);
+    h9_status result;
+    H9_JOURNAL_INPUT(h9, h9_journal_sysex_in(h9, sysex, len, (uint8_t)enforce_sysex_id), result = parse_sysex(h9, sysex, len, enforce_sysex_id));
+    return result;
+}
+
+bool h9_sysexSetHandler(h9 *h9, h9_message_code message_code, h9_sysex_handler handler, void *context) {
+    assert(h9);
+    int slot = ((uint32_t)message_code <= 0xFF) ? route_slot((uint8_t)message_code) : -1;
+    if (slot < 0) {
+        return false;
+    }
+    h9->sysex_routes[slot].handler = handler;
+    h9->sysex_routes[slot].context = context;
+    return true;
+}
+
+bool h9_sysexClassify(const uint8_t *sysex, size_t len, uint8_t *dest_id, uint8_t *message_code) {
+    size_t offset = (len > 0 && sysex[0] == 0xF0) ? 1 : 0;
+    if (len < offset + 4 || sysex[offset] != H9_SYSEX_EVENTIDE || sysex[offset + 1] != H9_SYSEX_H9) {
+        return false;
+    }
+    if (dest_id != NULL) {
+        *dest_id = sysex[offset + 2];
+    }
+    if (message_code != NULL) {
+        *message_code = sysex[offset + 3];
+    }
+    return true;
+}
+
+size_t h9_format_preset(h9 *h9, const h9_preset *preset, uint8_t *sysex, size_t max_len) {
+    assert(preset && preset->module && preset->algorithm);
 
     h9_sysex_preset sxpreset;
     memset(&sxpreset, 0x0, sizeof(sxpreset));
-    export_preset(&sxpreset, h9->preset);
+    export_preset(&sxpreset, preset);
+    return format_sysex(sysex, max_len, &sxpreset, h9->midi_config.sysex_id);
+}
 
-    size_t bytes_written = format_sysex(sysex, max_len, &sxpreset, h9->midi_config.sysex_id);
+size_t h9_dump(h9 *h9, uint8_t *sysex, size_t max_len, bool update_dirty_flag) {
+    size_t bytes_written = h9_format_preset(h9, h9->preset, sysex, max_len);
+    H9_TRACE_POINT(kH9_TRACE_DUMP, bytes_written, max_len, 0);
+    H9_PROBE(dump, h9, bytes_written, max_len);
     if (bytes_written <= max_len) {
+        H9_STATS_COUNT(h9, dumps);
+        H9_STATS_ADD(h9, bytes_dumped, bytes_written);
         if (update_dirty_flag) {
             h9->preset->dirty = false;
         }
@@ -886,67 +1037,67 @@ size_t h9_dump(h9 *h9, uint8_t *sysex, size_t max_len, bool update_dirty_flag) {
 
 // Requests and Writes = sysexGen* names generate the sysex but do not send via the callback, other names only send.
 size_t h9_sysexGenRequestCurrentPreset(h9 *h9, uint8_t *sysex, size_t max_len) {
-    size_t bytes_written = snprintf((char *)sysex, max_len, "\xf0%c%c%c%c\xf7", H9_SYSEX_EVENTIDE, H9_SYSEX_H9, h9->midi_config.sysex_id, kH9_DUMP_ONE);
-    return bytes_written;  // No +1 here, the f7 is the terminator.
+    return gen_request(h9->midi_config.sysex_id, kH9_DUMP_ONE, preset_requests, sysex, max_len);
 }
 
 size_t h9_sysexGenRequestSystemConfig(h9 *h9, uint8_t *sysex, size_t max_len) {
-    size_t bytes_written = snprintf((char *)sysex, max_len, "\xf0%c%c%c%c\xf7", H9_SYSEX_EVENTIDE, H9_SYSEX_H9, h9->midi_config.sysex_id, kH9_TJ_SYSVARS_WANT);
-    return bytes_written;  // No +1 here, the f7 is the terminator.
+    return gen_request(h9->midi_config.sysex_id, kH9_TJ_SYSVARS_WANT, sysvars_requests, sysex, max_len);
 }
 
 size_t h9_sysexGenRequestConfigVar(h9 *h9, uint16_t key, uint8_t *sysex, size_t max_len) {
-    size_t bytes_written = snprintf((char *)sysex, max_len, "\xf0%c%c%c%c%x%c\xf7", H9_SYSEX_EVENTIDE, H9_SYSEX_H9, h9->midi_config.sysex_id, kH9_VALUE_WANT, key, 0x0);
-    return bytes_written;  // No +1 here, the f7 is the terminator.
+    uint8_t message[H9_SYSEX_REQUEST_MAX_LEN];
+    size_t  len = write_request_preamble(message, h9->midi_config.sysex_id, kH9_VALUE_WANT);
+    len += format_hex((char *)&message[len], key);
+    message[len++] = 0x0;
+    message[len++] = 0xF7;
+    return copy_message(message, len, sysex, max_len);
 }
 
 size_t h9_sysexGenWriteConfigVar(h9 *h9, uint16_t key, uint16_t value, uint8_t *sysex, size_t max_len) {
-    size_t bytes_written =
-        snprintf((char *)sysex, max_len, "\xf0%c%c%c%c%x %x%c\xf7", H9_SYSEX_EVENTIDE, H9_SYSEX_H9, h9->midi_config.sysex_id, kH9_USER_VALUE_PUT, key, value, 0x0);
-    return bytes_written;  // No +1 here, the f7 is the terminator.
+    uint8_t message[H9_SYSEX_REQUEST_MAX_LEN];
+    size_t  len = write_request_preamble(message, h9->midi_config.sysex_id, kH9_USER_VALUE_PUT);
+    len += format_hex((char *)&message[len], key);
+    message[len++] = ' ';
+    len += format_hex((char *)&message[len], value);
+    message[len++] = 0x0;
+    message[len++] = 0xF7;
+    return copy_message(message, len, sysex, max_len);
 }
 
 void h9_sysexRequestCurrentPreset(h9 *h9) {
-    size_t  len = 15;
-    uint8_t sysex[len];
-    size_t  bytes_written = h9_sysexGenRequestCurrentPreset(h9, sysex, len);
-    if (bytes_written <= len && h9->sysex_callback != NULL) {
-        h9->sysex_callback(h9->callback_context, sysex, bytes_written);
+    uint8_t sysex[H9_SYSEX_REQUEST_MAX_LEN];
+    size_t  bytes_written = h9_sysexGenRequestCurrentPreset(h9, sysex, sizeof(sysex));
+    if (bytes_written < sizeof(sysex)) {
+        h9_send_sysex(h9, sysex, bytes_written);
     }
 }
 
 void h9_sysexRequestSystemConfig(h9 *h9) {
-    size_t  len = 15;
-    uint8_t sysex[len];
-    size_t  bytes_written = h9_sysexGenRequestSystemConfig(h9, sysex, len);
-    if (bytes_written <= len && h9->sysex_callback != NULL) {
-        h9->sysex_callback(h9->callback_context, sysex, bytes_written);
+    uint8_t sysex[H9_SYSEX_REQUEST_MAX_LEN];
+    size_t  bytes_written = h9_sysexGenRequestSystemConfig(h9, sysex, sizeof(sysex));
+    if (bytes_written < sizeof(sysex)) {
+        h9_send_sysex(h9, sysex, bytes_written);
     }
 }
 
 void h9_sysexRequestConfigVar(h9 *h9, uint16_t key) {
-    size_t  len = 15;
-    uint8_t sysex[len];
-    size_t  bytes_written = h9_sysexGenRequestConfigVar(h9, key, sysex, len);
-    if (bytes_written <= len && h9->sysex_callback != NULL) {
-        h9->sysex_callback(h9->callback_context, sysex, bytes_written);
+    uint8_t sysex[H9_SYSEX_REQUEST_MAX_LEN];
+    size_t  bytes_written = h9_sysexGenRequestConfigVar(h9, key, sysex, sizeof(sysex));
+    if (bytes_written < sizeof(sysex)) {
+        h9_send_sysex(h9, sysex, bytes_written);
     }
 }
 
 void h9_sysexWriteConfigVar(h9 *h9, uint16_t key, uint16_t value) {
-    size_t  len = 15;
-    uint8_t sysex[len];
-    size_t  bytes_written = h9_sysexGenWriteConfigVar(h9, key, value, sysex, len);
-    if (bytes_written <= len && h9->sysex_callback != NULL) {
-        h9->sysex_callback(h9->callback_context, sysex, bytes_written);
+    uint8_t sysex[H9_SYSEX_REQUEST_MAX_LEN];
+    size_t  bytes_written = h9_sysexGenWriteConfigVar(h9, key, value, sysex, sizeof(sysex));
+    if (bytes_written < sizeof(sysex)) {
+        h9_send_sysex(h9, sysex, bytes_written);
     }
 }
 
 bool h9_isSystemConfig(h9 *h9, uint8_t *sysex, size_t len) {
     assert(h9);
-    h9_sysex_blob payload;
-    if (parse_sysex_header(h9, sysex, len, &payload) != kH9_OK) {
-        return false;
-    }
-    return (payload.type == kH9_TJ_SYSVARS_DUMP);
+    uint8_t message_code;
+    return h9_sysexClassify(sysex, len, NULL, &message_code) && message_code == kH9_TJ_SYSVARS_DUMP;
 }
@@ -47,11 +47,13 @@ extern "C" {
  *    - a preset (as either a command TO the pedal or as a dump FROM the pedal),
  *    - a sysvars dump FROM the pedal (in which case the appropriate system settings are updated),
  *    - a system value response for a single config value
- * Other values will, at present, be harmlessly ignored with the appropriate response status.
+ * Other message codes are passed to the handler registered for them (see h9_sysexSetHandler), or else harmlessly ignored
+ * with kH9_UNSUPPORTED_COMMAND.
  *
  * Validates:
  *    - that it is intended for an H9
- *    - if enforce_sysex_id is set to kH9_RESTRICT_SYSEX_ID, that the message is intended for THIS H9
+ *    - if enforce_sysex_id is set to kH9_RESTRICT_TO_SYSEX_ID, that the message is intended for THIS H9 (its sysex id, or
+ *      the broadcast id 0, or any id if this h9's is 0), before any of the payload is read. Otherwise kH9_SYSEX_ID_MISMATCH.
  *    - that the checksum is correct,
  *    - that the bit of sysex is of the appropriate type (supported types are value dump, sysvars dump, and preset)
  *    - that the sysex is properly formatted,
@@ -74,7 +76,23 @@ h9_status h9_parse_sysex(h9* h9, uint8_t* sysex, size_t len, h9_enforce_sysex_id
  */
 size_t h9_dump(h9* h9, uint8_t* sysex, size_t max_len, bool update_dirty_flag);
 
+/*
+ * Registers a handler for incoming messages with the given code, replacing any previous one (NULL removes it).
+ * For the codes h9_parse_sysex applies itself (program, sysvars dump and value dump) the handler is called after the
+ * h9 has been updated, and only if that succeeded. Its return value is what h9_parse_sysex returns, with anything which
+ * isn't an h9_status reported as kH9_UNKNOWN.
+ * Returns false for a code which isn't in h9_message_code.
+ */
+bool h9_sysexSetHandler(h9* h9, h9_message_code message_code, h9_sysex_handler handler, void* context);
+
+// Reads only the header: true if this is H9 sysex, with its destination sysex id and h9_message_code (either may be NULL)
+bool h9_sysexClassify(const uint8_t* sysex, size_t len, uint8_t* dest_id, uint8_t* message_code);
+bool h9_isSystemConfig(h9* h9, uint8_t* sysex, size_t len);
+
 // SYSEX Generation (syncing and device inquiry)
+// Like h9_dump these return the full length, and a result >= max_len means the message was truncated. Every message
+// fits in H9_SYSEX_REQUEST_MAX_LEN.
+#define H9_SYSEX_REQUEST_MAX_LEN 17
 
 size_t h9_sysexGenRequestCurrentPreset(h9* h9, uint8_t* sysex, size_t max_len);
 size_t h9_sysexGenRequestSystemConfig(h9* h9, uint8_t* sysex, size_t max_len);
@@ -0,0 +1,235 @@
+/*  h9_trace.c
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "h9_trace.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "h9_clock.h"
+#include "libh9.h"
+#include "h9_module.h"
+
+#define CACHE_LINE  64
+#define DRAIN_CHUNK 256  // Records per write in h9_traceSave
+
+// One per thread which has traced, reused once that thread exits. The owning thread only moves head, the reader only
+// moves tail, each on its own cache line.
+typedef struct trace_ring {
+    _Atomic uint32_t   head;
+    char               head_pad[CACHE_LINE - sizeof(uint32_t)];
+    _Atomic uint32_t   tail;
+    char               tail_pad[CACHE_LINE - sizeof(uint32_t)];
+    atomic_bool        in_use;
+    _Atomic uint64_t   dropped;
+    uint16_t           thread;
+    struct trace_ring* next;
+    h9_trace_record    records[H9_TRACE_RING_SIZE];
+} trace_ring;
+
+_Static_assert((H9_TRACE_RING_SIZE & (H9_TRACE_RING_SIZE - 1)) == 0, "H9_TRACE_RING_SIZE must be a power of two");
+_Static_assert(sizeof(h9_trace_record) == 32, "Trace records should stay 32 bytes");
+
+atomic_bool h9_trace_enabled;
+
+static _Atomic(trace_ring *) rings;  // Every ring made so far, newest first. Never freed.
+static atomic_uint_fast16_t  num_rings;
+static _Thread_local trace_ring *thread_ring;
+static pthread_key_t             ring_key;  // Only for its destructor, which hands the ring back at thread exit
+static pthread_once_t            ring_key_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t           reader_lock   = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *const event_names[kH9_TRACE_NUM_EVENTS] = {
+    [kH9_TRACE_NONE]                 = "none",
+    [kH9_TRACE_SYSEX_PARSED]         = "sysex_parsed",
+    [kH9_TRACE_PRESET_LINES]         = "preset_lines",
+    [kH9_TRACE_PRESET_LINE_INVALID]  = "preset_line_invalid",
+    [kH9_TRACE_PRESET_FOUND]         = "preset_found",
+    [kH9_TRACE_PRESET_CHECKSUM]      = "preset_checksum",
+    [kH9_TRACE_SYSVARS_LINE_INVALID] = "sysvars_line_invalid",
+    [kH9_TRACE_SYSVARS_CHECKSUM]     = "sysvars_checksum",
+    [kH9_TRACE_CC_LSB_DROPPED]       = "cc_lsb_dropped",
+    [kH9_TRACE_DUMP]                 = "dump",
+};
+
+static const char *const event_formats[kH9_TRACE_NUM_EVENTS] = {
+    [kH9_TRACE_NONE]                 = "",
+    [kH9_TRACE_SYSEX_PARSED]         = "type 0x%02x, %u bytes, status %u",
+    [kH9_TRACE_PRESET_LINES]         = "found %u of %u lines",
+    [kH9_TRACE_PRESET_LINE_INVALID]  = "line %u has %u values, expected %u",
+    [kH9_TRACE_PRESET_FOUND]         = "preset %u, module %u, algorithm %u",
+    [kH9_TRACE_PRESET_CHECKSUM]      = "checksum mismatch, received %04x, computed %04x",
+    [kH9_TRACE_SYSVARS_LINE_INVALID] = "line %u has %u values, expected %u",
+    [kH9_TRACE_SYSVARS_CHECKSUM]     = "checksum mismatch, received %04x, computed %04x",
+    [kH9_TRACE_CC_LSB_DROPPED]       = "cc %u, %u us after its MSB",
+    [kH9_TRACE_DUMP]                 = "%u bytes into %u",
+};
+
+/* ==== Private Functions ========================================================= */
+
+static void release_ring(void *ring) {
+    atomic_store_explicit(&((trace_ring *)ring)->in_use, false, memory_order_release);
+}
+
+static void make_ring_key(void) {
+    pthread_key_create(&ring_key, release_ring);
+}
+
+static trace_ring *claim_ring(void) {
+    trace_ring *ring = atomic_load_explicit(&rings, memory_order_acquire);
+    for (; ring != NULL; ring = ring->next) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong_explicit(&ring->in_use, &expected, true, memory_order_acq_rel, memory_order_relaxed)) {
+            break;
+        }
+    }
+    if (ring == NULL) {
+        // Straight from calloc rather than h9_alloc: rings live as long as the process and are made on whichever thread
+        // traces first, so they must neither count as live h9_setAllocator allocations nor touch the pool's globals.
+        ring = calloc(1, sizeof(*ring));
+        if (ring == NULL) {
+            return NULL;
+        }
+        atomic_init(&ring->in_use, true);
+        ring->thread = (uint16_t)(atomic_fetch_add(&num_rings, 1) + 1);
+        ring->next   = atomic_load_explicit(&rings, memory_order_relaxed);
+        while (!atomic_compare_exchange_weak_explicit(&rings, &ring->next, ring, memory_order_release, memory_order_relaxed)) {
+        }
+    }
+    pthread_once(&ring_key_once, make_ring_key);
+    pthread_setspecific(ring_key, ring);
+    return ring;
+}
+
+// Copies out what the ring holds, up to max_records. Reader side, under reader_lock.
+static size_t drain_ring(trace_ring *ring, h9_trace_record *dest, size_t max_records) {
+    uint32_t tail  = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head  = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t   count = 0;
+    for (; tail != head && count < max_records; tail++) {
+        dest[count++] = ring->records[tail & (H9_TRACE_RING_SIZE - 1)];
+    }
+    atomic_store_explicit(&ring->tail, tail, memory_order_release);
+    return count;
+}
+
+/* ==== MODULE Private Function Definitions (implements h9_module.h) ============== */
+
+void h9_trace_write(uint16_t event, uint32_t arg0, uint32_t arg1, uint32_t arg2) {
+    trace_ring *ring = thread_ring;
+    if (ring == NULL) {
+        ring = thread_ring = claim_ring();
+        if (ring == NULL) {
+            return;
+        }
+    }
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&ring->tail, memory_order_acquire) >= H9_TRACE_RING_SIZE) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    h9_trace_record *record = &ring->records[head & (H9_TRACE_RING_SIZE - 1)];
+    record->timestamp       = h9_clock_ticks();
+    record->event           = event;
+    record->thread          = ring->thread;
+    record->args[0]         = arg0;
+    record->args[1]         = arg1;
+    record->args[2]         = arg2;
+    record->args[3]         = 0;
+    record->args[4]         = 0;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/* ==== PUBLIC (exported) Functions =============================================== */
+
+void h9_traceEnable(bool enabled) {
+    if (enabled) {
+        h9_clockTicksPerSecond();  // Calibrate now rather than while saving
+    }
+    atomic_store_explicit(&h9_trace_enabled, enabled, memory_order_relaxed);
+}
+
+bool h9_traceEnabled(void) {
+    return atomic_load_explicit(&h9_trace_enabled, memory_order_relaxed);
+}
+
+bool h9_traceRegisterThread(void) {
+    if (thread_ring == NULL) {
+        thread_ring = claim_ring();
+    }
+    return thread_ring != NULL;
+}
+
+size_t h9_traceDrain(h9_trace_record *dest, size_t max_records) {
+    size_t count = 0;
+    pthread_mutex_lock(&reader_lock);
+    for (trace_ring *ring = atomic_load_explicit(&rings, memory_order_acquire); ring != NULL && count < max_records; ring = ring->next) {
+        count += drain_ring(ring, dest + count, max_records - count);
+    }
+    pthread_mutex_unlock(&reader_lock);
+    return count;
+}
+
+uint64_t h9_traceDropped(void) {
+    uint64_t dropped = 0;
+    for (trace_ring *ring = atomic_load_explicit(&rings, memory_order_acquire); ring != NULL; ring = ring->next) {
+        dropped += atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+    }
+    return dropped;
+}
+
+const char *h9_traceEventName(uint16_t event) {
+    return (event < kH9_TRACE_NUM_EVENTS) ? event_names[event] : NULL;
+}
+
+size_t h9_traceFormatRecord(const h9_trace_record *record, double ticks_per_second, char *dest, size_t max_len) {
+    const char *name = h9_traceEventName(record->event);
+    if (name == NULL) {
+        return (size_t)snprintf(dest, max_len, "%14.6f [%u] unknown event %u", (double)record->timestamp / ticks_per_second, record->thread, record->event);
+    }
+    int len = snprintf(dest, max_len, "%14.6f [%u] %-20s ", (double)record->timestamp / ticks_per_second, record->thread, name);
+    if (len < 0) {
+        return 0;
+    }
+    size_t offset = ((size_t)len < max_len) ? (size_t)len : max_len;
+    int    args   = snprintf(dest + offset, max_len - offset, event_formats[record->event], record->args[0], record->args[1], record->args[2]);
+    return (size_t)len + (args > 0 ? (size_t)args : 0);
+}
+
+bool h9_traceSave(const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        return false;
+    }
+    h9_trace_file_header header = {H9_TRACE_MAGIC, H9_TRACE_VERSION, sizeof(h9_trace_record), 0, h9_clockTicksPerSecond()};
+    bool                 ok     = (fwrite(&header, sizeof(header), 1, file) == 1);
+
+    h9_trace_record chunk[DRAIN_CHUNK];
+    size_t          count;
+    while (ok && (count = h9_traceDrain(chunk, DRAIN_CHUNK)) > 0) {
+        ok = (fwrite(chunk, sizeof(*chunk), count, file) == count);
+        header.num_records += count;
+    }
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    return (fclose(file) == 0) && ok;
+}
@@ -0,0 +1,93 @@
+/*  h9_trace.h
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef h9_trace_h
+#define h9_trace_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Tracing (hosted builds only, compiled in with H9_TRACE, the CMake option of the same name).
+ *
+ * Trace points inside the library write fixed-size binary records into a lock-free ring owned by the calling thread:
+ * no formatting, locks or system calls, a few nanoseconds per record while tracing is enabled and a single untaken
+ * branch while it is not. Without H9_TRACE the trace points are not compiled at all.
+ *
+ * A reader (one at a time) collects records from every thread's ring with h9_traceDrain, then formats them with
+ * h9_traceFormatRecord, or h9_traceSave writes them to a file for tools/h9_tracedecode to format later. A ring which
+ * fills up before it is drained drops new records and counts them (h9_traceDropped). Rings come from malloc, not the
+ * h9_setAllocator hooks, and are kept for reuse by later threads.
+ */
+
+#define H9_TRACE_RING_SIZE 1024  // Records per thread, a power of two
+#define H9_TRACE_MAX_ARGS  5
+#define H9_TRACE_MAGIC     0x52543948  // "H9TR", little endian
+#define H9_TRACE_VERSION   1
+
+typedef enum h9_trace_event {
+    kH9_TRACE_NONE = 0U,
+    kH9_TRACE_SYSEX_PARSED,          // type, length, h9_status
+    kH9_TRACE_PRESET_LINES,          // lines found, lines expected
+    kH9_TRACE_PRESET_LINE_INVALID,   // line, values found, values expected
+    kH9_TRACE_PRESET_FOUND,          // preset number, module sysex id, algorithm
+    kH9_TRACE_PRESET_CHECKSUM,       // received, computed
+    kH9_TRACE_SYSVARS_LINE_INVALID,  // line, values found, values expected
+    kH9_TRACE_SYSVARS_CHECKSUM,      // received, computed
+    kH9_TRACE_CC_LSB_DROPPED,        // cc, microseconds since the MSB (0 if there was no MSB, at most UINT32_MAX)
+    kH9_TRACE_DUMP,                  // bytes written, buffer length
+    kH9_TRACE_NUM_EVENTS,            // KEEP THIS LAST
+} h9_trace_event;
+
+typedef struct h9_trace_record {
+    uint64_t timestamp;  // h9_clock_ticks()
+    uint16_t event;      // h9_trace_event
+    uint16_t thread;     // Ring the record came from, numbered from 1
+    uint32_t args[H9_TRACE_MAX_ARGS];
+} h9_trace_record;
+
+// Header of a file written by h9_traceSave, followed by num_records records
+typedef struct h9_trace_file_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t num_records;
+    double   ticks_per_second;
+} h9_trace_file_header;
+
+void        h9_traceEnable(bool enabled);
+bool        h9_traceEnabled(void);
+bool        h9_traceRegisterThread(void);  // Gives the calling thread its ring now rather than at its first record (which allocates)
+size_t      h9_traceDrain(h9_trace_record* dest, size_t max_records);  // Oldest first within each thread
+uint64_t    h9_traceDropped(void);                                     // Records dropped on full rings, all threads
+const char* h9_traceEventName(uint16_t event);                         // NULL if unknown
+size_t      h9_traceFormatRecord(const h9_trace_record* record, double ticks_per_second, char* dest, size_t max_len);  // snprintf semantics
+bool        h9_traceSave(const char* path);  // Drains everything to a file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* h9_trace_h */
@@ -0,0 +1,125 @@
+/*  h9_transition.c
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "h9_transition.h"
+
+#include <string.h>
+
+#include "h9_module.h"
+#include "libh9.h"
+
+/* ==== Private Functions ========================================================= */
+
+// Everything in a preset which can only be changed by sysex
+static bool same_sysex_settings(const h9_preset* current, const h9_preset* target) {
+    if (current->module != target->module || current->algorithm != target->algorithm) {
+        return false;
+    }
+    if (current->tempo != target->tempo || current->tempo_enabled != target->tempo_enabled || current->output_gain != target->output_gain ||
+        current->modfactor_fast_slow != target->modfactor_fast_slow || memcmp(current->xyz_map, target->xyz_map, sizeof(current->xyz_map)) != 0) {
+        return false;
+    }
+    for (size_t i = 0; i < H9_NUM_KNOBS; i++) {
+        const h9_knob* a = &current->knobs[i];
+        const h9_knob* b = &target->knobs[i];
+        if (a->exp_mapped != b->exp_mapped || a->psw_mapped != b->psw_mapped || a->exp_min != b->exp_min || a->exp_max != b->exp_max || a->psw != b->psw) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static control_value preset_control_value(const h9_preset* preset, control_id control) {
+    switch (control) {
+        case EXPR:
+            return preset->expression;
+        case PSW:
+            return preset->psw ? 1.0 : 0.0;
+        default:  // A knob
+            return preset->knobs[control].current_value;
+    }
+}
+
+// Compared at the resolution the CC can carry, so a transition never sends a CC which would change nothing
+static bool control_differs(const h9_preset* current, const h9_preset* target, control_id control) {
+    if (control == PSW) {
+        return current->psw != target->psw;
+    }
+    return h9_cc_value(preset_control_value(current, control)) != h9_cc_value(preset_control_value(target, control));
+}
+
+/* ==== PUBLIC (exported) Functions =============================================== */
+
+h9_transition_kind h9_planTransition(h9* h9, const h9_preset* target, h9_transition_plan* plan) {
+    memset(plan, 0x0, sizeof(*plan));
+
+    bool settings_match = same_sysex_settings(h9->preset, target);
+    for (size_t i = 0; i < NUM_CONTROLS; i++) {
+        if (!control_differs(h9->preset, target, (control_id)i)) {
+            continue;
+        }
+        plan->controls |= (h9_control_mask)(1U << i);
+        plan->cc_bytes += H9_TRANSITION_CC_BYTES;
+        if (h9->midi_config.cc_rx_map[i] == CC_DISABLED) {
+            plan->sysex_required = true;
+        }
+    }
+    plan->sysex_required |= !settings_match;
+
+    uint8_t sysex[H9_TRANSITION_MAX_SYSEX];
+    plan->sysex_bytes = h9_format_preset(h9, target, sysex, sizeof(sysex));
+
+    if (plan->sysex_required) {
+        plan->kind = kH9_TRANSITION_SYSEX;
+    } else if (plan->controls == 0) {
+        plan->kind = kH9_TRANSITION_NONE;
+    } else {
+        plan->kind = (plan->sysex_bytes < plan->cc_bytes) ? kH9_TRANSITION_SYSEX : kH9_TRANSITION_CC;
+    }
+    return plan->kind;
+}
+
+h9_transition_kind h9_transitionTo(h9* h9, const h9_preset* target) {
+    h9_transition_plan plan;
+    switch (h9_planTransition(h9, target, &plan)) {
+        case kH9_TRANSITION_CC:
+            h9_beginUpdate(h9);
+            for (size_t i = 0; i < NUM_CONTROLS; i++) {
+                if (plan.controls & (1U << i)) {
+                    h9_setControl(h9, (control_id)i, preset_control_value(target, (control_id)i), kH9_TRIGGER_CALLBACK);
+                }
+            }
+            h9_commitUpdate(h9);
+            break;
+        case kH9_TRANSITION_SYSEX: {
+            uint8_t sysex[H9_TRANSITION_MAX_SYSEX];
+            *h9->preset = *target;
+            size_t len  = h9_dump(h9, sysex, sizeof(sysex), true);
+            if (len <= sizeof(sysex)) {
+                h9_send_sysex(h9, sysex, len);
+            }
+            h9_reset_display_values(h9);
+            break;
+        }
+        case kH9_TRANSITION_NONE:
+            break;
+    }
+    return plan.kind;
+}
@@ -0,0 +1,66 @@
+/*  h9_transition.h
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef h9_transition_h
+#define h9_transition_h
+
+#include "libh9.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Transitions: moving the pedal from the current preset to a target preset with as little MIDI as possible.
+ *
+ * Where the target uses the same module, algorithm, knob maps and preset settings (tempo, gain, XYZ, modfactor) as the
+ * current preset, only the controls whose value differs are sent, as 14-bit CCs on cc_rx_map through cc_callback.
+ * Otherwise, or if a differing control has no CC mapped, or if the whole preset dump is actually shorter, the target
+ * is sent as a preset sysex through sysex_callback. The preset name only travels with a sysex, so a CC transition
+ * leaves the current name alone.
+ *
+ * Either way the h9's own preset is updated to match, with the usual display callbacks.
+ */
+
+#define H9_TRANSITION_CC_BYTES  6    // Per control: MSB and LSB control changes, 3 bytes each
+#define H9_TRANSITION_MAX_SYSEX 640  // Room for any preset dump
+
+typedef enum h9_transition_kind {
+    kH9_TRANSITION_NONE = 0U,  // Already there, nothing to send
+    kH9_TRANSITION_CC,
+    kH9_TRANSITION_SYSEX,
+} h9_transition_kind;
+
+typedef struct h9_transition_plan {
+    h9_transition_kind kind;
+    h9_control_mask    controls;        // Controls which differ (only meaningful if sysex_required is false)
+    bool               sysex_required;  // Module, algorithm, maps, settings differ, or a differing control has no CC
+    size_t             cc_bytes;        // MIDI bytes for the CC transition
+    size_t             sysex_bytes;     // MIDI bytes for the preset dump
+} h9_transition_plan;
+
+h9_transition_kind h9_planTransition(h9* h9, const h9_preset* target, h9_transition_plan* plan);  // Works out the cheapest route, sends nothing
+h9_transition_kind h9_transitionTo(h9* h9, const h9_preset* target);                               // Plans, then sends and applies it
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* h9_transition_h */
@@ -21,11 +21,11 @@
 #include "libh9.h"
 
 #include <assert.h>
-#include <math.h>
-#include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
-#include <time.h>
+
+#ifndef H9_FREESTANDING
+#include "h9_clock.h"
+#endif
 
 #include "h9_module.h"
 #include "h9_modules.h"
@@ -41,9 +41,6 @@
 #define EMPTY_PRESET_NAME            "Empty"
 #define MIDI_ACCEPTABLE_LSB_DELAY_MS 3.5  // roughly the amount of time to transmit the CC over a slow DIN connection
 
-#define DEBUG_LEVEL DEBUG_ERROR
-#include "debug.h"
-
 /* ==== Private Variables ========================================================= */
 
 /* ==== Private Function Declarations ============================================= */
@@ -63,17 +60,45 @@ void h9_reset_display_values(h9* h9) {
     h9_update_display_value(h9, PSW, h9->preset->psw ? 1.0f : 0.0f);
 }
 
-// This exists to handle future callbacks or other dynamic behaviour
+// This exists to handle future callbacks or other dynamic behaviour. Within a batch the callback is deferred to the commit.
 void h9_update_display_value(h9* h9, control_id control, control_value value) {
     if (control < H9_NUM_KNOBS) {
-        h9_knob* knob       = &h9->preset->knobs[control];
-        knob->display_value = value;
-        display_callback(h9, control, knob->current_value, knob->display_value);
+        h9->preset->knobs[control].display_value = value;
+    }
+    if (h9->update_depth > 0) {
+        h9->update_display |= (h9_control_mask)(1U << control);
+    } else if (control < H9_NUM_KNOBS) {
+        display_callback(h9, control, h9->preset->knobs[control].current_value, value);
     } else {
         display_callback(h9, control, value, value);
     }
 }
 
+// Re-evaluates every expression-mapped knob against the current pedal position and response curve
+void h9_update_expr_mappings(h9* h9) {
+    control_value response = h9_exprResponse(h9, h9->preset->expression);
+    for (size_t i = 0; i < H9_NUM_KNOBS; i++) {
+        h9_knob* knob = &h9->preset->knobs[i];
+        if (knob->exp_mapped) {
+            control_value interpolated_value = (knob->exp_max - knob->exp_min) * response + knob->exp_min;
+            h9_update_display_value(h9, (control_id)i, interpolated_value);
+        }
+    }
+}
+
+uint16_t h9_cc_value(control_value value) {
+    return (uint16_t)(clip(value, 0.0f, 1.0f) * MIDI_MAX);
+}
+
+void h9_send_sysex(h9* h9, uint8_t* sysex, size_t len) {
+    if (h9->sysex_callback != NULL) {
+        H9_STATS_COUNT(h9, sysex_callbacks);
+        H9_PROBE(sysex__callback, h9, len);
+        H9_JOURNAL_OUTPUT(h9, h9_journal_sysex_out(h9, sysex, len));
+        h9->sysex_callback(h9->callback_context, sysex, len);
+    }
+}
+
 /* ==== Private Functions ========================================================= */
 
 static void h9_setExpr(h9* h9, control_value value) {
@@ -84,14 +109,19 @@ static void h9_setExpr(h9* h9, control_value value) {
     }
 
     h9->preset->expression = expval;
+    h9_update_expr_mappings(h9);
+    h9_update_display_value(h9, EXPR, expval);
+}
+
+static void h9_update_psw_mappings(h9* h9) {
+    bool psw_on = h9->preset->psw;
     for (size_t i = 0; i < H9_NUM_KNOBS; i++) {
         h9_knob* knob = &h9->preset->knobs[i];
-        if (knob->exp_mapped) {
-            control_value interpolated_value = (knob->exp_max - knob->exp_min) * expval + knob->exp_min;
-            h9_update_display_value(h9, (control_id)i, interpolated_value);
+        if (knob->psw_mapped) {
+            // There might be an issue here if the expression has moved the knob and the PSW is turned on then off. Check vs. the pedal's behaviour.
+            h9_update_display_value(h9, (control_id)i, psw_on ? knob->psw : knob->current_value);
         }
     }
-    h9_update_display_value(h9, EXPR, expval);
 }
 
 static void h9_setPsw(h9* h9, bool psw_on) {
@@ -100,16 +130,32 @@ static void h9_setPsw(h9* h9, bool psw_on) {
     }
 
     h9->preset->psw = psw_on;
-    for (size_t i = 0; i < H9_NUM_KNOBS; i++) {
-        h9_knob* knob = &h9->preset->knobs[i];
-        if (knob->psw_mapped) {
-            // There might be an issue here if the expression has moved the knob and the PSW is turned on then off. Check vs. the pedal's behaviour.
-            h9_update_display_value(h9, (control_id)i, psw_on ? knob->psw : knob->current_value);
-        }
-    }
+    h9_update_psw_mappings(h9);
     h9_update_display_value(h9, PSW, psw_on ? 1.0 : 0.0f);
 }
 
+// Within a batch, only record the new value; the derived display values are worked out once, at the commit.
+static void h9_stageControl(h9* h9, control_id control, control_value value) {
+    switch (control) {
+        case EXPR:
+            value = clip(value, 0.0f, 1.0f);
+            if (h9->preset->expression == value) {
+                return;
+            }
+            h9->preset->expression = value;
+            break;
+        case PSW:
+            if (h9->preset->psw == (value > 0.0f)) {
+                return;
+            }
+            h9->preset->psw = (value > 0.0f);
+            break;
+        default:  // A knob
+            h9->preset->knobs[control].current_value = value;
+    }
+    h9->update_values |= (h9_control_mask)(1U << control);
+}
+
 static void h9_setKnob(h9* h9, control_id control, control_value value) {
     h9_knob* knob       = &h9->preset->knobs[control];
     knob->current_value = value;
@@ -120,6 +166,10 @@ static void h9_setKnob(h9* h9, control_id control, control_value value) {
 
 static void display_callback(h9* h9, control_id control, double current_value, double display_value) {
     if (h9->display_callback != NULL) {
+        H9_STATS_COUNT(h9, display_callbacks);
+        H9_LATENCY_DISPLAY(h9);
+        H9_PROBE(display__callback, h9, control);
+        H9_JOURNAL_OUTPUT(h9, h9_journal_display_out(h9, control, current_value, display_value));
         h9->display_callback(h9->callback_context, control, current_value, display_value);
     }
 }
@@ -130,32 +180,80 @@ static void cc_callback(h9* h9, control_id control, double value) {
     }
     uint8_t  midi_channel = h9->midi_config.midi_rx_channel;
     uint8_t  control_cc   = h9->midi_config.cc_rx_map[control];
-    uint16_t cc_value     = clip(value, 0.0f, 1.0f) * MIDI_MAX;
+    uint16_t cc_value     = h9_cc_value(value);
+    H9_STATS_COUNT(h9, cc_out);
+    H9_LATENCY_CC_OUT(h9);
+    H9_PROBE(cc__callback, h9, control_cc, cc_value);
+    H9_JOURNAL_OUTPUT(h9, h9_journal_cc_out(h9, midi_channel, control_cc, (uint8_t)(cc_value >> 7), (uint8_t)(cc_value & 0x7F)));
     h9->cc_callback(h9->callback_context, midi_channel, control_cc, (uint8_t)(cc_value >> 7), (uint8_t)(cc_value & 0x7F));
 }
 
 static double now_ms(void) {
-    struct timespec now;  // both C11 and POSIX
-    clock_gettime(CLOCK_MONOTONIC_RAW, &now);
-    double now_ms = ((double)now.tv_sec + 10.0E-9 * (double)now.tv_nsec) * 1000.0;
-    return now_ms;
+#ifdef H9_FREESTANDING
+    return h9_platform_now_ms();
+#else
+    return h9_clockNowMs();
+#endif
+}
+
+static void receive_cc(h9* h9, uint8_t cc_num, uint8_t cc_value, double time_ms) {
+    uint8_t value = cc_value & 0x7F;
+    H9_STATS_COUNT(h9, cc_in);
+
+    for (size_t i = 0; i < NUM_CONTROLS; i++) {
+        if (h9->midi_config.cc_tx_map[i] == cc_num) {
+            // i is the control listening to that CC, value is the MSB half
+
+            // Timestamp and save this information in case the LSB half shows up soon after
+            h9->midi_config.last_msb_cc             = cc_num;
+            h9->midi_config.last_msb                = value;
+            h9->midi_config.last_msb_timestamp_msec = time_ms;
+            h9_setKnob(h9, (control_id)i, ((double)value / 127.0f));
+            H9_PROBE(cc, h9, cc_num, value, kH9_PROBE_CC_MSB);
+            return;
+        } else if (h9->midi_config.cc_tx_map[i] == (cc_num - 32)) {
+            // i is the control listening to the CC, value is the LSB half
+
+            if (h9->midi_config.last_msb_cc != cc_num - 32) {
+                H9_STATS_COUNT(h9, lsb_unpaired);
+                H9_TRACE_POINT(kH9_TRACE_CC_LSB_DROPPED, cc_num, 0, 0);
+                H9_PROBE(cc, h9, cc_num, value, kH9_PROBE_CC_LSB_UNPAIRED);
+                return;  // Ignore, MSB shouldn't be sent randomly
+            }
+
+            if ((time_ms - h9->midi_config.last_msb_timestamp_msec) > MIDI_ACCEPTABLE_LSB_DELAY_MS) {
+                // It's been too long since we got the last MSB for this control, ignore and reset for next MSB.
+                h9->midi_config.last_msb_cc = CC_DISABLED;
+                H9_STATS_COUNT(h9, lsb_timeouts);
+                H9_TRACE_POINT(kH9_TRACE_CC_LSB_DROPPED, cc_num, h9_trace_us(time_ms - h9->midi_config.last_msb_timestamp_msec), 0);
+                H9_PROBE(cc, h9, cc_num, value, kH9_PROBE_CC_LSB_TIMEOUT);
+                return;
+            }
+
+            uint16_t high_res_cc   = (h9->midi_config.last_msb << 7) + value;
+            double   control_value = (double)high_res_cc / (double)((1 << 14) - 1);
+            h9_setKnob(h9, (control_id)i, control_value);
+            h9->midi_config.last_msb_cc = CC_DISABLED;
+            H9_STATS_COUNT(h9, lsb_paired);
+            H9_PROBE(cc, h9, cc_num, value, kH9_PROBE_CC_LSB);
+            return;
+        }
+    }
+    H9_STATS_COUNT(h9, cc_unmapped);
+    H9_PROBE(cc, h9, cc_num, value, kH9_PROBE_CC_UNMAPPED);
 }
 
 /* ==== PUBLIC (exported) Functions =============================================== */
 
-h9* h9_new(void) {
-    h9* h9 = malloc(sizeof(*h9));
-    if (h9 == NULL) {
-        return h9;
+h9* h9_init(h9* h9, h9_preset* preset) {
+    if (h9 == NULL || preset == NULL) {
+        return NULL;
     }
+    memset(h9, 0x0, sizeof(*h9));
 
     // Init the preset object
-    h9->preset = h9_preset_new();
-    if (h9->preset == NULL) {
-        h9_delete(h9);
-        h9 = NULL;
-        return h9;
-    }
+    h9_preset_init(preset);
+    h9->preset = preset;
 
     // Set sane default values so the object functions correctly
     h9->midi_config.last_msb_cc             = CC_DISABLED;
@@ -174,38 +272,56 @@ h9* h9_new(void) {
     h9->midi_config.cc_rx_map[PSW]  = DEFAULT_PSW_CC;
     h9->midi_config.cc_tx_map[PSW]  = DEFAULT_PSW_CC;
 
-    h9->cc_callback      = NULL;
-    h9->display_callback = NULL;
-    h9->sysex_callback   = NULL;
-    h9->callback_context = (void*)h9;
+    h9->expr_curve       = kH9_EXPR_LINEAR;
+    h9->expr_num_points  = 0;
+    h9->pedal_cal_min    = 0;
+    h9->pedal_cal_max    = H9_PEDAL_CAL_FULL_SCALE;
+    h9->pedal_cal_rx_min = 0;
+    h9->pedal_cal_rx_max = H9_PEDAL_CAL_FULL_SCALE;
+    h9_compile_expr(h9);
+
+    h9->cc_callback            = NULL;
+    h9->display_callback       = NULL;
+    h9->batch_display_callback = NULL;
+    h9->sysex_callback         = NULL;
+    h9->callback_context       = (void*)h9;
 
-    memset(h9->name, 0x0, sizeof(h9->name));
-    memset(h9->bluetooth_pin, 0x0, sizeof(h9->bluetooth_pin));
     strcpy(h9->name, "H9");
     strcpy(h9->bluetooth_pin, "0000");
 
     return h9;
 }
 
-void h9_delete(h9* h9) {
+h9* h9_new(void) {
+    h9* h9 = h9_alloc(sizeof(*h9));
     if (h9 == NULL) {
-        return;
+        return h9;
     }
-    if (h9->preset != NULL) {
-        free(h9->preset);
+
+    h9_preset* preset = h9_preset_new();
+    if (preset == NULL) {
+        h9_free(h9);
+        return NULL;
     }
-    free(h9);
+
+    return h9_init(h9, preset);
 }
 
-h9_preset* h9_preset_new(void) {
-    h9_preset* h9_preset = malloc(sizeof(*h9_preset));
-    if (h9_preset == NULL) {
-        return h9_preset;
+// Only for instances from h9_new, not storage passed to h9_init.
+void h9_delete(h9* h9) {
+    if (h9 == NULL) {
+        return;
     }
+    h9_preset_delete(h9->preset);
+    h9_free(h9);
+}
+
+void h9_preset_init(h9_preset* h9_preset) {
+    memset(h9_preset, 0x0, sizeof(*h9_preset));
 
     // Set up a safe (but not very useful) default preset
     h9_preset->module    = &h9_modules[DEFAULT_MODULE];
-    h9_preset->algorithm = &h9_preset->module->algorithms[DEFAULT_ALGORITHM];
+    h9_preset->algorithm = h9_algorithmAt(DEFAULT_MODULE, DEFAULT_ALGORITHM);
     strncpy(h9_preset->name, EMPTY_PRESET_NAME, H9_MAX_NAME_LEN);
     h9_preset->output_gain = 0.0f;
     h9_preset->tempo       = 120.0f;
@@ -223,18 +339,27 @@ h9_preset* h9_preset_new(void) {
 
     h9_preset->loaded = false;
     h9_preset->dirty  = false;
-
-    return h9_preset;
 }
 
 // Common H9 operations
 
 // Knob, Expr, and PSW operations
-void h9_setControl(h9* h9, control_id control, control_value value, h9_callback_action cc_cb_action) {
+static void set_control(h9* h9, control_id control, control_value value, h9_callback_action cc_cb_action) {
     if (control >= NUM_CONTROLS) {
         return;  // Control is invalid
     }
+    H9_PROBE(set__control, h9, control, h9_cc_value(value), cc_cb_action);
 
+    if (h9->update_depth > 0) {
+        h9_stageControl(h9, control, value);
+        h9->preset->dirty = true;
+        if (cc_cb_action == kH9_TRIGGER_CALLBACK) {
+            h9->update_cc |= (h9_control_mask)(1U << control);
+        }
+        return;
+    }
+
+    H9_LATENCY_BEGIN(h9, kH9_LATENCY_CONTROL_TO_CC);
     switch (control) {
         case EXPR:
             h9_setExpr(h9, value);
@@ -249,6 +374,88 @@ void h9_setControl(h9* h9, control_id control, control_value value, h9_callback_
     if (cc_cb_action == kH9_TRIGGER_CALLBACK) {
         cc_callback(h9, control, value);
     }
+    H9_LATENCY_END(h9);
+}
+
+void h9_setControl(h9* h9, control_id control, control_value value, h9_callback_action cc_cb_action) {
+    H9_JOURNAL_INPUT(h9, h9_journal_control_in(h9, control, value, cc_cb_action), set_control(h9, control, value, cc_cb_action));
+}
+
+void h9_setControls(h9* h9, const h9_control_update* updates, size_t num_updates, h9_callback_action cc_cb_action) {
+    h9_beginUpdate(h9);
+    for (size_t i = 0; i < num_updates; i++) {
+        h9_setControl(h9, updates[i].control, updates[i].value, cc_cb_action);
+    }
+    h9_commitUpdate(h9);
+}
+
+static void begin_update(h9* h9) {
+    if (h9->update_depth++ == 0) {
+        h9->update_values  = 0;
+        h9->update_display = 0;
+        h9->update_cc      = 0;
+    }
+}
+
+/*
+ The commit settles the staged controls in a fixed order: knobs first, then the expression mapping, then the PSW
+ mapping, so a scene's mapped knobs end up as the pedal would show them whatever order the controls were set in.
+ Each changed control is then notified once (or all together through batch_display_callback), followed by one pass
+ of CCs carrying the final values.
+ */
+static void commit_update(h9* h9) {
+    if (h9->update_depth == 0 || --h9->update_depth > 0) {
+        return;
+    }
+    h9->update_depth = 1;  // Keep collecting display changes while settling
+    for (size_t i = 0; i < H9_NUM_KNOBS; i++) {
+        h9_knob* knob = &h9->preset->knobs[i];
+        if ((h9->update_values & (1U << i)) && knob->current_value != knob->display_value) {
+            h9_update_display_value(h9, (control_id)i, knob->current_value);
+        }
+    }
+    if (h9->update_values & (1U << EXPR)) {
+        h9_update_expr_mappings(h9);
+        h9_update_display_value(h9, EXPR, h9->preset->expression);
+    }
+    if (h9->update_values & (1U << PSW)) {
+        h9_update_psw_mappings(h9);
+        h9_update_display_value(h9, PSW, h9->preset->psw ? 1.0f : 0.0f);
+    }
+    h9->update_depth = 0;
+
+    h9_control_mask changed = h9->update_display;
+    if (h9->batch_display_callback != NULL) {
+        if (changed != 0) {
+            H9_STATS_COUNT(h9, batch_display_callbacks);
+            H9_PROBE(batch__display__callback, h9, changed);
+            H9_JOURNAL_OUTPUT(h9, h9_journal_batch_display_out(h9, changed));
+            h9->batch_display_callback(h9->callback_context, changed);
+        }
+    } else {
+        for (size_t i = 0; i < NUM_CONTROLS; i++) {
+            if (changed & (1U << i)) {
+                control_value value = h9_controlValue(h9, (control_id)i);
+                display_callback(h9, (control_id)i, value, (i < H9_NUM_KNOBS) ? h9->preset->knobs[i].display_value : value);
+            }
+        }
+    }
+    for (size_t i = 0; i < NUM_CONTROLS; i++) {
+        if (h9->update_cc & (1U << i)) {
+            cc_callback(h9, (control_id)i, h9_controlValue(h9, (control_id)i));
+        }
+    }
+    h9->update_values  = 0;
+    h9->update_display = 0;
+    h9->update_cc      = 0;
+}
+
+void h9_beginUpdate(h9* h9) {
+    H9_JOURNAL_INPUT(h9, h9_journal_event(h9, kH9_JOURNAL_BEGIN_UPDATE), begin_update(h9));
+}
+
+void h9_commitUpdate(h9* h9) {
+    H9_JOURNAL_INPUT(h9, h9_journal_event(h9, kH9_JOURNAL_COMMIT_UPDATE), commit_update(h9));
 }
 
 void h9_setKnobMap(h9* h9, control_id knob_num, control_value exp_min, control_value exp_max, control_value psw) {
@@ -317,15 +524,12 @@ void h9_knobMap(h9* h9, control_id knob_num, control_value* exp_min, control_val
 
 // Preset Operations
 bool h9_setAlgorithm(h9* h9, uint8_t module_id, uint8_t algorithm_id) {
-    if (module_id >= H9_NUM_MODULES) {
+    const h9_algorithm* algorithm = h9_algorithmAt(module_id, algorithm_id);
+    if (algorithm == NULL) {
         return false;
     }
-    h9_module* module = &h9_modules[module_id];
-    if (algorithm_id >= module->num_algorithms) {
-        return false;
-    }
-    h9->preset->module    = module;
-    h9->preset->algorithm = &module->algorithms[algorithm_id];
+    h9->preset->module    = &h9_modules[module_id];
+    h9->preset->algorithm = algorithm;
     h9->preset->dirty     = true;
     h9_reset_display_values(h9);
     return true;
@@ -343,7 +547,7 @@ size_t h9_numAlgorithms(h9* h9, uint8_t module_id) {
     return h9_modules[module_id].num_algorithms;
 }
 
-h9_module* h9_currentModule(h9* h9) {
+const h9_module* h9_currentModule(h9* h9) {
     return h9->preset->module;
 }
 
@@ -351,7 +555,7 @@ uint8_t h9_currentModuleIndex(h9* h9) {
     return h9->preset->module->sysex_id - 1;  // Zero index externally
 }
 
-h9_algorithm* h9_currentAlgorithm(h9* h9) {
+const h9_algorithm* h9_currentAlgorithm(h9* h9) {
     return h9->preset->algorithm;
 }
 
@@ -363,11 +567,11 @@ const char* const h9_moduleName(uint8_t module_id) {
     if (module_id < 0 || module_id >= H9_NUM_MODULES) {
         return NULL;
     }
-    return h9_modules[module_id].name;
+    return H9_STRING(h9_modules[module_id].name);
 }
 
 const char* h9_currentModuleName(h9* h9) {
-    return h9->preset->module->name;
+    return H9_STRING(h9->preset->module->name);
 }
 
 bool h9_presetLoaded(h9* h9) {
@@ -425,15 +629,68 @@ bool h9_setPresetName(h9* h9, const char* name, size_t len) {
     }
 }
 
+// Module sysex ids start at 1, algorithm sysex ids at 0
 const char* const h9_algorithmName(uint8_t module_sysex_id, uint8_t algorithm_sysex_id) {
-    assert(module_sysex_id > 0 && module_sysex_id <= H9_NUM_MODULES);
-    h9_module* module = &h9_modules[module_sysex_id];
-    assert(algorithm_sysex_id < module->num_algorithms);
-    return module->algorithms[algorithm_sysex_id].name;
+    if (module_sysex_id == 0) {
+        return NULL;
+    }
+    const h9_algorithm* algorithm = h9_algorithmAt(module_sysex_id - 1, algorithm_sysex_id);
+    return (algorithm != NULL) ? H9_STRING(algorithm->name) : NULL;
 }
 
 const char* h9_currentAlgorithmName(h9* h9) {
-    return h9->preset->algorithm->name;
+    return H9_STRING(h9->preset->algorithm->name);
+}
+
+const h9_algorithm* h9_algorithmAt(uint8_t module_id, uint8_t algorithm_id) {
+    if (module_id >= H9_NUM_MODULES) {
+        return NULL;
+    }
+    const h9_module* module = &h9_modules[module_id];
+    if (algorithm_id >= module->num_algorithms) {
+        return NULL;
+    }
+    return &h9_algorithms[module->first_algorithm + algorithm_id];
+}
+
+const char* h9_knobLabel(const h9_algorithm* algorithm, control_id control) {
+    if (algorithm == NULL) {
+        return NULL;
+    }
+    if (control <= KNOB9) {
+        return H9_STRING(algorithm->knob_labels[control]);
+    }
+    if (control == PSW) {
+        return H9_STRING(algorithm->psw_label);
+    }
+    return NULL;
+}
+
+const h9_knob_range* h9_knobRange(const h9_algorithm* algorithm, control_id control) {
+    if (algorithm == NULL || control > KNOB9) {
+        return NULL;
+    }
+    return &h9_knob_ranges[algorithm->knob_ranges[control]];
+}
+
+int32_t h9_knobRangeLookup(const h9_knob_range* range, control_value value) {
+    size_t step = (size_t)(clip(value, 0.0f, 1.0f) * (range->steps - 1) + 0.5);
+    return h9_display_table[range->table + step];
+}
+
+size_t h9_displayString(h9* h9, control_id control, char* dest, size_t max_len) {
+    const h9_knob_range* range = h9_knobRange(h9->preset->algorithm, control);
+    if (range == NULL || max_len == 0) {
+        return 0;
+    }
+    int32_t     value         = h9_knobRangeLookup(range, h9->preset->knobs[control].display_value);
+    size_t      bytes_written = format_fixed(dest, max_len, value, range->decimals);
+    const char* unit          = H9_STRING(range->unit);
+    while (*unit != '\0' && bytes_written < max_len - 1) {
+        dest[bytes_written++] = *unit++;
+    }
+    dest[bytes_written] = '\0';
+    return bytes_written;
 }
 
 // MIDI configuration
@@ -470,37 +727,44 @@ bool h9_dirty(h9* h9) {
 }
 
 void h9_cc(h9* h9, uint8_t cc_num, uint8_t cc_value) {
-    uint8_t value = cc_value & 0x7F;
+    h9_ccAt(h9, cc_num, cc_value, (h9->clock_callback != NULL) ? h9->clock_callback(h9->clock_context) : now_ms());
+}
 
-    for (size_t i = 0; i < NUM_CONTROLS; i++) {
-        if (h9->midi_config.cc_tx_map[i] == cc_num) {
-            // i is the control listening to that CC, value is the MSB half
+void h9_ccAt(h9* h9, uint8_t cc_num, uint8_t cc_value, double time_ms) {
+    H9_LATENCY_BEGIN(h9, kH9_LATENCY_CC_TO_DISPLAY);
+    H9_JOURNAL_INPUT(h9, h9_journal_cc_in(h9, cc_num, cc_value, time_ms), receive_cc(h9, cc_num, cc_value, time_ms));
+    H9_LATENCY_END(h9);
+}
 
-            // Timestamp and save this information in case the LSB half shows up soon after
-            h9->midi_config.last_msb_cc             = cc_num;
-            h9->midi_config.last_msb                = value;
-            h9->midi_config.last_msb_timestamp_msec = now_ms();
-            h9_setKnob(h9, (control_id)i, ((double)value / 127.0f));
-            return;
-        } else if (h9->midi_config.cc_tx_map[i] == (cc_num - 32)) {
-            // i is the control listening to the CC, value is the LSB half
+/*
+ Each event is paired (MSB/LSB) by its own timestamp, so the outcome depends only on the events, not on when the batch
+ is drained. The batch is one update: each control changed is notified once at the end, as by h9_setControls.
+ */
+void h9_ccBatch(h9* h9, const h9_cc_event* events, size_t num_events) {
+    h9_beginUpdate(h9);
+    for (size_t i = 0; i < num_events; i++) {
+        h9_ccAt(h9, events[i].cc_num, events[i].cc_value, events[i].time_ms);
+    }
+    h9_commitUpdate(h9);
+}
 
-            if (h9->midi_config.last_msb_cc != cc_num - 32) {
-                return;  // Ignore, MSB shouldn't be sent randomly
-            }
+void h9_setClock(h9* h9, h9_clock_callback clock_callback, void* ctx) {
+    h9->clock_callback = clock_callback;
+    h9->clock_context  = ctx;
+}
 
-            double time_ms = now_ms();
-            if ((time_ms - h9->midi_config.last_msb_timestamp_msec) > MIDI_ACCEPTABLE_LSB_DELAY_MS) {
-                // It's been too long since we got the last MSB for this control, ignore and reset for next MSB.
-                h9->midi_config.last_msb_cc = CC_DISABLED;
-                return;
-            }
+bool h9_statsSnapshot(h9* h9, h9_stats* dest) {
+#ifdef H9_STATS
+    *dest = h9->stats;
+    return true;
+#else
+    memset(dest, 0x0, sizeof(*dest));
+    return false;
+#endif
+}
 
-            uint16_t high_res_cc   = (h9->midi_config.last_msb << 7) + value;
-            double   control_value = (double)high_res_cc / (double)((1 << 14) - 1);
-            h9_setKnob(h9, (control_id)i, control_value);
-            h9->midi_config.last_msb_cc = CC_DISABLED;
-            return;
-        }
-    }
+void h9_statsReset(h9* h9) {
+#ifdef H9_STATS
+    memset(&h9->stats, 0x0, sizeof(h9->stats));
+#endif
 }
@@ -27,6 +27,7 @@
 
 #define H9_NUM_MODULES    5
 #define H9_MAX_ALGORITHMS 12
+#define H9_NUM_ALGORITHMS 52  // Total across all modules
 #define H9_NUM_KNOBS      10
 #define H9_MAX_NAME_LEN   17  // 16 plus a null
 #define H9_SYSEX_EVENTIDE 0x1C
@@ -36,6 +37,10 @@
 #define CC_DISABLED       255
 #define MAX_CC            99  // H9 manual states that allowable CCs are 0-99.
 
+#define H9_EXPR_TABLE_SIZE      33      // Points in the compiled expression response table (32 segments)
+#define H9_EXPR_MAX_POINTS      16      // Breakpoints accepted for a custom expression curve
+#define H9_PEDAL_CAL_FULL_SCALE 0x7FFF  // Pedal calibration values are in raw pedal units, 0 to this
+
 typedef enum h9_status {
     kH9_UNKNOWN = 0U,
     kH9_OK,
@@ -44,8 +49,29 @@ typedef enum h9_status {
     kH9_SYSEX_CHECKSUM_INVALID,
     kH9_SYSEX_ID_MISMATCH,
     kH9_UNSUPPORTED_COMMAND,
+    kH9_NUM_STATUS,  // KEEP THIS LAST
 } h9_status;
 
+// The message type, the byte after the sysex id in every H9 sysex message
+typedef enum h9_message_code {
+    kH9_SYSEX_OK          = 0x0,
+    kH9_ERROR             = 0x0d,  // Response from pedal with problem. Body of response is ASCII readable error description.
+    kH9_USER_VALUE_PUT    = 0x2d,  // COMMAND to set indicated key to value. Data format: [key]<space>[value] in "ASCII hex". Response is VALUE_DUMP
+    kH9_SYSEX_VALUE_DUMP  = 0x2e,  // Response containing a single value as "ASCII hex"
+    kH9_OBJECTINFO_WANT   = 0x31,  // Request value of specified key. Data format: [key] = ["ASCII hex", e.g. "201" = 0x32 0x30 0x31 0x00]
+    kH9_VALUE_WANT        = 0x3b,  // Same as OBJECTINFO_WANT. Both reply with a VALUE_DUMP.
+    kH9_USER_OBJECT_SHORT = 0x3c,  // COMMAND: XXXX YY = [key] [value], same as VALUE_PUT.
+    kH9_DUMP_ALL          = 0x48,  // Requests all programs. Response is a PROGRAM_DUMP.
+    kH9_PROGRAM_DUMP      = 0x49,  // Response containing all programs in memory on the unit, sequentially.
+    kH9_TJ_SYSVARS_WANT   = 0x4c,  // Request full sysvars. Response is a TJ_SYSVARS_DUMP.
+    kH9_TJ_SYSVARS_DUMP   = 0x4d,  // Response to SYSVARS_WANT, contains full sysvar dump in unspecified format.
+    kH9_DUMP_ONE          = 0x4e,  // Requests the currently loaded PROGRAM. Response is PROGRAM.
+    kH9_PROGRAM           = 0x4f,  // COMMAND to set temporary PROGRAM, RESPONSE contains indicated PROGRAM.
+} h9_message_code;
+
+#define H9_NUM_MESSAGE_CODES  13  // Entries in h9_message_code
+#define H9_SYSEX_BROADCAST_ID 0   // Destination id which every pedal accepts
+
 typedef enum control_id {
     KNOB0 = 0U,  // KNOB 0 MUST REMAIN 0
     KNOB1,
@@ -73,31 +99,47 @@ typedef enum h9_callback_action {
     kH9_TRIGGER_CALLBACK,
 } h9_callback_action;
 
+typedef enum h9_expr_curve {
+    kH9_EXPR_LINEAR = 0U,
+    kH9_EXPR_LOG,     // Fast at the heel, slow at the toe (log10(1 + 9x))
+    kH9_EXPR_EXP,     // The inverse of LOG
+    kH9_EXPR_SCURVE,  // Smoothstep, slow at both ends
+    kH9_EXPR_CUSTOM,  // Piecewise linear through caller-supplied breakpoints
+} h9_expr_curve;
+
 typedef double control_value;  // 0.00 to 1.00 always.
 
+typedef struct h9_expr_point {
+    float x;  // pedal position, 0.0 to 1.0, strictly increasing
+    float y;  // response, 0.0 to 1.0
+} h9_expr_point;
+
+// Offset of a null-terminated string in the shared (generated) string pool, see h9_modules.h
+typedef uint16_t h9_strref;
+
+// Display range of a knob. The display value for each of the steps across the knob's travel is precomputed (see h9_knobRangeLookup)
+typedef struct h9_knob_range {
+    uint16_t  table;     // Offset of this range's first entry in the generated display table
+    uint16_t  steps;     // Number of entries, >= 2
+    h9_strref unit;      // Appended to the value by h9_displayString(), may be empty
+    uint8_t   decimals;  // Table entries are fixed point, scaled by 10^decimals
+} h9_knob_range;
+
 typedef struct h9_algorithm {
-    uint8_t     id;         // sero indexed for internal and sysex values
-    uint8_t     module_id;  // zero indexed internal value
-    char const* name;
-    char const* label_knob1;
-    char const* label_knob2;
-    char const* label_knob3;
-    char const* label_knob4;
-    char const* label_knob5;
-    char const* label_knob6;
-    char const* label_knob7;
-    char const* label_knob8;
-    char const* label_knob9;
-    char const* label_knob10;
-    char const* label_psw;
+    uint8_t   id;                         // sero indexed for internal and sysex values
+    uint8_t   module_id;                  // zero indexed internal value
+    h9_strref name;                       // Resolve with h9_algorithmName() / h9_currentAlgorithmName()
+    h9_strref knob_labels[H9_NUM_KNOBS];  // Resolve with h9_knobLabel()
+    h9_strref psw_label;
+    uint8_t   knob_ranges[H9_NUM_KNOBS];  // Resolve with h9_knobRange()
 } h9_algorithm;
 
 typedef struct h9_module {
-    char const*  name;
-    uint8_t      sysex_id;  // 1 indexed
-    uint8_t      psw_mode;
-    h9_algorithm algorithms[H9_MAX_ALGORITHMS];
-    size_t       num_algorithms;
+    h9_strref name;
+    uint8_t   sysex_id;  // 1 indexed
+    uint8_t   psw_mode;
+    uint8_t   first_algorithm;  // Index of this module's first entry in h9_algorithms[]
+    uint8_t   num_algorithms;
 } h9_module;
 
 typedef struct h9_knob {
@@ -112,17 +154,17 @@ typedef struct h9_knob {
 } h9_knob;
 
 typedef struct h9_preset {
-    char          name[H9_MAX_NAME_LEN];
-    h9_module*    module;
-    h9_algorithm* algorithm;
-    h9_knob       knobs[H9_NUM_KNOBS];
-    control_value expression;
-    bool          psw;
-    double        tempo;
-    double        output_gain;
-    uint8_t       xyz_map[3];
-    bool          tempo_enabled;
-    bool          modfactor_fast_slow;
+    char                name[H9_MAX_NAME_LEN];
+    const h9_module*    module;
+    const h9_algorithm* algorithm;
+    h9_knob             knobs[H9_NUM_KNOBS];
+    control_value       expression;
+    bool                psw;
+    double              tempo;
+    double              output_gain;
+    uint8_t             xyz_map[3];
+    bool                tempo_enabled;
+    bool                modfactor_fast_slow;
 
     bool dirty;   // true if changes have been made (e.g. knobs twiddled, exp map changed) after last load or save
     bool loaded;  // true if the preset has been loaded to or from the pedal
@@ -133,6 +175,74 @@ typedef struct h9 h9;
 typedef void (*h9_display_callback)(void* ctx, control_id control, control_value current_value, control_value display_value);
 typedef void (*h9_cc_callback)(void* ctx, uint8_t midi_channel, uint8_t cc, uint8_t msb, uint8_t lsb);
 typedef void (*h9_sysex_callback)(void* ctx, uint8_t* sysex, size_t len);
+typedef double (*h9_clock_callback)(void* ctx);  // Monotonic milliseconds, for h9_cc (see h9_setClock)
+typedef h9_status (*h9_sysex_handler)(void* ctx, uint8_t message_code, uint8_t* payload, size_t len);
+
+typedef struct h9_sysex_route {
+    h9_sysex_handler handler;
+    void*            context;
+} h9_sysex_route;
+
+// One bit per control_id, (1 << control)
+typedef uint16_t h9_control_mask;
+// Fired once per committed batch (see h9_beginUpdate) instead of display_callback per control, if registered.
+typedef void (*h9_batch_display_callback)(void* ctx, h9_control_mask changed);
+
+// Sysex successfully parsed, by message type
+typedef enum h9_stats_message {
+    kH9_STATS_PROGRAM = 0U,
+    kH9_STATS_SYSVARS,
+    kH9_STATS_VALUE_DUMP,
+    kH9_STATS_NUM_MESSAGES,  // KEEP THIS LAST
+} h9_stats_message;
+
+// Per-instance counters, see h9_statsSnapshot. Only kept if compiled with H9_STATS (the CMake option of the same name).
+typedef struct h9_stats {
+    uint32_t sysex_parsed[kH9_STATS_NUM_MESSAGES];
+    uint32_t parse_failures[kH9_NUM_STATUS];  // By the h9_status returned by h9_parse_sysex
+    uint32_t cc_in;                           // Calls to h9_cc, whether or not the CC was for a mapped control
+    uint32_t cc_unmapped;                     // ... of which matched no control
+    uint32_t lsb_paired;                      // LSBs combined with their MSB into a 14-bit value
+    uint32_t lsb_timeouts;                    // LSBs dropped, too long after their MSB (MIDI_ACCEPTABLE_LSB_DELAY_MS)
+    uint32_t lsb_unpaired;                    // LSBs dropped, with no MSB before them
+    uint32_t cc_out;                          // cc_callback invocations
+    uint32_t display_callbacks;
+    uint32_t batch_display_callbacks;
+    uint32_t sysex_callbacks;
+    uint32_t dumps;  // Successful h9_dump calls
+    uint64_t bytes_dumped;
+} h9_stats;
+
+// Paths timed end to end, see h9_latencySnapshot. Only measured if compiled with H9_LATENCY (hosted builds only).
+typedef enum h9_latency_path {
+    kH9_LATENCY_CC_TO_DISPLAY = 0U,  // h9_cc until the first display_callback it causes
+    kH9_LATENCY_SYSEX_TO_DISPLAY,    // h9_parse_sysex until the first display_callback it causes
+    kH9_LATENCY_CONTROL_TO_CC,       // h9_setControl until its cc_callback
+    kH9_NUM_LATENCY_PATHS,           // KEEP THIS LAST
+} h9_latency_path;
+
+#define H9_LATENCY_SUB_BITS    4   // 16 buckets per power of two, so every bucket is within 1/16 of its values
+#define H9_LATENCY_MAX_BITS    40  // Samples of 2^40 ticks or more all land in the last bucket
+#define H9_LATENCY_NUM_BUCKETS ((H9_LATENCY_MAX_BITS - H9_LATENCY_SUB_BITS + 1) << H9_LATENCY_SUB_BITS)
+
+// Log-linear (HDR style) histogram of h9_clock ticks: exact below 16, then 16 buckets per power of two
+typedef struct h9_latency_histogram {
+    uint32_t counts[H9_LATENCY_NUM_BUCKETS];
+    uint64_t total;
+    uint64_t max_ticks;
+} h9_latency_histogram;
+
+typedef struct h9_control_update {
+    control_id    control;
+    control_value value;
+} h9_control_update;
+
+// An incoming CC and when it arrived, on any monotonic millisecond clock (as h9_ccAt)
+typedef struct h9_cc_event {
+    double  time_ms;
+    uint8_t cc_num;
+    uint8_t cc_value;
+} h9_cc_event;
 
 /*
  sysex_id can be 1-16 (0 is prohibited as it is the broadcast value). 1 is the pedal default.
@@ -173,11 +283,49 @@ typedef struct h9 {
     bool         global_tempo;
     h9_knob_mode knob_mode;
 
+    // Expression response: curve and pedal calibration, compiled to expr_table (see h9_expr.h)
+    h9_expr_curve expr_curve;
+    h9_expr_point expr_points[H9_EXPR_MAX_POINTS];  // Only for kH9_EXPR_CUSTOM
+    size_t        expr_num_points;
+    uint16_t      pedal_cal_min;
+    uint16_t      pedal_cal_max;
+    uint16_t      pedal_cal_rx_min;  // Bounds from single value dumps, applied once they make a valid range
+    uint16_t      pedal_cal_rx_max;
+    bool          expr_identity;  // Linear and uncalibrated, expr_table is bypassed
+    float         expr_table[H9_EXPR_TABLE_SIZE];
+
+    // Batched updates in progress (see h9_beginUpdate)
+    uint8_t         update_depth;
+    h9_control_mask update_values;   // Controls set, still to be applied to the display values
+    h9_control_mask update_display;  // Display values changed, still to be notified
+    h9_control_mask update_cc;       // Controls whose CC is still to be sent
+
+#ifdef H9_STATS
+    h9_stats stats;
+#endif
+#if defined(H9_LATENCY) && !defined(H9_FREESTANDING)
+    h9_latency_histogram latency[kH9_NUM_LATENCY_PATHS];
+    uint64_t             latency_start;    // h9_clock ticks when the path being timed started
+    uint8_t              latency_pending;  // The h9_latency_path being timed + 1, 0 if none
+#endif
+#if defined(H9_JOURNAL) && !defined(H9_FREESTANDING)
+    struct h9_journal* journal;        // Recording, if not NULL (see h9_journal.h)
+    bool               journal_input;  // Inside a recorded input, so nested inputs aren't recorded again
+#endif
+
     // Observer registration
-    h9_display_callback display_callback;
-    h9_cc_callback      cc_callback;
-    h9_sysex_callback   sysex_callback;
-    void*               callback_context;
+    h9_display_callback       display_callback;
+    h9_batch_display_callback batch_display_callback;
+    h9_cc_callback            cc_callback;
+    h9_sysex_callback         sysex_callback;
+    void*                     callback_context;
+
+    // Time source for h9_cc, the OS clock if NULL (see h9_setClock)
+    h9_clock_callback clock_callback;
+    void*             clock_context;
+
+    // Handlers for incoming sysex, by message code (see h9_sysexSetHandler)
+    h9_sysex_route sysex_routes[H9_NUM_MESSAGE_CODES];
 } h9;
 
 #ifdef __cplusplus
@@ -186,39 +334,87 @@ extern "C" {
 
 // H9 API
 
-const char* const h9_algorithmName(uint8_t module_sysex_id, uint8_t algorithm_sysex_id);
-void              h9_delete(h9* h9);
-control_value     h9_controlValue(h9* h9, control_id control);
-void              h9_copyMidiConfig(h9* h9, h9_midi_config* dest_copy);
-h9_algorithm*     h9_currentAlgorithm(h9* h9);
-uint8_t           h9_currentAlgorithmIndex(h9* h9);
-const char*       h9_currentAlgorithmName(h9* h9);
-h9_module*        h9_currentModule(h9* h9);
-uint8_t           h9_currentModuleIndex(h9* h9);
-const char*       h9_currentModuleName(h9* h9);
-bool              h9_presetLoaded(h9* h9);
-const char*       h9_presetName(h9* h9, size_t* len);
-bool              h9_setPresetName(h9* h9, const char* name, size_t len);
-bool              h9_dirty(h9* h9);
-control_value     h9_displayValue(h9* h9, control_id control);
-void              h9_knobMap(h9* h9, control_id knob_num, control_value* exp_min, control_value* exp_max, control_value* psw);
-bool              h9_knobExprMapped(h9* h9, control_id knob_num);
-bool              h9_knobPswMapped(h9* h9, control_id knob_num);
-const char* const h9_moduleName(uint8_t module_id);
-h9*               h9_new(void);  // Allocates and returns a pointer to a new H9 instance
-size_t            h9_numAlgorithms(h9* h9, uint8_t module_id);
-size_t            h9_numModules(h9* h9);
-bool              h9_setAlgorithm(h9* h9, uint8_t module_id, uint8_t algorithm_id);
-void              h9_setControl(h9* h9, control_id knob_num, control_value value, h9_callback_action cc_cb_action);
-void              h9_setKnobMap(h9* h9, control_id knob_num, control_value exp_min, control_value exp_max, control_value psw);
-bool              h9_setMidiConfig(h9* h9, const h9_midi_config* midi_config);
-void              h9_cc(h9* h9, uint8_t cc_num, uint8_t cc_value);
+/*
+ Real-time safe subset: these never allocate, lock or make system calls, so they may be called from an audio thread as long
+ as the registered callbacks are real-time safe too and each h9 is only used by one thread at a time.
+
+   h9_ccAt, h9_ccBatch, h9_setControl, h9_setControls, h9_beginUpdate, h9_commitUpdate, h9_controlValue, h9_displayValue,
+   h9_displayString, h9_knobRangeLookup, h9_exprResponse
+
+ h9_cc reads the clock itself (CLOCK_MONOTONIC_RAW, which can be a system call, unless h9_setClock replaced it), so an
+ audio thread should pass its own timestamp to h9_ccAt or h9_ccBatch instead. With H9_TRACE, call h9_traceRegisterThread on the audio thread before it first traces, as
+ that allocates the thread's ring. H9_LATENCY reads the TSC on x86_64 but CLOCK_MONOTONIC elsewhere. An h9 being recorded
+ by h9_journalStart writes through stdio, which is not real-time safe.
+ test/rt_safety_test.c checks all of this.
+ */
+
+const h9_algorithm*  h9_algorithmAt(uint8_t module_id, uint8_t algorithm_id);  // NULL if either is out of range
+void                 h9_beginUpdate(h9* h9);  // Defer display and CC callbacks until the matching h9_commitUpdate (nests)
+void                 h9_commitUpdate(h9* h9);
+const char* const    h9_algorithmName(uint8_t module_sysex_id, uint8_t algorithm_sysex_id);  // NULL if either is out of range
+void                 h9_delete(h9* h9);
+size_t               h9_displayString(h9* h9, control_id control, char* dest, size_t max_len);  // Knobs only, returns the strlen written
+control_value        h9_controlValue(h9* h9, control_id control);
+void                 h9_copyMidiConfig(h9* h9, h9_midi_config* dest_copy);
+const h9_algorithm*  h9_currentAlgorithm(h9* h9);
+uint8_t              h9_currentAlgorithmIndex(h9* h9);
+const char*          h9_currentAlgorithmName(h9* h9);
+const h9_module*     h9_currentModule(h9* h9);
+uint8_t              h9_currentModuleIndex(h9* h9);
+const char*          h9_currentModuleName(h9* h9);
+bool                 h9_presetLoaded(h9* h9);
+const char*          h9_presetName(h9* h9, size_t* len);
+bool                 h9_setPresetName(h9* h9, const char* name, size_t len);
+bool                 h9_dirty(h9* h9);
+control_value        h9_displayValue(h9* h9, control_id control);
+void                 h9_knobMap(h9* h9, control_id knob_num, control_value* exp_min, control_value* exp_max, control_value* psw);
+bool                 h9_knobExprMapped(h9* h9, control_id knob_num);
+bool                 h9_knobPswMapped(h9* h9, control_id knob_num);
+const char*          h9_knobLabel(const h9_algorithm* algorithm, control_id control);  // Knobs and PSW only, NULL otherwise
+const h9_knob_range* h9_knobRange(const h9_algorithm* algorithm, control_id control);  // Knobs only, NULL otherwise
+int32_t              h9_knobRangeLookup(const h9_knob_range* range, control_value value);
+h9*                  h9_init(h9* h9, h9_preset* preset);  // Initializes caller-owned storage, returns h9 (NULL if either is NULL)
+const char* const    h9_moduleName(uint8_t module_id);
+h9*                  h9_new(void);  // Allocates and returns a pointer to a new H9 instance (see h9_alloc.h)
+size_t               h9_numAlgorithms(h9* h9, uint8_t module_id);
+size_t               h9_numModules(h9* h9);
+bool                 h9_setAlgorithm(h9* h9, uint8_t module_id, uint8_t algorithm_id);
+void                 h9_setControl(h9* h9, control_id knob_num, control_value value, h9_callback_action cc_cb_action);
+void                 h9_setControls(h9* h9, const h9_control_update* updates, size_t num_updates, h9_callback_action cc_cb_action);  // As one batch
+void                 h9_setKnobMap(h9* h9, control_id knob_num, control_value exp_min, control_value exp_max, control_value psw);
+bool                 h9_setMidiConfig(h9* h9, const h9_midi_config* midi_config);
+bool                 h9_statsSnapshot(h9* h9, h9_stats* dest);  // false (and dest zeroed) if compiled without H9_STATS
+void                 h9_statsReset(h9* h9);
+void                 h9_cc(h9* h9, uint8_t cc_num, uint8_t cc_value);
+void                 h9_ccAt(h9* h9, uint8_t cc_num, uint8_t cc_value, double time_ms);  // time_ms: any monotonic millisecond clock
+void                 h9_ccBatch(h9* h9, const h9_cc_event* events, size_t num_events);  // In order, by their own timestamps, as one batch
+void                 h9_setClock(h9* h9, h9_clock_callback clock_callback, void* ctx);  // Where h9_cc gets the time, NULL for the OS clock
+
+#ifdef H9_FREESTANDING
+// Freestanding builds (no malloc, stdio or OS clock) must be linked with a monotonic millisecond clock.
+double h9_platform_now_ms(void);
+#else
+bool   h9_latencySnapshot(h9* h9, h9_latency_path path, h9_latency_histogram* dest);  // false (and dest zeroed) without H9_LATENCY
+double h9_latencyPercentile(const h9_latency_histogram* histogram, double percentile);  // 0-100, in microseconds (0 if empty)
+void   h9_latencyReset(h9* h9);
+#endif
 
 #ifdef __cplusplus
 }
 #endif
 
 // Bring in the rest of the modules
+#include "h9_alloc.h"
+#include "h9_expr.h"
+#include "h9_fleet.h"
 #include "h9_sysex.h"
+#include "h9_transition.h"
+#ifndef H9_FREESTANDING
+#include "h9_executor.h"
+#include "h9_journal.h"
+#include "h9_shm.h"
+#include "h9_smf.h"
+#include "h9_trace.h"
+#endif
 
 #endif /* libh9_h */
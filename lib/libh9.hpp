@@ -0,0 +1,301 @@
+/*  libh9.hpp
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef libh9_hpp
+#define libh9_hpp
+
+/*
+ * Header-only C++17 wrapper over libh9.h. Everything is inline and forwards straight to the C API (nothing allocates
+ * beyond h9_new itself), so it costs nothing over calling the C functions directly.
+ *
+ *   libh9::H9 pedal;                                     // h9_new, h9_delete when it goes out of scope (move-only)
+ *   pedal.onDisplay([&](control_id c, control_value v, control_value d) { ... });  // stored inline, no heap
+ *   pedal.parse(sysex);                                  // any contiguous bytes: arrays, std::vector, spans
+ *   pedal.set<KNOB3>(0.5f);                              // an invalid control fails to compile
+ *   std::string_view name = pedal.presetName();
+ *
+ * Sysex is passed as libh9::span, which is std::span under C++20 and an equivalent minimal view under C++17.
+ */
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include "libh9.h"
+
+#if __cplusplus >= 202002L && __has_include(<span>)
+#include <span>
+#endif
+
+namespace libh9 {
+
+#if __cplusplus >= 202002L && __has_include(<span>)
+template <typename T>
+using span = std::span<T>;
+#else
+// Just enough of std::span: a pointer and a size, made from arrays or anything with data() and size()
+template <typename T>
+class span {
+ public:
+    constexpr span() noexcept = default;
+    constexpr span(T* data, size_t size) noexcept : data_(data), size_(size) {
+    }
+    template <size_t N>
+    constexpr span(T (&array)[N]) noexcept : data_(array), size_(N) {
+    }
+    template <typename Container, typename = std::enable_if_t<std::is_convertible_v<decltype(std::declval<Container&>().data()), T*>>>
+    constexpr span(Container& container) noexcept : data_(container.data()), size_(container.size()) {
+    }
+    template <typename U, typename = std::enable_if_t<std::is_convertible_v<U (*)[], T (*)[]>>>
+    constexpr span(const span<U>& other) noexcept : data_(other.data()), size_(other.size()) {
+    }
+    constexpr T* data() const noexcept {
+        return data_;
+    }
+    constexpr size_t size() const noexcept {
+        return size_;
+    }
+    constexpr T* begin() const noexcept {
+        return data_;
+    }
+    constexpr T* end() const noexcept {
+        return data_ + size_;
+    }
+
+ private:
+    T*     data_ = nullptr;
+    size_t size_ = 0;
+};
+#endif
+
+inline std::string_view moduleName(uint8_t module_id) {
+    const char* name = h9_moduleName(module_id);
+    return (name != nullptr) ? std::string_view(name) : std::string_view();
+}
+
+inline std::string_view algorithmName(uint8_t module_sysex_id, uint8_t algorithm_sysex_id) {
+    const char* name = h9_algorithmName(module_sysex_id, algorithm_sysex_id);
+    return (name != nullptr) ? std::string_view(name) : std::string_view();
+}
+
+class H9 {
+ public:
+    // Callables are copied into fixed storage inside the H9, so they must fit it and be trivially copyable: capture
+    // by reference or pointer rather than by value.
+    static constexpr size_t kCallbackStorage = 4 * sizeof(void*);
+
+    H9() : h9_(h9_new()) {
+    }
+    explicit H9(::h9* adopted) noexcept : h9_(adopted) {  // Takes ownership of an h9 from h9_new
+    }
+    ~H9() {
+        h9_delete(h9_);
+    }
+
+    H9(const H9&)            = delete;
+    H9& operator=(const H9&) = delete;
+    H9(H9&& other) noexcept : h9_(std::exchange(other.h9_, nullptr)), callbacks_(other.callbacks_) {
+        adoptContext(other);
+    }
+    H9& operator=(H9&& other) noexcept {
+        if (this != &other) {
+            h9_delete(h9_);
+            h9_        = std::exchange(other.h9_, nullptr);
+            callbacks_ = other.callbacks_;
+            adoptContext(other);
+        }
+        return *this;
+    }
+
+    explicit operator bool() const noexcept {
+        return h9_ != nullptr;
+    }
+    ::h9* get() const noexcept {
+        return h9_;
+    }
+    ::h9* release() noexcept {  // Hands back ownership, unregistering any callbacks set through this wrapper
+        if (h9_ != nullptr && h9_->callback_context == &callbacks_) {
+            h9_->display_callback       = nullptr;
+            h9_->cc_callback            = nullptr;
+            h9_->sysex_callback         = nullptr;
+            h9_->batch_display_callback = nullptr;
+            h9_->callback_context       = nullptr;
+        }
+        return std::exchange(h9_, nullptr);
+    }
+
+    // Sysex
+    h9_status parse(span<const uint8_t> sysex, h9_enforce_sysex_id enforce_sysex_id = kH9_RESTRICT_TO_SYSEX_ID) {
+        // h9_parse_sysex only reads the message
+        return h9_parse_sysex(h9_, const_cast<uint8_t*>(sysex.data()), sysex.size(), enforce_sysex_id);
+    }
+    size_t dump(span<uint8_t> dest, bool update_dirty_flag = false) {
+        return h9_dump(h9_, dest.data(), dest.size(), update_dirty_flag);
+    }
+
+    // Controls. The templates reject an invalid control at compile time. value() and displayValue() then read the preset
+    // directly; set() still goes through h9_setControl, which keeps its own range check.
+    template <control_id Control>
+    void set(control_value value, h9_callback_action cc_cb_action = kH9_SUPPRESS_CALLBACK) {
+        static_assert(Control < NUM_CONTROLS, "Not a control");
+        h9_setControl(h9_, Control, value, cc_cb_action);
+    }
+    template <control_id Control>
+    control_value value() const noexcept {
+        static_assert(Control < NUM_CONTROLS, "Not a control");
+        if constexpr (Control == EXPR) {
+            return h9_->preset->expression;
+        } else if constexpr (Control == PSW) {
+            return h9_->preset->psw ? 1.0f : 0.0f;
+        } else {
+            return h9_->preset->knobs[Control].current_value;
+        }
+    }
+    template <control_id Control>
+    control_value displayValue() const noexcept {
+        static_assert(Control < NUM_CONTROLS, "Not a control");
+        if constexpr (Control < H9_NUM_KNOBS) {
+            return h9_->preset->knobs[Control].display_value;
+        } else {
+            return value<Control>();
+        }
+    }
+    void setControl(control_id control, control_value value, h9_callback_action cc_cb_action = kH9_SUPPRESS_CALLBACK) {
+        h9_setControl(h9_, control, value, cc_cb_action);
+    }
+    void setControls(span<const h9_control_update> updates, h9_callback_action cc_cb_action = kH9_SUPPRESS_CALLBACK) {
+        h9_setControls(h9_, updates.data(), updates.size(), cc_cb_action);
+    }
+    control_value controlValue(control_id control) const {
+        return h9_controlValue(h9_, control);
+    }
+    void cc(uint8_t cc_num, uint8_t cc_value) {
+        h9_cc(h9_, cc_num, cc_value);
+    }
+    void ccAt(uint8_t cc_num, uint8_t cc_value, double time_ms) {
+        h9_ccAt(h9_, cc_num, cc_value, time_ms);
+    }
+    void ccBatch(span<const h9_cc_event> events) {
+        h9_ccBatch(h9_, events.data(), events.size());
+    }
+    void beginUpdate() {
+        h9_beginUpdate(h9_);
+    }
+    void commitUpdate() {
+        h9_commitUpdate(h9_);
+    }
+
+    // Presets and names
+    bool setAlgorithm(uint8_t module_id, uint8_t algorithm_id) {
+        return h9_setAlgorithm(h9_, module_id, algorithm_id);
+    }
+    std::string_view presetName() const {
+        size_t      len  = 0;
+        const char* name = h9_presetName(h9_, &len);
+        return std::string_view(name, len);
+    }
+    bool setPresetName(std::string_view name) {
+        return h9_setPresetName(h9_, name.data(), name.size());
+    }
+    std::string_view moduleName() const {
+        return libh9::moduleName(h9_currentModuleIndex(h9_));
+    }
+    std::string_view algorithmName() const {
+        const char* name = h9_currentAlgorithmName(h9_);
+        return (name != nullptr) ? std::string_view(name) : std::string_view();
+    }
+    bool dirty() const {
+        return h9_dirty(h9_);
+    }
+
+    // Callbacks, each replacing any earlier one of its kind. Pass nullptr to unregister. Registering any of them takes
+    // over callback_context, so do not mix these with callbacks set directly on the h9.
+    template <typename F>  // void(control_id control, control_value current_value, control_value display_value)
+    void onDisplay(F callback) {
+        h9_->display_callback = store<F>(callbacks_.display, callback, [](void* ctx, control_id control, control_value current, control_value display) {
+            invoke<F>(static_cast<Callbacks*>(ctx)->display, control, current, display);
+        });
+    }
+    template <typename F>  // void(uint8_t midi_channel, uint8_t cc, uint8_t msb, uint8_t lsb)
+    void onCc(F callback) {
+        h9_->cc_callback = store<F>(callbacks_.cc, callback, [](void* ctx, uint8_t midi_channel, uint8_t cc, uint8_t msb, uint8_t lsb) {
+            invoke<F>(static_cast<Callbacks*>(ctx)->cc, midi_channel, cc, msb, lsb);
+        });
+    }
+    template <typename F>  // void(span<uint8_t> sysex)
+    void onSysex(F callback) {
+        h9_->sysex_callback = store<F>(callbacks_.sysex, callback, [](void* ctx, uint8_t* sysex, size_t len) {
+            invoke<F>(static_cast<Callbacks*>(ctx)->sysex, span<uint8_t>(sysex, len));
+        });
+    }
+    template <typename F>  // void(h9_control_mask changed)
+    void onBatchDisplay(F callback) {
+        h9_->batch_display_callback = store<F>(callbacks_.batch_display, callback, [](void* ctx, h9_control_mask changed) {
+            invoke<F>(static_cast<Callbacks*>(ctx)->batch_display, changed);
+        });
+    }
+
+ private:
+    struct alignas(alignof(std::max_align_t)) Slot {
+        unsigned char storage[kCallbackStorage];
+    };
+    struct Callbacks {
+        Slot display;
+        Slot cc;
+        Slot sysex;
+        Slot batch_display;
+    };
+
+    // Copies callback into slot and returns thunk, or returns nullptr (unregistering) for a nullptr callback
+    template <typename F, typename Thunk>
+    auto store(Slot& slot, const F& callback, Thunk thunk) -> decltype(+thunk) {
+        h9_->callback_context = &callbacks_;
+        if constexpr (std::is_same_v<F, std::nullptr_t>) {
+            return nullptr;
+        } else {
+            static_assert(sizeof(F) <= kCallbackStorage, "Callback too large to store inline, capture by reference");
+            static_assert(std::is_trivially_copyable_v<F> && std::is_trivially_destructible_v<F>,
+                          "Callbacks must be trivially copyable, capture by reference");
+            std::memcpy(slot.storage, &callback, sizeof(F));
+            return +thunk;
+        }
+    }
+    template <typename F, typename... Args>
+    static void invoke(Slot& slot, Args... args) {
+        if constexpr (!std::is_same_v<F, std::nullptr_t>) {
+            (*std::launder(reinterpret_cast<F*>(slot.storage)))(args...);
+        }
+    }
+
+    void adoptContext(const H9& other) noexcept {
+        if (h9_ != nullptr && h9_->callback_context == &other.callbacks_) {
+            h9_->callback_context = &callbacks_;
+        }
+    }
+
+    ::h9*     h9_ = nullptr;
+    Callbacks callbacks_{};
+};
+
+}  // namespace libh9
+
+#endif /* libh9_hpp */
@@ -0,0 +1,378 @@
+/*  libh9_async.hpp
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef libh9_async_hpp
+#define libh9_async_hpp
+
+/*
+ * C++20 coroutine facade for request / response sysex exchanges, on top of libh9.hpp.
+ *
+ *   libh9::AsyncPedal pedal(h9, [&](libh9::span<uint8_t> sysex) { midi_out.send(sysex); });
+ *   libh9::Task<> sync() {
+ *       libh9::Reply preset = co_await pedal.requestPreset();
+ *       libh9::Reply bypass = co_await pedal.readConfigVar(0x102, std::chrono::milliseconds(200));
+ *       ...
+ *   }
+ *   // and from the host's MIDI input and event loop:
+ *   pedal.receive(incoming_sysex);  // parses into the h9, then completes the exchange it answers
+ *   pedal.poll();                   // times out overdue exchanges
+ *
+ * Any number of exchanges can be in flight per pedal. A response completes the oldest exchange waiting for that kind
+ * of message (a program, a sysvars dump, or the value of that key). Waiting coroutines are resumed through the
+ * Executor, anything with post(std::coroutine_handle<>) (InlineExecutor resumes them straight away), and deadlines
+ * come from Clock (std::chrono::steady_clock unless replaced, e.g. by a fake clock in tests). Nothing here is thread
+ * safe: receive, poll and the coroutines must all run on one thread, like the h9 itself.
+ */
+
+#if __cplusplus < 202002L
+#error "libh9_async.hpp needs C++20"
+#endif
+
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include "libh9.hpp"
+
+namespace libh9 {
+
+// Resumes on the spot, inside receive() / poll()
+struct InlineExecutor {
+    void post(std::coroutine_handle<> handle) {
+        handle.resume();
+    }
+};
+
+struct Reply {
+    h9_status status    = kH9_UNKNOWN;  // From parsing the response, kH9_UNKNOWN if none came
+    bool      timed_out = false;
+    uint32_t  value     = 0;  // readConfigVar only
+
+    explicit operator bool() const noexcept {
+        return status == kH9_OK;
+    }
+};
+
+// ==== Task: a lazily started coroutine which can be co_awaited, or started from plain code
+
+template <typename T>
+class Task;
+
+namespace detail {
+
+struct PromiseBase {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+
+    struct FinalAwaiter {
+        bool await_ready() const noexcept {
+            return false;
+        }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            return handle.promise().continuation;
+        }
+        void await_resume() const noexcept {
+        }
+    };
+
+    std::suspend_always initial_suspend() const noexcept {
+        return {};
+    }
+    FinalAwaiter final_suspend() const noexcept {
+        return {};
+    }
+    void unhandled_exception() const noexcept {
+        std::terminate();
+    }
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+    std::optional<T> value;
+
+    Task<T> get_return_object() noexcept;
+    void    return_value(T result) {
+        value.emplace(std::move(result));
+    }
+    T take() {
+        return std::move(*value);
+    }
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+    Task<void> get_return_object() noexcept;
+    void       return_void() const noexcept {
+    }
+    void take() const noexcept {
+    }
+};
+
+}  // namespace detail
+
+template <typename T = void>
+class [[nodiscard]] Task {
+ public:
+    using promise_type = detail::Promise<T>;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) noexcept : handle_(handle) {
+    }
+    Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {
+    }
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (handle_) {
+                handle_.destroy();
+            }
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+    Task(const Task&)            = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    void start() {  // Runs until the first suspension, from plain (non-coroutine) code
+        handle_.resume();
+    }
+    bool done() const noexcept {
+        return handle_ && handle_.done();
+    }
+    T result() {  // Once done()
+        return handle_.promise().take();
+    }
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle_.promise().continuation = awaiting;
+        return handle_;
+    }
+    T await_resume() {
+        return handle_.promise().take();
+    }
+
+ private:
+    std::coroutine_handle<promise_type> handle_;
+};
+
+namespace detail {
+template <typename T>
+Task<T> Promise<T>::get_return_object() noexcept {
+    return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+inline Task<void> Promise<void>::get_return_object() noexcept {
+    return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+}  // namespace detail
+
+// ==== AsyncPedal
+
+template <typename Executor = InlineExecutor, typename Clock = std::chrono::steady_clock>
+class AsyncPedal {
+ public:
+    using duration   = typename Clock::duration;
+    using time_point = typename Clock::time_point;
+
+    static constexpr duration kDefaultTimeout = std::chrono::duration_cast<duration>(std::chrono::milliseconds(500));
+
+    // Outgoing requests go to send, void(span<uint8_t>), which must not hold on to the span. Takes over pedal's sysex callback.
+    template <typename Send>
+    AsyncPedal(H9& pedal, Send send, Executor executor = Executor()) : pedal_(pedal), executor_(std::move(executor)) {
+        pedal_.onSysex(std::move(send));
+    }
+    AsyncPedal(const AsyncPedal&)            = delete;
+    AsyncPedal& operator=(const AsyncPedal&) = delete;
+
+    class Exchange;
+
+    Exchange requestPreset(duration timeout = kDefaultTimeout) {
+        return Exchange(*this, kH9_PROGRAM, 0, timeout);
+    }
+    Exchange requestSystemConfig(duration timeout = kDefaultTimeout) {
+        return Exchange(*this, kH9_TJ_SYSVARS_DUMP, 0, timeout);
+    }
+    Exchange readConfigVar(uint16_t key, duration timeout = kDefaultTimeout) {
+        return Exchange(*this, kH9_SYSEX_VALUE_DUMP, key, timeout);
+    }
+
+    // Parses incoming sysex into the h9, then completes the oldest exchange it answers (if any). Returns the parse status.
+    h9_status receive(span<const uint8_t> sysex, h9_enforce_sysex_id enforce_sysex_id = kH9_RESTRICT_TO_SYSEX_ID) {
+        h9_status status = pedal_.parse(sysex, enforce_sysex_id);
+        uint8_t   type   = 0;
+        if (status == kH9_SYSEX_ID_MISMATCH || !h9_sysexClassify(sysex.data(), sysex.size(), nullptr, &type)) {
+            return status;  // Not from this H9
+        }
+        uint32_t key   = 0;
+        uint32_t value = 0;
+        size_t   body  = (sysex.data()[0] == 0xF0) ? 5 : 4;
+        if (type == kH9_SYSEX_VALUE_DUMP && !parseKeyValue(sysex.data() + body, sysex.data() + sysex.size(), &key, &value)) {
+            return status;
+        }
+        for (Exchange* exchange = pending_; exchange != nullptr; exchange = exchange->next_) {
+            if (exchange->type_ == type && (type != kH9_SYSEX_VALUE_DUMP || exchange->key_ == key)) {
+                exchange->reply_.status = status;
+                exchange->reply_.value  = value;
+                complete(exchange);
+                break;
+            }
+        }
+        return status;
+    }
+
+    // Times out every exchange whose deadline has passed
+    void poll(time_point now = Clock::now()) {
+        Exchange* exchange = pending_;
+        while (exchange != nullptr) {
+            if (exchange->deadline_ <= now) {
+                exchange->reply_.timed_out = true;
+                complete(exchange);
+                exchange = pending_;  // Resuming may have changed the list, start over
+            } else {
+                exchange = exchange->next_;
+            }
+        }
+    }
+
+    size_t inFlight() const noexcept {
+        size_t count = 0;
+        for (Exchange* exchange = pending_; exchange != nullptr; exchange = exchange->next_) {
+            count++;
+        }
+        return count;
+    }
+
+    // Awaitable for one exchange. The request goes out when it is co_awaited.
+    class Exchange {
+     public:
+        Exchange(AsyncPedal& owner, uint8_t type, uint16_t key, duration timeout) : owner_(owner), type_(type), key_(key), timeout_(timeout) {
+        }
+        Exchange(const Exchange&)            = delete;
+        Exchange& operator=(const Exchange&) = delete;
+        ~Exchange() {
+            owner_.unlink(this);  // The awaiting coroutine was destroyed mid-exchange
+        }
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<> handle) {
+            handle_   = handle;
+            deadline_ = Clock::now() + timeout_;
+            owner_.link(this);
+            h9* h9 = owner_.pedal_.get();
+            switch (type_) {
+                case kH9_PROGRAM:
+                    h9_sysexRequestCurrentPreset(h9);
+                    break;
+                case kH9_TJ_SYSVARS_DUMP:
+                    h9_sysexRequestSystemConfig(h9);
+                    break;
+                default:
+                    h9_sysexRequestConfigVar(h9, key_);
+            }
+        }
+        Reply await_resume() const noexcept {
+            return reply_;
+        }
+
+     private:
+        friend class AsyncPedal;
+
+        AsyncPedal&             owner_;
+        uint8_t                 type_;
+        uint16_t                key_;
+        duration                timeout_;
+        time_point              deadline_{};
+        std::coroutine_handle<> handle_;
+        Reply                   reply_;
+        Exchange*               next_   = nullptr;
+        bool                    linked_ = false;
+    };
+
+ private:
+    // "key value" in ASCII hex, as in a value dump
+    static bool parseKeyValue(const uint8_t* cursor, const uint8_t* end, uint32_t* key, uint32_t* value) {
+        uint32_t* fields[] = {key, value};
+        for (uint32_t* field : fields) {
+            while (cursor < end && *cursor == ' ') {
+                cursor++;
+            }
+            size_t digits = 0;
+            for (*field = 0; cursor < end; cursor++, digits++) {
+                uint8_t c = *cursor;
+                if (c >= '0' && c <= '9') {
+                    *field = (*field << 4) | (uint32_t)(c - '0');
+                } else if (c >= 'a' && c <= 'f') {
+                    *field = (*field << 4) | (uint32_t)(c - 'a' + 10);
+                } else if (c >= 'A' && c <= 'F') {
+                    *field = (*field << 4) | (uint32_t)(c - 'A' + 10);
+                } else {
+                    break;
+                }
+            }
+            if (digits == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Appended, so responses complete exchanges oldest first
+    void link(Exchange* exchange) {
+        Exchange** tail = &pending_;
+        while (*tail != nullptr) {
+            tail = &(*tail)->next_;
+        }
+        *tail             = exchange;
+        exchange->next_   = nullptr;
+        exchange->linked_ = true;
+    }
+    void unlink(Exchange* exchange) {
+        if (!exchange->linked_) {
+            return;
+        }
+        for (Exchange** link = &pending_; *link != nullptr; link = &(*link)->next_) {
+            if (*link == exchange) {
+                *link = exchange->next_;
+                break;
+            }
+        }
+        exchange->linked_ = false;
+    }
+    void complete(Exchange* exchange) {
+        unlink(exchange);
+        executor_.post(exchange->handle_);
+    }
+
+    H9&       pedal_;
+    Executor  executor_;
+    Exchange* pending_ = nullptr;
+};
+
+}  // namespace libh9
+
+#endif /* libh9_async_hpp */
@@ -20,28 +20,65 @@
 
 #include "utils.h"
 
-#include <math.h>
-#include <stdio.h>
 #include <string.h>
 
-#define DEBUG_LEVEL DEBUG_ERROR
-#include "debug.h"
+static const char hex_digits[] = "0123456789abcdef";
+
+// Both hex digits of every byte value, so each byte is one two-char copy
+#define HEX_PAIRS(hi) hi "0" hi "1" hi "2" hi "3" hi "4" hi "5" hi "6" hi "7" hi "8" hi "9" hi "a" hi "b" hi "c" hi "d" hi "e" hi "f"
+static const char hex_pairs[513] = HEX_PAIRS("0") HEX_PAIRS("1") HEX_PAIRS("2") HEX_PAIRS("3") HEX_PAIRS("4") HEX_PAIRS("5") HEX_PAIRS("6")
+    HEX_PAIRS("7") HEX_PAIRS("8") HEX_PAIRS("9") HEX_PAIRS("a") HEX_PAIRS("b") HEX_PAIRS("c") HEX_PAIRS("d") HEX_PAIRS("e") HEX_PAIRS("f");
+
+// Encodes data[0..len) as hexdump() does, starting at byte index first (for the word grouping), into dest with room
+// for room chars. Stops at the first byte which doesn't fit along with a terminator. Writes no terminator itself.
+static size_t encode_hex(char *dest, size_t room, const uint8_t *data, size_t len, size_t first) {
+    char * cursor = dest;
+    size_t i      = 0;
+
+    // Whole words (8 digits and a space) while they fit with room for the terminator
+    if ((first & 3) == 0) {
+        for (; (len - i >= 4) && (room - (size_t)(cursor - dest) >= 10); i += 4) {
+            memcpy(cursor + 0, &hex_pairs[data[i + 0] * 2], 2);
+            memcpy(cursor + 2, &hex_pairs[data[i + 1] * 2], 2);
+            memcpy(cursor + 4, &hex_pairs[data[i + 2] * 2], 2);
+            memcpy(cursor + 6, &hex_pairs[data[i + 3] * 2], 2);
+            cursor[8] = ' ';
+            cursor += 9;
+        }
+    }
+    for (; i < len && (room - (size_t)(cursor - dest) >= 3); i++) {
+        memcpy(cursor, &hex_pairs[data[i] * 2], 2);
+        cursor += 2;
+        if (((first + i + 1) & 3) == 0 && (room - (size_t)(cursor - dest) >= 2)) {
+            *cursor++ = ' ';
+        }
+    }
+    return (size_t)(cursor - dest);
+}
 
 size_t hexdump(char *dest, size_t max_len, uint8_t *data, size_t len) {
-    char *cursor = dest;
-    char *end    = dest + max_len;
-    for (size_t i = 0; i < len; i++) {
-        if (cursor < (end - 2)) {
-            cursor += sprintf(cursor, "%02x", (int)data[i]);
-            if ((cursor < end - 1) && (i != 0) && ((i + 1) % 4 == 0)) {
-                cursor += sprintf(cursor, " ");
-            }
-        }
+    if (max_len < 3) {
+        return 0;
+    }
+    size_t bytes_written = encode_hex(dest, max_len, data, len, 0);
+    if (bytes_written > 0) {
+        dest[bytes_written] = '\0';
     }
-    size_t bytes_written = cursor - dest;
     return bytes_written;
 }
 
+size_t hexdump_stream(const uint8_t *data, size_t len, hexdump_sink sink, void *context) {
+    char   chunk[HEXDUMP_CHUNK_BYTES / 4 * 9 + 1];
+    size_t total = 0;
+    for (size_t i = 0; i < len; i += HEXDUMP_CHUNK_BYTES) {
+        size_t count   = (len - i < HEXDUMP_CHUNK_BYTES) ? len - i : HEXDUMP_CHUNK_BYTES;
+        size_t written = encode_hex(chunk, sizeof(chunk), data + i, count, i);
+        sink(context, chunk, written);
+        total += written;
+    }
+    return total;
+}
+
 // Returns 0 if not pure hex chars 0-9a-fA-F
 uint8_t htoi(char h) {
     if (h >= '0' && h <= '9') {
@@ -173,31 +210,97 @@ size_t scanhex_bool32(char *str, size_t strlen, uint32_t *dest) {
     return offset;
 }
 
+size_t scandec(char *str, size_t strlen, int32_t *dest, size_t destlen) {
+    size_t dest_i   = 0;
+    bool   found    = false;
+    bool   negative = false;
+
+    for (size_t i = 0; i < strlen; i++) {
+        char current = str[i];
+        if (current >= '0' && current <= '9') {
+            if (!found) {
+                if (dest_i >= destlen) {
+                    break;
+                }
+                dest[dest_i] = 0;
+                found        = true;
+            }
+            dest[dest_i] = dest[dest_i] * 10 + (current - '0');
+        } else if (current == '-' && !found && !negative) {
+            negative = true;
+        } else if (current == ' ' && found) {
+            dest[dest_i] = negative ? -dest[dest_i] : dest[dest_i];
+            dest_i++;
+            found    = false;
+            negative = false;
+        } else if (current != ' ' || negative) {
+            break;  // we found a non-decimal value.
+        }
+    }
+    // Catch any last pending value
+    if (found) {
+        dest[dest_i] = negative ? -dest[dest_i] : dest[dest_i];
+        dest_i++;
+    }
+
+    return dest_i;
+}
+
+// Parses [-]digits[.digits], ignoring anything after the number. Exact for the short values found in sysex.
+static float parse_float(const char *str, size_t len) {
+    static const double powers_of_ten[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16};
+    bool                negative        = false;
+    bool                fraction        = false;
+    double              mantissa        = 0.0;
+    size_t              decimals        = 0;
+    size_t              i               = 0;
+    if (i < len && str[i] == '-') {
+        negative = true;
+        i++;
+    }
+    for (; i < len; i++) {
+        char current = str[i];
+        if (current >= '0' && current <= '9') {
+            if (fraction && decimals >= sizeof(powers_of_ten) / sizeof(*powers_of_ten) - 1) {
+                continue;  // beyond float precision anyway
+            }
+            mantissa = mantissa * 10.0 + (current - '0');
+            decimals += fraction ? 1 : 0;
+        } else if (current == '.' && !fraction) {
+            fraction = true;
+        } else {
+            break;
+        }
+    }
+    double value = mantissa / powers_of_ten[decimals];
+    return (float)(negative ? -value : value);
+}
+
 size_t scanfloat(char *str, size_t strlen, float *dest, size_t destlen) {
     size_t dest_i = 0;
     bool   found  = false;
-    char * cursor;
+    size_t start  = 0;
 
     for (size_t i = 0; (i < strlen) && (dest_i < (int)destlen); i++) {
         char current = str[i];
         if ((current >= '0' && current <= '9') || (current == '.') || (current == '-')) {
             if (!found) {
-                cursor = &str[i];
-                found  = true;
+                start = i;
+                found = true;
             }
         } else if (current == ' ') {
             if (found) {
-                sscanf(cursor, "%f", &dest[dest_i++]);
-                found = false;
+                dest[dest_i++] = parse_float(&str[start], i - start);
+                found          = false;
             }
         } else {
             break;  // we found a non-float value.
         }
     }
     // Catch any last pending value
-    if (found) {
-        sscanf(cursor, "%f", &dest[dest_i++]);
-        found = false;
+    if (found && dest_i < destlen) {
+        dest[dest_i++] = parse_float(&str[start], strlen - start);
+        found          = false;
     }
 
     return dest_i;
@@ -240,7 +343,7 @@ uint16_t array_sum1(bool *array, size_t len) {
 uint16_t iarray_sumf(float *array, size_t len) {
     uint16_t result = 0U;
     for (size_t i = 0; i < len; i++) {
-        result += (uint16_t)truncf(array[i]);
+        result += (uint16_t)(int32_t)array[i];  // truncates toward zero
     }
     return result;
 }
@@ -255,6 +358,18 @@ float clip(float value, float min, float max) {
     }
 }
 
+// Rounds to the nearest integer, ties to even (the default rintf() behaviour) without needing libm.
+int32_t round_even(float value) {
+    int32_t truncated = (int32_t)value;
+    float   remainder = value - (float)truncated;
+    if (remainder > 0.5f || (remainder == 0.5f && (truncated & 1))) {
+        return truncated + 1;
+    } else if (remainder < -0.5f || (remainder == -0.5f && (truncated & 1))) {
+        return truncated - 1;
+    }
+    return truncated;
+}
+
 size_t find_lines(char *str, size_t strlen, char *line_heads[], size_t *line_lengths, size_t max_lines) {
     size_t num_lines    = 0;
     size_t line_index   = 0;
@@ -283,3 +398,83 @@ size_t find_lines(char *str, size_t strlen, char *line_heads[], size_t *line_len
 
     return num_lines;
 }
+
+// Writes value / 10^decimals as a decimal string, always null terminated. Returns the strlen written, which is truncated to fit.
+size_t format_fixed(char *dest, size_t max_len, int32_t value, uint8_t decimals) {
+    char     digits[16];
+    size_t   num_digits = 0;
+    uint32_t magnitude  = (value < 0) ? -(uint32_t)value : (uint32_t)value;
+    do {
+        digits[num_digits++] = '0' + (magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0 || num_digits <= decimals);  // at least one digit before the point
+
+    if (max_len == 0) {
+        return 0;
+    }
+    size_t bytes_written = 0;
+    if (value < 0 && bytes_written < max_len - 1) {
+        dest[bytes_written++] = '-';
+    }
+    while (num_digits > 0 && bytes_written < max_len - 1) {
+        if (num_digits == decimals) {
+            dest[bytes_written++] = '.';
+            if (bytes_written >= max_len - 1) {
+                break;
+            }
+        }
+        dest[bytes_written++] = digits[--num_digits];
+    }
+    dest[bytes_written] = '\0';
+    return bytes_written;
+}
+
+void writer_init(text_writer *writer, char *dest, size_t max_len) {
+    writer->dest    = dest;
+    writer->max_len = max_len;
+    writer->len     = 0;
+}
+
+void write_char(text_writer *writer, char c) {
+    if (writer->len + 1 < writer->max_len) {
+        writer->dest[writer->len] = c;
+    }
+    writer->len++;
+}
+
+void write_string(text_writer *writer, const char *str) {
+    while (*str != '\0') {
+        write_char(writer, *str++);
+    }
+}
+
+void write_hex(text_writer *writer, uint32_t value) {
+    char   digits[8];
+    size_t num_digits = format_hex(digits, value);
+    for (size_t i = 0; i < num_digits; i++) {
+        write_char(writer, digits[i]);
+    }
+}
+
+void write_decimal(text_writer *writer, int32_t value) {
+    char digits[12];
+    format_fixed(digits, sizeof(digits), value, 0);
+    write_string(writer, digits);
+}
+
+size_t format_hex(char *dest, uint32_t value) {
+    size_t num_digits = (value == 0) ? 1 : (size_t)((32 - __builtin_clz(value) + 3) / 4);
+    for (size_t i = num_digits; i > 0; i--) {
+        dest[i - 1] = hex_digits[value & 0xF];
+        value >>= 4;
+    }
+    return num_digits;
+}
+
+size_t writer_finish(text_writer *writer) {
+    if (writer->max_len > 0) {
+        size_t terminator        = (writer->len < writer->max_len) ? writer->len : writer->max_len - 1;
+        writer->dest[terminator] = '\0';
+    }
+    return writer->len;
+}
@@ -29,12 +29,27 @@
 extern "C" {
 #endif
 
-size_t   hexdump(char *dest, size_t max_len, uint8_t *data, size_t len);
+// Appends text to a fixed buffer with snprintf() semantics: output is truncated to fit (leaving room for the null),
+// but len keeps counting so the caller can tell how much space was needed.
+typedef struct text_writer {
+    char * dest;
+    size_t max_len;
+    size_t len;
+} text_writer;
+
+// Hexdump in chunks, e.g. straight to a log: each chunk (not terminated) encodes HEXDUMP_CHUNK_BYTES of data, the
+// last one the remainder. The concatenated chunks are what hexdump() writes given enough room.
+#define HEXDUMP_CHUNK_BYTES 512
+typedef void (*hexdump_sink)(void *context, const char *chunk, size_t len);
+
+size_t   hexdump(char *dest, size_t max_len, uint8_t *data, size_t len);  // Lowercase, a space after every 4 bytes
+size_t   hexdump_stream(const uint8_t *data, size_t len, hexdump_sink sink, void *context);  // Returns the chars written
 size_t   scanhex(char *str, size_t strlen, uint32_t *dest, size_t destlen);
 size_t   scanhex_word(char *str, size_t strlen, uint16_t *dest, size_t destlen);
 size_t   scanhex_byte(char *str, size_t strlen, uint8_t *dest, size_t destlen);
 size_t   scanhex_bool(char *str, size_t strlen, bool *dest, size_t destlen);
 size_t   scanhex_bool32(char *str, size_t strlen, uint32_t *dest);
+size_t   scandec(char *str, size_t strlen, int32_t *dest, size_t destlen);
 size_t   scanfloat(char *str, size_t strlen, float *dest, size_t len);
 uint16_t array_sum(uint32_t *array, size_t len);
 uint16_t array_sum16(uint16_t *array, size_t len);
@@ -42,7 +57,16 @@ uint16_t array_sum8(uint8_t *array, size_t len);
 uint16_t array_sum1(bool *array, size_t len);
 uint16_t iarray_sumf(float *array, size_t len);
 float    clip(float value, float min, float max);
+size_t   format_fixed(char *dest, size_t max_len, int32_t value, uint8_t decimals);
+size_t   format_hex(char *dest, uint32_t value);  // Lowercase, no leading zeros or terminator, dest holds 8. Returns the digits written.
+int32_t  round_even(float value);
 size_t   find_lines(char *str, size_t strlen, char *line_heads[], size_t *line_lengths, size_t max_lines);
+void     writer_init(text_writer *writer, char *dest, size_t max_len);
+void     write_char(text_writer *writer, char c);
+void     write_string(text_writer *writer, const char *str);
+void     write_hex(text_writer *writer, uint32_t value);
+void     write_decimal(text_writer *writer, int32_t value);
+size_t   writer_finish(text_writer *writer);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,138 @@
+/*  freestanding_runtime.c
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// The minimal runtime a freestanding libh9 needs: the handful of <string.h> primitives it calls (which compilers may
+// also emit on their own for struct copies), a monotonic clock and an entry point. No libc is linked at all, so any
+// stray dependency on malloc, stdio or libm in lib/ shows up as a link failure. Linux x86_64 only.
+
+#include <stddef.h>
+#include <stdint.h>
+
+double fake_now_ms = 0.0;
+
+double h9_platform_now_ms(void) {
+    return fake_now_ms;
+}
+
+void *memcpy(void *dest, const void *src, size_t n) {
+    uint8_t *      d = dest;
+    const uint8_t *s = src;
+    while (n--) {
+        *d++ = *s++;
+    }
+    return dest;
+}
+
+void *memmove(void *dest, const void *src, size_t n) {
+    uint8_t *      d = dest;
+    const uint8_t *s = src;
+    if (d < s) {
+        return memcpy(dest, src, n);
+    }
+    while (n--) {
+        d[n] = s[n];
+    }
+    return dest;
+}
+
+void *memset(void *dest, int c, size_t n) {
+    uint8_t *d = dest;
+    while (n--) {
+        *d++ = (uint8_t)c;
+    }
+    return dest;
+}
+
+int memcmp(const void *a, const void *b, size_t n) {
+    const uint8_t *x = a;
+    const uint8_t *y = b;
+    for (size_t i = 0; i < n; i++) {
+        if (x[i] != y[i]) {
+            return x[i] - y[i];
+        }
+    }
+    return 0;
+}
+
+void *memchr(const void *s, int c, size_t n) {
+    const uint8_t *p = s;
+    for (size_t i = 0; i < n; i++) {
+        if (p[i] == (uint8_t)c) {
+            return (void *)&p[i];
+        }
+    }
+    return NULL;
+}
+
+size_t strlen(const char *s) {
+    size_t len = 0;
+    while (s[len] != '\0') {
+        len++;
+    }
+    return len;
+}
+
+size_t strnlen(const char *s, size_t max_len) {
+    size_t len = 0;
+    while (len < max_len && s[len] != '\0') {
+        len++;
+    }
+    return len;
+}
+
+char *strcpy(char *dest, const char *src) {
+    char *d = dest;
+    while ((*d++ = *src++) != '\0') {
+    }
+    return dest;
+}
+
+char *strncpy(char *dest, const char *src, size_t n) {
+    size_t i = 0;
+    for (; i < n && src[i] != '\0'; i++) {
+        dest[i] = src[i];
+    }
+    for (; i < n; i++) {
+        dest[i] = '\0';
+    }
+    return dest;
+}
+
+int strncmp(const char *a, const char *b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (a[i] != b[i] || a[i] == '\0') {
+            return (uint8_t)a[i] - (uint8_t)b[i];
+        }
+    }
+    return 0;
+}
+
+int freestanding_main(void);
+
+// Align the stack, run the test and hand its result straight to the exit syscall.
+__asm__(
+    ".globl _start\n"
+    "_start:\n"
+    "    xor %rbp, %rbp\n"
+    "    and $-16, %rsp\n"
+    "    call freestanding_main\n"
+    "    mov %eax, %edi\n"
+    "    mov $60, %eax\n"
+    "    syscall\n");
@@ -0,0 +1,108 @@
+/*  freestanding_test.c
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Exercises a freestanding (H9_FREESTANDING) libh9 using only caller-owned storage. Linked against
+// freestanding_runtime.c instead of libc; the exit status is 0 on success or the number of the failed check.
+
+#include <string.h>
+
+#include "libh9.h"
+
+extern double fake_now_ms;
+
+static h9        h9_storage;
+static h9_preset preset_storage;
+static h9        copy_storage;
+static h9_preset copy_preset_storage;
+static uint8_t   sysex[1000];
+static size_t    display_updates;
+
+// A bump allocator over a static arena stands in for the firmware's allocator
+static uint8_t arena[64 * 1024] __attribute__((aligned(16)));
+static size_t  arena_used;
+
+static void *arena_alloc(void *ctx, size_t size) {
+    size = (size + 15) & ~(size_t)15;
+    if (arena_used + size > sizeof(arena)) {
+        return NULL;
+    }
+    void *ptr = &arena[arena_used];
+    arena_used += size;
+    return ptr;
+}
+
+static void arena_free(void *ctx, void *ptr) {
+}
+
+static void count_display(void *context, control_id control, control_value current_value, control_value display_value) {
+    display_updates++;
+}
+
+#define CHECK(n, condition) \
+    if (!(condition)) {     \
+        return (n);         \
+    }
+
+int freestanding_main(void) {
+    h9 *h9 = h9_init(&h9_storage, &preset_storage);
+    CHECK(1, h9 != NULL);
+    h9->display_callback = count_display;
+
+    // Controls, expression curve and display strings
+    h9_setControl(h9, KNOB2, 0.25f, kH9_SUPPRESS_CALLBACK);
+    CHECK(2, h9_controlValue(h9, KNOB2) == 0.25f);
+    CHECK(3, display_updates > 0);
+    CHECK(4, h9_setExprCurve(h9, kH9_EXPR_LOG, NULL, 0));
+    char display[16];
+    CHECK(5, h9_displayString(h9, KNOB2, display, sizeof(display)) > 0);
+
+    // 14-bit CC pairs depend on the platform clock
+    h9->midi_config.cc_rx_map[KNOB0] = 22;
+    fake_now_ms                      = 100.0;
+    h9_cc(h9, 22, 64);
+    h9_cc(h9, 22 + 32, 0);
+    CHECK(6, h9_controlValue(h9, KNOB0) > 0.49f && h9_controlValue(h9, KNOB0) < 0.51f);
+
+    // Round trip a preset through sysex
+    CHECK(7, h9_setAlgorithm(h9, 1, 3));
+    size_t len = h9_dump(h9, sysex, sizeof(sysex), true);
+    CHECK(8, len > 0 && len <= sizeof(sysex));
+    struct h9 *copy = h9_init(&copy_storage, &copy_preset_storage);
+    CHECK(9, h9_parse_sysex(copy, sysex, len, kH9_RESPOND_TO_ANY_SYSEX_ID) == kH9_OK);
+    CHECK(10, h9_currentModuleIndex(copy) == 1 && h9_currentAlgorithmIndex(copy) == 3);
+    CHECK(11, h9_controlValue(copy, KNOB2) > 0.249f && h9_controlValue(copy, KNOB2) < 0.251f);
+
+    // Request generation
+    len = h9_sysexGenRequestConfigVar(h9, 0x204, sysex, sizeof(sysex));
+    CHECK(12, len == 10 && memcmp(&sysex[5], "204", 3) == 0);
+
+    // No allocator until one is supplied, then h9_new and the preset pool work
+    CHECK(13, h9_new() == NULL);
+    h9_allocator hooks = {arena_alloc, arena_free, NULL};
+    CHECK(14, h9_setAllocator(&hooks));
+    struct h9 *allocated = h9_new();
+    CHECK(15, allocated != NULL && arena_used > 0);
+    h9_preset *scratch = h9_preset_clone(h9->preset);
+    CHECK(16, scratch != NULL && scratch->algorithm == h9->preset->algorithm);
+    h9_preset_delete(scratch);
+    h9_delete(allocated);
+
+    return 0;
+}
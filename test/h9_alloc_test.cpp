@@ -0,0 +1,175 @@
+/*  h9_alloc_test.cpp
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+#include "libh9.h"
+#include "test_helpers.hpp"
+
+#include "gtest/gtest.h"
+
+#define TEST_CLASS H9AllocTest
+
+namespace h9_test {
+
+static size_t allocs;
+static size_t frees;
+static bool   fail_allocs;
+
+static void *counting_alloc(void *ctx, size_t size) {
+    if (fail_allocs) {
+        return nullptr;
+    }
+    allocs++;
+    return malloc(size);
+}
+
+static void counting_free(void *ctx, void *ptr) {
+    frees++;
+    free(ptr);
+}
+
+// Test Fixture
+class TEST_CLASS : public ::testing::Test {
+ protected:
+    void SetUp() override {
+        allocs      = 0;
+        frees       = 0;
+        fail_allocs = false;
+    }
+
+    void TearDown() override {
+        h9_setAllocator(nullptr);
+    }
+};
+
+TEST_F(TEST_CLASS, h9_preset_clone_copiesIndependently) {
+    h9_preset *original = h9_preset_new();
+    ASSERT_NE(original, nullptr);
+    original->knobs[KNOB3].current_value = 0.75;
+    strcpy(original->name, "Original");
+
+    h9_preset *clone = h9_preset_clone(original);
+    ASSERT_NE(clone, nullptr);
+    EXPECT_NE(clone, original);
+    EXPECT_EQ(clone->knobs[KNOB3].current_value, 0.75);
+    EXPECT_STREQ(clone->name, "Original");
+    EXPECT_EQ(clone->algorithm, original->algorithm);
+
+    clone->knobs[KNOB3].current_value = 0.25;
+    EXPECT_EQ(original->knobs[KNOB3].current_value, 0.75);
+
+    h9_preset_delete(clone);
+    h9_preset_delete(original);
+}
+
+TEST_F(TEST_CLASS, h9_preset_delete_returnsStorageToThePool) {
+    size_t in_use, capacity;
+    h9_preset *first = h9_preset_new();
+    h9_presetPoolStats(&in_use, &capacity);
+    EXPECT_GE(in_use, 1);
+    EXPECT_GE(capacity, in_use);
+    h9_preset_delete(first);
+    size_t in_use_after;
+    h9_presetPoolStats(&in_use_after, nullptr);
+    EXPECT_EQ(in_use_after, in_use - 1);
+
+    h9_preset *second = h9_preset_new();
+    EXPECT_EQ(second, first);  // freelist reuse
+    h9_preset_delete(second);
+    h9_preset_delete(nullptr);  // ignored
+}
+
+TEST_F(TEST_CLASS, h9_preset_new_growsBySlabs) {
+    h9_preset *presets[H9_PRESET_SLAB_SIZE + 1];
+    size_t     capacity_before;
+    h9_presetPoolStats(nullptr, &capacity_before);
+    for (size_t i = 0; i < H9_PRESET_SLAB_SIZE + 1; i++) {
+        presets[i] = h9_preset_new();
+        ASSERT_NE(presets[i], nullptr);
+    }
+    size_t capacity;
+    h9_presetPoolStats(nullptr, &capacity);
+    EXPECT_GT(capacity, capacity_before);
+    EXPECT_EQ(capacity % H9_PRESET_SLAB_SIZE, 0);
+    for (size_t i = 0; i < H9_PRESET_SLAB_SIZE + 1; i++) {
+        h9_preset_delete(presets[i]);
+    }
+}
+
+TEST_F(TEST_CLASS, h9_setAllocator_routesAllAllocations) {
+    h9_allocator counting = {counting_alloc, counting_free, nullptr};
+    ASSERT_TRUE(h9_setAllocator(&counting));
+
+    h9 *h9obj = h9_new();
+    ASSERT_NE(h9obj, nullptr);
+    EXPECT_EQ(allocs, 2);  // the instance and one preset slab
+
+    h9_allocator other = {counting_alloc, counting_free, nullptr};
+    EXPECT_FALSE(h9_setAllocator(&other));  // h9obj is still live
+
+    h9_delete(h9obj);
+    EXPECT_EQ(frees, 1);  // the slab is kept for reuse
+    EXPECT_TRUE(h9_presetPoolTrim());
+    EXPECT_EQ(frees, 2);
+    EXPECT_TRUE(h9_setAllocator(nullptr));
+}
+
+TEST_F(TEST_CLASS, h9_setAllocator_rejectsIncompleteHooks) {
+    h9_allocator incomplete = {counting_alloc, nullptr, nullptr};
+    EXPECT_FALSE(h9_setAllocator(&incomplete));
+}
+
+TEST_F(TEST_CLASS, h9_new_whenAllocatorFails_returnsNull) {
+    h9_allocator failing = {counting_alloc, counting_free, nullptr};
+    ASSERT_TRUE(h9_setAllocator(&failing));
+    fail_allocs = true;
+    EXPECT_EQ(h9_new(), nullptr);
+    EXPECT_EQ(h9_preset_new(), nullptr);
+    fail_allocs = false;
+    EXPECT_EQ(frees, 0);
+}
+
+TEST_F(TEST_CLASS, h9_new_andDelete_onSeparateThreads) {
+    size_t in_use_before;
+    h9_presetPoolStats(&in_use_before, nullptr);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 4; t++) {
+        threads.emplace_back([] {
+            for (size_t i = 0; i < 2000; i++) {
+                h9 *h9obj = h9_new();
+                ASSERT_NE(h9obj, nullptr);
+                h9_setControl(h9obj, KNOB0, 0.25, kH9_SUPPRESS_CALLBACK);
+                h9_delete(h9obj);
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    size_t in_use_after;
+    h9_presetPoolStats(&in_use_after, nullptr);
+    EXPECT_EQ(in_use_after, in_use_before);
+    EXPECT_TRUE(h9_setAllocator(nullptr));  // Every allocation accounted for
+}
+
+}  // namespace h9_test
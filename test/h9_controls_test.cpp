@@ -20,6 +20,7 @@
 
 #include <math.h>
 #include <string.h>
+#include "h9_modules.h"
 #include "libh9.h"
 #include "test_helpers.hpp"
 #include "utils.h"
@@ -30,10 +31,21 @@
 #define DEFAULT_KNOB_CC 22  // Per the user guide
 #define DEFAULT_EXPR_CC 15  // Per the user guide, but only for transmit
 
-extern h9_module h9_modules[H9_NUM_MODULES];
-
 namespace h9_test {
 
+static size_t          display_count[NUM_CONTROLS];
+static size_t          batch_count;
+static h9_control_mask batch_mask;
+
+static void counting_display_callback(void *ctx, control_id control, control_value current_value, control_value display_value) {
+    display_count[control]++;
+}
+
+static void counting_batch_callback(void *ctx, h9_control_mask changed) {
+    batch_count++;
+    batch_mask = changed;
+}
+
 // Test Fixture
 class TEST_CLASS : public ::testing::Test {
  protected:
@@ -54,11 +66,15 @@ class TEST_CLASS : public ::testing::Test {
     void SetUp() override {
         h9obj = h9_new();
         init_callback_helpers();
+        memset(display_count, 0, sizeof(display_count));
+        batch_count = 0;
+        batch_mask  = 0;
     }
 
     void TearDown() override {
         // Code here will be called immediately after each test (right
         // before the destructor).
+        h9_delete(h9obj);
     }
 
     // Class members declared here can be used by all tests in the test suite
@@ -357,7 +373,7 @@ TEST_F(TEST_CLASS, h9_setAlgorithm_withValidAlgorithm_marksPresetDirty) {
 }
 
 TEST_F(TEST_CLASS, h9_setAlgorithm_withValidAlgorithm_setsModule) {
-    h9_algorithm *current_algorithm = h9_currentAlgorithm(h9obj);
+    const h9_algorithm *current_algorithm = h9_currentAlgorithm(h9obj);
     EXPECT_NE(current_algorithm->id, 1);
     EXPECT_NE(current_algorithm->module_id, 1);
     EXPECT_TRUE(h9_setAlgorithm(h9obj, 1, 1));
@@ -367,52 +383,130 @@ TEST_F(TEST_CLASS, h9_setAlgorithm_withValidAlgorithm_setsModule) {
 }
 
 TEST_F(TEST_CLASS, h9_currentModule_returnsActivePresetModule) {
-    h9_module *space_module = &h9_modules[3];
+    const h9_module *space_module = &h9_modules[3];
     EXPECT_TRUE(h9_setAlgorithm(h9obj, 3, 6));  // ModEchoVerb
-    h9_module *current_module = h9_currentModule(h9obj);
+    const h9_module *current_module = h9_currentModule(h9obj);
     EXPECT_EQ(current_module, space_module);
 }
 
 TEST_F(TEST_CLASS, h9_currentModuleIndex_returnsActivePresetModuleIndex) {
-    h9_module *space_module = &h9_modules[3];
+    const h9_module *space_module = &h9_modules[3];
     EXPECT_TRUE(h9_setAlgorithm(h9obj, 3, 6));  // ModEchoVerb
     EXPECT_EQ(&h9_modules[h9_currentModuleIndex(h9obj)], space_module);
 }
 
 TEST_F(TEST_CLASS, h9_currentAlgorithm_returnsActivePresetAlgorithm) {
-    h9_algorithm *modechoverb = &h9_modules[3].algorithms[6];
+    const h9_algorithm *modechoverb = h9_algorithmAt(3, 6);
     EXPECT_TRUE(h9_setAlgorithm(h9obj, 3, 6));
-    h9_algorithm *current_algorithm = h9_currentAlgorithm(h9obj);
+    const h9_algorithm *current_algorithm = h9_currentAlgorithm(h9obj);
     EXPECT_EQ(current_algorithm, modechoverb);
 }
 
 TEST_F(TEST_CLASS, h9_currentAlgorithmIndex_returnsActivePresetAlgorithmId) {
-    h9_algorithm *modechoverb = &h9_modules[3].algorithms[6];
+    const h9_algorithm *modechoverb = h9_algorithmAt(3, 6);
     EXPECT_TRUE(h9_setAlgorithm(h9obj, 3, 6));
-    EXPECT_EQ(&h9_modules[3].algorithms[h9_currentAlgorithmIndex(h9obj)], modechoverb);
+    EXPECT_EQ(h9_algorithmAt(3, h9_currentAlgorithmIndex(h9obj)), modechoverb);
 }
 
 TEST_F(TEST_CLASS, h9_moduleName_returnsModuleName) {
     for (size_t i = 0; i < H9_NUM_MODULES; i++) {
-        EXPECT_EQ(h9_moduleName(i), h9_modules[i].name);
+        EXPECT_EQ(h9_moduleName(i), H9_STRING(h9_modules[i].name));
     }
 }
 
 TEST_F(TEST_CLASS, h9_algorithmName_returnsAlgorithmName) {
-    h9_algorithm *modechoverb = &h9_modules[3].algorithms[6];
-    EXPECT_STREQ(h9_algorithmName(3, 6), modechoverb->name);
+    EXPECT_STREQ(h9_algorithmName(4, 6), "ModEchoVerb");  // Space is module sysex id 4
+    EXPECT_STREQ(h9_algorithmName(1, 0), H9_STRING(h9_algorithmAt(0, 0)->name));
+}
+
+TEST_F(TEST_CLASS, h9_algorithmName_coversTheLastModule) {
+    EXPECT_STREQ(h9_algorithmName(5, 0), "UltraTap");
+    EXPECT_STREQ(h9_algorithmName(5, 2), "EQ Compressor");
+}
+
+TEST_F(TEST_CLASS, h9_algorithmName_outOfRange_returnsNull) {
+    EXPECT_EQ(h9_algorithmName(0, 0), nullptr);
+    EXPECT_EQ(h9_algorithmName(H9_NUM_MODULES + 1, 0), nullptr);
+    EXPECT_EQ(h9_algorithmName(5, 200), nullptr);
 }
 
 TEST_F(TEST_CLASS, h9_currentAlgorithmName_returnsCurrentAlgorithmName) {
-    h9_algorithm *modechoverb = &h9_modules[3].algorithms[6];
     EXPECT_TRUE(h9_setAlgorithm(h9obj, 3, 6));
-    EXPECT_STREQ(h9_currentAlgorithmName(h9obj), modechoverb->name);
+    EXPECT_STREQ(h9_currentAlgorithmName(h9obj), "ModEchoVerb");
 }
 
 TEST_F(TEST_CLASS, h9_currentModuleName_returnsCurrentModuleName) {
-    h9_module *space = &h9_modules[3];
     EXPECT_TRUE(h9_setAlgorithm(h9obj, 3, 6));
-    EXPECT_STREQ(h9_currentModuleName(h9obj), space->name);
+    EXPECT_STREQ(h9_currentModuleName(h9obj), "Space");
+}
+
+TEST_F(TEST_CLASS, h9_algorithmAt_withInvalidIds_returnsNull) {
+    EXPECT_EQ(h9_algorithmAt(H9_NUM_MODULES, 0), nullptr);
+    EXPECT_EQ(h9_algorithmAt(0, h9_numAlgorithms(h9obj, 0)), nullptr);
+}
+
+TEST_F(TEST_CLASS, h9_algorithmAt_coversEveryAlgorithm) {
+    size_t total = 0;
+    for (uint8_t i = 0; i < H9_NUM_MODULES; i++) {
+        for (uint8_t j = 0; j < h9_numAlgorithms(h9obj, i); j++) {
+            const h9_algorithm *algorithm = h9_algorithmAt(i, j);
+            ASSERT_NE(algorithm, nullptr);
+            EXPECT_EQ(algorithm->id, j);
+            EXPECT_EQ(algorithm->module_id, i);
+            total++;
+        }
+    }
+    EXPECT_EQ(total, H9_NUM_ALGORITHMS);
+}
+
+TEST_F(TEST_CLASS, h9_knobLabel_returnsLabels) {
+    const h9_algorithm *modechoverb = h9_algorithmAt(3, 6);
+    EXPECT_STREQ(h9_knobLabel(modechoverb, KNOB0), "Mix");
+    EXPECT_STREQ(h9_knobLabel(modechoverb, KNOB3), "Echo");
+    EXPECT_STREQ(h9_knobLabel(modechoverb, KNOB9), "Echotone");
+    EXPECT_STREQ(h9_knobLabel(modechoverb, PSW), "HotSwitch");
+    EXPECT_EQ(h9_knobLabel(modechoverb, EXPR), nullptr);
+}
+
+TEST_F(TEST_CLASS, h9_knobRange_returnsRangeForKnobsOnly) {
+    const h9_algorithm *modechoverb = h9_algorithmAt(3, 6);
+    for (size_t i = KNOB0; i <= KNOB9; i++) {
+        const h9_knob_range *range = h9_knobRange(modechoverb, (control_id)i);
+        ASSERT_NE(range, nullptr);
+        EXPECT_GE(range->steps, 2);
+    }
+    EXPECT_EQ(h9_knobRange(modechoverb, EXPR), nullptr);
+    EXPECT_EQ(h9_knobRange(modechoverb, PSW), nullptr);
+}
+
+TEST_F(TEST_CLASS, h9_knobRangeLookup_coversEndpoints) {
+    const h9_knob_range *mix = h9_knobRange(h9_algorithmAt(3, 6), KNOB0);
+    EXPECT_EQ(h9_knobRangeLookup(mix, 0.0), 0);
+    EXPECT_EQ(h9_knobRangeLookup(mix, 0.5), 50);
+    EXPECT_EQ(h9_knobRangeLookup(mix, 1.0), 100);
+    EXPECT_EQ(h9_knobRangeLookup(mix, 2.0), 100);  // clipped
+}
+
+TEST_F(TEST_CLASS, h9_displayString_rendersDisplayValueWithUnit) {
+    char buf[16];
+    EXPECT_TRUE(h9_setAlgorithm(h9obj, 3, 6));
+    h9_setControl(h9obj, KNOB0, 0.25, kH9_SUPPRESS_CALLBACK);
+    EXPECT_EQ(h9_displayString(h9obj, KNOB0, buf, sizeof(buf)), 3);
+    EXPECT_STREQ(buf, "25%");
+    EXPECT_EQ(h9_displayString(h9obj, EXPR, buf, sizeof(buf)), 0);
+}
+
+TEST_F(TEST_CLASS, h9_displayString_followsExpressionMapping) {
+    char buf[16];
+    h9_setKnobMap(h9obj, KNOB0, 0.0, 1.0, 0.0);
+    h9_setControl(h9obj, EXPR, 0.75, kH9_SUPPRESS_CALLBACK);
+    h9_displayString(h9obj, KNOB0, buf, sizeof(buf));
+    EXPECT_STREQ(buf, "75%");
+}
+
+TEST_F(TEST_CLASS, h9_knobLabel_sharesDuplicateStrings) {
+    // Labels are pooled, so identical labels in different algorithms resolve to the same storage
+    EXPECT_EQ(h9_knobLabel(h9_algorithmAt(0, 0), KNOB0), h9_knobLabel(h9_algorithmAt(3, 6), KNOB0));
 }
 
 TEST_F(TEST_CLASS, h9_setPresetName_withValidName_returnsTrue) {
@@ -458,4 +552,59 @@ TEST_F(TEST_CLASS, h9_setPresetName_withInvalidCharacters_replacesWithSpaces) {
     EXPECT_EQ(len, strlen(expected_name));
 }
 
+TEST_F(TEST_CLASS, h9_setControls_notifiesEachChangedControlOnce) {
+    h9obj->display_callback            = counting_display_callback;
+    h9obj->cc_callback                 = cc_callback;
+    h9obj->midi_config.cc_rx_map[EXPR] = DEFAULT_EXPR_CC;
+    h9_control_update scene[]          = {{KNOB0, 0.1}, {KNOB1, 0.2}, {KNOB0, 0.3}, {EXPR, 0.5}};
+    h9_setControls(h9obj, scene, 4, kH9_TRIGGER_CALLBACK);
+
+    EXPECT_EQ(display_count[KNOB0], 1);
+    EXPECT_EQ(display_count[KNOB1], 1);
+    EXPECT_EQ(display_count[EXPR], 1);
+    EXPECT_EQ(display_count[KNOB2], 0);
+    EXPECT_EQ(cc_callback_count(), 3);  // KNOB0 once, with its final value
+    uint8_t cc_value;
+    ASSERT_TRUE(cc_callback_triggered(DEFAULT_KNOB_CC, &cc_value));
+    EXPECT_EQ(cc_value, (uint8_t)((uint16_t)(0.3 * 16383) >> 7));
+    EXPECT_DOUBLE_EQ(h9_controlValue(h9obj, KNOB0), 0.3);
+    EXPECT_TRUE(h9_dirty(h9obj));
+}
+
+TEST_F(TEST_CLASS, h9_beginUpdate_nests) {
+    h9obj->display_callback = counting_display_callback;
+    h9_beginUpdate(h9obj);
+    h9_setControl(h9obj, KNOB4, 0.9, kH9_SUPPRESS_CALLBACK);
+    h9_beginUpdate(h9obj);
+    h9_setControl(h9obj, KNOB5, 0.9, kH9_SUPPRESS_CALLBACK);
+    h9_commitUpdate(h9obj);
+    EXPECT_EQ(display_count[KNOB4] + display_count[KNOB5], 0);
+    h9_commitUpdate(h9obj);
+    EXPECT_EQ(display_count[KNOB4], 1);
+    EXPECT_EQ(display_count[KNOB5], 1);
+    h9_commitUpdate(h9obj);  // Unbalanced commits are ignored
+    EXPECT_EQ(display_count[KNOB4], 1);
+}
+
+TEST_F(TEST_CLASS, h9_commitUpdate_withBatchCallback_firesOnceWithMask) {
+    h9obj->display_callback       = counting_display_callback;
+    h9obj->batch_display_callback = counting_batch_callback;
+    h9_control_update scene[]     = {{KNOB3, 0.1}, {PSW, 1.0}, {KNOB9, 0.7}};
+    h9_setControls(h9obj, scene, 3, kH9_SUPPRESS_CALLBACK);
+    EXPECT_EQ(batch_count, 1);
+    EXPECT_EQ(batch_mask, (1 << KNOB3) | (1 << PSW) | (1 << KNOB9));
+    EXPECT_EQ(display_count[KNOB3], 0);
+
+    h9_setControls(h9obj, scene, 3, kH9_SUPPRESS_CALLBACK);  // Nothing changes
+    EXPECT_EQ(batch_count, 1);
+}
+
+TEST_F(TEST_CLASS, h9_commitUpdate_appliesExpressionAfterKnobs) {
+    h9_setKnobMap(h9obj, KNOB0, 0.0, 1.0, 0.0);
+    h9_control_update scene[] = {{EXPR, 1.0}, {KNOB0, 0.2}};
+    h9_setControls(h9obj, scene, 2, kH9_SUPPRESS_CALLBACK);
+    EXPECT_DOUBLE_EQ(h9_controlValue(h9obj, KNOB0), 0.2);
+    EXPECT_DOUBLE_EQ(h9_displayValue(h9obj, KNOB0), 1.0);  // The pedal still has it fully mapped
+}
+
 }  // namespace h9_test
@@ -0,0 +1,175 @@
+/*  h9_corpus.c
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "h9_corpus.h"
+
+#include <string.h>
+
+#include "h9_modules.h"
+#include "libh9.h"
+#include "utils.h"
+
+#define SYSVARS_BYTES      94
+#define SYSVARS_WORDS      58
+#define SYSVARS_BITS       32
+#define SYSVARS_NAME_WORD  50  // Pedal name, two characters per word, 8 words
+#define SYSVARS_PIN_WORD   48  // Bluetooth PIN, two digits per word, 2 words
+#define SYSVARS_CAL_WORD   46  // Pedal calibration min, max
+#define SYSVARS_SYSEX_ID   4
+#define SYSVARS_RX_CHANNEL 3
+#define SYSVARS_TX_CHANNEL 8
+
+static const char   kNameChars[]        = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+static const size_t kControlCCIndices[] = {27, 26, 25, 24, 23, 22, 18, 19, 20, 21, 32, 16};  // Byte values holding each control's CC
+static const char   kSysvarsHeader[]    = "[SYSTEM] 2 20 5.8.5[1]\r\n";
+
+// splitmix64, good enough for test data and trivially reproducible anywhere
+static uint64_t next_random(corpus *corpus) {
+    uint64_t z = (corpus->state += 0x9E3779B97F4A7C15ULL);
+    z          = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z          = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static uint32_t random_below(corpus *corpus, uint32_t limit) {
+    return (uint32_t)(next_random(corpus) % limit);
+}
+
+static control_value random_value(corpus *corpus) {
+    return (control_value)random_below(corpus, 0x4000) / (control_value)0x3FFF;
+}
+
+static void random_name(corpus *corpus, char *name, size_t max_len) {
+    size_t len = 1 + random_below(corpus, max_len);
+    for (size_t i = 0; i < len; i++) {
+        name[i] = kNameChars[random_below(corpus, sizeof(kNameChars) - 1)];
+    }
+    name[len] = '\0';
+}
+
+void corpus_init(corpus *corpus, uint64_t seed) {
+    corpus->state          = seed;
+    corpus->next_algorithm = 0;
+}
+
+uint32_t corpus_random(corpus *corpus) {
+    return (uint32_t)(next_random(corpus) >> 32);
+}
+
+size_t corpus_program(corpus *corpus, uint8_t *sysex, size_t max_len) {
+    h9        h9obj;
+    h9_preset preset;
+    h9_init(&h9obj, &preset);
+    h9obj.midi_config.sysex_id = 1 + random_below(corpus, 16);
+
+    const h9_algorithm *algorithm = &h9_algorithms[corpus->next_algorithm];
+    corpus->next_algorithm        = (corpus->next_algorithm + 1) % H9_NUM_ALGORITHMS;
+    h9_setAlgorithm(&h9obj, algorithm->module_id, algorithm->id);
+
+    for (size_t i = 0; i < H9_NUM_KNOBS; i++) {
+        h9_setControl(&h9obj, (control_id)i, random_value(corpus), kH9_SUPPRESS_CALLBACK);
+        control_value exp_min = 0.0;
+        control_value exp_max = 0.0;
+        control_value psw     = 0.0;
+        if (random_below(corpus, 3) == 0) {
+            exp_min = random_value(corpus);
+            exp_max = random_value(corpus);
+        }
+        if (random_below(corpus, 4) == 0) {
+            psw = random_value(corpus);
+        }
+        h9_setKnobMap(&h9obj, (control_id)i, exp_min, exp_max, psw);
+    }
+    h9_setControl(&h9obj, EXPR, random_value(corpus), kH9_SUPPRESS_CALLBACK);
+    h9_setControl(&h9obj, PSW, random_below(corpus, 2), kH9_SUPPRESS_CALLBACK);
+    preset.tempo       = (double)(3000 + random_below(corpus, 27000)) / 100.0;  // 30 to 300 BPM
+    preset.output_gain = (double)random_below(corpus, 25) - 12.0;
+    char name[H9_MAX_NAME_LEN];
+    random_name(corpus, name, H9_MAX_NAME_LEN - 1);
+    h9_setPresetName(&h9obj, name, strlen(name));
+
+    return h9_dump(&h9obj, sysex, max_len, false);
+}
+
+size_t corpus_sysvars(corpus *corpus, uint8_t *sysex, size_t max_len) {
+    uint8_t  bytes[SYSVARS_BYTES];
+    uint16_t words[SYSVARS_WORDS];
+    bool     bits[SYSVARS_BITS];
+    for (size_t i = 0; i < SYSVARS_BYTES; i++) {
+        bytes[i] = random_below(corpus, 0x80);
+    }
+    for (size_t i = 0; i < SYSVARS_WORDS; i++) {
+        words[i] = random_below(corpus, 0x10000);
+    }
+    for (size_t i = 0; i < SYSVARS_BITS; i++) {
+        bits[i] = random_below(corpus, 2);
+    }
+
+    // Keep the values the parser interprets within their legal ranges
+    uint8_t sysex_id          = 1 + random_below(corpus, 16);
+    bytes[SYSVARS_SYSEX_ID]   = sysex_id;
+    bytes[SYSVARS_RX_CHANNEL] = random_below(corpus, 16);
+    bytes[SYSVARS_TX_CHANNEL] = random_below(corpus, 16);
+    for (size_t i = 0; i < NUM_CONTROLS; i++) {
+        bytes[kControlCCIndices[i]] = random_below(corpus, MAX_CC + 1 + 5);  // Offset by 5, below 5 is disabled
+    }
+    uint16_t cal_min            = random_below(corpus, H9_PEDAL_CAL_FULL_SCALE / 2);
+    words[SYSVARS_CAL_WORD]     = cal_min;
+    words[SYSVARS_CAL_WORD + 1] = cal_min + 1 + random_below(corpus, H9_PEDAL_CAL_FULL_SCALE - cal_min);
+    for (size_t i = 0; i < 2; i++) {
+        words[SYSVARS_PIN_WORD + i] = ('0' + random_below(corpus, 10)) | (('0' + random_below(corpus, 10)) << 8);
+    }
+    char name[2 * 8 + 1] = {0};
+    random_name(corpus, name, 2 * 8 - 1);  // Leave a null within the name words
+    for (size_t i = 0; i < 8; i++) {
+        words[SYSVARS_NAME_WORD + i] = (uint8_t)name[2 * i] | ((uint8_t)name[2 * i + 1] << 8);
+    }
+
+    uint16_t checksum = array_sum8(bytes, SYSVARS_BYTES) + array_sum16(words, SYSVARS_WORDS) + array_sum1(bits, SYSVARS_BITS);
+
+    text_writer writer;
+    writer_init(&writer, (char *)sysex, max_len);
+    write_char(&writer, (char)0xF0);
+    write_char(&writer, H9_SYSEX_EVENTIDE);
+    write_char(&writer, H9_SYSEX_H9);
+    write_char(&writer, sysex_id);
+    write_char(&writer, 0x4D);  // TJ_SYSVARS_DUMP
+    write_string(&writer, kSysvarsHeader);
+    for (size_t i = 0; i < SYSVARS_BYTES; i++) {
+        write_hex(&writer, bytes[i]);
+        write_char(&writer, ' ');
+    }
+    write_string(&writer, "\r\n");
+    for (size_t i = 0; i < SYSVARS_WORDS; i++) {
+        write_hex(&writer, words[i]);
+        write_char(&writer, ' ');
+    }
+    write_string(&writer, "\r\n");
+    for (size_t i = 0; i < SYSVARS_BITS; i++) {
+        write_hex(&writer, bits[i]);
+        write_char(&writer, ' ');
+    }
+    write_string(&writer, "\r\nC_");
+    write_hex(&writer, checksum);
+    write_string(&writer, "\r\n");
+    write_char(&writer, 0x0);
+    write_char(&writer, (char)0xF7);
+    return writer_finish(&writer);
+}
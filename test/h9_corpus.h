@@ -0,0 +1,56 @@
+/*  h9_corpus.h
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef h9_corpus_h
+#define h9_corpus_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A deterministic generator of valid sysex messages, for tests and benchmarks which need more than a few fixtures.
+ *
+ * The same seed always produces the same sequence. Programs step through every algorithm of every module in turn
+ * (so any H9_NUM_ALGORITHMS consecutive programs cover them all), with random knob values, expression and PSW maps,
+ * name, tempo and sysex id. Sysvars dumps carry random MIDI settings, CC maps, pedal name, PIN and calibration. Both
+ * have correct C_xxxx checksums and parse with h9_parse_sysex.
+ */
+
+#define CORPUS_MAX_SYSEX 1024  // Room for any generated message
+
+typedef struct corpus {
+    uint64_t state;
+    size_t   next_algorithm;
+} corpus;
+
+void     corpus_init(corpus *corpus, uint64_t seed);
+uint32_t corpus_random(corpus *corpus);                                  // Uniform 32-bit
+size_t   corpus_program(corpus *corpus, uint8_t *sysex, size_t max_len);  // A PROGRAM message, returns its length
+size_t   corpus_sysvars(corpus *corpus, uint8_t *sysex, size_t max_len);  // A TJ_SYSVARS_DUMP message, returns its length
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* h9_corpus_h */
@@ -0,0 +1,106 @@
+/*  h9_corpus_test.cpp
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include "h9_corpus.h"
+#include "libh9.h"
+#include "test_helpers.hpp"
+
+#include "gtest/gtest.h"
+
+#define TEST_CLASS  H9CorpusTest
+#define CORPUS_SEED 0x5EED
+
+namespace h9_test {
+
+// Test Fixture
+class TEST_CLASS : public ::testing::Test {
+ protected:
+    void SetUp() override {
+        h9obj = h9_new();
+        corpus_init(&generator, CORPUS_SEED);
+    }
+
+    void TearDown() override {
+        h9_delete(h9obj);
+    }
+
+    h9 *    h9obj;
+    corpus  generator;
+    uint8_t sysex[CORPUS_MAX_SYSEX];
+};
+
+TEST_F(TEST_CLASS, corpus_isDeterministic) {
+    corpus  other;
+    uint8_t other_sysex[CORPUS_MAX_SYSEX];
+    corpus_init(&other, CORPUS_SEED);
+    for (size_t i = 0; i < 10; i++) {
+        size_t len = (i % 2) ? corpus_sysvars(&generator, sysex, sizeof(sysex)) : corpus_program(&generator, sysex, sizeof(sysex));
+        ASSERT_EQ(len, (i % 2) ? corpus_sysvars(&other, other_sysex, sizeof(other_sysex)) : corpus_program(&other, other_sysex, sizeof(other_sysex)));
+        EXPECT_EQ(memcmp(sysex, other_sysex, len), 0);
+    }
+
+    corpus_init(&other, CORPUS_SEED + 1);
+    size_t len = corpus_program(&generator, sysex, sizeof(sysex));
+    EXPECT_FALSE(len == corpus_program(&other, other_sysex, sizeof(other_sysex)) && memcmp(sysex, other_sysex, len) == 0);
+}
+
+TEST_F(TEST_CLASS, corpus_program_coversEveryAlgorithmAndParses) {
+    bool seen[H9_NUM_MODULES][H9_MAX_ALGORITHMS] = {};
+    for (size_t i = 0; i < H9_NUM_ALGORITHMS; i++) {
+        size_t len = corpus_program(&generator, sysex, sizeof(sysex));
+        ASSERT_LT(len, sizeof(sysex));
+        ASSERT_EQ(h9_parse_sysex(h9obj, sysex, len, kH9_RESPOND_TO_ANY_SYSEX_ID), kH9_OK) << "program " << i;
+        seen[h9_currentModuleIndex(h9obj)][h9_currentAlgorithmIndex(h9obj)] = true;
+
+        // Parsing and dumping again gives back the same message
+        uint8_t again[CORPUS_MAX_SYSEX];
+        h9obj->midi_config.sysex_id = sysex[3];
+        ASSERT_EQ(h9_dump(h9obj, again, sizeof(again), false), len);
+        EXPECT_EQ(memcmp(sysex, again, len), 0) << "program " << i;
+    }
+    for (size_t m = 0; m < H9_NUM_MODULES; m++) {
+        for (size_t a = 0; a < h9_numAlgorithms(h9obj, m); a++) {
+            EXPECT_TRUE(seen[m][a]) << "module " << m << " algorithm " << a;
+        }
+    }
+}
+
+TEST_F(TEST_CLASS, corpus_sysvars_parses) {
+    for (size_t i = 0; i < 100; i++) {
+        size_t len = corpus_sysvars(&generator, sysex, sizeof(sysex));
+        ASSERT_LT(len, sizeof(sysex));
+        ASSERT_EQ(h9_parse_sysex(h9obj, sysex, len, kH9_RESPOND_TO_ANY_SYSEX_ID), kH9_OK) << "sysvars " << i;
+        EXPECT_EQ(h9obj->midi_config.sysex_id, sysex[3]);
+        EXPECT_LT(h9obj->midi_config.midi_rx_channel, 16);
+        EXPECT_EQ(strlen(h9obj->bluetooth_pin), 4);
+        EXPECT_GT(strlen(h9obj->name), 0);
+    }
+}
+
+TEST_F(TEST_CLASS, corpus_sysvars_badChecksum_isRejected) {
+    size_t len = corpus_sysvars(&generator, sysex, sizeof(sysex));
+    uint8_t *checksum = (uint8_t *)memmem(sysex, len, "C_", 2);
+    ASSERT_NE(checksum, nullptr);
+    checksum[2] = (checksum[2] == '1') ? '2' : '1';
+    EXPECT_EQ(h9_parse_sysex(h9obj, sysex, len, kH9_RESPOND_TO_ANY_SYSEX_ID), kH9_SYSEX_CHECKSUM_INVALID);
+}
+
+}  // namespace h9_test
@@ -0,0 +1,163 @@
+/*  h9_executor_test.cpp
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "libh9.h"
+#include "test_helpers.hpp"
+
+#include "gtest/gtest.h"
+
+#include <unistd.h>
+
+#define TEST_CLASS    H9ExecutorTest
+#define NUM_INSTANCES 4
+#define KNOB0_CC      22  // default
+
+namespace h9_test {
+
+// Test Fixture
+class TEST_CLASS : public ::testing::Test {
+ protected:
+    void SetUp() override {
+        executor = h9_executor_new(2, 64, false);
+        ASSERT_NE(executor, nullptr);
+        for (size_t i = 0; i < NUM_INSTANCES; i++) {
+            instances[i]                              = h9_new();
+            instances[i]->midi_config.midi_rx_channel = i;
+            instances[i]->midi_config.sysex_id        = i + 1;
+        }
+    }
+
+    void TearDown() override {
+        h9_executor_delete(executor);
+        for (size_t i = 0; i < NUM_INSTANCES; i++) {
+            h9_delete(instances[i]);
+        }
+    }
+
+    void AddAll(uint8_t port) {
+        for (size_t i = 0; i < NUM_INSTANCES; i++) {
+            ASSERT_EQ(h9_executorAdd(executor, instances[i], port), (int)(i % 2));  // round robin
+        }
+    }
+
+    h9_executor *executor;
+    h9 *         instances[NUM_INSTANCES];
+};
+
+TEST_F(TEST_CLASS, h9_executorPostCC_routesByPortAndChannel) {
+    AddAll(3);
+    ASSERT_TRUE(h9_executorStart(executor));
+    EXPECT_TRUE(h9_executorPostCC(executor, 3, 1, KNOB0_CC, 127));
+    EXPECT_TRUE(h9_executorPostCC(executor, 3, 2, KNOB0_CC, 0));
+    EXPECT_TRUE(h9_executorPostCC(executor, 4, 3, KNOB0_CC, 0));  // nobody on port 4
+    h9_executorDrain(executor);
+    EXPECT_DOUBLE_EQ(h9_controlValue(instances[0], KNOB0), 0.5);
+    EXPECT_DOUBLE_EQ(h9_controlValue(instances[1], KNOB0), 1.0);
+    EXPECT_DOUBLE_EQ(h9_controlValue(instances[2], KNOB0), 0.0);
+    EXPECT_DOUBLE_EQ(h9_controlValue(instances[3], KNOB0), 0.5);
+}
+
+TEST_F(TEST_CLASS, h9_executorPostCC_pairsMSBAndLSBByPostTime) {
+    AddAll(0);
+    uint8_t knob5 = instances[0]->midi_config.cc_tx_map[KNOB5];
+    uint8_t knob6 = instances[0]->midi_config.cc_tx_map[KNOB6];
+    EXPECT_TRUE(h9_executorPostCC(executor, 0, 0, knob5, 42));
+    EXPECT_TRUE(h9_executorPostCC(executor, 0, 0, knob5 + 32, 24));
+    EXPECT_TRUE(h9_executorPostCC(executor, 0, 0, knob6, 42));
+    usleep(5000);  // Longer than the LSB window, between posting the knob 6 MSB and its LSB
+    EXPECT_TRUE(h9_executorPostCC(executor, 0, 0, knob6 + 32, 24));
+    usleep(5000);  // Queued, not yet processed
+    ASSERT_TRUE(h9_executorStart(executor));
+    h9_executorDrain(executor);
+    EXPECT_NEAR(h9_controlValue(instances[0], KNOB5), (double)((42 << 7) + 24) / (double)((1 << 14) - 1), 0.00001);
+    EXPECT_NEAR(h9_controlValue(instances[0], KNOB6), 42.0 / 127.0, 0.00001);
+}
+
+TEST_F(TEST_CLASS, h9_executorPostSysex_routesBySysexId) {
+    AddAll(0);
+    h9 *source = h9_new();
+    ASSERT_TRUE(h9_setAlgorithm(source, 1, 3));
+    source->midi_config.sysex_id = 3;  // instances[2]
+    uint8_t sysex[H9_EXECUTOR_MAX_SYSEX];
+    size_t  len = h9_dump(source, sysex, sizeof(sysex), false);
+    ASSERT_LE(len, sizeof(sysex));
+
+    ASSERT_TRUE(h9_executorStart(executor));
+    EXPECT_TRUE(h9_executorPostSysex(executor, 0, sysex, len));
+    h9_executorDrain(executor);
+    for (size_t i = 0; i < NUM_INSTANCES; i++) {
+        EXPECT_EQ(h9_currentModuleIndex(instances[i]), (i == 2) ? 1 : 4) << i;
+    }
+
+    sysex[3] = 0;  // broadcast
+    EXPECT_TRUE(h9_executorPostSysex(executor, 0, sysex, len));
+    h9_executorDrain(executor);
+    for (size_t i = 0; i < NUM_INSTANCES; i++) {
+        EXPECT_EQ(h9_currentAlgorithmIndex(instances[i]), 3) << i;
+    }
+    h9_delete(source);
+}
+
+TEST_F(TEST_CLASS, h9_executorPostSysex_withInstanceIdZero_takesAnyId) {
+    instances[1]->midi_config.sysex_id = 0;  // On the other shard from instances[2]
+    AddAll(0);
+    h9 *source = h9_new();
+    ASSERT_TRUE(h9_setAlgorithm(source, 1, 3));
+    source->midi_config.sysex_id = 3;  // instances[2]
+    uint8_t sysex[H9_EXECUTOR_MAX_SYSEX];
+    size_t  len = h9_dump(source, sysex, sizeof(sysex), false);
+    ASSERT_LE(len, sizeof(sysex));
+
+    ASSERT_TRUE(h9_executorStart(executor));
+    EXPECT_TRUE(h9_executorPostSysex(executor, 0, sysex, len));
+    h9_executorDrain(executor);
+    for (size_t i = 0; i < NUM_INSTANCES; i++) {
+        EXPECT_EQ(h9_currentModuleIndex(instances[i]), (i == 1 || i == 2) ? 1 : 4) << i;
+    }
+    h9_delete(source);
+}
+
+TEST_F(TEST_CLASS, h9_executorPost_whenQueueFull_returnsFalse) {
+    h9_executor_delete(executor);
+    executor = h9_executor_new(1, 2, false);
+    ASSERT_EQ(h9_executorAdd(executor, instances[0], 0), 0);
+    EXPECT_TRUE(h9_executorPostCC(executor, 0, 0, KNOB0_CC, 1));
+    EXPECT_TRUE(h9_executorPostCC(executor, 0, 0, KNOB0_CC, 2));
+    EXPECT_FALSE(h9_executorPostCC(executor, 0, 0, KNOB0_CC, 3));
+
+    // Queued events run once started
+    ASSERT_TRUE(h9_executorStart(executor));
+    h9_executorDrain(executor);
+    EXPECT_DOUBLE_EQ(h9_controlValue(instances[0], KNOB0), 2.0 / 127.0);
+    EXPECT_TRUE(h9_executorPostCC(executor, 0, 0, KNOB0_CC, 3));
+}
+
+TEST_F(TEST_CLASS, h9_executor_rejectsInvalidUse) {
+    EXPECT_EQ(h9_executor_new(0, 64, false), nullptr);
+    EXPECT_EQ(h9_executor_new(H9_EXECUTOR_MAX_SHARDS + 1, 64, false), nullptr);
+    EXPECT_EQ(h9_executorAdd(executor, instances[0], H9_EXECUTOR_MAX_PORTS), -1);
+    uint8_t too_big[H9_EXECUTOR_MAX_SYSEX + 1] = {0xF0};
+    EXPECT_FALSE(h9_executorPostSysex(executor, 0, too_big, sizeof(too_big)));
+    ASSERT_TRUE(h9_executorStart(executor));
+    EXPECT_FALSE(h9_executorStart(executor));
+    EXPECT_EQ(h9_executorAdd(executor, instances[0], 0), -1);  // too late
+}
+
+}  // namespace h9_test
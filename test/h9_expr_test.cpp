@@ -0,0 +1,168 @@
+/*  h9_expr_test.cpp
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "libh9.h"
+#include "test_helpers.hpp"
+#include "utils.h"
+
+#include "gtest/gtest.h"
+
+#define TEST_CLASS       H9ExprTest
+#define SP_PEDAL_CAL_MIN 0x32e
+#define SP_PEDAL_CAL_MAX 0x32f
+
+namespace h9_test {
+
+// Test Fixture
+class TEST_CLASS : public ::testing::Test {
+ protected:
+    void SetUp() override {
+        h9obj = h9_new();
+        init_callback_helpers();
+        h9obj->display_callback = display_callback;
+        h9_setKnobMap(h9obj, KNOB0, 0.0, 1.0, 0.0);
+    }
+
+    void TearDown() override {
+        h9_delete(h9obj);
+    }
+
+    control_value MappedKnobAt(control_value position) {
+        h9_setControl(h9obj, EXPR, position, kH9_SUPPRESS_CALLBACK);
+        return h9_displayValue(h9obj, KNOB0);
+    }
+
+    h9_status ValueDump(uint16_t key, uint16_t value) {
+        char sysex[32];
+        int  len = snprintf(sysex, sizeof(sysex), "\xf0\x1c\x70\x01\x2e%x %x\xf7", key, value);
+        return h9_parse_sysex(h9obj, (uint8_t *)sysex, (size_t)len, kH9_RESPOND_TO_ANY_SYSEX_ID);
+    }
+
+    // Class members declared here can be used by all tests in the test suite
+    h9 *h9obj;
+};
+
+TEST_F(TEST_CLASS, h9_new_defaultsToLinearUncalibrated) {
+    EXPECT_EQ(h9_exprCurve(h9obj), kH9_EXPR_LINEAR);
+    EXPECT_EQ(h9obj->pedal_cal_min, 0);
+    EXPECT_EQ(h9obj->pedal_cal_max, H9_PEDAL_CAL_FULL_SCALE);
+    EXPECT_EQ(h9_exprResponse(h9obj, 0.3), 0.3);
+}
+
+TEST_F(TEST_CLASS, h9_setExprCurve_log_isAboveLinearMidway) {
+    ASSERT_TRUE(h9_setExprCurve(h9obj, kH9_EXPR_LOG, nullptr, 0));
+    EXPECT_NEAR(MappedKnobAt(0.0), 0.0, 0.0001);
+    EXPECT_NEAR(MappedKnobAt(0.5), log10(1.0 + 9.0 * 0.5), 0.001);
+    EXPECT_NEAR(MappedKnobAt(1.0), 1.0, 0.0001);
+}
+
+TEST_F(TEST_CLASS, h9_setExprCurve_exp_isBelowLinearMidway) {
+    ASSERT_TRUE(h9_setExprCurve(h9obj, kH9_EXPR_EXP, nullptr, 0));
+    EXPECT_NEAR(MappedKnobAt(0.5), (pow(10.0, 0.5) - 1.0) / 9.0, 0.001);
+}
+
+TEST_F(TEST_CLASS, h9_setExprCurve_scurve_isSymmetric) {
+    ASSERT_TRUE(h9_setExprCurve(h9obj, kH9_EXPR_SCURVE, nullptr, 0));
+    EXPECT_NEAR(MappedKnobAt(0.5), 0.5, 0.001);
+    EXPECT_NEAR(MappedKnobAt(0.25) + MappedKnobAt(0.75), 1.0, 0.001);
+    EXPECT_LT(MappedKnobAt(0.25), 0.25);
+}
+
+TEST_F(TEST_CLASS, h9_setExprCurve_custom_interpolatesBreakpoints) {
+    h9_expr_point points[] = {{0.0f, 1.0f}, {0.5f, 0.0f}, {1.0f, 1.0f}};  // V shape
+    ASSERT_TRUE(h9_setExprCurve(h9obj, kH9_EXPR_CUSTOM, points, 3));
+    EXPECT_NEAR(MappedKnobAt(0.0), 1.0, 0.001);
+    EXPECT_NEAR(MappedKnobAt(0.25), 0.5, 0.001);
+    EXPECT_NEAR(MappedKnobAt(0.5), 0.0, 0.001);
+    EXPECT_NEAR(MappedKnobAt(1.0), 1.0, 0.001);
+}
+
+TEST_F(TEST_CLASS, h9_setExprCurve_custom_withInvalidPoints_returnsFalse) {
+    h9_expr_point not_increasing[] = {{0.0f, 0.0f}, {0.5f, 0.5f}, {0.5f, 0.6f}, {1.0f, 1.0f}};
+    h9_expr_point not_spanning[]   = {{0.1f, 0.0f}, {1.0f, 1.0f}};
+    h9_expr_point out_of_range[]   = {{0.0f, 0.0f}, {1.0f, 1.5f}};
+    EXPECT_FALSE(h9_setExprCurve(h9obj, kH9_EXPR_CUSTOM, not_increasing, 4));
+    EXPECT_FALSE(h9_setExprCurve(h9obj, kH9_EXPR_CUSTOM, not_spanning, 2));
+    EXPECT_FALSE(h9_setExprCurve(h9obj, kH9_EXPR_CUSTOM, out_of_range, 2));
+    EXPECT_FALSE(h9_setExprCurve(h9obj, kH9_EXPR_CUSTOM, nullptr, 0));
+    EXPECT_EQ(h9_exprCurve(h9obj), kH9_EXPR_LINEAR);
+}
+
+TEST_F(TEST_CLASS, h9_setPedalCalibration_rescalesPedalTravel) {
+    uint16_t quarter = H9_PEDAL_CAL_FULL_SCALE / 4;
+    ASSERT_TRUE(h9_setPedalCalibration(h9obj, quarter, 3 * quarter));
+    EXPECT_NEAR(MappedKnobAt(0.1), 0.0, 0.001);  // below cal_min clips
+    EXPECT_NEAR(MappedKnobAt(0.5), 0.5, 0.001);
+    EXPECT_NEAR(MappedKnobAt(0.625), 0.75, 0.01);
+    EXPECT_NEAR(MappedKnobAt(0.9), 1.0, 0.001);  // above cal_max clips
+}
+
+TEST_F(TEST_CLASS, h9_setPedalCalibration_withInvalidRange_returnsFalse) {
+    EXPECT_FALSE(h9_setPedalCalibration(h9obj, 100, 100));
+    EXPECT_FALSE(h9_setPedalCalibration(h9obj, 200, 100));
+    EXPECT_FALSE(h9_setPedalCalibration(h9obj, 0, H9_PEDAL_CAL_FULL_SCALE + 1));
+}
+
+TEST_F(TEST_CLASS, h9_parse_sysex_withSysvars_appliesPedalCalibration) {
+    FILE *sysvar_dump_file = fopen("../test_data/Device_Config3.syx", "r");
+    ASSERT_NE(sysvar_dump_file, nullptr);
+    uint8_t sysex[1000];
+    size_t  len = fread(sysex, 1, sizeof(sysex), sysvar_dump_file);
+    fclose(sysvar_dump_file);
+    ASSERT_EQ(h9_parse_sysex(h9obj, sysex, len, kH9_RESPOND_TO_ANY_SYSEX_ID), kH9_OK);
+    EXPECT_EQ(h9obj->pedal_cal_min, 0x21);
+    EXPECT_EQ(h9obj->pedal_cal_max, 0x7fe6);
+    EXPECT_NEAR(MappedKnobAt(1.0), 1.0, 0.0001);
+}
+
+TEST_F(TEST_CLASS, h9_parse_sysex_withValueDumps_movesCalibrationUp_minFirst) {
+    ASSERT_TRUE(h9_setPedalCalibration(h9obj, 100, 200));
+    ASSERT_EQ(ValueDump(SP_PEDAL_CAL_MIN, 300), kH9_OK);
+    EXPECT_EQ(h9obj->pedal_cal_min, 100);  // 300..200 isn't a range yet
+    ASSERT_EQ(ValueDump(SP_PEDAL_CAL_MAX, 400), kH9_OK);
+    EXPECT_EQ(h9obj->pedal_cal_min, 300);
+    EXPECT_EQ(h9obj->pedal_cal_max, 400);
+}
+
+TEST_F(TEST_CLASS, h9_parse_sysex_withValueDumps_movesCalibrationDown_maxFirst) {
+    ASSERT_TRUE(h9_setPedalCalibration(h9obj, 300, 400));
+    ASSERT_EQ(ValueDump(SP_PEDAL_CAL_MAX, 200), kH9_OK);
+    EXPECT_EQ(h9obj->pedal_cal_max, 400);  // 300..200 isn't a range yet
+    ASSERT_EQ(ValueDump(SP_PEDAL_CAL_MIN, 100), kH9_OK);
+    EXPECT_EQ(h9obj->pedal_cal_min, 100);
+    EXPECT_EQ(h9obj->pedal_cal_max, 200);
+}
+
+TEST_F(TEST_CLASS, h9_parse_sysex_withValueDumps_movesCalibrationInEitherOrder) {
+    ASSERT_TRUE(h9_setPedalCalibration(h9obj, 100, 200));
+    ASSERT_EQ(ValueDump(SP_PEDAL_CAL_MAX, 400), kH9_OK);  // Up, max first
+    ASSERT_EQ(ValueDump(SP_PEDAL_CAL_MIN, 300), kH9_OK);
+    EXPECT_EQ(h9obj->pedal_cal_min, 300);
+    EXPECT_EQ(h9obj->pedal_cal_max, 400);
+    ASSERT_EQ(ValueDump(SP_PEDAL_CAL_MIN, 100), kH9_OK);  // Down, min first
+    ASSERT_EQ(ValueDump(SP_PEDAL_CAL_MAX, 200), kH9_OK);
+    EXPECT_EQ(h9obj->pedal_cal_min, 100);
+    EXPECT_EQ(h9obj->pedal_cal_max, 200);
+}
+
+}  // namespace h9_test
@@ -0,0 +1,100 @@
+/*  h9_fleet_test.cpp
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdint.h>
+#include "libh9.h"
+#include "test_helpers.hpp"
+
+#include "gtest/gtest.h"
+
+#define TEST_CLASS H9FleetTest
+#define FLEET_SIZE 100
+
+namespace h9_test {
+
+// Test Fixture
+class TEST_CLASS : public ::testing::Test {
+ protected:
+    void SetUp() override {
+        fleet = h9_fleet_new(FLEET_SIZE);
+        ASSERT_NE(fleet, nullptr);
+    }
+
+    void TearDown() override {
+        h9_fleet_delete(fleet);
+    }
+
+    h9_fleet *fleet;
+};
+
+TEST_F(TEST_CLASS, h9_fleet_new_initializesEveryInstance) {
+    EXPECT_EQ(h9_fleetSize(fleet), FLEET_SIZE);
+    for (size_t i = 0; i < FLEET_SIZE; i++) {
+        h9 *instance = h9_fleetInstance(fleet, i);
+        ASSERT_NE(instance, nullptr);
+        EXPECT_EQ((uintptr_t)instance % H9_CACHE_LINE, 0);
+        EXPECT_EQ((uintptr_t)instance->preset % H9_CACHE_LINE, 0);
+        EXPECT_STREQ(h9_presetName(instance, nullptr), "Empty");
+        EXPECT_EQ(instance->midi_config.sysex_id, 1);
+    }
+    EXPECT_EQ(h9_fleetInstance(fleet, FLEET_SIZE), nullptr);
+}
+
+TEST_F(TEST_CLASS, h9_fleet_new_isOneContiguousArena) {
+    h9_footprint footprint;
+    h9_fleetFootprint(fleet, &footprint);
+    uintptr_t first = (uintptr_t)h9_fleetInstance(fleet, 0);
+    uintptr_t last  = (uintptr_t)h9_fleetInstance(fleet, FLEET_SIZE - 1);
+    EXPECT_EQ(last - first, (FLEET_SIZE - 1) * footprint.slot_bytes);
+    EXPECT_GE(footprint.slot_bytes, footprint.instance_bytes + footprint.preset_bytes);
+    EXPECT_EQ(footprint.slot_bytes % H9_CACHE_LINE, 0);
+    EXPECT_GE(footprint.arena_bytes, FLEET_SIZE * footprint.slot_bytes);
+}
+
+TEST_F(TEST_CLASS, h9_fleet_new_withNoInstances_returnsNull) {
+    EXPECT_EQ(h9_fleet_new(0), nullptr);
+}
+
+TEST_F(TEST_CLASS, h9_fleetApply_appliesEventsInOrder) {
+    h9_fleet_event events[] = {
+        {0, KNOB0, 0.1},
+        {99, KNOB9, 0.9},
+        {0, KNOB0, 0.2},  // later events win
+        {42, PSW, 1.0},
+        {100, KNOB0, 0.3},  // no such instance
+        {1, (control_id)NUM_CONTROLS, 0.3},  // no such control
+    };
+    EXPECT_EQ(h9_fleetApply(fleet, events, 6, kH9_SUPPRESS_CALLBACK), 4);
+    EXPECT_FLOAT_EQ(h9_controlValue(h9_fleetInstance(fleet, 0), KNOB0), 0.2);
+    EXPECT_FLOAT_EQ(h9_controlValue(h9_fleetInstance(fleet, 99), KNOB9), 0.9);
+    EXPECT_TRUE(h9_fleetInstance(fleet, 42)->preset->psw);
+    EXPECT_FALSE(h9_dirty(h9_fleetInstance(fleet, 1)));
+}
+
+TEST_F(TEST_CLASS, h9_fleetApply_triggersCallbacksPerInstance) {
+    init_callback_helpers();
+    h9 *instance          = h9_fleetInstance(fleet, 7);
+    instance->cc_callback = cc_callback;
+    h9_fleet_event event  = {7, KNOB2, 0.5};
+    EXPECT_EQ(h9_fleetApply(fleet, &event, 1, kH9_TRIGGER_CALLBACK), 1);
+    EXPECT_EQ(cc_callback_count(), 1);
+}
+
+}  // namespace h9_test
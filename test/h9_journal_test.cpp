@@ -0,0 +1,177 @@
+/*  h9_journal_test.cpp
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include "libh9.h"
+
+#include "gtest/gtest.h"
+
+#define TEST_CLASS H9JournalTest
+
+namespace h9_test {
+
+struct Outputs {
+    int ccs      = 0;
+    int displays = 0;
+    int sysex    = 0;
+};
+
+static void count_cc(void *ctx, uint8_t, uint8_t, uint8_t, uint8_t) {
+    static_cast<Outputs *>(ctx)->ccs++;
+}
+
+static void count_display(void *ctx, control_id, control_value, control_value) {
+    static_cast<Outputs *>(ctx)->displays++;
+}
+
+static void count_sysex(void *ctx, uint8_t *, size_t) {
+    static_cast<Outputs *>(ctx)->sysex++;
+}
+
+// Test Fixture
+class TEST_CLASS : public ::testing::Test {
+ protected:
+    void SetUp() override {
+        // ctest runs each test in its own process, possibly at the same time
+        path  = testing::TempDir() + "h9_journal_test_" + testing::UnitTest::GetInstance()->current_test_info()->name() + ".h9j";
+        h9obj = h9_new();
+        h9obj->cc_callback      = count_cc;
+        h9obj->display_callback = count_display;
+        h9obj->sysex_callback   = count_sysex;
+        h9obj->callback_context = &outputs;
+    }
+
+    void TearDown() override {
+        h9_delete(h9obj);
+        remove(path.c_str());
+    }
+
+    // A bit of everything: CCs (a 14-bit pair), a preset, controls with CCs out, a batch and a spontaneous request
+    void record_session() {
+        h9 *other = h9_new();
+        h9_setControl(other, KNOB2, 0.125, kH9_SUPPRESS_CALLBACK);
+        uint8_t program[1000];
+        size_t  program_len = h9_dump(other, program, sizeof(program), false);
+        h9_delete(other);
+
+        h9_journal *journal = h9_journalStart(h9obj, path.c_str());
+        ASSERT_NE(journal, nullptr);
+        EXPECT_EQ(h9_journalStart(h9obj, path.c_str()), nullptr);  // Already recording
+        uint8_t knob5_cc = h9obj->midi_config.cc_tx_map[KNOB5];
+        h9_cc(h9obj, knob5_cc, 42);
+        h9_ccAt(h9obj, knob5_cc, 100, 1000.0);
+        h9_ccAt(h9obj, knob5_cc + 32, 7, 1001.0);
+        h9_parse_sysex(h9obj, program, program_len, kH9_RESTRICT_TO_SYSEX_ID);
+        h9_setControl(h9obj, KNOB1, 0.75, kH9_TRIGGER_CALLBACK);
+        h9_control_update updates[] = {{KNOB3, 0.2}, {KNOB4, 0.9}, {EXPR, 0.6}};
+        h9_setControls(h9obj, updates, 3, kH9_TRIGGER_CALLBACK);
+        h9_sysexRequestCurrentPreset(h9obj);
+        records = h9_journalRecords(journal);
+        ASSERT_TRUE(h9_journalStop(journal));
+    }
+
+    std::string path;
+    h9 *        h9obj;
+    Outputs     outputs;
+    uint64_t    records = 0;
+};
+
+TEST_F(TEST_CLASS, h9_journalReplay_reproducesTheRecordedOutputs) {
+    record_session();
+    EXPECT_GT(records, 0);
+    int recorded_outputs = outputs.ccs + outputs.displays + outputs.sysex;
+
+    h9 *             replayed = h9_new();
+    Outputs          untouched;
+    h9_replay_result result;
+    replayed->cc_callback      = count_cc;
+    replayed->callback_context = &untouched;
+    ASSERT_TRUE(h9_journalReplay(path.c_str(), replayed, kH9_REPLAY_FAST, &result));
+    EXPECT_EQ(result.mismatches, 0) << "first at record " << result.first_mismatch;
+    EXPECT_EQ(result.inputs, 10);  // 3 CCs, a sysex, a control, then begin, 3 controls and commit
+    EXPECT_EQ(result.outputs, recorded_outputs - 1);  // All but the spontaneous request
+    for (size_t i = 0; i < NUM_CONTROLS; i++) {
+        EXPECT_EQ(h9_controlValue(replayed, (control_id)i), h9_controlValue(h9obj, (control_id)i)) << "control " << i;
+        EXPECT_EQ(h9_displayValue(replayed, (control_id)i), h9_displayValue(h9obj, (control_id)i)) << "control " << i;
+    }
+    EXPECT_EQ(untouched.ccs, 0);  // The caller's callbacks are put back, not called
+    EXPECT_EQ(replayed->cc_callback, count_cc);
+    EXPECT_EQ(replayed->callback_context, &untouched);
+    h9_delete(replayed);
+}
+
+TEST_F(TEST_CLASS, h9_journalReplay_reportsDivergentOutputs) {
+    record_session();
+    h9_journal *journal = h9_journalStart(h9obj, path.c_str());
+    ASSERT_NE(journal, nullptr);
+    h9_setControl(h9obj, KNOB1, 0.25, kH9_TRIGGER_CALLBACK);  // The last record is the CC this sends
+    ASSERT_TRUE(h9_journalStop(journal));
+
+    FILE *file = fopen(path.c_str(), "r+b");
+    ASSERT_NE(file, nullptr);
+    ASSERT_EQ(fseek(file, -1, SEEK_END), 0);
+    int lsb = fgetc(file);
+    ASSERT_EQ(fseek(file, -1, SEEK_END), 0);
+    fputc(lsb ^ 0x01, file);
+    fclose(file);
+
+    h9 *             replayed = h9_new();
+    h9_replay_result result;
+    ASSERT_TRUE(h9_journalReplay(path.c_str(), replayed, kH9_REPLAY_FAST, &result));
+    EXPECT_GT(result.mismatches, 0);
+    EXPECT_EQ(result.first_mismatch, 2);  // Input, display, then the altered CC
+    h9_delete(replayed);
+}
+
+TEST_F(TEST_CLASS, h9_journalReplay_realtimeKeepsTheRecordedPace) {
+    h9_journal *journal = h9_journalStart(h9obj, path.c_str());
+    ASSERT_NE(journal, nullptr);
+    h9_setControl(h9obj, KNOB1, 0.25, kH9_SUPPRESS_CALLBACK);
+    struct timespec pause = {0, 30 * 1000 * 1000};
+    nanosleep(&pause, NULL);
+    h9_setControl(h9obj, KNOB1, 0.75, kH9_SUPPRESS_CALLBACK);
+    ASSERT_TRUE(h9_journalStop(journal));
+
+    h9 *             replayed = h9_new();
+    h9_replay_result result;
+    ASSERT_TRUE(h9_journalReplay(path.c_str(), replayed, kH9_REPLAY_REALTIME, &result));
+    EXPECT_EQ(result.mismatches, 0);
+    EXPECT_GE(result.seconds, 0.025);
+    ASSERT_TRUE(h9_journalReplay(path.c_str(), replayed, kH9_REPLAY_FAST, &result));
+    EXPECT_LT(result.seconds, 0.025);
+    h9_delete(replayed);
+}
+
+TEST_F(TEST_CLASS, h9_journalReplay_rejectsOtherFiles) {
+    h9_replay_result result;
+    EXPECT_FALSE(h9_journalReplay(path.c_str(), h9obj, kH9_REPLAY_FAST, &result));  // Missing
+    FILE *file = fopen(path.c_str(), "wb");
+    ASSERT_NE(file, nullptr);
+    std::vector<uint8_t> garbage(256, 0x5a);
+    fwrite(garbage.data(), 1, garbage.size(), file);
+    fclose(file);
+    EXPECT_FALSE(h9_journalReplay(path.c_str(), h9obj, kH9_REPLAY_FAST, &result));
+}
+
+}  // namespace h9_test
@@ -0,0 +1,150 @@
+/*  h9_latency_test.cpp
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include "libh9.h"
+#include "test_helpers.hpp"
+
+#include "gtest/gtest.h"
+
+#define TEST_CLASS H9LatencyTest
+
+namespace h9_test {
+
+// Test Fixture
+class TEST_CLASS : public ::testing::Test {
+ protected:
+    void SetUp() override {
+#ifndef H9_LATENCY
+        GTEST_SKIP() << "Built without H9_LATENCY";
+#endif
+        init_callback_helpers();
+        h9obj                   = h9_new();
+        h9obj->cc_callback      = cc_callback;
+        h9obj->display_callback = display_callback;
+    }
+
+    void TearDown() override {
+        h9_delete(h9obj);
+    }
+
+    uint64_t Count(h9_latency_path path) {
+        h9_latency_histogram histogram;
+        EXPECT_TRUE(h9_latencySnapshot(h9obj, path, &histogram));
+        return histogram.total;
+    }
+
+    h9 *h9obj = nullptr;
+};
+
+TEST_F(TEST_CLASS, h9_new_startsEmpty) {
+    for (int path = 0; path < kH9_NUM_LATENCY_PATHS; path++) {
+        EXPECT_EQ(Count(static_cast<h9_latency_path>(path)), 0);
+    }
+}
+
+TEST_F(TEST_CLASS, cc_timesToTheFirstDisplayCallback) {
+    h9_cc(h9obj, h9obj->midi_config.cc_tx_map[KNOB2], 64);
+    h9_cc(h9obj, h9obj->midi_config.cc_tx_map[KNOB3], 32);
+    EXPECT_EQ(Count(kH9_LATENCY_CC_TO_DISPLAY), 2);
+    EXPECT_EQ(Count(kH9_LATENCY_CONTROL_TO_CC), 0);
+}
+
+TEST_F(TEST_CLASS, cc_unmapped_abandonsTiming) {
+    h9_cc(h9obj, 0x7F, 64);
+    EXPECT_EQ(Count(kH9_LATENCY_CC_TO_DISPLAY), 0);
+
+    // A later display callback from elsewhere is not attributed to it
+    h9_beginUpdate(h9obj);
+    h9_setControl(h9obj, KNOB0, 0.5f, kH9_SUPPRESS_CALLBACK);
+    h9_commitUpdate(h9obj);
+    EXPECT_EQ(Count(kH9_LATENCY_CC_TO_DISPLAY), 0);
+}
+
+TEST_F(TEST_CLASS, parseSysex_timesToTheFirstDisplayCallback) {
+    uint8_t sysex[1000];
+    size_t  len = h9_dump(h9obj, sysex, sizeof(sysex), false);
+    ASSERT_EQ(h9_parse_sysex(h9obj, sysex, len, kH9_RESTRICT_TO_SYSEX_ID), kH9_OK);
+    EXPECT_EQ(Count(kH9_LATENCY_SYSEX_TO_DISPLAY), 1);
+}
+
+TEST_F(TEST_CLASS, setControl_timesToTheCcCallback) {
+    h9_setControl(h9obj, KNOB1, 0.25f, kH9_TRIGGER_CALLBACK);
+    h9_setControl(h9obj, KNOB1, 0.75f, kH9_SUPPRESS_CALLBACK);
+    EXPECT_EQ(Count(kH9_LATENCY_CONTROL_TO_CC), 1);
+    EXPECT_EQ(Count(kH9_LATENCY_CC_TO_DISPLAY), 0);
+}
+
+TEST_F(TEST_CLASS, reset_clearsAllPaths) {
+    h9_cc(h9obj, h9obj->midi_config.cc_tx_map[KNOB2], 64);
+    h9_setControl(h9obj, KNOB1, 0.25f, kH9_TRIGGER_CALLBACK);
+    h9_latencyReset(h9obj);
+    EXPECT_EQ(Count(kH9_LATENCY_CC_TO_DISPLAY), 0);
+    EXPECT_EQ(Count(kH9_LATENCY_CONTROL_TO_CC), 0);
+}
+
+TEST_F(TEST_CLASS, snapshot_invalidPath_fails) {
+    h9_latency_histogram histogram;
+    EXPECT_FALSE(h9_latencySnapshot(h9obj, kH9_NUM_LATENCY_PATHS, &histogram));
+    EXPECT_EQ(histogram.total, 0);
+}
+
+TEST_F(TEST_CLASS, percentile_empty_isZero) {
+    h9_latency_histogram histogram;
+    memset(&histogram, 0x0, sizeof(histogram));
+    EXPECT_EQ(h9_latencyPercentile(&histogram, 99.0), 0.0);
+}
+
+TEST_F(TEST_CLASS, percentile_reportsBucketUpperBounds) {
+    h9_latency_histogram histogram;
+    memset(&histogram, 0x0, sizeof(histogram));
+    histogram.counts[1]   = 90;  // Exact: 1 tick
+    histogram.counts[10]  = 9;   // Exact: 10 ticks
+    histogram.counts[104] = 1;   // 768-799 ticks
+    histogram.total       = 100;
+    histogram.max_ticks   = 5000;
+
+    double tick = h9_latencyPercentile(&histogram, 0.0);
+    ASSERT_GT(tick, 0.0);
+    EXPECT_DOUBLE_EQ(h9_latencyPercentile(&histogram, 50.0), tick);
+    EXPECT_DOUBLE_EQ(h9_latencyPercentile(&histogram, 90.0), tick);
+    EXPECT_DOUBLE_EQ(h9_latencyPercentile(&histogram, 95.0), 10.0 * tick);
+    EXPECT_DOUBLE_EQ(h9_latencyPercentile(&histogram, 100.0), 799.0 * tick);
+
+    // Never above the largest sample
+    histogram.max_ticks = 790;
+    EXPECT_DOUBLE_EQ(h9_latencyPercentile(&histogram, 100.0), 790.0 * tick);
+}
+
+TEST_F(TEST_CLASS, percentile_recordedSamplesAreBelowMax) {
+    for (int i = 0; i < 100; i++) {
+        h9_cc(h9obj, h9obj->midi_config.cc_tx_map[KNOB2], (uint8_t)i);
+    }
+    h9_latency_histogram histogram;
+    ASSERT_TRUE(h9_latencySnapshot(h9obj, kH9_LATENCY_CC_TO_DISPLAY, &histogram));
+    EXPECT_EQ(histogram.total, 100);
+    double p50 = h9_latencyPercentile(&histogram, 50.0);
+    double p99 = h9_latencyPercentile(&histogram, 99.0);
+    EXPECT_GT(p50, 0.0);
+    EXPECT_LE(p50, p99);
+    EXPECT_LT(p99, 1000.0);  // Well inside the 1 ms budget
+}
+
+}  // namespace h9_test
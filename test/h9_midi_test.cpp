@@ -20,6 +20,7 @@
 
 #include <math.h>
 #include <string.h>
+#include <vector>
 #include "libh9.h"
 #include "test_helpers.hpp"
 #include "utils.h"
@@ -56,6 +57,7 @@ class TEST_CLASS : public ::testing::Test {
     void TearDown() override {
         // Code here will be called immediately after each test (right
         // before the destructor).
+        h9_delete(h9obj);
     }
 
     // Class members declared here can be used by all tests in the test suite
@@ -164,4 +166,79 @@ TEST_F(TEST_CLASS, h9_cc_withMappedCC_whenSending14bitCCLSB_afterMSB_afterTimeou
     }
 }
 
+
+TEST_F(TEST_CLASS, h9_ccAt_withLSBInsideTheWindow_updatesControl) {
+    uint8_t mapped_cc = h9obj->midi_config.cc_tx_map[KNOB5];
+    h9_ccAt(h9obj, mapped_cc, 42, 1000.0);
+    h9_ccAt(h9obj, mapped_cc + 32, 24, 1003.0);
+    EXPECT_NEAR(h9_controlValue(h9obj, KNOB5), (double)((42 << 7) + 24) / (double)((1 << 14) - 1), 0.00001);
+}
+
+TEST_F(TEST_CLASS, h9_ccAt_withLSBAfterTheWindow_keepsTheMSBValue) {
+    uint8_t mapped_cc = h9obj->midi_config.cc_tx_map[KNOB5];
+    h9_ccAt(h9obj, mapped_cc, 42, 1000.0);
+    h9_ccAt(h9obj, mapped_cc + 32, 24, 1004.0);
+    EXPECT_NEAR(h9_controlValue(h9obj, KNOB5), 42.0 / 127.0, 0.00001);
+}
+
+TEST_F(TEST_CLASS, h9_ccBatch_pairsByTheEventTimestamps) {
+    uint8_t     knob5 = h9obj->midi_config.cc_tx_map[KNOB5];
+    uint8_t     knob6 = h9obj->midi_config.cc_tx_map[KNOB6];
+    h9_cc_event events[] = {
+        {1000.0, knob5, 42},
+        {1003.0, (uint8_t)(knob5 + 32), 24},  // Inside the window
+        {2000.0, knob6, 42},
+        {2004.0, (uint8_t)(knob6 + 32), 24},  // Too late, however soon the batch is drained
+    };
+    h9_ccBatch(h9obj, events, sizeof(events) / sizeof(events[0]));
+    EXPECT_NEAR(h9_controlValue(h9obj, KNOB5), (double)((42 << 7) + 24) / (double)((1 << 14) - 1), 0.00001);
+    EXPECT_NEAR(h9_controlValue(h9obj, KNOB6), 42.0 / 127.0, 0.00001);
+}
+
+static int displays_counted;
+
+static void count_displays(void *, control_id, control_value, control_value) {
+    displays_counted++;
+}
+
+TEST_F(TEST_CLASS, h9_ccBatch_notifiesEachChangedControlOnce) {
+    uint8_t                  knob1 = h9obj->midi_config.cc_tx_map[KNOB1];
+    uint8_t                  knob2 = h9obj->midi_config.cc_tx_map[KNOB2];
+    std::vector<h9_cc_event> events;
+    for (size_t i = 0; i < 1000; i++) {
+        events.push_back({(double)i, (i % 2) ? knob1 : knob2, (uint8_t)(i & 0x7F)});
+    }
+    displays_counted        = 0;
+    h9obj->display_callback = count_displays;
+    h9_ccBatch(h9obj, events.data(), events.size());
+    EXPECT_EQ(displays_counted, 2);
+    EXPECT_NEAR(h9_controlValue(h9obj, KNOB1), (999 & 0x7F) / 127.0, 0.00001);
+    EXPECT_NEAR(h9_controlValue(h9obj, KNOB2), (998 & 0x7F) / 127.0, 0.00001);
+}
+
+static double fake_clock(void *ctx) {
+    return *static_cast<double *>(ctx);
+}
+
+TEST_F(TEST_CLASS, h9_setClock_timesSingleCCs) {
+    uint8_t mapped_cc = h9obj->midi_config.cc_tx_map[KNOB5];
+    double  now       = 1000.0;
+    h9_setClock(h9obj, fake_clock, &now);
+    h9_cc(h9obj, mapped_cc, 42);
+    now = 1003.0;
+    h9_cc(h9obj, mapped_cc + 32, 24);
+    EXPECT_NEAR(h9_controlValue(h9obj, KNOB5), (double)((42 << 7) + 24) / (double)((1 << 14) - 1), 0.00001);
+
+    now = 1010.0;
+    h9_cc(h9obj, mapped_cc, 42);
+    now = 1014.0;
+    h9_cc(h9obj, mapped_cc + 32, 24);
+    EXPECT_NEAR(h9_controlValue(h9obj, KNOB5), 42.0 / 127.0, 0.00001);
+
+    h9_setClock(h9obj, NULL, NULL);  // Back on the OS clock
+    h9_cc(h9obj, mapped_cc, 42);
+    h9_cc(h9obj, mapped_cc + 32, 24);
+    EXPECT_NEAR(h9_controlValue(h9obj, KNOB5), (double)((42 << 7) + 24) / (double)((1 << 14) - 1), 0.00001);
+}
+
 }  // namespace h9_test
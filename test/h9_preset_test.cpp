@@ -56,6 +56,7 @@ class TEST_CLASS : public ::testing::Test {
     void TearDown() override {
         // Code here will be called immediately after each test (right
         // before the destructor).
+        h9_delete(h9obj);
     }
 
     // Class members declared here can be used by all tests in the test suite
@@ -71,6 +72,23 @@ TEST_F(TEST_CLASS, h9_new_populates_default_preset) {
     EXPECT_STREQ(h9obj->preset->name, expected_name);
 }
 
+TEST_F(TEST_CLASS, h9_init_usesCallerStorage) {
+    h9        storage;
+    h9_preset preset_storage;
+    memset(&storage, 0xA5, sizeof(storage));  // garbage, as uninitialized storage would be
+    memset(&preset_storage, 0xA5, sizeof(preset_storage));
+    h9 *instance = h9_init(&storage, &preset_storage);
+    ASSERT_EQ(instance, &storage);
+    EXPECT_EQ(instance->preset, &preset_storage);
+    EXPECT_STREQ(instance->preset->name, EMPTY_PRESET_NAME);
+    EXPECT_STREQ(instance->name, "H9");
+    EXPECT_FALSE(instance->bypass);
+    EXPECT_EQ(instance->display_callback, nullptr);
+    EXPECT_FALSE(h9_dirty(instance));
+    EXPECT_EQ(h9_init(nullptr, &preset_storage), nullptr);
+    EXPECT_EQ(h9_init(&storage, nullptr), nullptr);
+}
+
 TEST_F(TEST_CLASS, h9_setControl_flagsPresetAsDirty) {
     EXPECT_FALSE(h9_dirty(h9obj));
     h9_setControl(h9obj, KNOB1, 0.5f, kH9_SUPPRESS_CALLBACK);
@@ -0,0 +1,159 @@
+/*  h9_shm_test.cpp
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <string>
+#include "libh9.h"
+
+#include "gtest/gtest.h"
+
+#define TEST_CLASS H9ShmTest
+#define PUBLISHES  20000
+
+namespace h9_test {
+
+// Test Fixture
+class TEST_CLASS : public ::testing::Test {
+ protected:
+    void SetUp() override {
+        name = "/h9_shm_test_" + std::to_string(getpid());
+        h9obj = h9_new();
+    }
+
+    void TearDown() override {
+        h9_delete(h9obj);
+        h9_shmUnlink(name.c_str());
+    }
+
+    std::string name;
+    h9 *        h9obj;
+};
+
+TEST_F(TEST_CLASS, h9_shmPublish_isSeenByAReader) {
+    h9_shm *writer = h9_shmCreate(name.c_str(), 2);
+    ASSERT_NE(writer, nullptr);
+    h9_shm *reader = h9_shmOpen(name.c_str());
+    ASSERT_NE(reader, nullptr);
+    EXPECT_EQ(h9_shmNumSlots(reader), 2);
+
+    h9_shm_state state;
+    ASSERT_TRUE(h9_shmRead(reader, 1, &state));
+    EXPECT_EQ(state.generation, 0);  // Never published
+
+    ASSERT_TRUE(h9_setAlgorithm(h9obj, 2, 1));
+    h9_setControl(h9obj, KNOB3, 0.25, kH9_SUPPRESS_CALLBACK);
+    h9_setControl(h9obj, PSW, 1.0, kH9_SUPPRESS_CALLBACK);
+    h9obj->midi_config.sysex_id = 7;
+    ASSERT_TRUE(h9_shmPublish(writer, 1, h9obj));
+    ASSERT_TRUE(h9_shmRead(reader, 1, &state));
+    EXPECT_EQ(state.generation, 1);
+    EXPECT_DOUBLE_EQ(state.current_values[KNOB3], 0.25);
+    EXPECT_DOUBLE_EQ(state.display_values[KNOB3], h9_displayValue(h9obj, KNOB3));
+    EXPECT_DOUBLE_EQ(state.current_values[PSW], 1.0);
+    EXPECT_EQ(state.module_sysex_id, h9obj->preset->module->sysex_id);
+    EXPECT_EQ(state.algorithm_id, 1);
+    EXPECT_STREQ(state.preset_name, h9obj->preset->name);
+    EXPECT_TRUE(state.dirty);
+    EXPECT_EQ(state.midi_config.sysex_id, 7);
+
+    ASSERT_TRUE(h9_shmRead(reader, 0, &state));
+    EXPECT_EQ(state.generation, 0);  // Slots are independent
+    EXPECT_FALSE(h9_shmPublish(reader, 0, h9obj));
+    EXPECT_FALSE(h9_shmPublish(writer, 2, h9obj));
+    EXPECT_FALSE(h9_shmRead(reader, 2, &state));
+    h9_shmClose(reader);
+    h9_shmClose(writer);
+}
+
+TEST_F(TEST_CLASS, h9_shmOpen_rejectsMissingOrForeignSegments) {
+    EXPECT_EQ(h9_shmOpen(name.c_str()), nullptr);
+    EXPECT_EQ(h9_shmCreate("", 1), nullptr);
+    EXPECT_EQ(h9_shmCreate(name.c_str(), 0), nullptr);
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(ftruncate(fd, 4096), 0);
+    void *garbage = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ASSERT_NE(garbage, MAP_FAILED);
+    memset(garbage, 0x5a, 4096);
+    munmap(garbage, 4096);
+    close(fd);
+    EXPECT_EQ(h9_shmOpen(name.c_str()), nullptr);
+    EXPECT_EQ(errno, EPROTO);
+}
+
+// Every publish from the writer process has all its values equal to its generation, so a torn read shows up as a mismatch
+TEST_F(TEST_CLASS, h9_shmRead_neverSeesATornPublishFromAnotherProcess) {
+    h9_shm *writer = h9_shmCreate(name.c_str(), 1);
+    ASSERT_NE(writer, nullptr);
+    fflush(NULL);
+    pid_t child = fork();
+    ASSERT_GE(child, 0);
+    if (child == 0) {
+        for (uint32_t i = 1; i <= PUBLISHES; i++) {
+            for (size_t knob = 0; knob < H9_NUM_KNOBS; knob++) {
+                h9obj->preset->knobs[knob].current_value = i;
+                h9obj->preset->knobs[knob].display_value = i;
+            }
+            snprintf(h9obj->preset->name, sizeof(h9obj->preset->name), "%u", i);
+            h9_shmPublish(writer, 0, h9obj);
+        }
+        _exit(0);
+    }
+
+    h9_shm *reader = h9_shmOpen(name.c_str());
+    ASSERT_NE(reader, nullptr);
+    h9_shm_state state;
+    uint64_t     last  = 0;
+    size_t       reads = 0;
+    size_t       torn  = 0;
+    while (last < PUBLISHES) {
+        if (!h9_shmRead(reader, 0, &state)) {
+            continue;
+        }
+        reads++;
+        ASSERT_GE(state.generation, last);
+        last = state.generation;
+        if (last == 0) {
+            continue;
+        }
+        char expected_name[H9_MAX_NAME_LEN];
+        snprintf(expected_name, sizeof(expected_name), "%u", (uint32_t)last);
+        bool consistent = strcmp(state.preset_name, expected_name) == 0;
+        for (size_t knob = 0; knob < H9_NUM_KNOBS; knob++) {
+            consistent &= state.current_values[knob] == (double)last && state.display_values[knob] == (double)last;
+        }
+        torn += consistent ? 0 : 1;
+    }
+    int status = 0;
+    ASSERT_EQ(waitpid(child, &status, 0), child);
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    EXPECT_EQ(torn, 0) << "of " << reads << " reads";
+    h9_shmClose(reader);
+    h9_shmClose(writer);
+}
+
+}  // namespace h9_test
@@ -0,0 +1,295 @@
+/*  h9_smf_test.cpp
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "libh9.h"
+
+#include "gtest/gtest.h"
+
+#define TEST_CLASS H9SmfTest
+
+namespace h9_test {
+
+// Builds a track chunk event by event
+class Track {
+ public:
+    Track &cc(uint32_t delta, uint8_t channel, uint8_t cc_num, uint8_t value) {
+        return event(delta, {(uint8_t)(0xB0 | channel), cc_num, value});
+    }
+    Track &runningStatus(uint32_t delta, uint8_t first, uint8_t second) {
+        return event(delta, {first, second});
+    }
+    Track &noteOn(uint32_t delta, uint8_t channel, uint8_t note) {
+        return event(delta, {(uint8_t)(0x90 | channel), note, 100});
+    }
+    Track &tempo(uint32_t delta, uint32_t us_per_quarter) {
+        return event(delta, {0xFF, 0x51, 0x03, (uint8_t)(us_per_quarter >> 16), (uint8_t)(us_per_quarter >> 8), (uint8_t)us_per_quarter});
+    }
+    Track &sysex(uint32_t delta, const uint8_t *message, size_t len) {  // message starts with F0
+        std::vector<uint8_t> bytes = {0xF0};
+        put_varint(bytes, (uint32_t)len - 1);
+        bytes.insert(bytes.end(), message + 1, message + len);
+        return event(delta, bytes);
+    }
+    Track &end(uint32_t delta = 0) {
+        return event(delta, {0xFF, 0x2F, 0x00});
+    }
+    Track &event(uint32_t delta, const std::vector<uint8_t> &bytes) {
+        put_varint(data, delta);
+        data.insert(data.end(), bytes.begin(), bytes.end());
+        return *this;
+    }
+
+    static void put_varint(std::vector<uint8_t> &dest, uint32_t value) {
+        uint8_t bytes[4];
+        size_t  len = 0;
+        do {
+            bytes[len++] = value & 0x7F;
+            value >>= 7;
+        } while (value);
+        while (len > 0) {
+            len--;
+            dest.push_back(bytes[len] | (len > 0 ? 0x80 : 0));
+        }
+    }
+
+    std::vector<uint8_t> data;
+};
+
+static void put_be(std::vector<uint8_t> &dest, uint32_t value, size_t len) {
+    for (size_t i = len; i > 0; i--) {
+        dest.push_back((uint8_t)(value >> (8 * (i - 1))));
+    }
+}
+
+static std::vector<uint8_t> smf(uint16_t format, uint16_t division, const std::vector<Track> &tracks) {
+    std::vector<uint8_t> file = {'M', 'T', 'h', 'd'};
+    put_be(file, 6, 4);
+    put_be(file, format, 2);
+    put_be(file, (uint32_t)tracks.size(), 2);
+    put_be(file, division, 2);
+    for (const Track &track : tracks) {
+        file.insert(file.end(), {'M', 'T', 'r', 'k'});
+        put_be(file, (uint32_t)track.data.size(), 4);
+        file.insert(file.end(), track.data.begin(), track.data.end());
+    }
+    return file;
+}
+
+static void record_display(void *ctx, control_id control, control_value, control_value) {
+    static_cast<std::vector<control_id> *>(ctx)->push_back(control);
+}
+
+// Test Fixture
+class TEST_CLASS : public ::testing::Test {
+ protected:
+    void SetUp() override {
+        h9obj = h9_new();
+        h9obj->display_callback = record_display;
+        h9obj->callback_context = &displayed;
+    }
+
+    void TearDown() override {
+        h9_delete(h9obj);
+    }
+
+    uint8_t cc(control_id control) {
+        return h9obj->midi_config.cc_tx_map[control];
+    }
+
+    h9 *                    h9obj;
+    std::vector<control_id> displayed;
+};
+
+TEST_F(TEST_CLASS, h9_smfPlay_format0_sendsCCsToTheMappedControls) {
+    Track track;
+    track.cc(0, 0, cc(KNOB1), 127).runningStatus(480, cc(KNOB2), 0).noteOn(0, 0, 60).cc(480, 15, 3, 1).end();
+    std::vector<uint8_t> file = smf(0, 480, {track});
+    h9_smf *             smf  = h9_smfOpenBuffer(file.data(), file.size());
+    ASSERT_NE(smf, nullptr);
+    EXPECT_EQ(h9_smfFormat(smf), 0);
+    EXPECT_EQ(h9_smfNumTracks(smf), 1);
+    EXPECT_EQ(h9_smfNumEvents(smf), 5);
+
+    h9_smf_result result;
+    h9_smfPlay(smf, h9obj, kH9_SMF_FAST, &result);
+    EXPECT_EQ(result.ccs, 3);  // Any channel, mapped or not
+    EXPECT_EQ(result.sysex, 0);
+    EXPECT_EQ(result.skipped, 1);               // The note
+    EXPECT_DOUBLE_EQ(result.song_seconds, 1.0);  // Two quarter notes at the default 120 bpm
+    EXPECT_DOUBLE_EQ(h9_controlValue(h9obj, KNOB1), 1.0);
+    EXPECT_DOUBLE_EQ(h9_controlValue(h9obj, KNOB2), 0.0);
+    h9_smfClose(smf);
+}
+
+TEST_F(TEST_CLASS, h9_smfPlay_format1_mergesTracksInTimeOrder) {
+    Track conductor, first, second;
+    conductor.tempo(0, 250000).end(960);
+    first.cc(100, 0, cc(KNOB1), 10).cc(200, 0, cc(KNOB3), 30).end();   // Ticks 100, 300
+    second.cc(50, 0, cc(KNOB2), 20).cc(200, 0, cc(KNOB4), 40).end();  // Ticks 50, 250
+    std::vector<uint8_t> file = smf(1, 480, {conductor, first, second});
+    h9_smf *             smf  = h9_smfOpenBuffer(file.data(), file.size());
+    ASSERT_NE(smf, nullptr);
+    EXPECT_EQ(h9_smfNumTracks(smf), 3);
+
+    h9_smf_result result;
+    h9_smfPlay(smf, h9obj, kH9_SMF_FAST, &result);
+    EXPECT_EQ(result.ccs, 4);
+    EXPECT_EQ(displayed, (std::vector<control_id>{KNOB2, KNOB1, KNOB4, KNOB3}));
+    EXPECT_DOUBLE_EQ(result.song_seconds, 0.5);  // The conductor's end of track, two quarter notes at 240 bpm
+    h9_smfClose(smf);
+}
+
+TEST_F(TEST_CLASS, h9_smfPlay_timestampsFollowTheTempoMap) {
+    // At 480 ticks per quarter, an LSB 3 ticks after its MSB is 3.1 ms later at 120 bpm (paired), 6.3 ms at 60 (dropped)
+    Track track;
+    track.cc(0, 0, cc(KNOB5), 64).cc(3, 0, cc(KNOB5) + 32, 64);
+    track.tempo(480, 1000000).cc(0, 0, cc(KNOB6), 64).cc(3, 0, cc(KNOB6) + 32, 64).end();
+    std::vector<uint8_t> file = smf(0, 480, {track});
+    h9_smf *             smf  = h9_smfOpenBuffer(file.data(), file.size());
+    ASSERT_NE(smf, nullptr);
+
+    h9_smf_result result;
+    h9_smfPlay(smf, h9obj, kH9_SMF_FAST, &result);
+    EXPECT_NEAR(h9_controlValue(h9obj, KNOB5), (double)((64 << 7) + 64) / (double)((1 << 14) - 1), 0.00001);
+    EXPECT_NEAR(h9_controlValue(h9obj, KNOB6), 64.0 / 127.0, 0.00001);
+    EXPECT_NEAR(result.song_seconds, 483.0 / 960.0 + 3.0 / 480.0, 1.0E-9);  // The tempo changes at tick 483
+    EXPECT_LT(result.seconds, 0.5);
+
+    h9_smfPlay(smf, h9obj, kH9_SMF_REALTIME, &result);  // Plays again from the start
+    EXPECT_EQ(result.ccs, 4);
+    EXPECT_GE(result.seconds, 0.5);
+    h9_smfClose(smf);
+}
+
+TEST_F(TEST_CLASS, h9_smfPlay_sendsEmbeddedSysexToTheParser) {
+    h9 *other = h9_new();
+    h9_setControl(other, KNOB2, 0.125, kH9_SUPPRESS_CALLBACK);
+    uint8_t program[1000];
+    size_t  program_len = h9_dump(other, program, sizeof(program), false);
+    h9_delete(other);
+
+    Track track;
+    track.sysex(0, program, program_len).event(10, {0xF7, 0x01, 0xFE}).end();
+    std::vector<uint8_t> file = smf(0, 96, {track});
+    h9_smf *             smf  = h9_smfOpenBuffer(file.data(), file.size());
+    ASSERT_NE(smf, nullptr);
+
+    h9_smf_result result;
+    h9_smfPlay(smf, h9obj, kH9_SMF_FAST, &result);
+    EXPECT_EQ(result.sysex, 1);
+    EXPECT_EQ(result.skipped, 1);  // The F7 escape
+    EXPECT_TRUE(h9_presetLoaded(h9obj));
+    EXPECT_NEAR(h9_controlValue(h9obj, KNOB2), 0.125, 0.001);
+    h9_smfClose(smf);
+}
+
+TEST_F(TEST_CLASS, h9_smfPlayFleet_routesCCsByChannelAndSysexById) {
+    h9_fleet *fleet = h9_fleet_new(4);
+    ASSERT_NE(fleet, nullptr);
+    for (size_t i = 0; i < 4; i++) {
+        h9_fleetInstance(fleet, i)->midi_config.midi_rx_channel = (uint8_t)(i % 2);
+        h9_fleetInstance(fleet, i)->midi_config.sysex_id        = (uint8_t)(i + 1);
+    }
+    h9 *source                   = h9_new();
+    source->midi_config.sysex_id = 3;  // Addressed to instance 2
+    uint8_t program[1000];
+    size_t  program_len = h9_dump(source, program, sizeof(program), false);
+    h9_delete(source);
+
+    Track track;
+    track.cc(0, 1, cc(KNOB1), 127).sysex(10, program, program_len).end();
+    std::vector<uint8_t> file = smf(0, 96, {track});
+    h9_smf *             smf  = h9_smfOpenBuffer(file.data(), file.size());
+    ASSERT_NE(smf, nullptr);
+
+    control_value knob1_before = h9_controlValue(h9_fleetInstance(fleet, 0), KNOB1);
+    h9_smf_result result;
+    ASSERT_TRUE(h9_smfPlayFleet(smf, fleet, kH9_SMF_FAST, &result));
+    EXPECT_EQ(result.ccs, 2);    // Instances 1 and 3 listen on channel 1
+    EXPECT_EQ(result.sysex, 4);  // Offered to all, taken by id 3 only
+    for (size_t i = 0; i < 4; i++) {
+        h9 *instance = h9_fleetInstance(fleet, i);
+        EXPECT_DOUBLE_EQ(h9_controlValue(instance, KNOB1), (i % 2 == 1) ? 1.0 : knob1_before) << "instance " << i;
+        EXPECT_EQ(h9_presetLoaded(instance), i == 2) << "instance " << i;
+    }
+    h9_smfClose(smf);
+    h9_fleet_delete(fleet);
+}
+
+TEST_F(TEST_CLASS, h9_smfOpen_mapsAFile) {
+    Track track;
+    track.cc(0, 0, cc(KNOB3), 127).end();
+    std::vector<uint8_t> file = smf(0, 96, {track});
+    std::string          path = testing::TempDir() + "h9_smf_test.mid";
+    FILE *               out  = fopen(path.c_str(), "wb");
+    ASSERT_NE(out, nullptr);
+    fwrite(file.data(), 1, file.size(), out);
+    fclose(out);
+
+    h9_smf *smf = h9_smfOpen(path.c_str());
+    remove(path.c_str());  // The mapping stays valid
+    ASSERT_NE(smf, nullptr);
+    h9_smf_result result;
+    h9_smfPlay(smf, h9obj, kH9_SMF_FAST, &result);
+    EXPECT_DOUBLE_EQ(h9_controlValue(h9obj, KNOB3), 1.0);
+    h9_smfClose(smf);
+
+    errno = 0;
+    EXPECT_EQ(h9_smfOpen(path.c_str()), nullptr);
+    EXPECT_EQ(errno, ENOENT);
+}
+
+TEST_F(TEST_CLASS, h9_smfOpenBuffer_rejectsMalformedFiles) {
+    Track good;
+    good.cc(0, 0, 1, 1).end();
+    Track no_status, truncated, bad_varint;
+    no_status.event(0, {0x01, 0x02});
+    truncated.event(0, {0xB0, 0x01});
+    bad_varint.cc(0, 0, 1, 1).event(0, {}).data.push_back(0x81);  // A delta time that never ends
+    std::vector<std::vector<uint8_t>> files = {
+        smf(2, 96, {good}),              // Format 2
+        smf(0, 96, {good, good}),        // Format 0 with two tracks
+        smf(1, 0, {good}),               // No ticks per quarter
+        smf(1, 0xE700, {good}),          // SMPTE with 25 fps but no ticks per frame
+        smf(0, 96, {no_status}),         // Running status with nothing to run
+        smf(0, 96, {truncated}),         // A CC missing its value
+        smf(0, 96, {bad_varint}),        // Truncated delta time
+        {'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0, 96},  // No track chunk
+        {'R', 'I', 'F', 'F'},
+    };
+    for (size_t i = 0; i < files.size(); i++) {
+        errno = 0;
+        EXPECT_EQ(h9_smfOpenBuffer(files[i].data(), files[i].size()), nullptr) << "file " << i;
+        EXPECT_EQ(errno, EINVAL) << "file " << i;
+    }
+
+    // Unknown chunks are skipped, and SMPTE timing doesn't depend on tempo
+    std::vector<uint8_t> file = smf(0, 0xE728, {good});  // 25 fps, 40 ticks per frame: 1 ms per tick
+    file.insert(file.begin() + 14, {'X', 'F', 'I', 'H', 0, 0, 0, 2, 0xAB, 0xCD});
+    h9_smf *smf = h9_smfOpenBuffer(file.data(), file.size());
+    ASSERT_NE(smf, nullptr);
+    h9_smfClose(smf);
+}
+
+}  // namespace h9_test
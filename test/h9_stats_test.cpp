@@ -0,0 +1,158 @@
+/*  h9_stats_test.cpp
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include <unistd.h>
+#include "libh9.h"
+#include "test_helpers.hpp"
+
+#include "gtest/gtest.h"
+
+#define TEST_CLASS H9StatsTest
+
+namespace h9_test {
+
+// Test Fixture
+class TEST_CLASS : public ::testing::Test {
+ protected:
+    void SetUp() override {
+#ifndef H9_STATS
+        GTEST_SKIP() << "Built without H9_STATS";
+#endif
+        init_callback_helpers();
+        h9obj                   = h9_new();
+        h9obj->cc_callback      = cc_callback;
+        h9obj->display_callback = display_callback;
+        h9obj->sysex_callback   = sysex_callback;
+    }
+
+    void TearDown() override {
+        h9_delete(h9obj);
+    }
+
+    h9_stats Snapshot(void) {
+        h9_stats stats;
+        EXPECT_TRUE(h9_statsSnapshot(h9obj, &stats));
+        return stats;
+    }
+
+    h9 *h9obj = nullptr;
+};
+
+TEST_F(TEST_CLASS, h9_new_startsAtZero) {
+    h9_stats stats = Snapshot();
+    h9_stats zero;
+    memset(&zero, 0x0, sizeof(zero));
+    EXPECT_EQ(memcmp(&stats, &zero, sizeof(stats)), 0);
+}
+
+TEST_F(TEST_CLASS, h9_parse_sysex_countsMessagesAndFailures) {
+    uint8_t value_dump[] = "\xf0\x1c\x70\x01\x2e"
+                           "102 1";
+    uint8_t garbage[]    = "\xf0\x1c\x70\x01\x2e"
+                           "zz";
+    uint8_t unsupported[] = "\xf0\x1c\x70\x01\x7f";
+    uint8_t not_h9[]      = "\xf0\x1d\x70\x01\x2e";
+    h9_parse_sysex(h9obj, value_dump, sizeof(value_dump), kH9_RESPOND_TO_ANY_SYSEX_ID);
+    h9_parse_sysex(h9obj, value_dump, sizeof(value_dump), kH9_RESPOND_TO_ANY_SYSEX_ID);
+    h9_parse_sysex(h9obj, garbage, sizeof(garbage), kH9_RESPOND_TO_ANY_SYSEX_ID);
+    h9_parse_sysex(h9obj, unsupported, sizeof(unsupported), kH9_RESPOND_TO_ANY_SYSEX_ID);
+    h9_parse_sysex(h9obj, not_h9, sizeof(not_h9), kH9_RESPOND_TO_ANY_SYSEX_ID);
+
+    h9_stats stats = Snapshot();
+    EXPECT_EQ(stats.sysex_parsed[kH9_STATS_VALUE_DUMP], 2);
+    EXPECT_EQ(stats.sysex_parsed[kH9_STATS_PROGRAM], 0);
+    EXPECT_EQ(stats.parse_failures[kH9_SYSEX_INVALID], 1);
+    EXPECT_EQ(stats.parse_failures[kH9_UNSUPPORTED_COMMAND], 1);
+    EXPECT_EQ(stats.parse_failures[kH9_SYSEX_PREAMBLE_INCORRECT], 1);
+    EXPECT_EQ(stats.parse_failures[kH9_OK], 0);
+}
+
+static h9_status return_garbage(void *ctx, uint8_t message_code, uint8_t *payload, size_t len) {
+    return (h9_status)0x7fffffff;
+}
+
+TEST_F(TEST_CLASS, h9_parse_sysex_withHandlerReturningNonStatus_countsUnknown) {
+    uint8_t error[] = "\xf0\x1c\x70\x01\x0d"
+                      "BAD KEY";
+    h9_sysexSetHandler(h9obj, kH9_ERROR, return_garbage, nullptr);
+    h9_parse_sysex(h9obj, error, sizeof(error) - 1, kH9_RESPOND_TO_ANY_SYSEX_ID);
+    EXPECT_EQ(Snapshot().parse_failures[kH9_UNKNOWN], 1);
+}
+
+TEST_F(TEST_CLASS, h9_cc_countsLsbPairingsAndDrops) {
+    uint8_t cc = h9obj->midi_config.cc_tx_map[KNOB2];
+    h9_cc(h9obj, cc, 42);
+    h9_cc(h9obj, cc + 32, 1);  // paired
+    h9_cc(h9obj, cc + 32, 1);  // no MSB before it
+    h9_cc(h9obj, cc, 42);
+    usleep(4000);
+    h9_cc(h9obj, cc + 32, 1);  // too late
+    h9_cc(h9obj, 127, 1);      // nothing mapped
+
+    h9_stats stats = Snapshot();
+    EXPECT_EQ(stats.cc_in, 6);
+    EXPECT_EQ(stats.lsb_paired, 1);
+    EXPECT_EQ(stats.lsb_unpaired, 1);
+    EXPECT_EQ(stats.lsb_timeouts, 1);
+    EXPECT_EQ(stats.cc_unmapped, 1);
+    EXPECT_EQ(stats.cc_out, 0);
+}
+
+TEST_F(TEST_CLASS, callbacksAndDumps_areCounted) {
+    h9_setControl(h9obj, KNOB0, 0.1, kH9_TRIGGER_CALLBACK);
+    h9_setControl(h9obj, KNOB1, 0.2, kH9_SUPPRESS_CALLBACK);
+    h9_sysexRequestCurrentPreset(h9obj);
+    uint8_t sysex[640];
+    size_t  len = h9_dump(h9obj, sysex, sizeof(sysex), false);
+
+    h9_stats stats = Snapshot();
+    EXPECT_EQ(stats.cc_out, 1);
+    EXPECT_EQ(stats.display_callbacks, 2);
+    EXPECT_EQ(stats.sysex_callbacks, 1);
+    EXPECT_EQ(stats.dumps, 1);
+    EXPECT_EQ(stats.bytes_dumped, len);
+}
+
+TEST_F(TEST_CLASS, transitions_withoutSysex_countNoDumps) {
+    h9_preset *target                  = h9_preset_clone(h9obj->preset);
+    target->knobs[KNOB2].current_value = 1.0;
+    h9_transition_plan plan;
+    EXPECT_EQ(h9_planTransition(h9obj, target, &plan), kH9_TRANSITION_CC);
+    EXPECT_GT(plan.sysex_bytes, 0);  // Measured, not dumped
+    EXPECT_EQ(Snapshot().dumps, 0);
+
+    EXPECT_EQ(h9_transitionTo(h9obj, target), kH9_TRANSITION_CC);
+    EXPECT_EQ(h9_transitionTo(h9obj, target), kH9_TRANSITION_NONE);
+    h9_stats stats = Snapshot();
+    EXPECT_EQ(stats.dumps, 0);
+    EXPECT_EQ(stats.bytes_dumped, 0);
+    h9_preset_delete(target);
+}
+
+TEST_F(TEST_CLASS, h9_statsReset_zeroesCounters) {
+    h9_setControl(h9obj, KNOB0, 0.1, kH9_TRIGGER_CALLBACK);
+    h9_statsReset(h9obj);
+    h9_stats stats = Snapshot();
+    EXPECT_EQ(stats.cc_out, 0);
+    EXPECT_EQ(stats.display_callbacks, 0);
+}
+
+}  // namespace h9_test
@@ -67,6 +67,7 @@ class TEST_CLASS : public ::testing::Test {
     void TearDown() override {
         // Code here will be called immediately after each test (right
         // before the destructor).
+        h9_delete(h9obj);
     }
 
     void LoadPatch(h9 *h9obj, char *sysex) {
@@ -137,7 +138,7 @@ TEST_F(TEST_CLASS, h9_dump_writes_expr) {
     bytes_written         = h9_dump(h9obj, output, buf_len, true);
     size_t position       = 65;  // TODO: make this less brittle by re-parsing
 
-    char found_string[5];
+    char found_string[5] = {0};
     strncpy(found_string, reinterpret_cast<char *>(&output[position]), 4);
     EXPECT_STREQ(found_string, expected_str);
 }
@@ -199,7 +200,7 @@ TEST_F(TEST_CLASS, h9_load_parses_system_variable_dump) {
     ASSERT_NE(sysvar_dump_file, nullptr);
     uint8_t buffer[1000];
     size_t  buffer_len;
-    buffer_len = fread(buffer, 1000, 1, sysvar_dump_file);
+    buffer_len = fread(buffer, 1, sizeof(buffer), sysvar_dump_file);
 
     // Fill h9obj with dummy values so we can be sure they were loaded from the file
     h9obj->bypass                          = true;
@@ -242,6 +243,172 @@ TEST_F(TEST_CLASS, h9_load_parses_system_variable_dump) {
     EXPECT_STREQ(h9obj->bluetooth_pin, "1723");
 }
 
+TEST_F(TEST_CLASS, h9_load_parses_single_system_value) {
+    uint8_t sysex_id_dump[] = "\xf0\x1c\x70\x01\x2e"
+                              "204 3";  // sp_sysex_id = 3
+    ASSERT_EQ(h9_parse_sysex(h9obj, sysex_id_dump, sizeof(sysex_id_dump), kH9_RESPOND_TO_ANY_SYSEX_ID), kH9_OK);
+    EXPECT_EQ(h9obj->midi_config.sysex_id, 3);
+
+    uint8_t bypass_dump[] = "\xf0\x1c\x70\x01\x2e"
+                            "102 1";  // sp_bypass = 1
+    h9obj->bypass         = false;
+    ASSERT_EQ(h9_parse_sysex(h9obj, bypass_dump, sizeof(bypass_dump), kH9_RESPOND_TO_ANY_SYSEX_ID), kH9_OK);
+    EXPECT_TRUE(h9obj->bypass);
+
+    uint8_t garbage_dump[] = "\xf0\x1c\x70\x01\x2e"
+                             "zz";
+    EXPECT_EQ(h9_parse_sysex(h9obj, garbage_dump, sizeof(garbage_dump), kH9_RESPOND_TO_ANY_SYSEX_ID), kH9_SYSEX_INVALID);
+}
+
+TEST_F(TEST_CLASS, h9_sysexGen_requests_are_formatted) {
+    uint8_t buffer[16];
+    h9obj->midi_config.sysex_id = 2;
+
+    uint8_t current_preset[] = {0xf0, 0x1c, 0x70, 0x02, 0x4e, 0xf7};
+    ASSERT_EQ(h9_sysexGenRequestCurrentPreset(h9obj, buffer, sizeof(buffer)), sizeof(current_preset));
+    EXPECT_EQ(memcmp(buffer, current_preset, sizeof(current_preset)), 0);
+
+    uint8_t write_var[] = {0xf0, 0x1c, 0x70, 0x02, 0x2d, '2', '0', '4', ' ', '1', 'f', 0x00, 0xf7};
+    ASSERT_EQ(h9_sysexGenWriteConfigVar(h9obj, 0x204, 0x1f, buffer, sizeof(buffer)), sizeof(write_var));
+    EXPECT_EQ(memcmp(buffer, write_var, sizeof(write_var)), 0);
+
+    // Too small: reports the space needed, like snprintf
+    EXPECT_EQ(h9_sysexGenWriteConfigVar(h9obj, 0x204, 0x1f, buffer, 4), sizeof(write_var));
+}
+
+TEST_F(TEST_CLASS, h9_sysexGen_requests_coverEverySysexId) {
+    uint8_t buffer[H9_SYSEX_REQUEST_MAX_LEN];
+    for (uint8_t id = 0; id <= 20; id++) {
+        h9obj->midi_config.sysex_id = id;
+        uint8_t current_preset[]    = {0xf0, 0x1c, 0x70, id, 0x4e, 0xf7};
+        uint8_t system_config[]     = {0xf0, 0x1c, 0x70, id, 0x4c, 0xf7};
+        ASSERT_EQ(h9_sysexGenRequestCurrentPreset(h9obj, buffer, sizeof(buffer)), sizeof(current_preset));
+        EXPECT_EQ(memcmp(buffer, current_preset, sizeof(current_preset)), 0) << "sysex id " << (int)id;
+        ASSERT_EQ(h9_sysexGenRequestSystemConfig(h9obj, buffer, sizeof(buffer)), sizeof(system_config));
+        EXPECT_EQ(memcmp(buffer, system_config, sizeof(system_config)), 0) << "sysex id " << (int)id;
+    }
+
+    // Truncated like the text writer: what fits before a terminating null
+    h9obj->midi_config.sysex_id = 3;
+    EXPECT_EQ(h9_sysexGenRequestCurrentPreset(h9obj, buffer, 4), 6);
+    EXPECT_EQ(memcmp(buffer, "\xf0\x1c\x70\x00", 4), 0);
+}
+
+TEST_F(TEST_CLASS, h9_sysexGen_configVars_emitHex) {
+    uint8_t buffer[H9_SYSEX_REQUEST_MAX_LEN];
+    uint8_t request_zero[] = {0xf0, 0x1c, 0x70, 0x01, 0x3b, '0', 0x00, 0xf7};
+    ASSERT_EQ(h9_sysexGenRequestConfigVar(h9obj, 0, buffer, sizeof(buffer)), sizeof(request_zero));
+    EXPECT_EQ(memcmp(buffer, request_zero, sizeof(request_zero)), 0);
+
+    uint8_t write_max[] = {0xf0, 0x1c, 0x70, 0x01, 0x2d, 'f', 'f', 'f', 'f', ' ', 'a', 'b', 'c', 'd', 0x00, 0xf7};
+    ASSERT_EQ(h9_sysexGenWriteConfigVar(h9obj, 0xffff, 0xabcd, buffer, sizeof(buffer)), sizeof(write_max));
+    EXPECT_EQ(memcmp(buffer, write_max, sizeof(write_max)), 0);
+}
+
+TEST_F(TEST_CLASS, h9_sysexWriteConfigVar_sendsTheLongestMessage) {
+    h9obj->sysex_callback = sysex_callback;
+    h9_sysexWriteConfigVar(h9obj, 0xffff, 0xffff);
+    uint8_t *sysex = nullptr;
+    size_t   len   = 0;
+    ASSERT_TRUE(sysex_callback_triggered(&sysex, &len));
+    EXPECT_EQ(len, 16);  // The buffer itself was on the stack, see h9_sysexGen_configVars_emitHex for the content
+}
+
+TEST_F(TEST_CLASS, h9_parse_sysex_restrict_rejectsOtherPedalsMessages) {
+    uint8_t for_pedal_2[] = "\xf0\x1c\x70\x02\x2e"
+                            "102 1";
+    uint8_t broadcast[]   = "\xf0\x1c\x70\x00\x2e"
+                            "102 1";
+    h9obj->bypass         = false;
+    EXPECT_EQ(h9_parse_sysex(h9obj, for_pedal_2, sizeof(for_pedal_2), kH9_RESTRICT_TO_SYSEX_ID), kH9_SYSEX_ID_MISMATCH);
+    EXPECT_FALSE(h9obj->bypass);
+
+    // Unless it's broadcast, or restriction is off, or this h9 has no id
+    EXPECT_EQ(h9_parse_sysex(h9obj, broadcast, sizeof(broadcast), kH9_RESTRICT_TO_SYSEX_ID), kH9_OK);
+    EXPECT_TRUE(h9obj->bypass);
+    h9obj->bypass = false;
+    EXPECT_EQ(h9_parse_sysex(h9obj, for_pedal_2, sizeof(for_pedal_2), kH9_RESPOND_TO_ANY_SYSEX_ID), kH9_OK);
+    EXPECT_TRUE(h9obj->bypass);
+    h9obj->bypass               = false;
+    h9obj->midi_config.sysex_id = 0;
+    EXPECT_EQ(h9_parse_sysex(h9obj, for_pedal_2, sizeof(for_pedal_2), kH9_RESTRICT_TO_SYSEX_ID), kH9_OK);
+    EXPECT_TRUE(h9obj->bypass);
+}
+
+struct RoutedMessage {
+    int     calls = 0;
+    uint8_t message_code;
+    char    text[32];
+};
+
+static h9_status record_message(void *ctx, uint8_t message_code, uint8_t *payload, size_t len) {
+    RoutedMessage *routed = static_cast<RoutedMessage *>(ctx);
+    routed->calls++;
+    routed->message_code = message_code;
+    snprintf(routed->text, sizeof(routed->text), "%.*s", (int)len, (const char *)payload);
+    return kH9_OK;
+}
+
+TEST_F(TEST_CLASS, h9_sysexSetHandler_routesUnparsedCodes) {
+    RoutedMessage routed;
+    uint8_t       error[] = "\xf0\x1c\x70\x01\x0d"
+                            "BAD KEY";
+    EXPECT_EQ(h9_parse_sysex(h9obj, error, sizeof(error) - 1, kH9_RESTRICT_TO_SYSEX_ID), kH9_UNSUPPORTED_COMMAND);
+
+    ASSERT_TRUE(h9_sysexSetHandler(h9obj, kH9_ERROR, record_message, &routed));
+    EXPECT_EQ(h9_parse_sysex(h9obj, error, sizeof(error) - 1, kH9_RESTRICT_TO_SYSEX_ID), kH9_OK);
+    EXPECT_EQ(routed.calls, 1);
+    EXPECT_EQ(routed.message_code, kH9_ERROR);
+    EXPECT_STREQ(routed.text, "BAD KEY");
+
+    ASSERT_TRUE(h9_sysexSetHandler(h9obj, kH9_ERROR, NULL, NULL));
+    EXPECT_EQ(h9_parse_sysex(h9obj, error, sizeof(error) - 1, kH9_RESTRICT_TO_SYSEX_ID), kH9_UNSUPPORTED_COMMAND);
+    EXPECT_EQ(routed.calls, 1);
+    EXPECT_FALSE(h9_sysexSetHandler(h9obj, (h9_message_code)0x7f, record_message, &routed));
+}
+
+TEST_F(TEST_CLASS, h9_sysexSetHandler_runsAfterBuiltInParsing) {
+    RoutedMessage routed;
+    ASSERT_TRUE(h9_sysexSetHandler(h9obj, kH9_PROGRAM, record_message, &routed));
+    ASSERT_EQ(h9_parse_sysex(h9obj, (uint8_t *)sysex_hrmdlo, sizeof(sysex_hrmdlo) - 1, kH9_RESTRICT_TO_SYSEX_ID), kH9_OK);
+    EXPECT_EQ(routed.calls, 1);
+    EXPECT_EQ(routed.message_code, kH9_PROGRAM);
+    EXPECT_STREQ(h9obj->preset->name, "HRMDLO");
+
+    // A payload the parser rejects never reaches the handler
+    uint8_t bad_program[] = "\xf0\x1c\x70\x01\x4f"
+                            "[1] 8 5 5\r\n";
+    EXPECT_NE(h9_parse_sysex(h9obj, bad_program, sizeof(bad_program) - 1, kH9_RESTRICT_TO_SYSEX_ID), kH9_OK);
+    EXPECT_EQ(routed.calls, 1);
+}
+
+static h9_status return_garbage(void *ctx, uint8_t message_code, uint8_t *payload, size_t len) {
+    return (h9_status)0x7fffffff;
+}
+
+TEST_F(TEST_CLASS, h9_sysexSetHandler_withInvalidStatus_reportsUnknown) {
+    uint8_t error[] = "\xf0\x1c\x70\x01\x0d"
+                      "BAD KEY";
+    ASSERT_TRUE(h9_sysexSetHandler(h9obj, kH9_ERROR, return_garbage, NULL));
+    EXPECT_EQ(h9_parse_sysex(h9obj, error, sizeof(error) - 1, kH9_RESTRICT_TO_SYSEX_ID), kH9_UNKNOWN);
+}
+
+TEST_F(TEST_CLASS, h9_sysexClassify_readsOnlyTheHeader) {
+    uint8_t dest_id      = 0;
+    uint8_t message_code = 0;
+    uint8_t sysvars[]    = {0xf0, 0x1c, 0x70, 0x05, 0x4d};
+    ASSERT_TRUE(h9_sysexClassify(sysvars, sizeof(sysvars), &dest_id, &message_code));
+    EXPECT_EQ(dest_id, 5);
+    EXPECT_EQ(message_code, kH9_TJ_SYSVARS_DUMP);
+    EXPECT_TRUE(h9_isSystemConfig(h9obj, sysvars, sizeof(sysvars)));
+    EXPECT_TRUE(h9_sysexClassify(sysvars + 1, sizeof(sysvars) - 1, NULL, NULL));
+
+    uint8_t other_maker[] = {0xf0, 0x41, 0x10, 0x01, 0x4d};
+    EXPECT_FALSE(h9_sysexClassify(other_maker, sizeof(other_maker), &dest_id, &message_code));
+    EXPECT_FALSE(h9_sysexClassify(sysvars, 4, &dest_id, &message_code));
+    EXPECT_FALSE(h9_isSystemConfig(h9obj, (uint8_t *)sysex_hrmdlo, sizeof(sysex_hrmdlo) - 1));
+}
+
 /*
 Tests to do:
  - Loading a preset from sysex sets loaded and clears dirty
@@ -254,10 +421,6 @@ Tests to do:
     (does it reset the expression pedal position, does it "ignore" it until it updates? - and does the catch-up mode matter?)
     and then test that the behaviour matches.
  - Test generator methods for requesting data
- - When incoming sysex id is 0, restrict is ignored (correctly)
- - When incoming sysex id is not 0, and h9 sysex id is 0, restrict is ignored (correctly)
- - When incoming sysex id is not 0 and h9 sysex id is not 0, if restrict is set, the sysex is not processed
- - And when it is not set, the sysex is processed.
 */
 
 }  // namespace h9_test
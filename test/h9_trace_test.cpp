@@ -0,0 +1,233 @@
+/*  h9_trace_test.cpp
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "libh9.h"
+#include "test_helpers.hpp"
+
+#include "gtest/gtest.h"
+
+#define TEST_CLASS H9TraceTest
+
+namespace h9_test {
+
+// Test Fixture
+class TEST_CLASS : public ::testing::Test {
+ protected:
+    void SetUp() override {
+#ifndef H9_TRACE
+        GTEST_SKIP() << "Built without H9_TRACE";
+#endif
+        init_callback_helpers();
+        h9obj = h9_new();
+        Drain();  // Anything left over from other tests
+        h9_traceEnable(true);
+    }
+
+    void TearDown() override {
+        h9_traceEnable(false);
+        h9_delete(h9obj);
+    }
+
+    std::vector<h9_trace_record> Drain(void) {
+        std::vector<h9_trace_record> records(4 * H9_TRACE_RING_SIZE);
+        records.resize(h9_traceDrain(records.data(), records.size()));
+        return records;
+    }
+
+    size_t Dump(uint8_t *sysex, size_t max_len) {
+        return h9_dump(h9obj, sysex, max_len, false);
+    }
+
+    h9 *h9obj = nullptr;
+};
+
+TEST_F(TEST_CLASS, parse_recordsEventsInOrder) {
+    uint8_t sysex[1000];
+    size_t  len = Dump(sysex, sizeof(sysex));
+    ASSERT_GT(len, 0);
+    ASSERT_EQ(h9_parse_sysex(h9obj, sysex, len, kH9_RESTRICT_TO_SYSEX_ID), kH9_OK);
+
+    std::vector<h9_trace_record> records = Drain();
+    ASSERT_EQ(records.size(), 3);
+    EXPECT_EQ(records[0].event, kH9_TRACE_DUMP);
+    EXPECT_EQ(records[0].args[0], len);
+    EXPECT_EQ(records[1].event, kH9_TRACE_PRESET_FOUND);
+    EXPECT_EQ(records[1].args[1], h9obj->preset->module->sysex_id);
+    EXPECT_EQ(records[2].event, kH9_TRACE_SYSEX_PARSED);
+    EXPECT_EQ(records[2].args[1], len);
+    EXPECT_EQ(records[2].args[2], kH9_OK);
+    EXPECT_LE(records[0].timestamp, records[1].timestamp);
+    EXPECT_LE(records[1].timestamp, records[2].timestamp);
+    EXPECT_EQ(records[0].thread, records[2].thread);
+}
+
+TEST_F(TEST_CLASS, parse_badChecksum_recordsMismatch) {
+    uint8_t sysex[1000];
+    size_t  len = Dump(sysex, sizeof(sysex));
+    char   *checksum = strstr(reinterpret_cast<char *>(sysex), "C_");
+    ASSERT_NE(checksum, nullptr);
+    checksum[2] = (checksum[2] == '0') ? '1' : '0';
+    Drain();
+
+    EXPECT_EQ(h9_parse_sysex(h9obj, sysex, len, kH9_RESTRICT_TO_SYSEX_ID), kH9_SYSEX_CHECKSUM_INVALID);
+    std::vector<h9_trace_record> records = Drain();
+    ASSERT_EQ(records.size(), 3);
+    EXPECT_EQ(records[1].event, kH9_TRACE_PRESET_CHECKSUM);
+    EXPECT_NE(records[1].args[0], records[1].args[1]);
+    EXPECT_EQ(records[2].args[2], kH9_SYSEX_CHECKSUM_INVALID);
+}
+
+TEST_F(TEST_CLASS, ccLsbTimeout_recordsMicrosecondsSinceTheMsb) {
+    uint8_t knob_cc = h9obj->midi_config.cc_tx_map[KNOB0];
+    h9_ccAt(h9obj, knob_cc, 42, 1000.0);
+    h9_ccAt(h9obj, knob_cc + 32, 24, 1010.0);
+    h9_ccAt(h9obj, knob_cc, 42, 1000.0);
+    h9_ccAt(h9obj, knob_cc + 32, 24, 1.0E10);  // Far beyond what fits in 32 bits of microseconds
+
+    std::vector<h9_trace_record> records = Drain();
+    ASSERT_EQ(records.size(), 2);
+    EXPECT_EQ(records[0].event, kH9_TRACE_CC_LSB_DROPPED);
+    EXPECT_EQ(records[0].args[1], 10000);
+    EXPECT_EQ(records[1].args[1], UINT32_MAX);
+}
+
+TEST_F(TEST_CLASS, disabled_recordsNothing) {
+    uint8_t sysex[1000];
+    h9_traceEnable(false);
+    EXPECT_FALSE(h9_traceEnabled());
+    Dump(sysex, sizeof(sysex));
+    EXPECT_TRUE(Drain().empty());
+}
+
+TEST_F(TEST_CLASS, fullRing_dropsAndCounts) {
+    uint8_t  sysex[1000];
+    uint64_t dropped = h9_traceDropped();
+    for (size_t i = 0; i < H9_TRACE_RING_SIZE + 10; i++) {
+        Dump(sysex, sizeof(sysex));
+    }
+    EXPECT_EQ(Drain().size(), H9_TRACE_RING_SIZE);
+    EXPECT_EQ(h9_traceDropped() - dropped, 10);
+
+    // Draining makes room again
+    Dump(sysex, sizeof(sysex));
+    EXPECT_EQ(Drain().size(), 1);
+}
+
+TEST_F(TEST_CLASS, threads_writeToTheirOwnRings) {
+    uint8_t sysex[1000];
+    Dump(sysex, sizeof(sysex));
+    std::thread other([] {
+        h9     *other_h9 = h9_new();
+        uint8_t other_sysex[1000];
+        h9_dump(other_h9, other_sysex, sizeof(other_sysex), false);
+        h9_dump(other_h9, other_sysex, sizeof(other_sysex), false);
+        h9_delete(other_h9);
+    });
+    other.join();
+
+    std::vector<h9_trace_record> records = Drain();
+    ASSERT_EQ(records.size(), 3);
+    size_t mine = 0;
+    for (const h9_trace_record &record : records) {
+        EXPECT_EQ(record.event, kH9_TRACE_DUMP);
+        mine += (record.thread == records[0].thread) ? 1 : 0;
+    }
+    EXPECT_TRUE(mine == 1 || mine == 2);
+}
+
+static void *counting_alloc(void *ctx, size_t size) {
+    (*static_cast<size_t *>(ctx))++;
+    return malloc(size);
+}
+
+static void counting_free(void *, void *ptr) {
+    free(ptr);
+}
+
+TEST_F(TEST_CLASS, rings_stayOutsideTheAllocator) {
+    h9_delete(h9obj);
+    h9obj = nullptr;
+    size_t       allocations = 0;
+    h9_allocator counting    = {counting_alloc, counting_free, &allocations};
+    ASSERT_TRUE(h9_setAllocator(&counting));
+    std::thread other([] {
+        h9     *other_h9 = h9_new();
+        uint8_t sysex[1000];
+        h9_dump(other_h9, sysex, sizeof(sysex), false);  // A new thread, so a new ring
+        h9_delete(other_h9);
+    });
+    other.join();
+    EXPECT_EQ(allocations, 2);              // The h9 and a preset slab, not the ring
+    EXPECT_TRUE(h9_setAllocator(nullptr));  // Nothing the ring holds is live
+    h9obj = h9_new();
+}
+
+TEST_F(TEST_CLASS, formatRecord) {
+    h9_trace_record record = {2000, kH9_TRACE_PRESET_FOUND, 3, {7, 4, 2, 0, 0}};
+    char            line[128];
+    size_t          len = h9_traceFormatRecord(&record, 1000.0, line, sizeof(line));
+    EXPECT_EQ(len, strlen(line));
+    EXPECT_STREQ(line, "      2.000000 [3] preset_found         preset 7, module 4, algorithm 2");
+
+    // Truncation keeps snprintf semantics
+    EXPECT_EQ(h9_traceFormatRecord(&record, 1000.0, line, 10), len);
+    EXPECT_EQ(strlen(line), 9);
+
+    record.event = kH9_TRACE_NUM_EVENTS;
+    h9_traceFormatRecord(&record, 1000.0, line, sizeof(line));
+    EXPECT_NE(strstr(line, "unknown event"), nullptr);
+    EXPECT_EQ(h9_traceEventName(kH9_TRACE_NUM_EVENTS), nullptr);
+    EXPECT_STREQ(h9_traceEventName(kH9_TRACE_CC_LSB_DROPPED), "cc_lsb_dropped");
+}
+
+TEST_F(TEST_CLASS, save_writesHeaderAndRecords) {
+    uint8_t sysex[1000];
+    Dump(sysex, sizeof(sysex));
+    Dump(sysex, sizeof(sysex));
+    std::string path = "h9_trace_test_" + std::to_string(getpid()) + ".bin";
+    ASSERT_TRUE(h9_traceSave(path.c_str()));
+
+    FILE *file = fopen(path.c_str(), "rb");
+    ASSERT_NE(file, nullptr);
+    h9_trace_file_header header;
+    h9_trace_record      records[3];
+    ASSERT_EQ(fread(&header, sizeof(header), 1, file), 1);
+    size_t count = fread(records, sizeof(*records), 3, file);
+    fclose(file);
+    unlink(path.c_str());
+
+    EXPECT_EQ(header.magic, H9_TRACE_MAGIC);
+    EXPECT_EQ(header.version, H9_TRACE_VERSION);
+    EXPECT_EQ(header.record_size, sizeof(h9_trace_record));
+    EXPECT_EQ(header.num_records, 2);
+    EXPECT_GT(header.ticks_per_second, 0.0);
+    ASSERT_EQ(count, 2);
+    EXPECT_EQ(records[0].event, kH9_TRACE_DUMP);
+    EXPECT_TRUE(Drain().empty());
+}
+
+}  // namespace h9_test
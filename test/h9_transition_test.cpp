@@ -0,0 +1,164 @@
+/*  h9_transition_test.cpp
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include "libh9.h"
+#include "test_helpers.hpp"
+
+#include "gtest/gtest.h"
+
+#define TEST_CLASS      H9TransitionTest
+#define DEFAULT_KNOB_CC 22  // Per the user guide
+
+namespace h9_test {
+
+static size_t sysex_sent_len(void) {
+    uint8_t *sysex = nullptr;
+    size_t   len   = 0;
+    sysex_callback_triggered(&sysex, &len);
+    return len;
+}
+
+// Test Fixture
+class TEST_CLASS : public ::testing::Test {
+ protected:
+    void SetUp() override {
+        init_callback_helpers();
+        h9obj                   = h9_new();
+        h9obj->cc_callback      = cc_callback;
+        h9obj->display_callback = display_callback;
+        h9obj->sysex_callback   = sysex_callback;
+        h9_setAlgorithm(h9obj, 1, 2);
+        target = h9_preset_clone(h9obj->preset);
+        ASSERT_NE(target, nullptr);
+        init_callback_helpers();
+    }
+
+    void TearDown() override {
+        h9_preset_delete(target);
+        h9_delete(h9obj);
+    }
+
+    h9 *       h9obj;
+    h9_preset *target;
+};
+
+TEST_F(TEST_CLASS, h9_transitionTo_samePreset_sendsNothing) {
+    strcpy(target->name, "Other Name");  // The name alone is not worth a sysex
+
+    EXPECT_EQ(h9_transitionTo(h9obj, target), kH9_TRANSITION_NONE);
+    EXPECT_EQ(cc_callback_count(), 0);
+    EXPECT_EQ(sysex_sent_len(), 0);
+    EXPECT_STREQ(h9_presetName(h9obj, nullptr), "Empty");
+}
+
+TEST_F(TEST_CLASS, h9_transitionTo_knobChanges_sendsOnlyChangedKnobCCs) {
+    target->knobs[KNOB2].current_value = 1.0;
+    target->knobs[KNOB7].current_value = 0.25;
+
+    EXPECT_EQ(h9_transitionTo(h9obj, target), kH9_TRANSITION_CC);
+    EXPECT_EQ(cc_callback_count(), 2);
+    uint8_t msb = 0;
+    EXPECT_TRUE(cc_callback_triggered(DEFAULT_KNOB_CC + 2, &msb));
+    EXPECT_EQ(msb, 0x7F);
+    EXPECT_TRUE(cc_callback_triggered(DEFAULT_KNOB_CC + 7, &msb));
+    EXPECT_EQ(msb, 0x1F);
+    EXPECT_FALSE(cc_callback_triggered(DEFAULT_KNOB_CC, nullptr));
+    EXPECT_EQ(sysex_sent_len(), 0);
+
+    EXPECT_DOUBLE_EQ(h9_controlValue(h9obj, KNOB2), 1.0);
+    EXPECT_DOUBLE_EQ(h9_controlValue(h9obj, KNOB7), 0.25);
+    control_value display = 0.0;
+    EXPECT_TRUE(display_callback_triggered(KNOB7, &display));
+    EXPECT_DOUBLE_EQ(display, 0.25);
+}
+
+TEST_F(TEST_CLASS, h9_transitionTo_pswChange_sendsPswCC) {
+    h9_midi_config config;
+    h9_copyMidiConfig(h9obj, &config);
+    config.cc_rx_map[PSW] = 5;  // PSW rx is disabled by default
+    ASSERT_TRUE(h9_setMidiConfig(h9obj, &config));
+    target->psw = true;
+
+    EXPECT_EQ(h9_transitionTo(h9obj, target), kH9_TRANSITION_CC);
+    EXPECT_EQ(cc_callback_count(), 1);
+    EXPECT_TRUE(cc_callback_triggered(5, nullptr));
+    EXPECT_DOUBLE_EQ(h9_controlValue(h9obj, PSW), 1.0);
+}
+
+TEST_F(TEST_CLASS, h9_transitionTo_exprWithoutRxCC_fallsBackToSysex) {
+    target->expression = 0.5;  // EXPR rx is disabled by default
+
+    EXPECT_EQ(h9_transitionTo(h9obj, target), kH9_TRANSITION_SYSEX);
+    EXPECT_EQ(cc_callback_count(), 0);
+    EXPECT_GT(sysex_sent_len(), 0);
+    EXPECT_DOUBLE_EQ(h9_controlValue(h9obj, EXPR), 0.5);
+}
+
+TEST_F(TEST_CLASS, h9_transitionTo_exprWithRxCC_sendsExprCC) {
+    h9_midi_config config;
+    h9_copyMidiConfig(h9obj, &config);
+    config.cc_rx_map[EXPR] = 4;
+    ASSERT_TRUE(h9_setMidiConfig(h9obj, &config));
+    target->expression = 0.5;
+
+    EXPECT_EQ(h9_transitionTo(h9obj, target), kH9_TRANSITION_CC);
+    EXPECT_TRUE(cc_callback_triggered(4, nullptr));
+    EXPECT_DOUBLE_EQ(h9_controlValue(h9obj, EXPR), 0.5);
+}
+
+TEST_F(TEST_CLASS, h9_transitionTo_differentAlgorithm_sendsSysex) {
+    target->algorithm                  = h9_algorithmAt(1, 3);
+    target->knobs[KNOB0].current_value = 0.75;
+    strcpy(target->name, "Scene B");
+
+    EXPECT_EQ(h9_transitionTo(h9obj, target), kH9_TRANSITION_SYSEX);
+    EXPECT_EQ(cc_callback_count(), 0);
+    EXPECT_GT(sysex_sent_len(), 0);
+    EXPECT_EQ(h9_currentAlgorithm(h9obj), h9_algorithmAt(1, 3));
+    EXPECT_DOUBLE_EQ(h9_controlValue(h9obj, KNOB0), 0.75);
+    EXPECT_STREQ(h9_presetName(h9obj, nullptr), "Scene B");
+    EXPECT_FALSE(h9_dirty(h9obj));
+}
+
+TEST_F(TEST_CLASS, h9_transitionTo_differentKnobMap_sendsSysex) {
+    target->knobs[KNOB3].exp_mapped = true;
+    target->knobs[KNOB3].exp_max    = 1.0;
+
+    EXPECT_EQ(h9_transitionTo(h9obj, target), kH9_TRANSITION_SYSEX);
+    EXPECT_TRUE(h9_knobExprMapped(h9obj, KNOB3));
+}
+
+TEST_F(TEST_CLASS, h9_planTransition_countsBytesAndSendsNothing) {
+    h9_transition_plan plan;
+    target->knobs[KNOB0].current_value = 0.0;
+    target->knobs[KNOB1].current_value = 0.5 + 1.0 / 65536.0;  // Below the resolution of a 14-bit CC
+
+    EXPECT_EQ(h9_planTransition(h9obj, target, &plan), kH9_TRANSITION_CC);
+    EXPECT_EQ(plan.controls, 1U << KNOB0);
+    EXPECT_FALSE(plan.sysex_required);
+    EXPECT_EQ(plan.cc_bytes, H9_TRANSITION_CC_BYTES);
+    EXPECT_GT(plan.sysex_bytes, plan.cc_bytes);
+    EXPECT_EQ(cc_callback_count(), 0);
+    EXPECT_EQ(sysex_sent_len(), 0);
+    EXPECT_DOUBLE_EQ(h9_controlValue(h9obj, KNOB0), 0.5);
+}
+
+}  // namespace h9_test
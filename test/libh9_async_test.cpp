@@ -0,0 +1,240 @@
+/*  libh9_async_test.cpp
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include "libh9_async.hpp"
+
+#include "gtest/gtest.h"
+
+#define TEST_CLASS H9AsyncTest
+
+namespace h9_test {
+
+struct FakeClock {
+    using duration                  = std::chrono::milliseconds;
+    using rep                       = duration::rep;
+    using period                    = duration::period;
+    using time_point                = std::chrono::time_point<FakeClock>;
+    static constexpr bool is_steady = true;
+
+    static inline time_point current{};
+    static time_point        now() noexcept {
+        return current;
+    }
+    static void advance(duration by) {
+        current += by;
+    }
+};
+
+// Holds resumed coroutines until run(), like an event loop would
+struct QueueExecutor {
+    std::vector<std::coroutine_handle<>>* queue;
+
+    void post(std::coroutine_handle<> handle) {
+        queue->push_back(handle);
+    }
+};
+
+using Pedal = libh9::AsyncPedal<libh9::InlineExecutor, FakeClock>;
+
+struct Wire {
+    std::vector<std::vector<uint8_t>> sent;
+
+    auto sender() {
+        return [this](libh9::span<uint8_t> sysex) { sent.emplace_back(sysex.data(), sysex.data() + sysex.size()); };
+    }
+};
+
+static std::vector<uint8_t> value_dump(uint16_t key, uint32_t value) {
+    char text[32];
+    snprintf(text, sizeof(text), "%x %x", key, value);
+    std::string sysex = std::string{'\xF0', H9_SYSEX_EVENTIDE, H9_SYSEX_H9, 0x01, 0x2e} + text + '\xF7';
+    return std::vector<uint8_t>(sysex.begin(), sysex.end());
+}
+
+static std::vector<uint8_t> program_dump(float knob) {
+    libh9::H9 other;
+    other.set<KNOB0>(knob);
+    std::vector<uint8_t> sysex(1000);
+    sysex.resize(other.dump(sysex));
+    return sysex;
+}
+
+static libh9::Task<libh9::Reply> read_var(Pedal& pedal, uint16_t key) {
+    co_return co_await pedal.readConfigVar(key);
+}
+
+TEST(TEST_CLASS, requestPreset_sendsRequestAndCompletesOnProgram) {
+    libh9::H9 h9;
+    Wire      wire;
+    Pedal     pedal(h9, wire.sender());
+
+    auto task = [](Pedal& pedal) -> libh9::Task<libh9::Reply> { co_return co_await pedal.requestPreset(); }(pedal);
+    task.start();
+    ASSERT_EQ(wire.sent.size(), 1);
+    EXPECT_EQ(wire.sent[0][4], 0x4e);  // DUMP_ONE
+    EXPECT_FALSE(task.done());
+    EXPECT_EQ(pedal.inFlight(), 1);
+
+    std::vector<uint8_t> program = program_dump(0.25f);
+    EXPECT_EQ(pedal.receive(program), kH9_OK);
+    ASSERT_TRUE(task.done());
+    libh9::Reply reply = task.result();
+    EXPECT_TRUE(reply);
+    EXPECT_FALSE(reply.timed_out);
+    EXPECT_FLOAT_EQ(h9.controlValue(KNOB0), 0.25f);
+    EXPECT_EQ(pedal.inFlight(), 0);
+}
+
+TEST(TEST_CLASS, readConfigVar_matchesResponsesByKey) {
+    libh9::H9 h9;
+    Wire      wire;
+    Pedal     pedal(h9, wire.sender());
+
+    auto bypass = read_var(pedal, 0x102);
+    auto tempo  = read_var(pedal, 0x100);
+    bypass.start();
+    tempo.start();
+    EXPECT_EQ(wire.sent.size(), 2);
+    EXPECT_EQ(pedal.inFlight(), 2);
+
+    pedal.receive(value_dump(0x100, 0x2ee0));
+    EXPECT_FALSE(bypass.done());
+    ASSERT_TRUE(tempo.done());
+    EXPECT_EQ(tempo.result().value, 0x2ee0);
+
+    pedal.receive(value_dump(0x102, 1));
+    ASSERT_TRUE(bypass.done());
+    libh9::Reply reply = bypass.result();
+    EXPECT_TRUE(reply);
+    EXPECT_EQ(reply.value, 1);
+}
+
+TEST(TEST_CLASS, receive_completesOldestMatchingExchangeFirst) {
+    libh9::H9 h9;
+    Wire      wire;
+    Pedal     pedal(h9, wire.sender());
+
+    auto first  = read_var(pedal, 0x102);
+    auto second = read_var(pedal, 0x102);
+    first.start();
+    second.start();
+
+    pedal.receive(value_dump(0x102, 1));
+    EXPECT_TRUE(first.done());
+    EXPECT_FALSE(second.done());
+    pedal.receive(value_dump(0x102, 0));
+    ASSERT_TRUE(second.done());
+    EXPECT_EQ(second.result().value, 0);
+}
+
+TEST(TEST_CLASS, receive_ignoresUnsolicitedAndForeignSysex) {
+    libh9::H9 h9;
+    Wire      wire;
+    Pedal     pedal(h9, wire.sender());
+
+    auto task = read_var(pedal, 0x102);
+    task.start();
+    std::vector<uint8_t> foreign{0xF0, 0x41, 0x10, 0x01, 0x2e, 0xF7};
+    EXPECT_NE(pedal.receive(foreign), kH9_OK);
+    pedal.receive(program_dump(0.5f));
+    pedal.receive(value_dump(0x100, 0x2ee0));
+    EXPECT_FALSE(task.done());
+    EXPECT_EQ(pedal.inFlight(), 1);
+}
+
+TEST(TEST_CLASS, poll_timesOutOverdueExchanges) {
+    libh9::H9 h9;
+    Wire      wire;
+    Pedal     pedal(h9, wire.sender());
+
+    auto slow = [](Pedal& pedal) -> libh9::Task<libh9::Reply> { co_return co_await pedal.requestSystemConfig(std::chrono::milliseconds(100)); }(pedal);
+    auto fast = [](Pedal& pedal) -> libh9::Task<libh9::Reply> { co_return co_await pedal.requestPreset(std::chrono::milliseconds(10)); }(pedal);
+    slow.start();
+    fast.start();
+
+    FakeClock::advance(std::chrono::milliseconds(50));
+    pedal.poll();
+    ASSERT_TRUE(fast.done());
+    libh9::Reply reply = fast.result();
+    EXPECT_FALSE(reply);
+    EXPECT_TRUE(reply.timed_out);
+    EXPECT_FALSE(slow.done());
+
+    FakeClock::advance(std::chrono::milliseconds(50));
+    pedal.poll();
+    ASSERT_TRUE(slow.done());
+    EXPECT_TRUE(slow.result().timed_out);
+    EXPECT_EQ(pedal.inFlight(), 0);
+}
+
+TEST(TEST_CLASS, task_sequencesExchangesInOneCoroutine) {
+    libh9::H9 h9;
+    Wire      wire;
+    Pedal     pedal(h9, wire.sender());
+
+    auto sync = [](Pedal& pedal) -> libh9::Task<uint32_t> {
+        libh9::Reply preset = co_await pedal.requestPreset();
+        libh9::Reply bypass = co_await read_var(pedal, 0x102);
+        co_return preset && bypass ? bypass.value + 1 : 0;
+    }(pedal);
+    sync.start();
+    ASSERT_EQ(wire.sent.size(), 1);
+    pedal.receive(program_dump(0.75f));
+    ASSERT_EQ(wire.sent.size(), 2);  // The second request goes out once the first is answered
+    EXPECT_FALSE(sync.done());
+    pedal.receive(value_dump(0x102, 1));
+    ASSERT_TRUE(sync.done());
+    EXPECT_EQ(sync.result(), 2);
+}
+
+TEST(TEST_CLASS, executor_defersResumption) {
+    libh9::H9                            h9;
+    Wire                                 wire;
+    std::vector<std::coroutine_handle<>> queue;
+    libh9::AsyncPedal<QueueExecutor, FakeClock> pedal(h9, wire.sender(), QueueExecutor{&queue});
+
+    auto task = [](auto& pedal) -> libh9::Task<libh9::Reply> { co_return co_await pedal.readConfigVar(0x102); }(pedal);
+    task.start();
+    pedal.receive(value_dump(0x102, 1));
+    EXPECT_FALSE(task.done());
+    EXPECT_EQ(pedal.inFlight(), 0);
+    ASSERT_EQ(queue.size(), 1);
+    queue[0].resume();
+    ASSERT_TRUE(task.done());
+    EXPECT_EQ(task.result().value, 1);
+}
+
+TEST(TEST_CLASS, destroyingSuspendedTask_cancelsItsExchange) {
+    libh9::H9 h9;
+    Wire      wire;
+    Pedal     pedal(h9, wire.sender());
+    {
+        auto task = read_var(pedal, 0x102);
+        task.start();
+        EXPECT_EQ(pedal.inFlight(), 1);
+    }
+    EXPECT_EQ(pedal.inFlight(), 0);
+    pedal.receive(value_dump(0x102, 1));  // Nothing left to resume
+}
+
+}  // namespace h9_test
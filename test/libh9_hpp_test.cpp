@@ -0,0 +1,145 @@
+/*  libh9_hpp_test.cpp
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <array>
+#include <string_view>
+#include <vector>
+#include "libh9.hpp"
+#include "test_helpers.hpp"
+
+#include "gtest/gtest.h"
+
+#define TEST_CLASS H9CppTest
+
+namespace h9_test {
+
+TEST(TEST_CLASS, H9_constructs_andOwnsAnInstance) {
+    libh9::H9 pedal;
+    ASSERT_TRUE(pedal);
+    EXPECT_NE(pedal.get(), nullptr);
+    EXPECT_EQ(pedal.moduleName(), std::string_view(h9_currentModuleName(pedal.get())));
+}
+
+TEST(TEST_CLASS, H9_move_transfersOwnershipAndCallbacks) {
+    libh9::H9 pedal;
+    int       displays = 0;
+    pedal.onDisplay([&displays](control_id, control_value, control_value) { displays++; });
+
+    libh9::H9 moved(std::move(pedal));
+    EXPECT_FALSE(pedal);
+    ASSERT_TRUE(moved);
+    moved.set<KNOB1>(0.25f);
+    EXPECT_EQ(displays, 1);
+
+    libh9::H9 assigned;
+    assigned = std::move(moved);
+    assigned.set<KNOB1>(0.75f);
+    EXPECT_EQ(displays, 2);
+}
+
+TEST(TEST_CLASS, H9_release_unregistersCallbacks) {
+    libh9::H9 pedal;
+    int       displays = 0;
+    pedal.onDisplay([&displays](control_id, control_value, control_value) { displays++; });
+    h9 *raw = pedal.release();
+    EXPECT_FALSE(pedal);
+    EXPECT_EQ(raw->display_callback, nullptr);
+    h9_delete(raw);
+}
+
+TEST(TEST_CLASS, set_andValue_matchTheCApi) {
+    libh9::H9 pedal;
+    pedal.set<KNOB4>(0.3f);
+    pedal.set<EXPR>(0.6f);
+    pedal.set<PSW>(1.0f);
+    EXPECT_EQ(pedal.value<KNOB4>(), h9_controlValue(pedal.get(), KNOB4));
+    EXPECT_EQ(pedal.value<EXPR>(), h9_controlValue(pedal.get(), EXPR));
+    EXPECT_EQ(pedal.value<PSW>(), 1.0f);
+    EXPECT_EQ(pedal.displayValue<KNOB4>(), h9_displayValue(pedal.get(), KNOB4));
+    EXPECT_EQ(pedal.displayValue<EXPR>(), h9_displayValue(pedal.get(), EXPR));
+    EXPECT_TRUE(pedal.dirty());
+}
+
+TEST(TEST_CLASS, ccBatch_takesAContainer) {
+    libh9::H9                pedal;
+    uint8_t                  cc     = pedal.get()->midi_config.cc_tx_map[KNOB2];
+    std::vector<h9_cc_event> events = {{10.0, cc, 127}, {11.0, (uint8_t)(cc + 32), 127}};
+    pedal.ccBatch(events);
+    EXPECT_EQ(pedal.value<KNOB2>(), 1.0f);
+}
+
+TEST(TEST_CLASS, dumpAndParse_roundTripThroughContainers) {
+    libh9::H9 source;
+    ASSERT_TRUE(source.setAlgorithm(2, 1));
+    ASSERT_TRUE(source.setPresetName("SPANS"));
+    source.set<KNOB2>(0.125f);
+    std::array<uint8_t, 1000> sysex;
+    size_t                    len = source.dump(sysex);
+    ASSERT_GT(len, 0);
+    ASSERT_LE(len, sysex.size());
+
+    std::vector<uint8_t> message(sysex.begin(), sysex.begin() + len);
+    libh9::H9            dest;
+    EXPECT_EQ(dest.parse(message), kH9_OK);
+    EXPECT_EQ(dest.presetName(), "SPANS");
+    EXPECT_EQ(dest.algorithmName(), source.algorithmName());
+    EXPECT_NEAR(dest.value<KNOB2>(), 0.125f, 0.001f);
+}
+
+TEST(TEST_CLASS, parse_ofEmptySpan_fails) {
+    libh9::H9 pedal;
+    EXPECT_NE(pedal.parse({}), kH9_OK);
+}
+
+TEST(TEST_CLASS, callbacks_receiveTheirArguments) {
+    libh9::H9 pedal;
+    pedal.get()->midi_config.cc_rx_map[KNOB0] = 22;
+    uint8_t         last_cc                  = 0;
+    size_t          sysex_len                = 0;
+    control_id      last_display             = NUM_CONTROLS;
+    h9_control_mask changed                  = 0;
+    pedal.onCc([&last_cc](uint8_t, uint8_t cc, uint8_t, uint8_t) { last_cc = cc; });
+    pedal.onSysex([&sysex_len](libh9::span<uint8_t> sysex) { sysex_len = sysex.size(); });
+    pedal.onDisplay([&last_display](control_id control, control_value, control_value) { last_display = control; });
+
+    pedal.set<KNOB0>(0.3f, kH9_TRIGGER_CALLBACK);
+    EXPECT_EQ(last_cc, 22);
+    EXPECT_EQ(last_display, KNOB0);
+    h9_sysexRequestCurrentPreset(pedal.get());
+    EXPECT_GT(sysex_len, 0);
+
+    pedal.onBatchDisplay([&changed](h9_control_mask mask) { changed = mask; });
+    pedal.beginUpdate();
+    pedal.setControl(KNOB3, 0.1f);
+    pedal.commitUpdate();
+    EXPECT_EQ(changed, 1U << KNOB3);
+
+    // Unregistering
+    pedal.onDisplay(nullptr);
+    EXPECT_EQ(pedal.get()->display_callback, nullptr);
+}
+
+TEST(TEST_CLASS, names_areStringViews) {
+    EXPECT_EQ(libh9::moduleName(0), std::string_view(h9_moduleName(0)));
+    EXPECT_TRUE(libh9::moduleName(200).empty());
+    EXPECT_EQ(libh9::algorithmName(1, 0), std::string_view(h9_algorithmName(1, 0)));
+}
+
+}  // namespace h9_test
@@ -0,0 +1,142 @@
+/*  rt_safety_test.c
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Checks the real-time safe subset of the API (see libh9.h) never allocates, locks or reads the clock. Linked with
+// --wrap for each of those, so any call to them made while in_rt_section is set is counted as a violation; the exit
+// status is 0 on success or the number of the failed check.
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "libh9.h"
+
+static bool   in_rt_section;
+static size_t violations;
+static size_t display_updates;
+static size_t ccs_sent;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void  __real_free(void *ptr);
+int   __real_clock_gettime(clockid_t clock, struct timespec *now);
+int   __real_pthread_mutex_lock(pthread_mutex_t *mutex);
+
+void *__wrap_malloc(size_t size) {
+    violations += in_rt_section;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    violations += in_rt_section;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    violations += in_rt_section;
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr) {
+    violations += in_rt_section;
+    __real_free(ptr);
+}
+
+int __wrap_clock_gettime(clockid_t clock, struct timespec *now) {
+    violations += in_rt_section;
+    return __real_clock_gettime(clock, now);
+}
+
+int __wrap_pthread_mutex_lock(pthread_mutex_t *mutex) {
+    violations += in_rt_section;
+    return __real_pthread_mutex_lock(mutex);
+}
+
+static void count_display(void *context, control_id control, control_value current_value, control_value display_value) {
+    display_updates++;
+}
+
+static void count_cc(void *context, uint8_t midi_channel, uint8_t cc_num, uint8_t msb, uint8_t lsb) {
+    ccs_sent++;
+}
+
+static double audio_clock(void *context) {
+    return *(double *)context;
+}
+
+#define CHECK(n, condition) \
+    if (!(condition)) {     \
+        return (n);         \
+    }
+
+int main(void) {
+    h9 *h9 = h9_new();
+    CHECK(1, h9 != NULL);
+    h9->display_callback                 = count_display;
+    h9->cc_callback                      = count_cc;
+    h9->midi_config.cc_rx_map[KNOB0]     = 22;
+    h9->midi_config.cc_tx_map[KNOB0]     = 22;
+    h9_control_update updates[]          = {{KNOB1, 0.1f}, {KNOB2, 0.2f}, {EXPR, 0.5f}, {PSW, 1.0f}};
+    char              display[16];
+    double            audio_time         = 0.0;
+    h9_cc_event       batch[]            = {{0.0, 22, 0x10}, {0.5, 22 + 32, 0x20}, {2.0, 22, 0x30}, {9.0, 22 + 32, 0x40}};
+    h9_setClock(h9, audio_clock, &audio_time);
+    h9_traceEnable(true);
+    CHECK(2, h9_traceRegisterThread());
+
+    in_rt_section = true;
+    for (int i = 0; i < 1000; i++) {
+        double now = 10.0 * i;
+        h9_ccAt(h9, 22, (uint8_t)(i & 0x7F), now);
+        h9_ccAt(h9, 22 + 32, 0x40, now + 0.5);  // Paired LSB
+        h9_ccAt(h9, 22 + 32, 0x40, now + 1.0);  // Unpaired LSB
+        h9_ccBatch(h9, batch, sizeof(batch) / sizeof(batch[0]));
+        audio_time = now + 5.0;
+        h9_cc(h9, 22, 0x50);  // On the audio clock
+        for (control_id control = KNOB0; control < NUM_CONTROLS; control++) {
+            h9_setControl(h9, control, (control_value)(i % 100) / 100.0f, kH9_TRIGGER_CALLBACK);
+            (void)h9_controlValue(h9, control);
+            (void)h9_displayValue(h9, control);
+        }
+        h9_setControls(h9, updates, sizeof(updates) / sizeof(updates[0]), kH9_TRIGGER_CALLBACK);
+        h9_beginUpdate(h9);
+        h9_setControl(h9, KNOB3, 0.75f, kH9_TRIGGER_CALLBACK);
+        h9_commitUpdate(h9);
+        h9_displayString(h9, KNOB3, display, sizeof(display));
+        (void)h9_knobRangeLookup(h9_knobRange(h9_currentAlgorithm(h9), KNOB3), 0.5f);
+        (void)h9_exprResponse(h9, 0.5f);
+    }
+    in_rt_section = false;
+    CHECK(3, violations == 0);
+    CHECK(4, display_updates > 0 && ccs_sent > 0);
+
+    // The wrapping works: h9_cc reads the clock, once it's back on the OS clock
+    h9_setClock(h9, NULL, NULL);
+    in_rt_section = true;
+    h9_cc(h9, 22, 0);
+    in_rt_section = false;
+    CHECK(5, violations > 0);
+
+    h9_traceEnable(false);
+    h9_delete(h9);
+    return 0;
+}
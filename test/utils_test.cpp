@@ -21,6 +21,8 @@
 #include "utils.h"
 #include <math.h>
 #include <string.h>
+#include <string>
+#include <vector>
 #include "libh9.h"
 #include "test_helpers.hpp"
 
@@ -166,4 +168,127 @@ TEST_F(TEST_CLASS, find_lines_whenNoTrailingNewline_works) {
     EXPECT_EQ(lengths[5], 1);
 }
 
+TEST_F(TEST_CLASS, format_fixed_formatsDecimals) {
+    char buf[16];
+    EXPECT_EQ(format_fixed(buf, sizeof(buf), 0, 0), 1);
+    EXPECT_STREQ(buf, "0");
+    EXPECT_EQ(format_fixed(buf, sizeof(buf), 1234, 0), 4);
+    EXPECT_STREQ(buf, "1234");
+    EXPECT_EQ(format_fixed(buf, sizeof(buf), 1234, 2), 5);
+    EXPECT_STREQ(buf, "12.34");
+    EXPECT_EQ(format_fixed(buf, sizeof(buf), 5, 2), 4);
+    EXPECT_STREQ(buf, "0.05");
+    EXPECT_EQ(format_fixed(buf, sizeof(buf), -125, 1), 5);
+    EXPECT_STREQ(buf, "-12.5");
+}
+
+TEST_F(TEST_CLASS, format_fixed_truncatesToFit) {
+    char buf[4];
+    EXPECT_EQ(format_fixed(buf, sizeof(buf), 123456, 0), 3);
+    EXPECT_STREQ(buf, "123");
+    EXPECT_EQ(format_fixed(buf, 0, 1, 0), 0);
+}
+
+TEST_F(TEST_CLASS, scandec_scansSignedValues) {
+    char    string[]   = " 12 -3  0 7x 9";
+    int32_t scanned[5] = {0};
+    size_t  found      = scandec(string, strlen(string), scanned, 5);
+    ASSERT_EQ(found, 4);  // Stops at the x
+    EXPECT_EQ(scanned[0], 12);
+    EXPECT_EQ(scanned[1], -3);
+    EXPECT_EQ(scanned[2], 0);
+    EXPECT_EQ(scanned[3], 7);
+    EXPECT_EQ(scandec(string, strlen(string), scanned, 1), 1);
+}
+
+TEST_F(TEST_CLASS, scanfloat_scansDecimals) {
+    char  string[] = "65000 0.5 -1.25 12";
+    float scanned[4];
+    ASSERT_EQ(scanfloat(string, strlen(string), scanned, 4), 4);
+    EXPECT_FLOAT_EQ(scanned[0], 65000.0f);
+    EXPECT_FLOAT_EQ(scanned[1], 0.5f);
+    EXPECT_FLOAT_EQ(scanned[2], -1.25f);
+    EXPECT_FLOAT_EQ(scanned[3], 12.0f);
+}
+
+TEST_F(TEST_CLASS, round_even_matchesRintf) {
+    float values[] = {0.0f, 0.4f, 0.5f, 1.5f, 2.5f, 2.6f, -0.5f, -1.5f, -2.4f, 32735.5f, 12050.0f};
+    for (float value : values) {
+        EXPECT_EQ(round_even(value), (int32_t)rintf(value)) << value;
+    }
+}
+
+TEST_F(TEST_CLASS, writer_behavesLikeSnprintf) {
+    char        buf[8];
+    text_writer writer;
+    writer_init(&writer, buf, sizeof(buf));
+    write_string(&writer, "C_");
+    write_hex(&writer, 0xbeef);
+    write_char(&writer, ' ');
+    write_decimal(&writer, -42);
+    EXPECT_EQ(writer_finish(&writer), 10U);  // As snprintf, the untruncated length of "C_beef -42"
+    EXPECT_STREQ(buf, "C_beef ");
+}
+
+TEST_F(TEST_CLASS, hexdump_groupsWords) {
+    uint8_t data[] = {0x00, 0x1f, 0xa0, 0xff, 0x42};
+    char    buf[32];
+    EXPECT_EQ(hexdump(buf, sizeof(buf), data, sizeof(data)), 11);
+    EXPECT_STREQ(buf, "001fa0ff 42");
+}
+
+// The byte at a time hexdump which the table driven one replaced, to check the bounds behaviour is unchanged
+static size_t reference_hexdump(char *dest, size_t max_len, uint8_t *data, size_t len) {
+    static const char digits[] = "0123456789abcdef";
+    size_t            cursor   = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (cursor + 2 < max_len) {
+            dest[cursor++] = digits[data[i] >> 4];
+            dest[cursor++] = digits[data[i] & 0xF];
+            dest[cursor]   = '\0';
+            if ((cursor + 1 < max_len) && (i != 0) && ((i + 1) % 4 == 0)) {
+                dest[cursor++] = ' ';
+                dest[cursor]   = '\0';
+            }
+        }
+    }
+    return cursor;
+}
+
+TEST_F(TEST_CLASS, hexdump_matchesReferenceForEveryBound) {
+    uint8_t data[23];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t)(i * 37 + 5);
+    }
+    for (size_t len = 0; len <= sizeof(data); len++) {
+        for (size_t max_len = 0; max_len < 60; max_len++) {
+            char expected[64];
+            char actual[64];
+            memset(expected, '#', sizeof(expected));
+            memset(actual, '#', sizeof(actual));
+            size_t expected_len = reference_hexdump(expected, max_len, data, len);
+            ASSERT_EQ(hexdump(actual, max_len, data, len), expected_len) << "len " << len << " max_len " << max_len;
+            ASSERT_EQ(memcmp(actual, expected, sizeof(actual)), 0) << "len " << len << " max_len " << max_len;
+        }
+    }
+}
+
+static void append_chunk(void *context, const char *chunk, size_t len) {
+    static_cast<std::string *>(context)->append(chunk, len);
+}
+
+TEST_F(TEST_CLASS, hexdumpStream_concatenatesToTheFullHexdump) {
+    std::vector<uint8_t> data(HEXDUMP_CHUNK_BYTES * 3 + 7);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = (uint8_t)(i ^ (i >> 8));
+    }
+    std::vector<char> full(data.size() * 3 + 1);
+    size_t            full_len = hexdump(full.data(), full.size(), data.data(), data.size());
+
+    std::string streamed;
+    EXPECT_EQ(hexdump_stream(data.data(), data.size(), append_chunk, &streamed), full_len);
+    EXPECT_EQ(streamed, std::string(full.data(), full_len));
+    EXPECT_EQ(hexdump_stream(data.data(), 0, append_chunk, &streamed), 0);
+}
+
 }  // namespace h9_test
@@ -0,0 +1,233 @@
+#!/usr/bin/env python3
+#  h9_modgen.py
+#  This file is part of libh9, a library for remotely managing Eventide H9
+#  effects pedals.
+#
+#  Copyright (C) 2020 Daniel Collins
+#
+#  This program is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+"""Generates h9_modules.c (the module/algorithm tables) from the CSVs in data/.
+
+All names, labels and units are packed into a single deduplicated string pool
+and the tables refer to them by 16-bit offset, so the whole thing is const and
+lives in .rodata without any relocations.
+
+Each knob is also assigned a display range from the ranges CSV. Every distinct
+range gets a precomputed table of its display values (fixed point, scaled by
+10^decimals), so rendering a knob's display text is a table lookup.
+
+Usage: h9_modgen.py <modules.csv> <algorithms.csv> <ranges.csv> <output.c>
+"""
+
+import csv
+import math
+import sys
+
+NUM_KNOBS = 10
+MAX_ALGORITHMS = 12
+MAX_POOL_SIZE = 0xFFFF
+MAX_RANGES = 0xFF
+CURVES = ("linear", "log")
+
+
+def read_csv(path):
+    with open(path, newline="") as f:
+        lines = [line for line in f if not line.lstrip().startswith("#")]
+    rows = [[cell.strip() for cell in row] for row in csv.reader(lines)]
+    return [row for row in rows[1:] if row]  # drop the header and any blank lines
+
+
+def load_modules(path):
+    modules = []
+    for row in read_csv(path):
+        sysex_id, name, psw_mode = int(row[0]), row[1], int(row[2])
+        if sysex_id != len(modules) + 1:
+            sys.exit("%s: modules must be listed in sysex id order (got %d)" % (path, sysex_id))
+        modules.append({"name": name, "sysex_id": sysex_id, "psw_mode": psw_mode, "algorithms": []})
+    return modules
+
+
+def load_algorithms(path, modules):
+    for row in read_csv(path):
+        if len(row) != 3 + NUM_KNOBS + 1:
+            sys.exit("%s: expected %d columns, got %d: %s" % (path, 3 + NUM_KNOBS + 1, len(row), row))
+        alg_id, module_sysex_id, name = int(row[0]), int(row[1]), row[2]
+        if module_sysex_id < 1 or module_sysex_id > len(modules):
+            sys.exit("%s: unknown module %d for %s" % (path, module_sysex_id, name))
+        module = modules[module_sysex_id - 1]
+        if alg_id != len(module["algorithms"]):
+            sys.exit("%s: algorithms must be listed in id order (%s)" % (path, name))
+        if alg_id >= MAX_ALGORITHMS:
+            sys.exit("%s: too many algorithms in module %s" % (path, module["name"]))
+        module["algorithms"].append({"id": alg_id, "name": name, "labels": row[3 : 3 + NUM_KNOBS], "psw": row[-1]})
+
+
+def load_ranges(path):
+    rules = []
+    for row in read_csv(path):
+        if len(row) != 9:
+            sys.exit("%s: expected 9 columns, got %d: %s" % (path, len(row), row))
+        module, algorithm, label = row[0:3]
+        lo, hi, steps, decimals = float(row[3]), float(row[4]), int(row[5]), int(row[6])
+        unit, curve = row[7], row[8]
+        if curve not in CURVES:
+            sys.exit("%s: unknown curve '%s'" % (path, curve))
+        if steps < 2 or steps > 0xFFFF or decimals < 0 or decimals > 9:
+            sys.exit("%s: invalid steps/decimals for %s" % (path, label))
+        if curve == "log" and (lo <= 0 or hi <= 0):
+            sys.exit("%s: log ranges must be strictly positive (%s)" % (path, label))
+        specificity = sum(1 for key in (module, algorithm, label) if key != "*")
+        rules.append({"key": (module, algorithm, label), "specificity": specificity, "range": (lo, hi, steps, decimals, unit, curve)})
+    if not any(rule["specificity"] == 0 for rule in rules):
+        sys.exit("%s: a catch-all (*,*,*) range is required" % path)
+    return rules
+
+
+def match_range(rules, module, algorithm, label):
+    best = None
+    for rule in rules:
+        if all(key in ("*", value) for key, value in zip(rule["key"], (module, algorithm, label))):
+            if best is None or rule["specificity"] > best["specificity"]:
+                best = rule
+    return best["range"]
+
+
+def display_values(lo, hi, steps, decimals, curve):
+    scale = 10**decimals
+    values = []
+    for i in range(steps):
+        x = i / (steps - 1)
+        value = lo + (hi - lo) * x if curve == "linear" else lo * math.pow(hi / lo, x)
+        values.append(int(math.floor(value * scale + 0.5)))
+    return values
+
+
+class StringPool:
+    """Null-terminated strings packed back to back. Exact duplicates and strings
+    which are a suffix of an already pooled string share storage."""
+
+    def __init__(self, strings):
+        self.offsets = {}
+        self.data = ""
+        # Longest first, so shorter strings can land inside the tail of a longer one.
+        for s in sorted(set(strings), key=lambda s: (-len(s), s)):
+            for placed, offset in self.offsets.items():
+                if placed.endswith(s):
+                    self.offsets[s] = offset + len(placed) - len(s)
+                    break
+            else:
+                self.offsets[s] = len(self.data)
+                self.data += s + "\0"
+        if len(self.data) > MAX_POOL_SIZE:
+            sys.exit("String pool is %d bytes, which does not fit a 16-bit offset." % len(self.data))
+
+    def __getitem__(self, s):
+        return self.offsets[s]
+
+
+def c_string_chunks(data, width=100):
+    chunk = ""
+    for i, ch in enumerate(data):
+        token = "\\0" if ch == "\0" else ch.replace("\\", "\\\\").replace('"', '\\"')
+        if ch == "\0" and data[i + 1 : i + 2].isdigit():
+            token += '" "'  # keep a following digit out of the octal escape
+        chunk += token
+        if ch == "\0" and len(chunk) >= width:
+            yield chunk
+            chunk = ""
+    if chunk:
+        yield chunk
+
+
+def generate(modules, rules, sources):
+    ranges = []  # distinct ranges, in order of first use
+    strings = []
+    for module in modules:
+        strings.append(module["name"])
+        for alg in module["algorithms"]:
+            strings += [alg["name"], alg["psw"]] + alg["labels"]
+            alg["ranges"] = []
+            for label in alg["labels"]:
+                knob_range = match_range(rules, module["name"], alg["name"], label)
+                if knob_range not in ranges:
+                    ranges.append(knob_range)
+                alg["ranges"].append(ranges.index(knob_range))
+    if len(ranges) > MAX_RANGES:
+        sys.exit("Too many distinct knob ranges (%d)" % len(ranges))
+    strings += [r[4] for r in ranges]
+    pool = StringPool(strings)
+
+    out = []
+    out.append("/* Generated by tools/h9_modgen.py from %s. DO NOT EDIT. */\n" % ", ".join(sources))
+    out.append('#include "h9_modules.h"\n')
+    num_algorithms = sum(len(m["algorithms"]) for m in modules)
+    out.append("_Static_assert(H9_NUM_MODULES == %d, \"H9_NUM_MODULES does not match the module table\");" % len(modules))
+    out.append("_Static_assert(H9_NUM_ALGORITHMS == %d, \"H9_NUM_ALGORITHMS does not match the algorithm table\");\n" % num_algorithms)
+
+    out.append("const char h9_strings[%d] =" % len(pool.data))
+    chunks = list(c_string_chunks(pool.data))
+    for i, chunk in enumerate(chunks):
+        out.append('    "%s"%s' % (chunk, ";" if i == len(chunks) - 1 else ""))
+    out.append("")
+
+    table = []
+    out.append("const h9_knob_range h9_knob_ranges[%d] = {" % len(ranges))
+    for lo, hi, steps, decimals, unit, curve in ranges:
+        values = display_values(lo, hi, steps, decimals, curve)
+        out.append("    {%d, %d, %d, %d},  // %g..%g %s (%s)" % (len(table), steps, pool[unit], decimals, lo, hi, unit, curve))
+        table += values
+    out.append("};\n")
+    if len(table) > 0xFFFF:
+        sys.exit("Display tables total %d entries, which does not fit a 16-bit offset." % len(table))
+
+    out.append("const int32_t h9_display_table[%d] = {" % len(table))
+    for i in range(0, len(table), 16):
+        out.append("    " + ", ".join("%d" % v for v in table[i : i + 16]) + ",")
+    out.append("};\n")
+
+    out.append("const h9_algorithm h9_algorithms[H9_NUM_ALGORITHMS] = {")
+    for index, module in enumerate(modules):
+        for alg in module["algorithms"]:
+            labels = ", ".join("%d" % pool[label] for label in alg["labels"])
+            knob_ranges = ", ".join("%d" % r for r in alg["ranges"])
+            out.append(
+                "    {%d, %d, %d, {%s}, %d, {%s}},  // %s: %s"
+                % (alg["id"], index, pool[alg["name"]], labels, pool[alg["psw"]], knob_ranges, module["name"], alg["name"])
+            )
+    out.append("};\n")
+
+    out.append("const h9_module h9_modules[H9_NUM_MODULES] = {")
+    first = 0
+    for module in modules:
+        count = len(module["algorithms"])
+        out.append("    {%d, %d, %d, %d, %d},  // %s" % (pool[module["name"]], module["sysex_id"], module["psw_mode"], first, count, module["name"]))
+        first += count
+    out.append("};")
+    return "\n".join(out) + "\n"
+
+
+def main(argv):
+    if len(argv) != 5:
+        sys.exit(__doc__)
+    modules = load_modules(argv[1])
+    load_algorithms(argv[2], modules)
+    rules = load_ranges(argv[3])
+    source = generate(modules, rules, [p.replace("\\", "/").split("/")[-1] for p in argv[1:4]])
+    with open(argv[4], "w", newline="\n") as f:
+        f.write(source)
+
+
+if __name__ == "__main__":
+    main(sys.argv)
@@ -0,0 +1,86 @@
+/*  h9_replay.c
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Replays a journal written by h9_journalStart into a fresh h9, checks that it produces the recorded outputs, and
+ * reports the throughput. Exits non-zero on any mismatch, so a recorded show doubles as a regression test.
+ *
+ * Usage: h9_replay [--realtime] [--repeat N] <journal>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libh9.h"
+
+int main(int argc, char *argv[]) {
+    h9_replay_speed speed  = kH9_REPLAY_FAST;
+    unsigned long   repeat = 1;
+    const char *    path   = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--realtime") == 0) {
+            speed = kH9_REPLAY_REALTIME;
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = strtoul(argv[++i], NULL, 10);
+        } else if (path == NULL && argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            path = NULL;
+            break;
+        }
+    }
+    if (path == NULL || repeat == 0) {
+        fprintf(stderr, "Usage: %s [--realtime] [--repeat N] <journal>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    h9_replay_result total;
+    memset(&total, 0x0, sizeof(total));
+    for (unsigned long i = 0; i < repeat; i++) {
+        h9 *h9obj = h9_new();
+        if (h9obj == NULL) {
+            return EXIT_FAILURE;
+        }
+        h9_replay_result result;
+        bool             ok = h9_journalReplay(path, h9obj, speed, &result);
+        h9_delete(h9obj);
+        if (!ok) {
+            fprintf(stderr, "%s: not a journal this build can replay\n", path);
+            return EXIT_FAILURE;
+        }
+        if (result.mismatches > 0 && total.mismatches == 0) {
+            total.first_mismatch = result.first_mismatch;
+        }
+        total.inputs += result.inputs;
+        total.outputs += result.outputs;
+        total.mismatches += result.mismatches;
+        total.seconds += result.seconds;
+    }
+
+    double seconds = (total.seconds > 0.0) ? total.seconds : 1.0E-9;
+    printf("%llu inputs, %llu outputs matched, %llu mismatches in %.3f s (%.0f inputs/s)\n", (unsigned long long)total.inputs,
+           (unsigned long long)total.outputs, (unsigned long long)total.mismatches, total.seconds, (double)total.inputs / seconds);
+    if (total.mismatches > 0) {
+        printf("first mismatch at record %llu\n", (unsigned long long)total.first_mismatch);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
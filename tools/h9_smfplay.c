@@ -0,0 +1,111 @@
+/*  h9_smfplay.c
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Plays a Standard MIDI File (format 0 or 1) into one h9, or into a fleet whose instances listen on channels and
+ * sysex ids 1-16 in turn, and reports how many CCs and sysex messages went in and how fast.
+ *
+ * Usage: h9_smfplay [--realtime] [--fleet N] [--repeat N] <file.mid>
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libh9.h"
+
+static void add_result(h9_smf_result *total, const h9_smf_result *result) {
+    total->ccs += result->ccs;
+    total->sysex += result->sysex;
+    total->skipped += result->skipped;
+    total->song_seconds += result->song_seconds;
+    total->seconds += result->seconds;
+}
+
+int main(int argc, char *argv[]) {
+    h9_smf_speed  speed     = kH9_SMF_FAST;
+    unsigned long repeat    = 1;
+    unsigned long num_fleet = 0;
+    const char *  path      = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--realtime") == 0) {
+            speed = kH9_SMF_REALTIME;
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--fleet") == 0 && i + 1 < argc) {
+            num_fleet = strtoul(argv[++i], NULL, 10);
+        } else if (path == NULL && argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            path = NULL;
+            break;
+        }
+    }
+    if (path == NULL || repeat == 0) {
+        fprintf(stderr, "Usage: %s [--realtime] [--fleet N] [--repeat N] <file.mid>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    h9_smf *smf = h9_smfOpen(path);
+    if (smf == NULL) {
+        fprintf(stderr, "%s: %s\n", path, (errno == EINVAL) ? "not a format 0 or 1 MIDI file" : strerror(errno));
+        return EXIT_FAILURE;
+    }
+    h9_fleet *fleet = NULL;
+    h9 *      h9obj = NULL;
+    if (num_fleet > 0) {
+        fleet = h9_fleet_new(num_fleet);
+        for (size_t i = 0; fleet != NULL && i < num_fleet; i++) {
+            h9 *instance                          = h9_fleetInstance(fleet, i);
+            instance->midi_config.midi_rx_channel = (uint8_t)(i % 16);
+            instance->midi_config.sysex_id        = (uint8_t)(i % 16 + 1);
+        }
+    } else {
+        h9obj = h9_new();
+    }
+    if (fleet == NULL && h9obj == NULL) {
+        h9_smfClose(smf);
+        return EXIT_FAILURE;
+    }
+
+    h9_smf_result total;
+    memset(&total, 0x0, sizeof(total));
+    for (unsigned long i = 0; i < repeat; i++) {
+        h9_smf_result result;
+        if (fleet == NULL) {
+            h9_smfPlay(smf, h9obj, speed, &result);
+        } else if (!h9_smfPlayFleet(smf, fleet, speed, &result)) {
+            fprintf(stderr, "Out of memory\n");
+            break;
+        }
+        add_result(&total, &result);
+    }
+
+    double seconds = (total.seconds > 0.0) ? total.seconds : 1.0E-9;
+    printf("format %u, %u tracks, %llu events, %.3f s of music\n", h9_smfFormat(smf), h9_smfNumTracks(smf),
+           (unsigned long long)h9_smfNumEvents(smf), total.song_seconds / (double)repeat);
+    printf("%llu CCs, %llu sysex, %llu skipped in %.3f s (%.0f events/s)\n", (unsigned long long)total.ccs, (unsigned long long)total.sysex,
+           (unsigned long long)total.skipped, total.seconds, (double)(total.ccs + total.sysex) / seconds);
+    h9_fleet_delete(fleet);
+    h9_delete(h9obj);
+    h9_smfClose(smf);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,83 @@
+/*  h9_tracedecode.c
+    This file is part of libh9, a library for remotely managing Eventide H9
+    effects pedals.
+
+    Copyright (C) 2020 Daniel Collins
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Formats a trace file written by h9_traceSave, one record per line, ordered by timestamp across all threads and
+ * relative to the first record.
+ *
+ * Usage: h9_tracedecode <trace file>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libh9.h"
+
+static int compare_timestamps(const void *a, const void *b) {
+    uint64_t ta = ((const h9_trace_record *)a)->timestamp;
+    uint64_t tb = ((const h9_trace_record *)b)->timestamp;
+    return (ta > tb) - (ta < tb);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <trace file>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    FILE *file = fopen(argv[1], "rb");
+    if (file == NULL) {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    h9_trace_file_header header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != H9_TRACE_MAGIC) {
+        fprintf(stderr, "%s: not an h9 trace file\n", argv[1]);
+        fclose(file);
+        return EXIT_FAILURE;
+    }
+    if (header.version != H9_TRACE_VERSION || header.record_size != sizeof(h9_trace_record) || header.ticks_per_second <= 0.0) {
+        fprintf(stderr, "%s: unsupported trace version %u (record size %u)\n", argv[1], header.version, header.record_size);
+        fclose(file);
+        return EXIT_FAILURE;
+    }
+
+    h9_trace_record *records = malloc((header.num_records > 0 ? header.num_records : 1) * sizeof(*records));
+    if (records == NULL) {
+        fclose(file);
+        return EXIT_FAILURE;
+    }
+    size_t count = fread(records, sizeof(*records), header.num_records, file);
+    fclose(file);
+    if (count != header.num_records) {
+        fprintf(stderr, "%s: truncated, %zu of %u records\n", argv[1], count, header.num_records);
+    }
+
+    qsort(records, count, sizeof(*records), compare_timestamps);
+    uint64_t start = (count > 0) ? records[0].timestamp : 0;
+    char     line[256];
+    for (size_t i = 0; i < count; i++) {
+        records[i].timestamp -= start;
+        h9_traceFormatRecord(&records[i], header.ticks_per_second, line, sizeof(line));
+        puts(line);
+    }
+    free(records);
+    return EXIT_SUCCESS;
+}